@@ -0,0 +1,159 @@
+//*********************************************************
+//
+// MemoryMappedFile
+//
+// Read-only view of an entire file mapped into memory, so
+// that parsers can work directly out of the OS page cache
+// instead of issuing a read call for every chunk.
+//
+// Uses file mapping objects on Windows and mmap on POSIX.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace DXRenderer
+{
+    class MemoryMappedFile
+    {
+    public:
+        MemoryMappedFile() : m_data(nullptr), m_size(0) {}
+        ~MemoryMappedFile() { Close(); }
+
+        MemoryMappedFile(const MemoryMappedFile&) = delete;
+        MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+        bool IsMapped() const { return m_data != nullptr; }
+        const uint8_t* GetData() const { return m_data; }
+        uint64_t GetSize() const { return m_size; }
+
+#ifdef _WIN32
+        /// <summary>
+        /// Maps the file behind an open handle. The handle must have GENERIC_READ access
+        /// and may be closed once this returns.
+        /// </summary>
+        /// <returns>false if the file can't be mapped, e.g. it is empty or too large for the
+        /// address space. GetLastError() has more information.</returns>
+        bool Map(_In_ HANDLE hFile)
+        {
+            Close();
+
+            LARGE_INTEGER size = {};
+            if (!GetFileSizeEx(hFile, &size) || size.QuadPart <= 0 ||
+                static_cast<uint64_t>(size.QuadPart) > static_cast<uint64_t>(SIZE_MAX))
+            {
+                return false;
+            }
+
+            HANDLE mapping = CreateFileMappingFromApp(hFile, nullptr, PAGE_READONLY, 0, nullptr);
+            if (!mapping)
+            {
+                return false;
+            }
+
+            void* view = MapViewOfFileFromApp(mapping, FILE_MAP_READ, 0, 0);
+
+            // The view holds its own reference to the mapping.
+            CloseHandle(mapping);
+
+            if (!view)
+            {
+                return false;
+            }
+
+            m_data = static_cast<const uint8_t*>(view);
+            m_size = static_cast<uint64_t>(size.QuadPart);
+            return true;
+        }
+
+        bool Open(_In_z_ const wchar_t* fileName)
+        {
+            HANDLE hFile = CreateFile2(fileName, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+            if (hFile == INVALID_HANDLE_VALUE)
+            {
+                return false;
+            }
+
+            bool mapped = Map(hFile);
+            CloseHandle(hFile);
+            return mapped;
+        }
+
+        void Close()
+        {
+            if (m_data)
+            {
+                UnmapViewOfFile(m_data);
+            }
+
+            m_data = nullptr;
+            m_size = 0;
+        }
+#else
+        /// <summary>
+        /// Maps the file behind an open descriptor, which may be closed once this returns.
+        /// </summary>
+        /// <returns>false if the file can't be mapped; errno has more information.</returns>
+        bool Map(int fd)
+        {
+            Close();
+
+            struct stat info = {};
+            if (fstat(fd, &info) != 0 || info.st_size <= 0 ||
+                static_cast<uint64_t>(info.st_size) > static_cast<uint64_t>(SIZE_MAX))
+            {
+                return false;
+            }
+
+            void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view == MAP_FAILED)
+            {
+                return false;
+            }
+
+            m_data = static_cast<const uint8_t*>(view);
+            m_size = static_cast<uint64_t>(info.st_size);
+            return true;
+        }
+
+        bool Open(const char* fileName)
+        {
+            int fd = open(fileName, O_RDONLY);
+            if (fd < 0)
+            {
+                return false;
+            }
+
+            bool mapped = Map(fd);
+            close(fd);
+            return mapped;
+        }
+
+        void Close()
+        {
+            if (m_data)
+            {
+                munmap(const_cast<uint8_t*>(m_data), static_cast<size_t>(m_size));
+            }
+
+            m_data = nullptr;
+            m_size = 0;
+        }
+#endif
+
+    private:
+        const uint8_t*                                          m_data;
+        uint64_t                                                m_size;
+    };
+}
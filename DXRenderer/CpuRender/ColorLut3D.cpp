@@ -0,0 +1,208 @@
+//*********************************************************
+//
+// ColorLut3D
+//
+// See ColorLut3D.h. Tetrahedral interpolation splits each
+// lattice cube into 6 tetrahedra along its main diagonal, so
+// a lookup reads 4 lattice points instead of trilinear's 8,
+// and reproduces neutral (r = g = b) inputs from the diagonal
+// alone, which keeps grays free of hue shifts.
+//
+//*********************************************************
+
+#include "ColorLut3D.h"
+#include "ParallelFor.h"
+#include "../MagicConstants.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+using namespace DXRenderer;
+
+namespace
+{
+    // PQ linear light is 1.0 = 10000 nits.
+    const float sc_pqMaxNits = 10000.0f;
+}
+
+ColorLut3D::ColorLut3D(ColorLutDomain domain, unsigned int size, const Function& func, unsigned int threadCount) :
+    m_domain(domain),
+    m_size((std::min)((std::max)(size, sc_ColorLutMinSize), sc_ColorLutMaxSize)),
+    m_domainMax(domain == ColorLutDomain::Pq ? sc_pqMaxNits / sc_SceneReferredSdrWhiteNits : 1.0f)
+{
+    m_table.resize(static_cast<size_t>(m_size) * m_size * m_size);
+
+    float scale = 1.0f / (m_size - 1);
+
+    // One blue slice per unit of work.
+    ParallelFor(0, m_size, 1, threadCount, [&](size_t first, size_t last)
+    {
+        for (size_t b = first; b < last; b++)
+        {
+            for (unsigned int g = 0; g < m_size; g++)
+            {
+                XMFLOAT4A* row = &m_table[(b * m_size + g) * m_size];
+
+                for (unsigned int r = 0; r < m_size; r++)
+                {
+                    XMVECTOR coord = XMVectorSet(r * scale, g * scale, b * scale, 1.0f);
+                    XMStoreFloat4A(&row[r], XMVectorSetW(func(Decode(coord)), 1.0f));
+                }
+            }
+        }
+    });
+}
+
+XMVECTOR XM_CALLCONV ColorLut3D::Encode(FXMVECTOR color) const
+{
+    if (m_domain == ColorLutDomain::Pq)
+    {
+        // Through the table rather than XMVECTOR PqInverseEotf, which is two pows per channel.
+        XMFLOAT4A c;
+        XMStoreFloat4A(&c, XMVectorScale(color, sc_SceneReferredSdrWhiteNits / sc_pqMaxNits));
+
+        return XMVectorSet(m_pqEncode(c.x), m_pqEncode(c.y), m_pqEncode(c.z), c.w);
+    }
+
+    return color;
+}
+
+XMVECTOR XM_CALLCONV ColorLut3D::Decode(FXMVECTOR coord) const
+{
+    if (m_domain == ColorLutDomain::Pq)
+    {
+        // Baking isn't time critical, so lattice points use the double precision EOTF.
+        XMFLOAT4 c;
+        XMStoreFloat4(&c, coord);
+
+        double toScRgb = sc_pqMaxNits / sc_SceneReferredSdrWhiteNits;
+        return XMVectorSet(
+            static_cast<float>(PqEotf(static_cast<double>(c.x)) * toScRgb),
+            static_cast<float>(PqEotf(static_cast<double>(c.y)) * toScRgb),
+            static_cast<float>(PqEotf(static_cast<double>(c.z)) * toScRgb),
+            c.w);
+    }
+
+    return coord;
+}
+
+XMVECTOR XM_CALLCONV ColorLut3D::Map(FXMVECTOR color) const
+{
+    float last = static_cast<float>(m_size - 1);
+
+    // The cube's origin is clamped so the top face still has a cube to interpolate in.
+    XMVECTOR p = XMVectorScale(XMVectorSaturate(Encode(color)), last);
+    XMVECTOR origin = XMVectorMin(XMVectorFloor(p), XMVectorReplicate(last - 1.0f));
+
+    XMFLOAT4A o, f;
+    XMStoreFloat4A(&o, origin);
+    XMStoreFloat4A(&f, XMVectorSubtract(p, origin));
+
+    const size_t dr = 1;
+    const size_t dg = m_size;
+    const size_t db = static_cast<size_t>(m_size) * m_size;
+
+    const XMFLOAT4A* c000 = &m_table[static_cast<size_t>(o.z) * db + static_cast<size_t>(o.y) * dg + static_cast<size_t>(o.x)];
+
+    // The enclosing tetrahedron runs from c000 to c111, stepping along the axes in decreasing
+    // order of their fractions: steps are the offsets of its two middle vertices, and
+    // f0 >= f1 >= f2 the sorted fractions.
+    size_t step1, step2;
+    float f0, f1, f2;
+
+    if (f.x >= f.y)
+    {
+        if (f.y >= f.z)
+        {
+            step1 = dr; step2 = dr + dg; f0 = f.x; f1 = f.y; f2 = f.z;
+        }
+        else if (f.x >= f.z)
+        {
+            step1 = dr; step2 = dr + db; f0 = f.x; f1 = f.z; f2 = f.y;
+        }
+        else
+        {
+            step1 = db; step2 = db + dr; f0 = f.z; f1 = f.x; f2 = f.y;
+        }
+    }
+    else
+    {
+        if (f.x >= f.z)
+        {
+            step1 = dg; step2 = dg + dr; f0 = f.y; f1 = f.x; f2 = f.z;
+        }
+        else if (f.y >= f.z)
+        {
+            step1 = dg; step2 = dg + db; f0 = f.y; f1 = f.z; f2 = f.x;
+        }
+        else
+        {
+            step1 = db; step2 = db + dg; f0 = f.z; f1 = f.y; f2 = f.x;
+        }
+    }
+
+    // (1 - f0) c000 + (f0 - f1) c1 + (f1 - f2) c2 + f2 c111.
+    XMVECTOR rgb = XMVectorScale(XMLoadFloat4A(c000), 1.0f - f0);
+    rgb = XMVectorMultiplyAdd(XMVectorReplicate(f0 - f1), XMLoadFloat4A(c000 + step1), rgb);
+    rgb = XMVectorMultiplyAdd(XMVectorReplicate(f1 - f2), XMLoadFloat4A(c000 + step2), rgb);
+    rgb = XMVectorMultiplyAdd(XMVectorReplicate(f2), XMLoadFloat4A(c000 + dr + dg + db), rgb);
+
+    return XMVectorSelect(color, rgb, g_XMSelect1110);
+}
+
+ColorLut3DCache::ColorLut3DCache(size_t capacity) :
+    m_capacity((std::max)(capacity, size_t(1))),
+    m_hits(0),
+    m_misses(0)
+{
+}
+
+std::shared_ptr<const ColorLut3D> ColorLut3DCache::GetOrBake(const Key& key, const std::function<std::shared_ptr<const ColorLut3D>()>& bake)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+        {
+            if (it->first == key)
+            {
+                m_entries.splice(m_entries.begin(), m_entries, it);
+                m_hits++;
+
+                return m_entries.front().second;
+            }
+        }
+
+        m_misses++;
+    }
+
+    auto lut = bake();
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    m_entries.emplace_front(key, lut);
+    if (m_entries.size() > m_capacity)
+    {
+        m_entries.pop_back();
+    }
+
+    return lut;
+}
+
+void ColorLut3DCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_entries.clear();
+}
+
+size_t ColorLut3DCache::GetHitCount() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_hits;
+}
+
+size_t ColorLut3DCache::GetMissCount() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_misses;
+}
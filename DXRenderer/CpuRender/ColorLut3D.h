@@ -0,0 +1,132 @@
+//*********************************************************
+//
+// ColorLut3D
+//
+// A per pixel RGB to RGB function baked into a size^3 lattice
+// (usually 33^3 or 65^3) and evaluated by tetrahedral
+// interpolation. CpuRenderPipeline bakes color management,
+// tonemapping and gamut mapping into one of these, so each
+// pixel costs one lookup however many stages the render
+// options enable.
+//
+// The lattice is uniform over a shaped input domain, so that
+// the samples are spread evenly in perceptual terms: either
+// the input as is (for values which are already gamma
+// encoded), or PQ encoded scRGB. Values outside the domain
+// can't be looked up; the caller checks IsInDomain and
+// evaluates the function directly for those.
+//
+// Accuracy is limited by the lattice spacing: with 33 points
+// a smooth function over the PQ domain is within a few
+// percent above 1 nit, and hard clips are smoothed over one
+// lattice cell. 65 points reduce both by about 4x.
+//
+// ColorLut3DCache keeps recently baked LUTs so that pipelines
+// with the same settings bake once.
+//
+//*********************************************************
+
+#pragma once
+
+#include "TransferFunctions.h"
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace DXRenderer
+{
+    enum class ColorLutDomain
+    {
+        Unit,   // [0, 1], used as is, e.g. sRGB encoded values.
+        Pq      // [0, 125] scRGB (0 to 10000 nits), PQ encoded.
+    };
+
+    // Lattice sizes. 33 is the usual size for display LUTs; 65 when accuracy matters more than bake time.
+    const unsigned int sc_ColorLutDefaultSize = 33;
+    const unsigned int sc_ColorLutMinSize = 2;
+    const unsigned int sc_ColorLutMaxSize = 129;
+
+    class ColorLut3D
+    {
+    public:
+        typedef std::function<DirectX::XMVECTOR(DirectX::FXMVECTOR)> Function;
+
+        /// <summary>
+        /// Evaluates func at every lattice point. func takes and returns RGB; w is undefined on
+        /// input and ignored on output.
+        /// </summary>
+        /// <param name="size">Points per axis, clamped to [sc_ColorLutMinSize, sc_ColorLutMaxSize].</param>
+        /// <param name="threadCount">0 means use all hardware threads.</param>
+        ColorLut3D(ColorLutDomain domain, unsigned int size, const Function& func, unsigned int threadCount = 0);
+
+        ColorLutDomain GetDomain() const { return m_domain; }
+        unsigned int GetSize() const { return m_size; }
+
+        /// <summary>
+        /// True if all of r, g and b are inside the domain. False for NaN.
+        /// </summary>
+        bool XM_CALLCONV IsInDomain(DirectX::FXMVECTOR color) const
+        {
+            using namespace DirectX;
+
+            return XMVector3GreaterOrEqual(color, XMVectorZero()) && XMVector3LessOrEqual(color, XMVectorReplicate(m_domainMax));
+        }
+
+        /// <summary>
+        /// func(color) for a color inside the domain, interpolated from the 4 lattice points of the
+        /// enclosing tetrahedron. Alpha is passed through.
+        /// </summary>
+        DirectX::XMVECTOR XM_CALLCONV Map(DirectX::FXMVECTOR color) const;
+
+        /// <summary>
+        /// Lattice point (r, g, b), r varying fastest, e.g. to upload as a texture.
+        /// </summary>
+        const DirectX::XMFLOAT4A* GetTable() const { return m_table.data(); }
+
+    private:
+        DirectX::XMVECTOR XM_CALLCONV Encode(DirectX::FXMVECTOR color) const;
+        DirectX::XMVECTOR XM_CALLCONV Decode(DirectX::FXMVECTOR coord) const;
+
+        ColorLutDomain                                          m_domain;
+        unsigned int                                            m_size;
+        float                                                   m_domainMax;
+        PqInverseEotfTable                                      m_pqEncode;
+        std::vector<DirectX::XMFLOAT4A>                         m_table;
+    };
+
+    /// <summary>
+    /// Thread safe cache of the most recently used LUTs. Keys are any list of the values that
+    /// determine the baked function; CpuRenderPipeline uses its derived render parameters.
+    /// </summary>
+    class ColorLut3DCache
+    {
+    public:
+        typedef std::vector<float> Key;
+
+        explicit ColorLut3DCache(size_t capacity = 4);
+
+        /// <summary>
+        /// The cached LUT for key, or the result of bake, which is added to the cache. The lock is
+        /// not held while baking, so concurrent misses for the same key may bake twice.
+        /// </summary>
+        std::shared_ptr<const ColorLut3D> GetOrBake(const Key& key, const std::function<std::shared_ptr<const ColorLut3D>()>& bake);
+
+        void Clear();
+
+        size_t GetHitCount() const;
+        size_t GetMissCount() const;
+
+    private:
+        mutable std::mutex                                      m_lock;
+        std::list<std::pair<Key, std::shared_ptr<const ColorLut3D>>> m_entries; // Most recently used first.
+        size_t                                                  m_capacity;
+        size_t                                                  m_hits;
+        size_t                                                  m_misses;
+    };
+}
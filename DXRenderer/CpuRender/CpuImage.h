@@ -0,0 +1,46 @@
+//*********************************************************
+//
+// CpuImage
+//
+// Device-independent RGBA FP32 image buffer used by the
+// CpuRender pipeline. Pixels are tightly packed, row-major
+// and 16 byte aligned for SIMD access.
+//
+//*********************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+namespace DXRenderer
+{
+    class CpuImage
+    {
+    public:
+        CpuImage() : m_width(0), m_height(0) {}
+
+        CpuImage(unsigned int width, unsigned int height) :
+            m_width(width),
+            m_height(height),
+            m_pixels(static_cast<size_t>(width) * height)
+        {
+        }
+
+        unsigned int GetWidth() const { return m_width; }
+        unsigned int GetHeight() const { return m_height; }
+        size_t GetPixelCount() const { return m_pixels.size(); }
+        bool IsEmpty() const { return m_pixels.empty(); }
+
+        DirectX::XMFLOAT4A* GetPixels() { return m_pixels.data(); }
+        const DirectX::XMFLOAT4A* GetPixels() const { return m_pixels.data(); }
+
+        DirectX::XMFLOAT4A* GetRow(unsigned int y) { return m_pixels.data() + static_cast<size_t>(y) * m_width; }
+        const DirectX::XMFLOAT4A* GetRow(unsigned int y) const { return m_pixels.data() + static_cast<size_t>(y) * m_width; }
+
+    private:
+        unsigned int                                            m_width;
+        unsigned int                                            m_height;
+        std::vector<DirectX::XMFLOAT4A>                         m_pixels;
+    };
+}
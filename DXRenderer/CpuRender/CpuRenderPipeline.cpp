@@ -0,0 +1,401 @@
+//*********************************************************
+//
+// CpuRenderPipeline
+//
+// See CpuRenderPipeline.h. Each stage is a SIMD kernel that
+// operates on one scRGB pixel; all stages are fused into a
+// single pass over each band of rows. With options.lutSize
+// set, the stages which are a fixed function of the pixel's
+// color are baked into a ColorLut3D instead.
+//
+//*********************************************************
+
+#include "CpuRenderPipeline.h"
+#include "GainMapKernel.h"
+#include "ParallelFor.h"
+#include "../MagicConstants.h"
+#include "../Matrix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+using namespace DirectX;
+using namespace DXRenderer;
+
+namespace
+{
+    const XMVECTORF32 sc_bt709Luminance = { { { 0.2126f, 0.7152f, 0.0722f, 0.0f } } };
+
+    /// <summary>
+    /// Converts a 3x3 color matrix (column vector convention, as used by ColorMatrix) to
+    /// DirectXMath row vector convention.
+    /// </summary>
+    XMFLOAT4X4A MatrixToXM(const ColorMatrix& m)
+    {
+        XMFLOAT4X4A ret;
+        XMStoreFloat4x4A(&ret, XMMatrixIdentity());
+
+        for (size_t row = 0; row < 3; row++)
+        {
+            for (size_t col = 0; col < 3; col++)
+            {
+                ret.m[col][row] = static_cast<float>(m(row, col));
+            }
+        }
+
+        return ret;
+    }
+
+    inline XMVECTOR XM_CALLCONV TransformRgb(FXMVECTOR color, FXMMATRIX m)
+    {
+        // Alpha passthrough.
+        return XMVectorSelect(color, XMVector3TransformNormal(color, m), g_XMSelect1110);
+    }
+
+    inline float XM_CALLCONV GetNits(FXMVECTOR color)
+    {
+        return XMVectorGetX(XMVector3Dot(color, sc_bt709Luminance)) * sc_SceneReferredSdrWhiteNits;
+    }
+
+    // Equivalent to D2D1_COLORMANAGEMENT with an sRGB source profile.
+    inline XMVECTOR XM_CALLCONV SrgbToLinear(FXMVECTOR color)
+    {
+        XMVECTOR linearSegment = XMVectorMultiply(color, XMVectorReplicate(1.0f / 12.92f));
+        XMVECTOR curveSegment = XMVectorPow(
+            XMVectorMultiplyAdd(color, XMVectorReplicate(1.0f / 1.055f), XMVectorReplicate(0.055f / 1.055f)),
+            XMVectorReplicate(2.4f));
+
+        XMVECTOR rgb = XMVectorSelect(linearSegment, curveSegment, XMVectorGreater(color, XMVectorReplicate(0.04045f)));
+
+        // Alpha is not gamma encoded.
+        return XMVectorSelect(color, rgb, g_XMSelect1110);
+    }
+
+    inline XMVECTOR XM_CALLCONV ScaleRgb(FXMVECTOR color, float scale)
+    {
+        return XMVectorMultiply(color, XMVectorSet(scale, scale, scale, 1.0f));
+    }
+
+    // Same as MaxLuminanceEffect.hlsl.
+    inline XMVECTOR XM_CALLCONV MaxLuminance(FXMVECTOR color, float maxLuminance)
+    {
+        if (GetNits(color) >= maxLuminance)
+        {
+            return g_XMIdentityR3; // Opaque black.
+        }
+
+        return XMVectorSetW(color, 1.0f);
+    }
+
+    // Same as SdrOverlayEffect.hlsl.
+    inline XMVECTOR XM_CALLCONV SdrOverlay(FXMVECTOR color)
+    {
+        XMVECTOR rgb = XMVectorSetW(color, 0.5f);
+        if (XMVector4InBounds(XMVectorSubtract(rgb, XMVectorReplicate(0.5f)), XMVectorReplicate(0.5f)))
+        {
+            float lum = XMVectorGetX(XMVector3Dot(color, XMVectorSet(0.3f, 0.59f, 0.11f, 0.0f)));
+            return XMVectorSet(lum, lum, lum, 1.0f);
+        }
+
+        return XMVectorSetW(color, 1.0f);
+    }
+
+    // Direct2D's WhiteLevelAdjustment effect scales by (input white level / output white level).
+    inline float WhiteLevelAdjustmentScale(float inputWhiteLevel, float outputWhiteLevel)
+    {
+        return inputWhiteLevel / outputWhiteLevel;
+    }
+}
+
+CpuRenderPipeline::CpuRenderPipeline(const CpuSourceInfo& source, const CpuRenderOptions& options, ColorLut3DCache* lutCache) :
+    m_source(source),
+    m_options(options),
+    m_applyGamutMap(false),
+    m_gainMapScale(1.0f),
+    m_whiteScale(1.0f),
+    m_tonemapInputMax(1.0f),
+    m_tonemapOutputMax(1.0f),
+    m_applySdrWhiteScale(false),
+    m_sdrWhiteScale(1.0f),
+    m_maxLuminance(sc_SceneReferredSdrWhiteNits),
+    m_lutIncludesSource(false)
+{
+    // ColorManagement: source primaries to scRGB.
+    if (m_source.hasChromaticities)
+    {
+        auto& c = m_source.chromaticities;
+        auto sourceToXyz = ColorMatrix::RgbToXyzD65(c.redX, c.redY, c.greenX, c.greenY, c.blueX, c.blueY, c.whiteX, c.whiteY);
+        m_sourceToScRgb = MatrixToXM(sc_XyzToScRgb * sourceToXyz);
+    }
+    else
+    {
+        XMStoreFloat4x4A(&m_sourceToScRgb, XMMatrixIdentity());
+    }
+
+    float sdrWhite = m_options.hasDisplayInfo ? m_options.display.sdrWhiteLevelInNits : sc_SceneReferredSdrWhiteNits;
+    auto acKind = m_options.hasDisplayInfo ? m_options.display.kind : CpuAdvancedColorKind::HighDynamicRange;
+
+    // GainMapMerge.
+    m_gainMapScale = WhiteLevelAdjustmentScale(sdrWhite, sc_SceneReferredSdrWhiteNits);
+
+    // WhiteScale, see HDRImageViewerRenderer::UpdateWhiteLevelScale.
+    if (m_source.imageKind == CpuAdvancedColorKind::HighDynamicRange && !m_source.hasAppleHdrGainMap)
+    {
+        m_whiteScale = 1.0f;
+    }
+    else
+    {
+        m_whiteScale = sdrWhite / sc_SceneReferredSdrWhiteNits;
+    }
+
+    m_whiteScale *= m_options.exposureAdjustment;
+
+    // HdrTonemap and sdrWhiteScale.
+    float targetMaxNits = GetBestDispMaxLuminance(m_options);
+
+    float maxCLL = m_source.maxCLL != -1.0f ? m_source.maxCLL : sc_DefaultImageMaxCLL;
+    maxCLL *= m_options.exposureAdjustment;
+    maxCLL = (std::max)(maxCLL, sc_SceneReferredSdrWhiteNits);
+
+    m_tonemapInputMax = maxCLL / sc_SceneReferredSdrWhiteNits;
+    m_tonemapOutputMax = targetMaxNits / sc_SceneReferredSdrWhiteNits;
+
+    m_applySdrWhiteScale = acKind != CpuAdvancedColorKind::HighDynamicRange;
+    m_sdrWhiteScale = WhiteLevelAdjustmentScale(sc_SceneReferredSdrWhiteNits, (std::min)(targetMaxNits, maxCLL));
+
+    // MaxLuminance.
+    float lum = m_options.hasDisplayInfo ? m_options.display.maxLuminanceInNits : 0.0f;
+    m_maxLuminance = (std::min)((std::max)(lum, 80.0f), 10000.0f);
+
+    // Gamut constraint, see HDRImageViewerRenderer::UpdateGamutTransforms.
+    m_applyGamutMap = m_options.constrainGamut && m_options.hasDisplayInfo;
+    if (m_applyGamutMap)
+    {
+        auto& p = m_options.display.primaries;
+        auto panelToXyz = ColorMatrix::RgbToXyzD65(p.redX, p.redY, p.greenX, p.greenY, p.blueX, p.blueY, p.whiteX, p.whiteY);
+        auto transform = panelToXyz.Invert() * sc_ScRgbToXyz;
+
+        XMFLOAT4X4A scRgbToPanel = MatrixToXM(transform);
+        m_gamutCompressor = GamutCompressor(XMLoadFloat4x4A(&scRgbToPanel));
+    }
+
+    // The other effects have hard edges (MaxLuminance, SdrOverlay) or their own LUT (LuminanceHeatmap).
+    bool lutEffect = m_options.effect == CpuRenderEffectKind::HdrTonemap || m_options.effect == CpuRenderEffectKind::None;
+
+    if (m_options.lutSize != 0 && lutEffect)
+    {
+        DispatchTonemapper(m_options.tonemapOperator, m_tonemapInputMax, m_tonemapOutputMax, [&](const auto& tonemapper)
+        {
+            BakeLut(tonemapper, lutCache);
+        });
+    }
+}
+
+template <typename Curve>
+void CpuRenderPipeline::BakeLut(const Tonemapper<Curve>& tonemapper, ColorLut3DCache* lutCache)
+{
+    // The gain map varies per pixel, so with one the LUT starts after GainMapMerge, over scRGB.
+    // Otherwise it starts from the source values; sRGB encoded values are already evenly spread.
+    m_lutIncludesSource = !m_source.hasAppleHdrGainMap;
+
+    auto domain = m_lutIncludesSource && m_source.transfer == CpuSourceTransfer::Srgb ? ColorLutDomain::Unit : ColorLutDomain::Pq;
+
+    auto bake = [&]()
+    {
+        return std::make_shared<const ColorLut3D>(domain, m_options.lutSize, [&](FXMVECTOR color)
+        {
+            XMMATRIX sourceToScRgb = XMLoadFloat4x4A(&m_sourceToScRgb);
+
+            XMVECTOR scRgb = m_lutIncludesSource ? ManageColor(color, sourceToScRgb) : color;
+            return ApplyRenderOptions(scRgb, tonemapper);
+        });
+    };
+
+    m_lut = lutCache != nullptr ? lutCache->GetOrBake(GetLutKey(domain), bake) : bake();
+}
+
+// Every value the baked function depends on. Covers the source profile, display primaries,
+// max luminances and exposure through the values derived from them.
+ColorLut3DCache::Key CpuRenderPipeline::GetLutKey(ColorLutDomain domain) const
+{
+    ColorLut3DCache::Key key =
+    {
+        static_cast<float>(m_options.effect),
+        static_cast<float>(m_options.tonemapOperator),
+        static_cast<float>(domain),
+        static_cast<float>(m_options.lutSize),
+        m_lutIncludesSource ? 1.0f : 0.0f,
+        m_whiteScale,
+        m_tonemapInputMax,
+        m_tonemapOutputMax,
+        m_applySdrWhiteScale ? m_sdrWhiteScale : 0.0f,
+        m_applyGamutMap ? 1.0f : 0.0f,
+    };
+
+    if (m_lutIncludesSource)
+    {
+        key.push_back(static_cast<float>(m_source.transfer));
+        key.insert(key.end(), &m_sourceToScRgb.m[0][0], &m_sourceToScRgb.m[0][0] + 16);
+    }
+
+    if (m_applyGamutMap)
+    {
+        // Everything the compressor derives from the display primaries.
+        auto& constants = m_gamutCompressor.GetConstants();
+        const float* first = &constants.scRgbToPanel[0].x;
+        key.insert(key.end(), first, first + sizeof(constants) / sizeof(float));
+    }
+
+    return key;
+}
+
+// If AdvancedColorInfo does not have valid data, picks an appropriate default value,
+// or the manually overridden value. Same as HDRImageViewerRenderer::GetBestDispMaxLuminance.
+float CpuRenderPipeline::GetBestDispMaxLuminance(const CpuRenderOptions& options)
+{
+    float val = options.hasDisplayInfo ? options.display.maxLuminanceInNits : 0.0f;
+    auto acKind = options.hasDisplayInfo ? options.display.kind : CpuAdvancedColorKind::HighDynamicRange;
+
+    if (options.dispMaxCllOverride != 0.0f)
+    {
+        val = options.dispMaxCllOverride;
+    }
+
+    if (val == 0.0f)
+    {
+        val = acKind == CpuAdvancedColorKind::HighDynamicRange ? sc_DefaultHdrDispMaxNits : sc_DefaultSdrDispMaxNits;
+    }
+
+    return val;
+}
+
+bool CpuRenderPipeline::SetHeatmapStops(const ColormapStop* stops, size_t count)
+{
+    return m_colormap.SetStops(stops, count);
+}
+
+void CpuRenderPipeline::Render(CpuImage& image, const CpuImage* gainMap, unsigned int threadCount) const
+{
+    // The tonemapper is chosen here so each operator gets its own copy of the pixel loop.
+    DispatchTonemapper(m_options.tonemapOperator, m_tonemapInputMax, m_tonemapOutputMax, [&](const auto& tonemapper)
+    {
+        Process(image, gainMap, false, tonemapper, threadCount);
+    });
+}
+
+void CpuRenderPipeline::RenderSceneLinear(CpuImage& image, const CpuImage* gainMap, unsigned int threadCount) const
+{
+    Process(image, gainMap, true, Tonemapper<ReinhardCurve>(m_tonemapInputMax, m_tonemapOutputMax), threadCount);
+}
+
+XMVECTOR XM_CALLCONV CpuRenderPipeline::ManageColor(FXMVECTOR color, CXMMATRIX sourceToScRgb) const
+{
+    XMVECTOR linear = m_source.transfer == CpuSourceTransfer::Srgb ? SrgbToLinear(color) : color;
+    return TransformRgb(linear, sourceToScRgb);
+}
+
+template <typename Curve>
+XMVECTOR XM_CALLCONV CpuRenderPipeline::ApplyRenderOptions(FXMVECTOR color, const Tonemapper<Curve>& tonemapper) const
+{
+    XMVECTOR result;
+
+    switch (m_options.effect)
+    {
+    case CpuRenderEffectKind::HdrTonemap:
+        result = tonemapper(ScaleRgb(color, m_whiteScale));
+        if (m_applySdrWhiteScale)
+        {
+            result = ScaleRgb(result, m_sdrWhiteScale);
+        }
+        break;
+
+    case CpuRenderEffectKind::LuminanceHeatmap:
+        result = ScaleRgb(m_colormap.Map(color), m_whiteScale);
+        break;
+
+    case CpuRenderEffectKind::MaxLuminance:
+        result = ScaleRgb(MaxLuminance(color, m_maxLuminance), m_whiteScale);
+        break;
+
+    case CpuRenderEffectKind::SdrOverlay:
+        result = ScaleRgb(SdrOverlay(color), m_whiteScale);
+        break;
+
+    case CpuRenderEffectKind::None:
+    default:
+        result = ScaleRgb(color, m_whiteScale);
+        break;
+    }
+
+    // Soft compression into the panel gamut, same as GamutCompressionEffect.
+    if (m_applyGamutMap)
+    {
+        result = m_gamutCompressor(result);
+    }
+
+    return result;
+}
+
+XMVECTOR XM_CALLCONV CpuRenderPipeline::LookupLut(FXMVECTOR color) const
+{
+    // The baked effects all pass alpha through.
+    return m_lut->Map(color);
+}
+
+template <typename Curve>
+void CpuRenderPipeline::Process(CpuImage& image, const CpuImage* gainMap, bool sceneLinearOnly, const Tonemapper<Curve>& tonemapper, unsigned int threadCount) const
+{
+    bool useGainMap = m_source.hasAppleHdrGainMap && gainMap != nullptr && !gainMap->IsEmpty();
+
+    // Colors outside the LUT's domain (negative, or above 10000 nits) take the per stage path.
+    const ColorLut3D* lut = sceneLinearOnly ? nullptr : m_lut.get();
+    const ColorLut3D* sourceLut = m_lutIncludesSource ? lut : nullptr;
+    const ColorLut3D* scRgbLut = m_lutIncludesSource ? nullptr : lut;
+
+    // GainMapMerge: linearized and scaled once per gain map sample, then upsampled per pixel.
+    std::unique_ptr<GainMapKernel> gainMapKernel;
+    if (useGainMap)
+    {
+        gainMapKernel = std::make_unique<GainMapKernel>(*gainMap, image.GetWidth(), image.GetHeight(), m_gainMapScale, threadCount);
+    }
+
+    ParallelFor(0, image.GetHeight(), sc_DefaultRowsPerBand, threadCount, [&](size_t first, size_t last)
+    {
+        XMMATRIX sourceToScRgb = XMLoadFloat4x4A(&m_sourceToScRgb);
+
+        for (size_t y = first; y < last; y++)
+        {
+            XMFLOAT4A* row = image.GetRow(static_cast<unsigned int>(y));
+            GainMapKernel::Row gainRow = useGainMap ? gainMapKernel->GetRow(static_cast<unsigned int>(y)) : GainMapKernel::Row();
+
+            for (unsigned int x = 0; x < image.GetWidth(); x++)
+            {
+                XMVECTOR color = XMLoadFloat4A(&row[x]);
+
+                if (sourceLut != nullptr && sourceLut->IsInDomain(color))
+                {
+                    XMStoreFloat4A(&row[x], LookupLut(color));
+                    continue;
+                }
+
+                color = ManageColor(color, sourceToScRgb);
+
+                // GainMapMerge.
+                if (useGainMap)
+                {
+                    color = ScaleRgb(color, gainMapKernel->Sample(gainRow, x));
+                }
+
+                if (!sceneLinearOnly)
+                {
+                    color = scRgbLut != nullptr && scRgbLut->IsInDomain(color)
+                        ? LookupLut(color)
+                        : ApplyRenderOptions(color, tonemapper);
+                }
+
+                XMStoreFloat4A(&row[x], color);
+            }
+        }
+    });
+}
@@ -0,0 +1,184 @@
+//*********************************************************
+//
+// CpuRenderPipeline
+//
+// Device-independent reimplementation of the Direct2D effect
+// graph built by HDRImageViewerRenderer. Processes CpuImage
+// buffers using DirectXMath SIMD kernels, split into row bands
+// across threads. Does not depend on Direct2D, WIC or the
+// Windows Runtime so it can run on machines without a GPU.
+// The app itself still renders and exports with the
+// Direct2D graph; UnitTests exercises this pipeline.
+//
+// Keep in sync with HDRImageViewerRenderer::SetRenderOptions
+// and CreateImageDependentResources.
+//
+//*********************************************************
+
+#pragma once
+
+#include "ColorLut3D.h"
+#include "CpuImage.h"
+#include "GamutCompressor.h"
+#include "LuminanceColormap.h"
+#include "Tonemappers.h"
+
+namespace DXRenderer
+{
+    /// <summary>
+    /// Mirrors RenderEffectKind, which is a Windows Runtime type.
+    /// SphereMap is not supported as it is not ready for release.
+    /// </summary>
+    enum class CpuRenderEffectKind
+    {
+        HdrTonemap,
+        None,
+        SdrOverlay,
+        MaxLuminance,
+        LuminanceHeatmap
+    };
+
+    /// <summary>
+    /// Mirrors Windows::Graphics::Display::AdvancedColorKind.
+    /// </summary>
+    enum class CpuAdvancedColorKind
+    {
+        StandardDynamicRange,
+        WideColorGamut,
+        HighDynamicRange
+    };
+
+    /// <summary>
+    /// Transfer function of the source pixel values.
+    /// </summary>
+    enum class CpuSourceTransfer
+    {
+        Linear, // e.g. scRGB FP16/FP32, OpenEXR.
+        Srgb    // e.g. 8/16-bit integer SDR images.
+    };
+
+    /// <summary>
+    /// CIE xy chromaticity coordinates of a set of RGB primaries and white point.
+    /// </summary>
+    struct CpuChromaticities
+    {
+        float redX, redY;
+        float greenX, greenY;
+        float blueX, blueY;
+        float whiteX, whiteY;
+    };
+
+    /// <summary>
+    /// Mirrors the subset of AdvancedColorInfo used by the renderer.
+    /// </summary>
+    struct CpuDisplayInfo
+    {
+        CpuAdvancedColorKind    kind;
+        float                   maxLuminanceInNits;
+        float                   sdrWhiteLevelInNits;
+        CpuChromaticities       primaries;
+    };
+
+    /// <summary>
+    /// Properties of the source image which affect rendering. Corresponds to ImageInfo and ImageCLL.
+    /// </summary>
+    struct CpuSourceInfo
+    {
+        CpuAdvancedColorKind    imageKind;
+        bool                    hasAppleHdrGainMap;
+        float                   maxCLL;             // Nits. -1 if unknown.
+        CpuSourceTransfer       transfer;
+        bool                    hasChromaticities;  // If false, source primaries are BT.709/sRGB.
+        CpuChromaticities       chromaticities;
+    };
+
+    /// <summary>
+    /// Same parameters as HDRImageViewerRenderer::SetRenderOptions.
+    /// </summary>
+    struct CpuRenderOptions
+    {
+        CpuRenderEffectKind     effect;
+        float                   exposureAdjustment;
+        float                   dispMaxCllOverride; // 0 indicates no override.
+        bool                    hasDisplayInfo;     // If false, assumes an HDR display (same as a nullptr acInfo).
+        CpuDisplayInfo          display;
+        bool                    constrainGamut;
+        TonemapOperator         tonemapOperator;    // Used by HdrTonemap. Reinhard matches SimpleTonemapEffect's default.
+        unsigned int            lutSize;            // 0 evaluates every stage per pixel. Otherwise HdrTonemap and None
+                                                    // are baked into a lutSize^3 ColorLut3D, e.g. sc_ColorLutDefaultSize.
+    };
+
+    class CpuRenderPipeline
+    {
+    public:
+        /// <param name="lutCache">If not null, and options.lutSize is set, the LUT is taken from or
+        /// added to this cache, so pipelines with the same settings share one bake.</param>
+        CpuRenderPipeline(const CpuSourceInfo& source, const CpuRenderOptions& options, ColorLut3DCache* lutCache = nullptr);
+
+        /// <summary>
+        /// Runs the full pipeline in place. Output is scRGB, equivalent to the renderer's m_finalOutput.
+        /// </summary>
+        /// <param name="gainMap">Required if the source has an Apple HDR gain map. May be a different size than image.</param>
+        /// <param name="threadCount">0 means use all hardware threads.</param>
+        void Render(CpuImage& image, const CpuImage* gainMap = nullptr, unsigned int threadCount = 0) const;
+
+        /// <summary>
+        /// Runs only ColorManagement and GainMapMerge in place. Output is linear scRGB before any
+        /// render options are applied; this is the input to HDR metadata computation.
+        /// </summary>
+        void RenderSceneLinear(CpuImage& image, const CpuImage* gainMap = nullptr, unsigned int threadCount = 0) const;
+
+        /// <summary>
+        /// Colormap used by LuminanceHeatmap, e.g. false color exposure bands. Defaults to the
+        /// renderer's heatmap. Returns false if the stops are invalid, see LuminanceColormap::SetStops.
+        /// </summary>
+        bool SetHeatmapStops(const ColormapStop* stops, size_t count);
+
+        static float GetBestDispMaxLuminance(const CpuRenderOptions& options);
+
+        /// <summary>
+        /// True if Render uses a baked ColorLut3D.
+        /// </summary>
+        bool IsLutBaked() const { return m_lut != nullptr; }
+
+    private:
+        template <typename Curve>
+        void BakeLut(const Tonemapper<Curve>& tonemapper, ColorLut3DCache* lutCache);
+
+        ColorLut3DCache::Key GetLutKey(ColorLutDomain domain) const;
+
+        // ColorManagement.
+        DirectX::XMVECTOR XM_CALLCONV ManageColor(DirectX::FXMVECTOR color, DirectX::CXMMATRIX sourceToScRgb) const;
+
+        // Everything after GainMapMerge: the render effect and the gamut constraint.
+        template <typename Curve>
+        DirectX::XMVECTOR XM_CALLCONV ApplyRenderOptions(DirectX::FXMVECTOR color, const Tonemapper<Curve>& tonemapper) const;
+
+        // Same as ApplyRenderOptions (or ManageColor then ApplyRenderOptions if m_lutIncludesSource)
+        // for colors inside the LUT's domain.
+        DirectX::XMVECTOR XM_CALLCONV LookupLut(DirectX::FXMVECTOR color) const;
+
+        template <typename Curve>
+        void Process(CpuImage& image, const CpuImage* gainMap, bool sceneLinearOnly, const Tonemapper<Curve>& tonemapper, unsigned int threadCount) const;
+
+        CpuSourceInfo                                           m_source;
+        CpuRenderOptions                                        m_options;
+
+        DirectX::XMFLOAT4X4A                                    m_sourceToScRgb;
+        GamutCompressor                                         m_gamutCompressor;
+        bool                                                    m_applyGamutMap;
+
+        float                                                   m_gainMapScale;
+        float                                                   m_whiteScale;
+        float                                                   m_tonemapInputMax;
+        float                                                   m_tonemapOutputMax;
+        bool                                                    m_applySdrWhiteScale;
+        float                                                   m_sdrWhiteScale;
+        float                                                   m_maxLuminance;
+
+        LuminanceColormap                                       m_colormap;
+
+        std::shared_ptr<const ColorLut3D>                       m_lut;
+        bool                                                    m_lutIncludesSource;
+    };
+}
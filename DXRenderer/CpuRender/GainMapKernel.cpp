@@ -0,0 +1,125 @@
+//*********************************************************
+//
+// GainMapKernel
+//
+// See GainMapKernel.h. Gains are interpolated after being
+// linearized rather than before as Direct2D does, which is
+// the physically correct order; the two differ by well under
+// one 8 bit step of the gain map.
+//
+//*********************************************************
+
+#include "GainMapKernel.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+using namespace DXRenderer;
+
+namespace
+{
+    // GammaTransfer exponent and ArithmeticComposite coefficient of the Direct2D GainMapMerge.
+    const float sc_gainMapGamma = 1.0f / 2.2f;
+    const float sc_gainMapComposite = 2.0f;
+
+    inline float LinearizeGain(float value, float scale)
+    {
+        return powf((std::max)(value, 0.0f), sc_gainMapGamma) * scale;
+    }
+
+    inline XMVECTOR XM_CALLCONV ApplyGain(FXMVECTOR color, float gain)
+    {
+        // Alpha passthrough.
+        return XMVectorMultiply(color, XMVectorSelect(g_XMOne, XMVectorReplicate(gain), g_XMSelect1110));
+    }
+}
+
+GainMapKernel::GainMapKernel(
+    const CpuImage& gainMap,
+    unsigned int imageWidth,
+    unsigned int imageHeight,
+    float gainMapScale,
+    unsigned int threadCount)
+{
+    if (!Initialize(gainMap.GetWidth(), gainMap.GetHeight(), imageWidth, imageHeight)) return;
+
+    float scale = sc_gainMapComposite * gainMapScale;
+
+    ParallelFor(0, m_height, sc_DefaultRowsPerBand, threadCount, [&](size_t first, size_t last)
+    {
+        for (size_t y = first; y < last; y++)
+        {
+            const XMFLOAT4A* src = gainMap.GetRow(static_cast<unsigned int>(y));
+            float* dest = m_gains.data() + y * m_width;
+
+            for (unsigned int x = 0; x < m_width; x++)
+            {
+                dest[x] = LinearizeGain(src[x].x, scale);
+            }
+        }
+    });
+}
+
+bool GainMapKernel::Initialize(unsigned int width, unsigned int height, unsigned int imageWidth, unsigned int imageHeight)
+{
+    // An empty gain map becomes a single sample which leaves the image unchanged.
+    m_width = (std::max)(width, 1u);
+    m_height = (std::max)(height, 1u);
+    m_imageWidth = imageWidth;
+    m_imageHeight = imageHeight;
+
+    m_gains.assign(static_cast<size_t>(m_width) * m_height, 1.0f);
+    m_taps.resize(m_imageWidth);
+
+    float scaleX = static_cast<float>(m_width) / (std::max)(m_imageWidth, 1u);
+    float maxX = static_cast<float>(m_width - 1);
+
+    for (unsigned int x = 0; x < m_imageWidth; x++)
+    {
+        float gainX = (std::min)((std::max)((static_cast<float>(x) + 0.5f) * scaleX - 0.5f, 0.0f), maxX);
+
+        Tap& tap = m_taps[x];
+        tap.x0 = static_cast<uint32_t>(gainX);
+        tap.x1 = (std::min)(tap.x0 + 1, m_width - 1);
+        tap.fx = gainX - static_cast<float>(tap.x0);
+    }
+
+    return width != 0 && height != 0;
+}
+
+GainMapKernel::Row GainMapKernel::GetRow(unsigned int y) const
+{
+    float scaleY = static_cast<float>(m_height) / (std::max)(m_imageHeight, 1u);
+    float maxY = static_cast<float>(m_height - 1);
+    float gainY = (std::min)((std::max)((static_cast<float>(y) + 0.5f) * scaleY - 0.5f, 0.0f), maxY);
+
+    Row row;
+    row.y0 = static_cast<unsigned int>(gainY);
+    row.y1 = (std::min)(row.y0 + 1, m_height - 1);
+    row.fy = gainY - static_cast<float>(row.y0);
+    row.row0 = m_gains.data() + static_cast<size_t>(row.y0) * m_width;
+    row.row1 = m_gains.data() + static_cast<size_t>(row.y1) * m_width;
+
+    return row;
+}
+
+void GainMapKernel::Apply(CpuImage& image, unsigned int threadCount) const
+{
+    if (image.IsEmpty() || image.GetWidth() != m_imageWidth || image.GetHeight() != m_imageHeight) return;
+
+    ParallelFor(0, m_imageHeight, sc_DefaultRowsPerBand, threadCount, [&](size_t first, size_t last)
+    {
+        for (size_t y = first; y < last; y++)
+        {
+            XMFLOAT4A* pixels = image.GetRow(static_cast<unsigned int>(y));
+            Row row = GetRow(static_cast<unsigned int>(y));
+
+            for (unsigned int x = 0; x < m_imageWidth; x++)
+            {
+                XMStoreFloat4A(&pixels[x], ApplyGain(XMLoadFloat4A(&pixels[x]), Sample(row, x)));
+            }
+        }
+    });
+}
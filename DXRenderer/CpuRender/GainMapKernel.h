@@ -0,0 +1,104 @@
+//*********************************************************
+//
+// GainMapKernel
+//
+// Applies an Apple HDR gain map to a linear scRGB image:
+// gain map linearization, reference white scaling, bilinear
+// upsampling from the gain map's own (usually half) resolution
+// and the multiply. This is the CPU equivalent of the
+// GainMapMerge chain built in
+// HDRImageViewerRenderer::CreateImageDependentResources
+// (GammaTransfer > WhiteLevelAdjustment > ArithmeticComposite).
+//
+// Linearization and scaling happen once per gain map sample,
+// when the kernel is created, so the per pixel work is only
+// the interpolation and a multiply. Apply does both in a
+// single row parallel pass; CpuRenderPipeline instead calls
+// Sample from its own per pixel loop.
+//
+//*********************************************************
+
+#pragma once
+
+#include "CpuImage.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace DXRenderer
+{
+    class GainMapKernel
+    {
+    public:
+        /// <summary>
+        /// The two gain map rows, and the weight between them, that one image row samples from.
+        /// </summary>
+        struct Row
+        {
+            const float*                                        row0;
+            const float*                                        row1;
+            float                                               fy;
+            unsigned int                                        y0;
+            unsigned int                                        y1;
+        };
+
+        /// <summary>
+        /// From a gain map already converted to a CpuImage, e.g. by WIC. Only red is used.
+        /// </summary>
+        /// <param name="imageWidth">Size of the base image the gain map will be applied to.</param>
+        /// <param name="gainMapScale">The renderer's WhiteLevelAdjustment of the gain map, i.e.
+        /// SDR white level / sc_SceneReferredSdrWhiteNits.</param>
+        /// <param name="threadCount">0 means use all hardware threads.</param>
+        GainMapKernel(
+            const CpuImage& gainMap,
+            unsigned int imageWidth,
+            unsigned int imageHeight,
+            float gainMapScale,
+            unsigned int threadCount = 0);
+
+        Row GetRow(unsigned int y) const;
+
+        /// <summary>
+        /// Bilinear gain for pixel x of the image row passed to GetRow. Gain map pixel centers
+        /// are aligned to the image's, and edges are clamped.
+        /// </summary>
+        float Sample(const Row& row, unsigned int x) const
+        {
+            const Tap& tap = m_taps[x];
+
+            float top = row.row0[tap.x0] + (row.row0[tap.x1] - row.row0[tap.x0]) * tap.fx;
+            float bottom = row.row1[tap.x0] + (row.row1[tap.x1] - row.row1[tap.x0]) * tap.fx;
+
+            return top + (bottom - top) * row.fy;
+        }
+
+        /// <summary>
+        /// Multiplies image, which must be linear scRGB of the size given at construction, by the
+        /// gain map in place, a band of rows per thread. Alpha is unchanged.
+        /// </summary>
+        /// <param name="threadCount">0 means use all hardware threads.</param>
+        void Apply(CpuImage& image, unsigned int threadCount = 0) const;
+
+    private:
+        struct Tap
+        {
+            uint32_t                                            x0;
+            uint32_t                                            x1;
+            float                                               fx;
+        };
+
+        // Returns false if the gain map is empty.
+        bool Initialize(unsigned int width, unsigned int height, unsigned int imageWidth, unsigned int imageHeight);
+
+        unsigned int                                            m_width;
+        unsigned int                                            m_height;
+        unsigned int                                            m_imageWidth;
+        unsigned int                                            m_imageHeight;
+
+        // Linear gains including the white level and composite scale, m_width * m_height.
+        std::vector<float>                                      m_gains;
+
+        // Horizontal sample positions, the same for every row.
+        std::vector<Tap>                                        m_taps;
+    };
+}
@@ -0,0 +1,142 @@
+//*********************************************************
+//
+// GamutCompressor
+//
+// See GamutCompressor.h. The per display values are derived
+// once, when the compressor is created: the inverse matrix,
+// and the compression scale from how far outside the panel
+// gamut BT.2020 colors fall, found by sampling the BT.2020
+// triangle.
+//
+//*********************************************************
+
+#include "GamutCompressor.h"
+#include "ParallelFor.h"
+#include "../Matrix.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+using namespace DXRenderer;
+
+namespace
+{
+    // Columns are the BT.2020 red, green and blue primaries in linear scRGB.
+    constexpr ColorMatrix sc_bt2020ToScRgb = sc_XyzToScRgb * sc_Bt2020ToXyz;
+
+    XMVECTOR XM_CALLCONV Bt2020Primary(size_t index)
+    {
+        return XMVectorSet(
+            static_cast<float>(sc_bt2020ToScRgb(0, index)),
+            static_cast<float>(sc_bt2020ToScRgb(1, index)),
+            static_cast<float>(sc_bt2020ToScRgb(2, index)),
+            0.0f);
+    }
+
+    // Steps along each edge of the BT.2020 triangle when searching for the largest distance.
+    const unsigned int sc_referenceGamutSteps = 32;
+
+    // Channels whose largest distance is this close to the boundary aren't compressed.
+    const float sc_minCompressedLimit = 1.001f;
+
+    void StoreRows(FXMMATRIX m, XMFLOAT4 rows[3])
+    {
+        // DirectXMath's rows are the columns of the column vector convention.
+        XMFLOAT4X4 t;
+        XMStoreFloat4x4(&t, XMMatrixTranspose(m));
+
+        for (int i = 0; i < 3; i++)
+        {
+            rows[i] = XMFLOAT4(t.m[i][0], t.m[i][1], t.m[i][2], 0.0f);
+        }
+    }
+}
+
+GamutCompressor::GamutCompressor()
+{
+    Initialize(XMMatrixIdentity());
+}
+
+GamutCompressor::GamutCompressor(FXMMATRIX scRgbToPanel)
+{
+    Initialize(scRgbToPanel);
+}
+
+void GamutCompressor::Initialize(FXMMATRIX scRgbToPanel)
+{
+    // Only the 3x3 part is used.
+    XMMATRIX toPanel(
+        XMVectorSetW(scRgbToPanel.r[0], 0.0f),
+        XMVectorSetW(scRgbToPanel.r[1], 0.0f),
+        XMVectorSetW(scRgbToPanel.r[2], 0.0f),
+        g_XMIdentityR3);
+
+    XMVECTOR determinant;
+    XMMATRIX toScRgb = XMMatrixInverse(&determinant, toPanel);
+
+    XMStoreFloat4x4A(&m_scRgbToPanel, toPanel);
+    XMStoreFloat4x4A(&m_panelToScRgb, toScRgb);
+
+    StoreRows(toPanel, m_constants.scRgbToPanel);
+    StoreRows(toScRgb, m_constants.panelToScRgb);
+
+    // Largest distance of each channel over the BT.2020 triangle.
+    XMFLOAT3 limit = { 0.0f, 0.0f, 0.0f };
+
+    XMVECTOR red = Bt2020Primary(0);
+    XMVECTOR green = Bt2020Primary(1);
+    XMVECTOR blue = Bt2020Primary(2);
+
+    for (unsigned int i = 0; i <= sc_referenceGamutSteps; i++)
+    {
+        for (unsigned int j = 0; i + j <= sc_referenceGamutSteps; j++)
+        {
+            float a = static_cast<float>(i) / sc_referenceGamutSteps;
+            float b = static_cast<float>(j) / sc_referenceGamutSteps;
+
+            XMVECTOR color = XMVectorScale(red, a);
+            color = XMVectorMultiplyAdd(XMVectorReplicate(b), green, color);
+            color = XMVectorMultiplyAdd(XMVectorReplicate(1.0f - a - b), blue, color);
+
+            XMFLOAT3 rgb;
+            XMStoreFloat3(&rgb, XMVector3TransformNormal(color, toPanel));
+
+            float achromatic = (std::max)((std::max)(rgb.x, rgb.y), rgb.z);
+            if (achromatic <= 0.0f) continue;
+
+            limit.x = (std::max)(limit.x, (achromatic - rgb.x) / achromatic);
+            limit.y = (std::max)(limit.y, (achromatic - rgb.y) / achromatic);
+            limit.z = (std::max)(limit.z, (achromatic - rgb.z) / achromatic);
+        }
+    }
+
+    // s such that the limit maps to 1: (l - t) / sqrt(((l - t) / (1 - t))^2 - 1).
+    float t = sc_GamutCompressionThreshold;
+    auto inverseScale = [t](float l)
+    {
+        if (l < sc_minCompressedLimit) return 0.0f;
+
+        float ratio = (l - t) / (1.0f - t);
+        return std::sqrt(ratio * ratio - 1.0f) / (l - t);
+    };
+
+    m_constants.threshold = XMFLOAT4(t, t, t, 0.0f);
+    m_constants.inverseScale = XMFLOAT4(inverseScale(limit.x), inverseScale(limit.y), inverseScale(limit.z), 0.0f);
+}
+
+void GamutCompressor::Apply(CpuImage& image, unsigned int threadCount) const
+{
+    ParallelFor(0, image.GetHeight(), sc_DefaultRowsPerBand, threadCount, [&](size_t first, size_t last)
+    {
+        for (size_t y = first; y < last; y++)
+        {
+            XMFLOAT4A* row = image.GetRow(static_cast<unsigned int>(y));
+
+            for (unsigned int x = 0; x < image.GetWidth(); x++)
+            {
+                XMStoreFloat4A(&row[x], (*this)(XMLoadFloat4A(&row[x])));
+            }
+        }
+    });
+}
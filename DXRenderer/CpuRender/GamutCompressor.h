@@ -0,0 +1,104 @@
+//*********************************************************
+//
+// GamutCompressor
+//
+// Constrains scRGB colors to a display's gamut in one pass:
+// scRGB to panel RGB, soft compression toward the gamut
+// boundary, and back to scRGB. Replaces the hard colorimetric
+// clip of the two ColorMatrix effects HDRImageViewerRenderer
+// used to chain, which flattens gradients where they leave
+// the gamut.
+//
+// Compression works on each channel's distance from the
+// achromatic axis, d = (max(r, g, b) - c) / max(r, g, b),
+// which is 0 for neutrals, 1 on the gamut boundary and above
+// 1 outside it. Distances below a threshold are unchanged;
+// above it they are compressed along
+//   t + (d - t) / sqrt(1 + ((d - t) / s)^2)
+// with s chosen per channel so that the most out of gamut
+// BT.2020 color lands on the boundary. Hue and max(r, g, b)
+// are preserved. Luminance above the panel's range is left
+// to the tonemapper.
+//
+// GamutCompressionEffect runs the same kernel on the GPU from
+// the same GamutCompressionConstants.
+//
+//*********************************************************
+
+#pragma once
+
+#include "CpuImage.h"
+
+#include <DirectXMath.h>
+
+namespace DXRenderer
+{
+    // Distance from the achromatic axis at which compression starts; 1.0 is the gamut boundary.
+    const float sc_GamutCompressionThreshold = 0.8f;
+
+    /// <summary>
+    /// Per display values. Same layout as the constant buffer in GamutCompressionEffect.hlsl.
+    /// Matrices are rows of the column vector convention, i.e. out.r = dot(row[0].xyz, in.rgb).
+    /// </summary>
+    struct GamutCompressionConstants
+    {
+        DirectX::XMFLOAT4                                       scRgbToPanel[3];
+        DirectX::XMFLOAT4                                       panelToScRgb[3];
+        DirectX::XMFLOAT4                                       threshold;      // Per channel; w unused.
+        DirectX::XMFLOAT4                                       inverseScale;   // 1 / s per channel, 0 disables compression.
+    };
+
+    class GamutCompressor
+    {
+    public:
+        /// <summary>
+        /// A BT.709/sRGB panel.
+        /// </summary>
+        GamutCompressor();
+
+        /// <param name="scRgbToPanel">Linear scRGB to linear panel RGB, in DirectXMath (row vector)
+        /// convention. Must be invertible.</param>
+        explicit GamutCompressor(DirectX::FXMMATRIX scRgbToPanel);
+
+        const GamutCompressionConstants& GetConstants() const { return m_constants; }
+
+        /// <summary>
+        /// Compresses one scRGB pixel into the panel's gamut. Alpha is unchanged.
+        /// </summary>
+        DirectX::XMVECTOR XM_CALLCONV operator()(DirectX::FXMVECTOR color) const
+        {
+            using namespace DirectX;
+
+            XMVECTOR rgb = XMVector3TransformNormal(color, XMLoadFloat4x4A(&m_scRgbToPanel));
+
+            XMVECTOR achromatic = XMVectorMax(XMVectorMax(XMVectorSplatX(rgb), XMVectorSplatY(rgb)), XMVectorSplatZ(rgb));
+            XMVECTOR positive = XMVectorGreater(achromatic, XMVectorZero());
+
+            XMVECTOR distance = XMVectorDivide(XMVectorSubtract(achromatic, rgb), XMVectorSelect(g_XMOne, achromatic, positive));
+
+            // over / sqrt(1 + (over / s)^2) is (d - t) compressed, and 0 below the threshold.
+            XMVECTOR over = XMVectorMax(XMVectorSubtract(distance, XMLoadFloat4(&m_constants.threshold)), XMVectorZero());
+            XMVECTOR x = XMVectorMultiply(over, XMLoadFloat4(&m_constants.inverseScale));
+            XMVECTOR compressed = XMVectorMultiplyAdd(over, XMVectorReciprocalSqrt(XMVectorMultiplyAdd(x, x, g_XMOne)), XMVectorSubtract(distance, over));
+
+            // Colors with no positive channel are black on the panel.
+            rgb = XMVectorSelect(rgb, XMVectorNegativeMultiplySubtract(compressed, achromatic, achromatic), positive);
+            rgb = XMVectorMax(rgb, XMVectorZero());
+
+            return XMVectorSelect(color, XMVector3TransformNormal(rgb, XMLoadFloat4x4A(&m_panelToScRgb)), g_XMSelect1110);
+        }
+
+        /// <summary>
+        /// Compresses image in place.
+        /// </summary>
+        /// <param name="threadCount">0 means use all hardware threads.</param>
+        void Apply(CpuImage& image, unsigned int threadCount = 0) const;
+
+    private:
+        void Initialize(DirectX::FXMMATRIX scRgbToPanel);
+
+        DirectX::XMFLOAT4X4A                                    m_scRgbToPanel;
+        DirectX::XMFLOAT4X4A                                    m_panelToScRgb;
+        GamutCompressionConstants                               m_constants;
+    };
+}
@@ -0,0 +1,542 @@
+//*********************************************************
+//
+// HeifGridParser
+//
+// See HeifGridParser.h. Box layouts are from ISO/IEC 14496-12
+// (ISOBMFF: meta, iinf, infe, iloc, iref, idat) and 23008-12
+// (HEIF: iprp, ipco, ipma, ispe and the grid descriptor).
+// Everything is big endian.
+//
+//*********************************************************
+
+#include "HeifGridParser.h"
+
+#include <algorithm>
+
+using namespace DXRenderer;
+
+namespace
+{
+    constexpr uint32_t FourCC(const char* code)
+    {
+        return (static_cast<uint32_t>(static_cast<uint8_t>(code[0])) << 24) |
+            (static_cast<uint32_t>(static_cast<uint8_t>(code[1])) << 16) |
+            (static_cast<uint32_t>(static_cast<uint8_t>(code[2])) << 8) |
+            static_cast<uint32_t>(static_cast<uint8_t>(code[3]));
+    }
+
+    const uint32_t sc_boxMeta = FourCC("meta");
+    const uint32_t sc_boxIinf = FourCC("iinf");
+    const uint32_t sc_boxInfe = FourCC("infe");
+    const uint32_t sc_boxIloc = FourCC("iloc");
+    const uint32_t sc_boxIref = FourCC("iref");
+    const uint32_t sc_boxIdat = FourCC("idat");
+    const uint32_t sc_boxIprp = FourCC("iprp");
+    const uint32_t sc_boxIpco = FourCC("ipco");
+    const uint32_t sc_boxIpma = FourCC("ipma");
+    const uint32_t sc_boxUuid = FourCC("uuid");
+
+    const uint32_t sc_itemGrid = FourCC("grid");
+    const uint32_t sc_refDimg = FourCC("dimg");
+
+    const uint32_t sc_propertyIspe = FourCC("ispe");
+    const uint32_t sc_propertyIrot = FourCC("irot");
+    const uint32_t sc_propertyImir = FourCC("imir");
+    const uint32_t sc_propertyClap = FourCC("clap");
+
+    // Version and flags of a full box.
+    const uint64_t sc_fullBoxHeaderSize = 4;
+
+    // Version, flags, rows - 1, columns - 1 and two 32 bit output dimensions.
+    const size_t sc_gridDescriptorMaxSize = 12;
+
+    struct Box
+    {
+        uint32_t                                                type;
+        uint64_t                                                content;        // Just past the header.
+        uint64_t                                                end;
+    };
+
+    struct ItemInfo
+    {
+        uint32_t                                                id;
+        uint32_t                                                type;           // 0 for infe versions 0 and 1.
+        uint64_t                                                flagsOffset;    // Last byte of the infe flags.
+    };
+
+    struct PropertyAssociation
+    {
+        uint32_t                                                itemId;
+        uint16_t                                                index;          // 1 based into ipco; 0 is no property.
+    };
+
+    /// <summary>
+    /// Bounds checked big endian reads and box headers.
+    /// </summary>
+    class BoxReader
+    {
+    public:
+        BoxReader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+        uint64_t GetSize() const { return m_size; }
+
+        bool Contains(uint64_t offset, uint64_t length) const
+        {
+            return offset <= m_size && length <= m_size - offset;
+        }
+
+        /// <summary>
+        /// Reads an unsigned integer of 0 to 8 bytes; 0 bytes reads as 0.
+        /// </summary>
+        bool Read(uint64_t offset, unsigned int bytes, uint64_t& value) const
+        {
+            if (bytes > 8 || !Contains(offset, bytes)) return false;
+
+            value = 0;
+            for (unsigned int i = 0; i < bytes; i++)
+            {
+                value = (value << 8) | m_data[offset + i];
+            }
+
+            return true;
+        }
+
+        bool Read8(uint64_t offset, uint8_t& value) const
+        {
+            if (!Contains(offset, 1)) return false;
+
+            value = m_data[offset];
+            return true;
+        }
+
+        bool Read16(uint64_t offset, uint16_t& value) const
+        {
+            uint64_t wide = 0;
+            if (!Read(offset, 2, wide)) return false;
+
+            value = static_cast<uint16_t>(wide);
+            return true;
+        }
+
+        bool Read32(uint64_t offset, uint32_t& value) const
+        {
+            uint64_t wide = 0;
+            if (!Read(offset, 4, wide)) return false;
+
+            value = static_cast<uint32_t>(wide);
+            return true;
+        }
+
+        /// <summary>
+        /// Reads the header of the box at offset, which must lie within [offset, end).
+        /// </summary>
+        bool ReadBox(uint64_t offset, uint64_t end, Box& box) const
+        {
+            uint32_t size32 = 0;
+            if (!Read32(offset, size32) || !Read32(offset + 4, box.type)) return false;
+
+            uint64_t headerSize = 8;
+            uint64_t size = size32;
+
+            if (size32 == 1)
+            {
+                if (!Read(offset + 8, 8, size)) return false;
+                headerSize = 16;
+            }
+            else if (size32 == 0)
+            {
+                // Extends to the end of its parent.
+                size = end - offset;
+            }
+
+            if (box.type == sc_boxUuid) headerSize += 16;
+
+            if (size < headerSize || size > end - offset) return false;
+
+            box.content = offset + headerSize;
+            box.end = offset + size;
+            return true;
+        }
+
+    private:
+        const uint8_t*                                          m_data;
+        uint64_t                                                m_size;
+    };
+
+    /// <summary>
+    /// Calls onBox(box) for each box in [begin, end). Stops and returns false at the first invalid
+    /// header or if onBox returns false.
+    /// </summary>
+    template <typename Func>
+    bool ForEachBox(const BoxReader& reader, uint64_t begin, uint64_t end, Func onBox)
+    {
+        for (uint64_t offset = begin; offset < end;)
+        {
+            Box box = {};
+            if (!reader.ReadBox(offset, end, box) || !onBox(box)) return false;
+
+            offset = box.end;
+        }
+
+        return true;
+    }
+
+    bool ParseItemInfos(const BoxReader& reader, const Box& iinf, std::vector<ItemInfo>& items)
+    {
+        uint8_t version = 0;
+        if (!reader.Read8(iinf.content, version)) return false;
+
+        // The entry count is only needed to know where the entries start.
+        uint64_t entries = iinf.content + sc_fullBoxHeaderSize + (version == 0 ? 2 : 4);
+
+        return ForEachBox(reader, entries, iinf.end, [&](const Box& infe)
+        {
+            if (infe.type != sc_boxInfe) return true;
+
+            uint8_t infeVersion = 0;
+            if (!reader.Read8(infe.content, infeVersion)) return false;
+
+            ItemInfo item = {};
+            item.flagsOffset = infe.content + 3;
+
+            uint64_t field = infe.content + sc_fullBoxHeaderSize;
+            if (infeVersion >= 3)
+            {
+                if (!reader.Read32(field, item.id) || !reader.Read32(field + 6, item.type)) return false;
+            }
+            else
+            {
+                uint16_t id = 0;
+                if (!reader.Read16(field, id)) return false;
+                item.id = id;
+
+                if (infeVersion == 2 && !reader.Read32(field + 4, item.type)) return false;
+            }
+
+            items.push_back(item);
+            return true;
+        });
+    }
+
+    /// <summary>
+    /// Finds the items that itemId references with the given type.
+    /// </summary>
+    bool ParseReferences(const BoxReader& reader, const Box& iref, uint32_t itemId, uint32_t type, std::vector<uint32_t>& ids)
+    {
+        uint8_t version = 0;
+        if (!reader.Read8(iref.content, version)) return false;
+
+        unsigned int idBytes = version == 0 ? 2 : 4;
+
+        return ForEachBox(reader, iref.content + sc_fullBoxHeaderSize, iref.end, [&](const Box& reference)
+        {
+            uint64_t fromId = 0;
+            uint16_t count = 0;
+            if (!reader.Read(reference.content, idBytes, fromId) ||
+                !reader.Read16(reference.content + idBytes, count) ||
+                reference.content + idBytes + 2 + static_cast<uint64_t>(count) * idBytes > reference.end)
+            {
+                return false;
+            }
+
+            if (reference.type != type || fromId != itemId) return true;
+
+            for (uint16_t i = 0; i < count; i++)
+            {
+                uint64_t id = 0;
+                reader.Read(reference.content + idBytes + 2 + static_cast<uint64_t>(i) * idBytes, idBytes, id);
+                ids.push_back(static_cast<uint32_t>(id));
+            }
+
+            return true;
+        });
+    }
+
+    /// <summary>
+    /// Reads up to size bytes of item itemId, wherever iloc says its extents are.
+    /// </summary>
+    /// <param name="idat">Payload of the meta box's idat, for construction method 1.</param>
+    /// <param name="bytesRead">Receives how many bytes the item has, up to size.</param>
+    bool ReadItemData(const BoxReader& reader, const Box& iloc, const Box* idat, uint32_t itemId, uint8_t* data, size_t size, size_t& bytesRead)
+    {
+        uint8_t version = 0, sizes = 0, baseSizes = 0;
+        if (!reader.Read8(iloc.content, version) || version > 2 ||
+            !reader.Read8(iloc.content + sc_fullBoxHeaderSize, sizes) ||
+            !reader.Read8(iloc.content + sc_fullBoxHeaderSize + 1, baseSizes))
+        {
+            return false;
+        }
+
+        unsigned int offsetSize = sizes >> 4;
+        unsigned int lengthSize = sizes & 0xF;
+        unsigned int baseOffsetSize = baseSizes >> 4;
+        unsigned int indexSize = version >= 1 ? baseSizes & 0xF : 0;
+        unsigned int idBytes = version < 2 ? 2 : 4;
+
+        uint64_t itemCount = 0;
+        uint64_t cursor = iloc.content + sc_fullBoxHeaderSize + 2;
+        if (!reader.Read(cursor, idBytes, itemCount)) return false;
+        cursor += idBytes;
+
+        for (uint64_t i = 0; i < itemCount; i++)
+        {
+            uint64_t id = 0, constructionMethod = 0, baseOffset = 0;
+            uint16_t extentCount = 0;
+
+            if (!reader.Read(cursor, idBytes, id)) return false;
+            cursor += idBytes;
+
+            if (version >= 1)
+            {
+                if (!reader.Read(cursor, 2, constructionMethod)) return false;
+                constructionMethod &= 0xF;
+                cursor += 2;
+            }
+
+            // Skip the data reference index; only this file is supported.
+            cursor += 2;
+
+            if (!reader.Read(cursor, baseOffsetSize, baseOffset) ||
+                !reader.Read16(cursor + baseOffsetSize, extentCount))
+            {
+                return false;
+            }
+
+            cursor += baseOffsetSize + 2;
+
+            uint64_t extentSize = indexSize + offsetSize + lengthSize;
+            if (cursor + extentCount * extentSize > iloc.end) return false;
+
+            if (id != itemId)
+            {
+                cursor += extentCount * extentSize;
+                continue;
+            }
+
+            // Offsets are into the file or into idat.
+            uint64_t sourceBegin = 0, sourceEnd = reader.GetSize();
+            if (constructionMethod == 1)
+            {
+                if (!idat) return false;
+
+                sourceBegin = idat->content;
+                sourceEnd = idat->end;
+            }
+            else if (constructionMethod != 0)
+            {
+                return false;
+            }
+
+            bytesRead = 0;
+            for (uint16_t e = 0; e < extentCount && bytesRead < size; e++)
+            {
+                uint64_t extent = cursor + e * extentSize + indexSize;
+                uint64_t offset = 0, length = 0;
+                reader.Read(extent, offsetSize, offset);
+                reader.Read(extent + offsetSize, lengthSize, length);
+
+                uint64_t begin = sourceBegin + baseOffset + offset;
+                if (begin < sourceBegin || begin > sourceEnd) return false;
+
+                // A length of 0 is the rest of the source.
+                uint64_t available = sourceEnd - begin;
+                if (length == 0) length = available;
+                if (length > available) return false;
+
+                size_t chunk = static_cast<size_t>((std::min)(length, static_cast<uint64_t>(size - bytesRead)));
+                for (size_t b = 0; b < chunk; b++)
+                {
+                    uint8_t value = 0;
+                    reader.Read8(begin + b, value);
+                    data[bytesRead + b] = value;
+                }
+
+                bytesRead += chunk;
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+
+    bool ParsePropertyAssociations(const BoxReader& reader, const Box& ipma, std::vector<PropertyAssociation>& associations)
+    {
+        uint8_t version = 0, flags = 0;
+        uint32_t entryCount = 0;
+        if (!reader.Read8(ipma.content, version) ||
+            !reader.Read8(ipma.content + 3, flags) ||
+            !reader.Read32(ipma.content + sc_fullBoxHeaderSize, entryCount))
+        {
+            return false;
+        }
+
+        unsigned int idBytes = version < 1 ? 2 : 4;
+        unsigned int indexBytes = (flags & 1) ? 2 : 1;
+        uint16_t indexMask = (flags & 1) ? 0x7FFF : 0x7F;
+
+        uint64_t cursor = ipma.content + sc_fullBoxHeaderSize + 4;
+        for (uint32_t i = 0; i < entryCount; i++)
+        {
+            uint64_t id = 0;
+            uint8_t count = 0;
+            if (!reader.Read(cursor, idBytes, id) || !reader.Read8(cursor + idBytes, count)) return false;
+            cursor += idBytes + 1;
+
+            if (cursor + static_cast<uint64_t>(count) * indexBytes > ipma.end) return false;
+
+            for (uint8_t a = 0; a < count; a++, cursor += indexBytes)
+            {
+                uint64_t value = 0;
+                reader.Read(cursor, indexBytes, value);
+
+                PropertyAssociation association = { static_cast<uint32_t>(id), static_cast<uint16_t>(value & indexMask) };
+                associations.push_back(association);
+            }
+        }
+
+        return true;
+    }
+}
+
+bool DXRenderer::ParseHeifGrid(const uint8_t* data, size_t size, uint32_t itemId, HeifGrid& grid)
+{
+    BoxReader reader(data, size);
+
+    Box meta = {};
+    bool hasMeta = false;
+    ForEachBox(reader, 0, size, [&](const Box& box)
+    {
+        hasMeta = box.type == sc_boxMeta;
+        if (hasMeta) meta = box;
+
+        // Stop at the meta box.
+        return !hasMeta;
+    });
+
+    if (!hasMeta) return false;
+
+    Box iinf = {}, iloc = {}, iref = {}, iprp = {}, idat = {};
+    bool hasIinf = false, hasIloc = false, hasIref = false, hasIprp = false, hasIdat = false;
+
+    bool metaValid = ForEachBox(reader, meta.content + sc_fullBoxHeaderSize, meta.end, [&](const Box& box)
+    {
+        if (box.type == sc_boxIinf) { iinf = box; hasIinf = true; }
+        else if (box.type == sc_boxIloc) { iloc = box; hasIloc = true; }
+        else if (box.type == sc_boxIref) { iref = box; hasIref = true; }
+        else if (box.type == sc_boxIprp) { iprp = box; hasIprp = true; }
+        else if (box.type == sc_boxIdat) { idat = box; hasIdat = true; }
+
+        return true;
+    });
+
+    if (!metaValid || !hasIinf || !hasIloc || !hasIref || !hasIprp) return false;
+
+    std::vector<ItemInfo> items;
+    if (!ParseItemInfos(reader, iinf, items)) return false;
+
+    auto findItem = [&](uint32_t id)
+    {
+        return std::find_if(items.begin(), items.end(), [id](const ItemInfo& item) { return item.id == id; });
+    };
+
+    auto gridItem = findItem(itemId);
+    if (gridItem == items.end() || gridItem->type != sc_itemGrid) return false;
+
+    // Grid descriptor.
+    uint8_t descriptor[sc_gridDescriptorMaxSize] = {};
+    size_t descriptorSize = 0;
+    if (!ReadItemData(reader, iloc, hasIdat ? &idat : nullptr, itemId, descriptor, sizeof(descriptor), descriptorSize) ||
+        descriptorSize < 4 || descriptor[0] != 0)
+    {
+        return false;
+    }
+
+    size_t fieldSize = (descriptor[1] & 1) ? 4 : 2;
+    if (descriptorSize < 4 + 2 * fieldSize) return false;
+
+    BoxReader descriptorReader(descriptor, descriptorSize);
+    uint64_t outputWidth = 0, outputHeight = 0;
+    descriptorReader.Read(4, static_cast<unsigned int>(fieldSize), outputWidth);
+    descriptorReader.Read(4 + fieldSize, static_cast<unsigned int>(fieldSize), outputHeight);
+
+    grid.rows = descriptor[2] + 1u;
+    grid.columns = descriptor[3] + 1u;
+    grid.outputWidth = static_cast<uint32_t>(outputWidth);
+    grid.outputHeight = static_cast<uint32_t>(outputHeight);
+
+    uint32_t tileCount = grid.rows * grid.columns;
+    if (tileCount > sc_HeifGridMaxTiles || grid.outputWidth == 0 || grid.outputHeight == 0) return false;
+
+    // Tiles.
+    grid.tileIds.clear();
+    if (!ParseReferences(reader, iref, itemId, sc_refDimg, grid.tileIds) || grid.tileIds.size() != tileCount) return false;
+
+    grid.hiddenFlagOffsets.clear();
+    for (uint32_t tileId : grid.tileIds)
+    {
+        auto tile = findItem(tileId);
+        if (tile == items.end()) return false;
+
+        uint8_t flags = 0;
+        reader.Read8(tile->flagsOffset, flags);
+        if (flags & 1) grid.hiddenFlagOffsets.push_back(tile->flagsOffset);
+    }
+
+    std::sort(grid.hiddenFlagOffsets.begin(), grid.hiddenFlagOffsets.end());
+    grid.hiddenFlagOffsets.erase(std::unique(grid.hiddenFlagOffsets.begin(), grid.hiddenFlagOffsets.end()), grid.hiddenFlagOffsets.end());
+
+    // Properties.
+    std::vector<Box> properties;
+    std::vector<PropertyAssociation> associations;
+
+    bool iprpValid = ForEachBox(reader, iprp.content, iprp.end, [&](const Box& box)
+    {
+        if (box.type == sc_boxIpco)
+        {
+            return ForEachBox(reader, box.content, box.end, [&](const Box& property)
+            {
+                properties.push_back(property);
+                return true;
+            });
+        }
+
+        return box.type != sc_boxIpma || ParsePropertyAssociations(reader, box, associations);
+    });
+
+    if (!iprpValid) return false;
+
+    std::vector<uint32_t> sortedTileIds = grid.tileIds;
+    std::sort(sortedTileIds.begin(), sortedTileIds.end());
+
+    grid.tileWidth = 0;
+    grid.tileHeight = 0;
+
+    for (const auto& association : associations)
+    {
+        bool isGrid = association.itemId == itemId;
+        bool isFirstTile = association.itemId == grid.tileIds[0];
+        bool isTile = std::binary_search(sortedTileIds.begin(), sortedTileIds.end(), association.itemId);
+
+        if ((!isGrid && !isTile) || association.index == 0) continue;
+        if (association.index > properties.size()) return false;
+
+        const Box& property = properties[association.index - 1];
+
+        if (property.type == sc_propertyIrot || property.type == sc_propertyImir || property.type == sc_propertyClap)
+        {
+            return false;
+        }
+
+        if (isFirstTile && property.type == sc_propertyIspe &&
+            (!reader.Read32(property.content + sc_fullBoxHeaderSize, grid.tileWidth) ||
+             !reader.Read32(property.content + sc_fullBoxHeaderSize + 4, grid.tileHeight)))
+        {
+            return false;
+        }
+    }
+
+    return grid.tileWidth > 0 && grid.tileHeight > 0 &&
+        static_cast<uint64_t>(grid.tileWidth) * grid.columns >= grid.outputWidth &&
+        static_cast<uint64_t>(grid.tileHeight) * grid.rows >= grid.outputHeight;
+}
@@ -0,0 +1,48 @@
+//*********************************************************
+//
+// HeifGridParser
+//
+// Reads the layout of a HEIF grid image ('grid' item) from
+// the file's meta box: the grid descriptor, its tile items
+// in order and the tiles' size. This is what libheif 1.12
+// keeps to itself, and is needed to decode the tiles one by
+// one. Only the meta box is read; the coded data is not.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DXRenderer
+{
+    // Larger grids are rejected; a 48MP iPhone image has 96 tiles.
+    const uint32_t sc_HeifGridMaxTiles = 64 * 1024;
+
+    struct HeifGrid
+    {
+        uint32_t                                                rows;
+        uint32_t                                                columns;
+        uint32_t                                                outputWidth;    // Of the composed image, before any cropping.
+        uint32_t                                                outputHeight;
+        uint32_t                                                tileWidth;      // From the first tile's ispe property.
+        uint32_t                                                tileHeight;
+        std::vector<uint32_t>                                   tileIds;        // Row major, rows * columns of them.
+
+        // Offset in the file of the flags byte holding the hidden bit (bit 0) of each tile whose
+        // item info entry has it set, in increasing order.
+        std::vector<uint64_t>                                   hiddenFlagOffsets;
+    };
+
+    /// <summary>
+    /// Finds item itemId in the meta box of a HEIF file and, if it is a grid image, reads its
+    /// descriptor, the tiles it references through 'dimg' and their size. The grid descriptor may
+    /// be stored in the file or in the meta box's idat.
+    /// </summary>
+    /// <param name="data">The whole file.</param>
+    /// <returns>False if the item isn't a grid, the boxes are invalid, or the grid or any tile has a
+    /// transformative property (irot, imir, clap), which only applies to the image as a whole.</returns>
+    bool ParseHeifGrid(const uint8_t* data, size_t size, uint32_t itemId, HeifGrid& grid);
+}
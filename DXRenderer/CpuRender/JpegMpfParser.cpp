@@ -0,0 +1,254 @@
+//*********************************************************
+//
+// JpegMpfParser
+//
+// See JpegMpfParser.h. The MPF segment is "MPF\0" followed by
+// a TIFF header and the MP Index IFD; all of its offsets are
+// relative to that TIFF header, so the offsets of individual
+// images are rebased onto the file here.
+//
+//*********************************************************
+
+#include "JpegMpfParser.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace DXRenderer;
+
+namespace
+{
+    const uint8_t sc_markerPrefix = 0xFF;
+    const uint8_t sc_markerSoi = 0xD8;
+    const uint8_t sc_markerEoi = 0xD9;
+    const uint8_t sc_markerSos = 0xDA;
+    const uint8_t sc_markerApp2 = 0xE2;
+    const uint8_t sc_markerTem = 0x01;
+    const uint8_t sc_markerRst0 = 0xD0;
+    const uint8_t sc_markerRst7 = 0xD7;
+
+    const char sc_mpfIdentifier[4] = { 'M', 'P', 'F', '\0' };
+    const char sc_mpfVersion[4] = { '0', '1', '0', '0' };
+
+    const uint16_t sc_tagMpfVersion = 0xB000;
+    const uint16_t sc_tagNumberOfImages = 0xB001;
+    const uint16_t sc_tagMpEntry = 0xB002;
+
+    const uint16_t sc_tiffTypeLong = 4;
+    const uint16_t sc_tiffTypeUndefined = 7;
+    const uint16_t sc_tiffMagic = 42;
+
+    const size_t sc_ifdEntrySize = 12;
+    const size_t sc_mpEntrySize = 16;
+
+    /// <summary>
+    /// Bounds checked reads from a TIFF structure of either byte order.
+    /// </summary>
+    class TiffReader
+    {
+    public:
+        TiffReader(const uint8_t* data, size_t size) : m_data(data), m_size(size), m_bigEndian(false) {}
+
+        bool ReadHeader(uint32_t& firstIfdOffset)
+        {
+            if (m_size < 8) return false;
+
+            if (m_data[0] == 'M' && m_data[1] == 'M')
+            {
+                m_bigEndian = true;
+            }
+            else if (m_data[0] != 'I' || m_data[1] != 'I')
+            {
+                return false;
+            }
+
+            uint16_t magic = 0;
+            return Read16(2, magic) && magic == sc_tiffMagic && Read32(4, firstIfdOffset);
+        }
+
+        bool Contains(uint64_t offset, uint64_t length) const
+        {
+            return offset <= m_size && length <= m_size - offset;
+        }
+
+        const uint8_t* At(size_t offset) const { return m_data + offset; }
+
+        bool Read16(uint64_t offset, uint16_t& value) const
+        {
+            if (!Contains(offset, 2)) return false;
+
+            const uint8_t* p = m_data + offset;
+            value = m_bigEndian ?
+                static_cast<uint16_t>((p[0] << 8) | p[1]) :
+                static_cast<uint16_t>((p[1] << 8) | p[0]);
+            return true;
+        }
+
+        bool Read32(uint64_t offset, uint32_t& value) const
+        {
+            if (!Contains(offset, 4)) return false;
+
+            const uint8_t* p = m_data + offset;
+            value = m_bigEndian ?
+                (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3] :
+                (static_cast<uint32_t>(p[3]) << 24) | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[0];
+            return true;
+        }
+
+    private:
+        const uint8_t*                                          m_data;
+        size_t                                                  m_size;
+        bool                                                    m_bigEndian;
+    };
+
+    /// <summary>
+    /// Reads and validates the MP Index IFD.
+    /// </summary>
+    /// <param name="tiffOffset">Where the TIFF header is in the file.</param>
+    bool ParseMpIndex(const uint8_t* tiff, size_t tiffSize, uint64_t tiffOffset, uint64_t fileSize, MpfIndex& index)
+    {
+        TiffReader reader(tiff, tiffSize);
+
+        uint32_t ifdOffset = 0;
+        uint16_t ifdEntryCount = 0;
+        if (!reader.ReadHeader(ifdOffset) ||
+            !reader.Read16(ifdOffset, ifdEntryCount) ||
+            !reader.Contains(static_cast<uint64_t>(ifdOffset) + 2, static_cast<uint64_t>(ifdEntryCount) * sc_ifdEntrySize))
+        {
+            return false;
+        }
+
+        bool hasVersion = false;
+        uint32_t numberOfImages = 0;
+        uint32_t mpEntryOffset = 0;
+        uint32_t mpEntryBytes = 0;
+
+        for (uint16_t i = 0; i < ifdEntryCount; i++)
+        {
+            uint64_t entry = static_cast<uint64_t>(ifdOffset) + 2 + i * sc_ifdEntrySize;
+
+            uint16_t tag = 0, type = 0;
+            uint32_t count = 0, value = 0;
+            reader.Read16(entry, tag);
+            reader.Read16(entry + 2, type);
+            reader.Read32(entry + 4, count);
+            reader.Read32(entry + 8, value);
+
+            switch (tag)
+            {
+            case sc_tagMpfVersion:
+                // Four bytes fit in the entry itself.
+                hasVersion = type == sc_tiffTypeUndefined && count == sizeof(sc_mpfVersion) &&
+                    memcmp(reader.At(static_cast<size_t>(entry) + 8), sc_mpfVersion, sizeof(sc_mpfVersion)) == 0;
+                break;
+
+            case sc_tagNumberOfImages:
+                if (type != sc_tiffTypeLong || count != 1) return false;
+                numberOfImages = value;
+                break;
+
+            case sc_tagMpEntry:
+                if (type != sc_tiffTypeUndefined) return false;
+                mpEntryBytes = count;
+                mpEntryOffset = value;
+                break;
+
+            default:
+                // Image UID list, total frames: not needed.
+                break;
+            }
+        }
+
+        if (!hasVersion || numberOfImages == 0 ||
+            mpEntryBytes != static_cast<uint64_t>(numberOfImages) * sc_mpEntrySize ||
+            !reader.Contains(mpEntryOffset, mpEntryBytes))
+        {
+            return false;
+        }
+
+        index.count = (std::min)(numberOfImages, sc_MpfMaxImages);
+
+        for (unsigned int i = 0; i < index.count; i++)
+        {
+            uint64_t entry = mpEntryOffset + static_cast<uint64_t>(i) * sc_mpEntrySize;
+
+            MpfImage& image = index.images[i];
+            uint32_t offset = 0;
+            reader.Read32(entry, image.attributes);
+            reader.Read32(entry + 4, image.size);
+            reader.Read32(entry + 8, offset);
+
+            if (image.size == 0) return false;
+
+            if (i == 0)
+            {
+                // The primary image is the file itself, which is where it says offsets are relative to.
+                if (offset != 0 || !image.IsJpeg() || image.size > fileSize) return false;
+
+                image.offset = 0;
+            }
+            else
+            {
+                // There may be a gap after the primary image's EOI, but no overlap.
+                image.offset = tiffOffset + offset;
+
+                if (offset == 0 || !image.IsJpeg() ||
+                    image.offset < index.images[0].size ||
+                    image.offset > fileSize || image.size > fileSize - image.offset)
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+}
+
+bool DXRenderer::ParseJpegMpf(const uint8_t* head, size_t headSize, uint64_t fileSize, MpfIndex& index)
+{
+    index.count = 0;
+
+    if (headSize < 4 || head[0] != sc_markerPrefix || head[1] != sc_markerSoi) return false;
+
+    size_t position = 2;
+    while (position + 4 <= headSize)
+    {
+        if (head[position] != sc_markerPrefix) return false;
+
+        uint8_t marker = head[position + 1];
+        if (marker == sc_markerPrefix)
+        {
+            // Fill byte.
+            position++;
+            continue;
+        }
+
+        position += 2;
+
+        if (marker == sc_markerTem || (marker >= sc_markerRst0 && marker <= sc_markerRst7)) continue;
+
+        // MPF must come before the image data.
+        if (marker == sc_markerSos || marker == sc_markerEoi) return false;
+
+        // The length includes its own two bytes.
+        size_t length = (static_cast<size_t>(head[position]) << 8) | head[position + 1];
+        if (length < 2) return false;
+
+        if (marker == sc_markerApp2 &&
+            length >= 2 + sizeof(sc_mpfIdentifier) &&
+            position + length <= headSize &&
+            memcmp(head + position + 2, sc_mpfIdentifier, sizeof(sc_mpfIdentifier)) == 0)
+        {
+            size_t tiff = position + 2 + sizeof(sc_mpfIdentifier);
+            if (ParseMpIndex(head + tiff, position + length - tiff, tiff, fileSize, index)) return true;
+
+            index.count = 0;
+            return false;
+        }
+
+        position += length;
+    }
+
+    return false;
+}
@@ -0,0 +1,65 @@
+//*********************************************************
+//
+// JpegMpfParser
+//
+// Reads the Multi-Picture Format (CIPA DC-007) index of a
+// JPEG file, which locates the other images stored after the
+// primary one, e.g. an Apple or Ultra HDR gain map. MPF lives
+// in an APP2 segment ahead of the image data, so parsing needs
+// only the head of the file. Nothing is allocated or copied.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace DXRenderer
+{
+    // Bytes at the start of the file to read for ParseJpegMpf. Each marker segment is at most
+    // 64KB, and MPF follows at most the EXIF and XMP APP1 segments in files seen in practice.
+    const size_t sc_MpfHeadBytes = 256 * 1024;
+
+    // Individual images beyond this are ignored.
+    const unsigned int sc_MpfMaxImages = 8;
+
+    // MP type codes, the low 24 bits of an individual image's attributes.
+    const uint32_t sc_MpfTypeUndefined = 0x000000;
+    const uint32_t sc_MpfTypeLargeThumbnailVga = 0x010001;
+    const uint32_t sc_MpfTypeLargeThumbnailFullHd = 0x010002;
+    const uint32_t sc_MpfTypePanorama = 0x020001;
+    const uint32_t sc_MpfTypeDisparity = 0x020002;
+    const uint32_t sc_MpfTypeMultiAngle = 0x020003;
+    const uint32_t sc_MpfTypeBaselinePrimary = 0x030000;
+
+    /// <summary>
+    /// One MP Entry, with its offset made relative to the start of the file.
+    /// </summary>
+    struct MpfImage
+    {
+        uint32_t                                                attributes;
+        uint32_t                                                size;           // Bytes from SOI to EOI.
+        uint64_t                                                offset;         // Of the SOI, from the start of the file.
+
+        uint32_t GetType() const { return attributes & 0xFFFFFF; }
+        bool IsJpeg() const { return ((attributes >> 24) & 0x7) == 0; }
+    };
+
+    struct MpfIndex
+    {
+        unsigned int                                            count;          // Entries in images, the primary image first.
+        MpfImage                                                images[sc_MpfMaxImages];
+    };
+
+    /// <summary>
+    /// Walks the marker segments at the head of a JPEG file to the first MPF APP2 segment and
+    /// reads its MP Index IFD. The MP Entry table is checked against the specification: the
+    /// version, that the image count matches it, that the primary image starts the file, and
+    /// that every other image is a JPEG lying past the primary image and inside the file.
+    /// </summary>
+    /// <param name="head">The first headSize bytes of the file, ideally sc_MpfHeadBytes.</param>
+    /// <param name="fileSize">Size of the whole file.</param>
+    /// <returns>False if the data isn't a JPEG, has no MPF segment within head, or its index is invalid.</returns>
+    bool ParseJpegMpf(const uint8_t* head, size_t headSize, uint64_t fileSize, MpfIndex& index);
+}
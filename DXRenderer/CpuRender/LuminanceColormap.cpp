@@ -0,0 +1,136 @@
+//*********************************************************
+//
+// LuminanceColormap
+//
+// See LuminanceColormap.h. For the heatmap the LUT has about
+// 50 entries per doubling of luminance, so interpolating
+// between entries stays within a fraction of a percent of
+// evaluating the stops directly, except within one entry of
+// a hard edge.
+//
+//*********************************************************
+
+#include "LuminanceColormap.h"
+#include "ParallelFor.h"
+#include "../MagicConstants.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+using namespace DXRenderer;
+
+namespace
+{
+    const XMVECTORF32 sc_bt709Luminance = { { { 0.2126f, 0.7152f, 0.0722f, 0.0f } } };
+
+    // Nits to color mappings of the heatmap. Orange isn't a simple combination of primary colors
+    // but allows 8 gradient segments, which gives cleaner definitions for the mappings.
+    const ColormapStop sc_heatmapStops[] =
+    {
+        { 0.00f,   { 0.0f, 0.0f, 0.0f, 1.0f } }, // Black
+        { 3.16f,   { 0.0f, 0.0f, 1.0f, 1.0f } }, // Blue
+        { 10.0f,   { 0.0f, 1.0f, 1.0f, 1.0f } }, // Cyan
+        { 31.6f,   { 0.0f, 1.0f, 0.0f, 1.0f } }, // Green
+        { 100.f,   { 1.0f, 1.0f, 0.0f, 1.0f } }, // Yellow
+        { 316.f,   { 1.0f, 0.2f, 0.0f, 1.0f } }, // Orange
+        { 1000.f,  { 1.0f, 0.0f, 0.0f, 1.0f } }, // Red
+        { 3160.f,  { 1.0f, 0.0f, 1.0f, 1.0f } }, // Magenta
+        { 10000.f, { 1.0f, 1.0f, 1.0f, 1.0f } }, // White
+    };
+}
+
+LuminanceColormap::LuminanceColormap() :
+    m_lut(sc_ColormapLutSize),
+    m_minNits(0.0f),
+    m_maxNits(0.0f),
+    m_lutMinNits(0.0f),
+    m_log2LutMin(0.0f),
+    m_indexScale(0.0f)
+{
+    SetStops(sc_heatmapStops, sizeof(sc_heatmapStops) / sizeof(sc_heatmapStops[0]));
+}
+
+bool LuminanceColormap::SetStops(const ColormapStop* stops, size_t count)
+{
+    if (stops == nullptr || count < 2) return false;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!std::isfinite(stops[i].nits) || stops[i].nits < 0.0f) return false;
+        if (i > 0 && stops[i].nits < stops[i - 1].nits) return false;
+    }
+
+    if (!(stops[count - 1].nits > stops[0].nits)) return false;
+
+    m_stops.assign(stops, stops + count);
+    Bake();
+
+    return true;
+}
+
+void LuminanceColormap::Bake()
+{
+    m_minNits = m_stops.front().nits;
+    m_maxNits = m_stops.back().nits;
+    m_lutMinNits = m_minNits > 0.0f ? m_minNits : (std::min)(sc_ColormapMinNits, m_maxNits * 0.5f);
+    m_log2LutMin = log2f(m_lutMinNits);
+    m_indexScale = (sc_ColormapLutSize - 1) / (log2f(m_maxNits) - m_log2LutMin);
+
+    size_t segment = 0;
+
+    for (unsigned int i = 0; i < sc_ColormapLutSize; i++)
+    {
+        float nits = i == sc_ColormapLutSize - 1 ? m_maxNits : exp2f(m_log2LutMin + i / m_indexScale);
+
+        // Entries increase in nits, so the segment only moves forward. At a hard edge the later
+        // stop wins.
+        while (segment + 2 < m_stops.size() && nits >= m_stops[segment + 1].nits)
+        {
+            segment++;
+        }
+
+        const ColormapStop& lower = m_stops[segment];
+        const ColormapStop& upper = m_stops[segment + 1];
+
+        float width = upper.nits - lower.nits;
+        float t = width > 0.0f ? (std::min)((std::max)((nits - lower.nits) / width, 0.0f), 1.0f) : 1.0f;
+
+        XMStoreFloat4A(&m_lut[i], XMVectorLerp(XMLoadFloat4(&lower.color), XMLoadFloat4(&upper.color), t));
+    }
+}
+
+XMVECTOR XM_CALLCONV LuminanceColormap::Map(FXMVECTOR color) const
+{
+    float nits = XMVectorGetX(XMVector3Dot(color, sc_bt709Luminance)) * sc_SceneReferredSdrWhiteNits;
+
+    // Also rejects NaN.
+    if (!(nits >= m_minNits && nits <= m_maxNits))
+    {
+        return g_XMZero;
+    }
+
+    float index = (log2f((std::max)(nits, m_lutMinNits)) - m_log2LutMin) * m_indexScale;
+    index = (std::min)((std::max)(index, 0.0f), static_cast<float>(sc_ColormapLutSize - 1));
+
+    unsigned int i0 = static_cast<unsigned int>(index);
+    unsigned int i1 = (std::min)(i0 + 1, sc_ColormapLutSize - 1);
+
+    return XMVectorLerp(XMLoadFloat4A(&m_lut[i0]), XMLoadFloat4A(&m_lut[i1]), index - static_cast<float>(i0));
+}
+
+void LuminanceColormap::Apply(CpuImage& image, unsigned int threadCount) const
+{
+    ParallelFor(0, image.GetHeight(), sc_DefaultRowsPerBand, threadCount, [&](size_t first, size_t last)
+    {
+        for (size_t y = first; y < last; y++)
+        {
+            XMFLOAT4A* row = image.GetRow(static_cast<unsigned int>(y));
+
+            for (unsigned int x = 0; x < image.GetWidth(); x++)
+            {
+                XMStoreFloat4A(&row[x], Map(XMLoadFloat4A(&row[x])));
+            }
+        }
+    });
+}
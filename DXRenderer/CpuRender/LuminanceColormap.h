@@ -0,0 +1,91 @@
+//*********************************************************
+//
+// LuminanceColormap
+//
+// Maps the luminance of scRGB pixels to colors, e.g. the
+// luminance heatmap or false color exposure bands. A list of
+// (nits, color) stops is baked into a 1D LUT indexed by log2
+// luminance, so mapping a pixel is one lookup and a lerp
+// however many stops there are. The same LUT is uploaded as a
+// resource texture by LuminanceHeatmapEffect.
+//
+//*********************************************************
+
+#pragma once
+
+#include "CpuImage.h"
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <vector>
+
+namespace DXRenderer
+{
+    /// <summary>
+    /// Color at a luminance. Colors are interpolated linearly in nits between stops. Two stops at
+    /// the same luminance make a hard edge there, as used for exposure bands.
+    /// </summary>
+    struct ColormapStop
+    {
+        float                                                   nits;
+        DirectX::XMFLOAT4                                       color;          // scRGB with alpha.
+    };
+
+    // Entries in the baked LUT.
+    const unsigned int sc_ColormapLutSize = 1024;
+
+    // When the first stop is at 0 nits, the LUT starts here instead; darker pixels use its color.
+    const float sc_ColormapMinNits = 1.0f / 128.0f;
+
+    class LuminanceColormap
+    {
+    public:
+        /// <summary>
+        /// The luminance heatmap: black at 0 nits, then two colors per order of magnitude up to
+        /// white at 10000 nits.
+        /// </summary>
+        LuminanceColormap();
+
+        /// <summary>
+        /// Replaces the stops and rebakes the LUT. Pixels outside [first stop, last stop] map to
+        /// transparent black.
+        /// </summary>
+        /// <returns>False, leaving the colormap unchanged, if there are fewer than two stops, a stop
+        /// is negative or not finite, the stops aren't in non-decreasing order of nits or the last
+        /// stop isn't above the first.</returns>
+        bool SetStops(const ColormapStop* stops, size_t count);
+
+        const std::vector<ColormapStop>& GetStops() const { return m_stops; }
+
+        /// <summary>
+        /// Color for an scRGB pixel (1.0 = 80 nits).
+        /// </summary>
+        DirectX::XMVECTOR XM_CALLCONV Map(DirectX::FXMVECTOR color) const;
+
+        /// <summary>
+        /// Replaces every pixel of image with its color.
+        /// </summary>
+        /// <param name="threadCount">0 means use all hardware threads.</param>
+        void Apply(CpuImage& image, unsigned int threadCount = 0) const;
+
+        // The LUT and how to index it: index = (log2(max(nits, lutMinNits)) - log2LutMin) * indexScale,
+        // interpolating between entries floor(index) and floor(index) + 1.
+        const DirectX::XMFLOAT4A* GetLut() const { return m_lut.data(); }
+        float GetMinNits() const { return m_minNits; }
+        float GetMaxNits() const { return m_maxNits; }
+        float GetLutMinNits() const { return m_lutMinNits; }
+        float GetLog2LutMin() const { return m_log2LutMin; }
+        float GetIndexScale() const { return m_indexScale; }
+
+    private:
+        void Bake();
+
+        std::vector<ColormapStop>                               m_stops;
+        std::vector<DirectX::XMFLOAT4A>                         m_lut;
+        float                                                   m_minNits;
+        float                                                   m_maxNits;
+        float                                                   m_lutMinNits;
+        float                                                   m_log2LutMin;
+        float                                                   m_indexScale;
+    };
+}
@@ -0,0 +1,284 @@
+//*********************************************************
+//
+// LuminanceHistogram
+//
+// See LuminanceHistogram.h. Pixels are binned four at a time:
+// RGB is transposed into SoA form, converted to normalized Y,
+// and the histogram gamma is applied with vectorized log2/exp2.
+//
+//*********************************************************
+
+#include "LuminanceHistogram.h"
+#include "ParallelFor.h"
+#include "../Matrix.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+using namespace DXRenderer;
+
+namespace
+{
+    // Twice sc_DefaultRowsPerBand: each worker merges a whole histogram of its own at the end, and
+    // binning a row is cheap, so larger bands keep the hand-out overhead down.
+    const size_t sc_rowsPerBand = 32;
+
+    // FP16 pixels are expanded to FP32 in chunks of this many pixels.
+    const size_t sc_halfChunkPixels = 256;
+
+    // MaxCLL is nominally calculated for the single brightest pixel in a frame.
+    // But we take a slightly more conservative definition that takes the 99.99th percentile
+    // to account for extreme outliers in the image.
+    const float sc_maxCLLPercent = 0.9999f;
+
+    // Same normalization as the color matrix in HDRImageViewerRenderer::CreateHistogramResources:
+    // scRGB values to Y, divided so that sc_histMaxNits maps to 1.0.
+    const float sc_normalizeScale = sc_SceneReferredSdrWhiteNits / sc_histMaxNits;
+
+    // BT.709 luminance coefficients for scRGB input.
+    const XMFLOAT3 sc_scRgbLuminance = { 0.2126f, 0.7152f, 0.0722f };
+
+    inline void XM_CALLCONV BinFourPixels(
+        FXMVECTOR p0, FXMVECTOR p1, FXMVECTOR p2, GXMVECTOR p3,
+        HXMVECTOR lumR, HXMVECTOR lumG, CXMVECTOR lumB,
+        _Inout_ uint64_t* bins)
+    {
+        // Rows of the transposed matrix are R, G, B and A of the four pixels.
+        XMMATRIX soa = XMMatrixTranspose(XMMATRIX(p0, p1, p2, p3));
+
+        XMVECTOR y = XMVectorMultiply(soa.r[0], lumR);
+        y = XMVectorMultiplyAdd(soa.r[1], lumG, y);
+        y = XMVectorMultiplyAdd(soa.r[2], lumB, y);
+
+        // Negative and NaN luminance go to bin 0.
+        XMVECTOR isPositive = XMVectorGreater(y, g_XMZero);
+        y = XMVectorMax(y, g_XMZero);
+
+        // pow(y, gamma) == exp2(log2(y) * gamma).
+        XMVECTOR v = XMVectorExp2(XMVectorScale(XMVectorLog2(y), sc_histGamma));
+        v = XMVectorSelect(g_XMZero, v, isPositive);
+
+        // Values >= 1.0 are clamped to the top bin.
+        v = XMVectorMin(XMVectorScale(v, static_cast<float>(sc_histNumBins)), XMVectorReplicate(static_cast<float>(sc_histNumBins - 1)));
+
+        XMFLOAT4A binIndex;
+        XMStoreFloat4A(&binIndex, v);
+
+        bins[static_cast<unsigned int>(binIndex.x)]++;
+        bins[static_cast<unsigned int>(binIndex.y)]++;
+        bins[static_cast<unsigned int>(binIndex.z)]++;
+        bins[static_cast<unsigned int>(binIndex.w)]++;
+    }
+}
+
+LuminanceHistogram::LuminanceHistogram() :
+    LuminanceHistogram(sc_scRgbLuminance)
+{
+}
+
+LuminanceHistogram::LuminanceHistogram(const XMFLOAT3& luminanceWeights)
+{
+    XMStoreFloat4A(&m_lumR, XMVectorReplicate(luminanceWeights.x * sc_normalizeScale));
+    XMStoreFloat4A(&m_lumG, XMVectorReplicate(luminanceWeights.y * sc_normalizeScale));
+    XMStoreFloat4A(&m_lumB, XMVectorReplicate(luminanceWeights.z * sc_normalizeScale));
+
+    Clear();
+}
+
+void LuminanceHistogram::Clear()
+{
+    m_bins.fill(0);
+    m_pixelCount = 0;
+}
+
+void LuminanceHistogram::AddPixels(const XMFLOAT4A* pixels, size_t count)
+{
+    XMVECTOR lumR = XMLoadFloat4A(&m_lumR);
+    XMVECTOR lumG = XMLoadFloat4A(&m_lumG);
+    XMVECTOR lumB = XMLoadFloat4A(&m_lumB);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        BinFourPixels(
+            XMLoadFloat4A(&pixels[i]),
+            XMLoadFloat4A(&pixels[i + 1]),
+            XMLoadFloat4A(&pixels[i + 2]),
+            XMLoadFloat4A(&pixels[i + 3]),
+            lumR, lumG, lumB,
+            m_bins.data());
+    }
+
+    if (i < count)
+    {
+        // Pad the remainder with black and remove the padding afterwards.
+        XMVECTOR tail[4] = { g_XMZero, g_XMZero, g_XMZero, g_XMZero };
+        size_t remainder = count - i;
+
+        for (size_t j = 0; j < remainder; j++)
+        {
+            tail[j] = XMLoadFloat4A(&pixels[i + j]);
+        }
+
+        BinFourPixels(tail[0], tail[1], tail[2], tail[3], lumR, lumG, lumB, m_bins.data());
+        m_bins[0] -= 4 - remainder;
+    }
+
+    m_pixelCount += count;
+}
+
+void LuminanceHistogram::AddPixels(const XMHALF4* pixels, size_t count)
+{
+    XMFLOAT4A expanded[sc_halfChunkPixels];
+
+    for (size_t i = 0; i < count; i += sc_halfChunkPixels)
+    {
+        size_t chunk = (std::min)(sc_halfChunkPixels, count - i);
+
+        XMConvertHalfToFloatStream(
+            &expanded[0].x,
+            sizeof(float),
+            &pixels[i].x,
+            sizeof(HALF),
+            chunk * 4);
+
+        AddPixels(expanded, chunk);
+    }
+}
+
+void LuminanceHistogram::AddPixels(
+    const XMHALF4* pixels,
+    unsigned int width,
+    unsigned int height,
+    size_t rowPitchBytes,
+    unsigned int threadCount)
+{
+    // Partials copy the luminance weights of this histogram.
+    LuminanceHistogram empty(*this);
+    empty.Clear();
+
+    unsigned int numWorkers = GetParallelForWorkerCount(0, height, sc_rowsPerBand, threadCount);
+    std::vector<LuminanceHistogram> partials(numWorkers, empty);
+
+    ParallelForWorkers(0, height, sc_rowsPerBand, threadCount, [&](size_t first, size_t last, unsigned int worker)
+    {
+        for (size_t y = first; y < last; y++)
+        {
+            auto row = reinterpret_cast<const XMHALF4*>(reinterpret_cast<const uint8_t*>(pixels) + y * rowPitchBytes);
+            partials[worker].AddPixels(row, width);
+        }
+    });
+
+    for (auto& partial : partials)
+    {
+        Merge(partial);
+    }
+}
+
+void LuminanceHistogram::Merge(const LuminanceHistogram& other)
+{
+    for (size_t i = 0; i < m_bins.size(); i++)
+    {
+        m_bins[i] += other.m_bins[i];
+    }
+
+    m_pixelCount += other.m_pixelCount;
+}
+
+HistogramCLL LuminanceHistogram::ComputeCLL() const
+{
+    if (m_pixelCount == 0)
+    {
+        return { -1.0f, -1.0f };
+    }
+
+    std::array<float, sc_histNumBins> normalized;
+    for (size_t i = 0; i < m_bins.size(); i++)
+    {
+        normalized[i] = static_cast<float>(static_cast<double>(m_bins[i]) / static_cast<double>(m_pixelCount));
+    }
+
+    return ComputeCLL(normalized.data());
+}
+
+LuminanceHistogram LuminanceHistogram::Compute(const CpuImage& image, unsigned int threadCount)
+{
+    unsigned int numWorkers = GetParallelForWorkerCount(0, image.GetHeight(), sc_rowsPerBand, threadCount);
+    std::vector<LuminanceHistogram> partials(numWorkers);
+
+    ParallelForWorkers(0, image.GetHeight(), sc_rowsPerBand, threadCount, [&](size_t first, size_t last, unsigned int worker)
+    {
+        const XMFLOAT4A* rows = image.GetRow(static_cast<unsigned int>(first));
+        partials[worker].AddPixels(rows, (last - first) * image.GetWidth());
+    });
+
+    LuminanceHistogram result;
+    for (auto& partial : partials)
+    {
+        result.Merge(partial);
+    }
+
+    return result;
+}
+
+LuminanceHistogram LuminanceHistogram::Compute(
+    const XMHALF4* pixels,
+    unsigned int width,
+    unsigned int height,
+    size_t rowPitchBytes,
+    unsigned int threadCount)
+{
+    LuminanceHistogram result;
+    result.AddPixels(pixels, width, height, rowPitchBytes, threadCount);
+
+    return result;
+}
+
+HistogramCLL LuminanceHistogram::ComputeCLL(const float* normalizedHistogram)
+{
+    unsigned int maxCLLbin = 0;
+    unsigned int avgCLLbin = 0; // Average is defined as 50th percentile.
+    float runningSum = 0.0f; // Cumulative sum of values in histogram is 1.0.
+    for (int i = sc_histNumBins - 1; i >= 0; i--)
+    {
+        runningSum += normalizedHistogram[i];
+
+        // Note the inequality (<) is the opposite of the next if block.
+        if (runningSum < 1.0f - sc_maxCLLPercent)
+        {
+            maxCLLbin = i;
+        }
+
+        if (runningSum > 0.5f)
+        {
+            // Note if the entire histogram is 0, avgCLLbin remains at 0.
+            avgCLLbin = i;
+            break;
+        }
+    }
+
+    return { BinToNits(maxCLLbin), BinToNits(avgCLLbin) };
+}
+
+XMFLOAT3 LuminanceHistogram::GetLuminanceWeights(
+    float redX, float redY,
+    float greenX, float greenY,
+    float blueX, float blueY,
+    float whiteX, float whiteY)
+{
+    // Y row of the RGB to XYZ matrix.
+    auto toXyz = ColorMatrix::RgbToXyz(redX, redY, greenX, greenY, blueX, blueY, whiteX, whiteY);
+
+    return XMFLOAT3(
+        static_cast<float>(toXyz(1, 0)),
+        static_cast<float>(toXyz(1, 1)),
+        static_cast<float>(toXyz(1, 2)));
+}
+
+float LuminanceHistogram::BinToNits(unsigned int bin)
+{
+    float binNorm = static_cast<float>(bin) / static_cast<float>(sc_histNumBins);
+    return powf(binNorm, 1 / sc_histGamma) * sc_histMaxNits;
+}
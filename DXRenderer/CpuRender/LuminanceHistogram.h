@@ -0,0 +1,126 @@
+//*********************************************************
+//
+// LuminanceHistogram
+//
+// Exact CPU implementation of the luminance histogram used to
+// compute HDR metadata (MaxCLL and median CLL). Uses the same
+// bin layout as the Direct2D histogram pipeline built in
+// HDRImageViewerRenderer::CreateHistogramResources:
+// sc_histNumBins bins over [0, sc_histMaxNits] with a gamma of
+// sc_histGamma, and Y computed with BT.709 coefficients.
+//
+// Operates on full resolution data, unlike the Direct2D path
+// which must first downscale the image.
+//
+//*********************************************************
+
+#pragma once
+
+#include "CpuImage.h"
+#include "../MagicConstants.h"
+
+#include <DirectXPackedVector.h>
+#include <array>
+#include <cstdint>
+
+namespace DXRenderer
+{
+    /// <summary>
+    /// Equivalent of ImageCLL which does not depend on the Windows Runtime.
+    /// </summary>
+    struct HistogramCLL
+    {
+        float maxNits;      // -1 if unknown.
+        float medianNits;   // -1 if unknown.
+    };
+
+    class LuminanceHistogram
+    {
+    public:
+        LuminanceHistogram();
+
+        /// <summary>
+        /// Histograms pixels in a color space other than scRGB.
+        /// </summary>
+        /// <param name="luminanceWeights">Contribution of R, G and B to Y; the Y row of the source RGB to XYZ matrix.</param>
+        explicit LuminanceHistogram(const DirectX::XMFLOAT3& luminanceWeights);
+
+        void Clear();
+
+        /// <summary>
+        /// Adds scRGB pixels to the histogram. Not thread safe; use one histogram per thread and Merge.
+        /// </summary>
+        void AddPixels(_In_reads_(count) const DirectX::XMFLOAT4A* pixels, size_t count);
+        void AddPixels(_In_reads_(count) const DirectX::PackedVector::XMHALF4* pixels, size_t count);
+
+        /// <summary>
+        /// Adds a block of FP16 pixels, split across threads.
+        /// </summary>
+        /// <param name="threadCount">0 means use all hardware threads.</param>
+        void AddPixels(
+            _In_ const DirectX::PackedVector::XMHALF4* pixels,
+            unsigned int width,
+            unsigned int height,
+            size_t rowPitchBytes,
+            unsigned int threadCount);
+
+        /// <summary>
+        /// Adds the bins of another histogram, which must use the same luminance weights.
+        /// </summary>
+        void Merge(const LuminanceHistogram& other);
+
+        uint64_t GetPixelCount() const { return m_pixelCount; }
+        const std::array<uint64_t, sc_histNumBins>& GetBins() const { return m_bins; }
+
+        /// <summary>
+        /// MaxCLL (99.99th percentile) and median luminance of all added pixels.
+        /// </summary>
+        HistogramCLL ComputeCLL() const;
+
+        /// <summary>
+        /// Histograms an entire image, split across threads.
+        /// </summary>
+        /// <param name="threadCount">0 means use all hardware threads.</param>
+        static LuminanceHistogram Compute(const CpuImage& image, unsigned int threadCount = 0);
+
+        /// <summary>
+        /// Histograms FP16 scRGB pixels (e.g. a mapped DXGI_FORMAT_R16G16B16A16_FLOAT surface), split across threads.
+        /// </summary>
+        static LuminanceHistogram Compute(
+            _In_ const DirectX::PackedVector::XMHALF4* pixels,
+            unsigned int width,
+            unsigned int height,
+            size_t rowPitchBytes,
+            unsigned int threadCount = 0);
+
+        /// <summary>
+        /// Computes MaxCLL and median from a normalized histogram (sum of bins is 1) with sc_histNumBins bins.
+        /// Shared with the Direct2D histogram path so both produce identical results for identical bins.
+        /// </summary>
+        static HistogramCLL ComputeCLL(_In_reads_(sc_histNumBins) const float* normalizedHistogram);
+
+        /// <summary>
+        /// Luminance weights for an RGB color space given its primaries and white point as CIE xy,
+        /// for use with the luminanceWeights constructor.
+        /// </summary>
+        static DirectX::XMFLOAT3 GetLuminanceWeights(
+            float redX, float redY,
+            float greenX, float greenY,
+            float blueX, float blueY,
+            float whiteX, float whiteY);
+
+        /// <summary>
+        /// Luminance in nits at the lower edge of a bin.
+        /// </summary>
+        static float BinToNits(unsigned int bin);
+
+    private:
+        // Luminance weights pre-multiplied by the histogram normalization, replicated for BinFourPixels.
+        DirectX::XMFLOAT4A                                      m_lumR;
+        DirectX::XMFLOAT4A                                      m_lumG;
+        DirectX::XMFLOAT4A                                      m_lumB;
+
+        std::array<uint64_t, sc_histNumBins>                    m_bins;
+        uint64_t                                                m_pixelCount;
+    };
+}
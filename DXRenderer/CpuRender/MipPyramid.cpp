@@ -0,0 +1,187 @@
+//*********************************************************
+//
+// MipPyramid
+//
+// See MipPyramid.h. Each thread expands a pair of source rows
+// to FP32, averages 2x2 blocks with DirectXMath and packs the
+// output row back to FP16. Odd dimensions round up, and the
+// last row/column is repeated.
+//
+//*********************************************************
+
+#include "MipPyramid.h"
+#include "ParallelFor.h"
+#include "PixelDecoders.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+using namespace DXRenderer;
+
+namespace
+{
+    void LoadRow(const uint8_t* row, MipSourceFormat format, unsigned int width, XMFLOAT4A* output)
+    {
+        switch (format)
+        {
+        case MipSourceFormat::R16G16B16A16Float:
+            DecodeRowR16G16B16A16Float(reinterpret_cast<const uint16_t*>(row), width, output);
+            break;
+
+        case MipSourceFormat::R16G16B16A16Unorm:
+            DecodeRowR16G16B16A16Unorm(reinterpret_cast<const uint16_t*>(row), width, output);
+            break;
+
+        case MipSourceFormat::B8G8R8A8Unorm:
+            DecodeRowB8G8R8A8(row, width, output);
+            break;
+
+        case MipSourceFormat::R10G10B10A2Unorm:
+            DecodeRowR10G10B10A2(reinterpret_cast<const uint32_t*>(row), width, output);
+            break;
+
+        case MipSourceFormat::Rgbe:
+            DecodeRowRgbe(row, width, output);
+            break;
+        }
+    }
+
+    /// <summary>
+    /// Computes output rows [first, last) of dest.
+    /// </summary>
+    /// <param name="scratch">Room for two source rows and one output row.</param>
+    void DownsampleRows(
+        const uint8_t* source,
+        MipSourceFormat format,
+        unsigned int sourceWidth,
+        unsigned int sourceHeight,
+        size_t rowPitchBytes,
+        MipLevel& dest,
+        size_t first,
+        size_t last,
+        XMFLOAT4A* scratch)
+    {
+        XMFLOAT4A* row0 = scratch;
+        XMFLOAT4A* row1 = scratch + sourceWidth;
+        XMFLOAT4A* output = scratch + 2 * static_cast<size_t>(sourceWidth);
+
+        const XMVECTOR quarter = XMVectorReplicate(0.25f);
+
+        // RGBE covers a far wider range than FP16; saturate rather than produce infinities.
+        const XMVECTOR halfMax = XMVectorReplicate(65504.0f);
+
+        for (size_t y = first; y < last; y++)
+        {
+            size_t sy0 = y * 2;
+            size_t sy1 = (std::min)(sy0 + 1, static_cast<size_t>(sourceHeight) - 1);
+
+            LoadRow(source + sy0 * rowPitchBytes, format, sourceWidth, row0);
+            LoadRow(source + sy1 * rowPitchBytes, format, sourceWidth, row1);
+
+            for (unsigned int x = 0; x < dest.width; x++)
+            {
+                unsigned int sx0 = x * 2;
+                unsigned int sx1 = (std::min)(sx0 + 1, sourceWidth - 1);
+
+                XMVECTOR top = XMVectorAdd(XMLoadFloat4A(&row0[sx0]), XMLoadFloat4A(&row0[sx1]));
+                XMVECTOR bottom = XMVectorAdd(XMLoadFloat4A(&row1[sx0]), XMLoadFloat4A(&row1[sx1]));
+
+                XMStoreFloat4A(&output[x], XMVectorMin(XMVectorMultiply(XMVectorAdd(top, bottom), quarter), halfMax));
+            }
+
+            XMConvertFloatToHalfStream(
+                &dest.pixels[y * dest.width].x,
+                sizeof(HALF),
+                &output[0].x,
+                sizeof(float),
+                static_cast<size_t>(dest.width) * 4);
+        }
+    }
+}
+
+void MipPyramid::Downsample(
+    const void* pixels,
+    MipSourceFormat format,
+    unsigned int width,
+    unsigned int height,
+    size_t rowPitchBytes,
+    MipLevel& dest,
+    unsigned int threadCount)
+{
+    auto source = static_cast<const uint8_t*>(pixels);
+
+    dest.width = (width + 1) / 2;
+    dest.height = (height + 1) / 2;
+    dest.pixels.resize(static_cast<size_t>(dest.width) * dest.height);
+
+    size_t scratchPerWorker = 2 * static_cast<size_t>(width) + dest.width;
+    unsigned int numWorkers = GetParallelForWorkerCount(0, dest.height, sc_DefaultRowsPerBand, threadCount);
+    std::vector<XMFLOAT4A> scratch(scratchPerWorker * numWorkers);
+
+    ParallelForWorkers(0, dest.height, sc_DefaultRowsPerBand, threadCount, [&](size_t first, size_t last, unsigned int worker)
+    {
+        DownsampleRows(source, format, width, height, rowPitchBytes, dest, first, last, &scratch[scratchPerWorker * worker]);
+    });
+}
+
+void MipPyramid::Build(
+    const void* pixels,
+    MipSourceFormat format,
+    unsigned int width,
+    unsigned int height,
+    size_t rowPitchBytes,
+    unsigned int minDimension,
+    unsigned int threadCount)
+{
+    m_levels.clear();
+
+    auto source = static_cast<const uint8_t*>(pixels);
+
+    while (width > 1 || height > 1)
+    {
+        unsigned int levelWidth = (width + 1) / 2;
+        unsigned int levelHeight = (height + 1) / 2;
+
+        if (levelWidth < minDimension && levelHeight < minDimension)
+        {
+            break;
+        }
+
+        MipLevel level;
+        Downsample(source, format, width, height, rowPitchBytes, level, threadCount);
+
+        m_levels.push_back(std::move(level));
+
+        // The next level is filtered from this one.
+        auto& previous = m_levels.back();
+        source = reinterpret_cast<const uint8_t*>(previous.pixels.data());
+        format = MipSourceFormat::R16G16B16A16Float;
+        width = previous.width;
+        height = previous.height;
+        rowPitchBytes = static_cast<size_t>(width) * sizeof(XMHALF4);
+    }
+}
+
+uint64_t MipPyramid::GetSizeInBytes() const
+{
+    uint64_t size = 0;
+    for (auto& level : m_levels)
+    {
+        size += level.pixels.size() * sizeof(XMHALF4);
+    }
+
+    return size;
+}
+
+unsigned int MipPyramid::SelectLevel(float zoom, unsigned int levelCount)
+{
+    // Level n is 2^-n the size of the source.
+    unsigned int level = 0;
+    while (level < levelCount && zoom * static_cast<float>(2u << level) <= 1.0f)
+    {
+        level++;
+    }
+
+    return level;
+}
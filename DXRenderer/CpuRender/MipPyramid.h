@@ -0,0 +1,102 @@
+//*********************************************************
+//
+// MipPyramid
+//
+// Power-of-two reductions of a decoded image, stored as FP16
+// RGBA. Lets the renderer sample a level close to the display
+// size instead of scaling the full resolution image every
+// frame, which matters when a very large image is fit to the
+// window.
+//
+// Each level is a 2x2 box filter of the level above it. Pixels
+// are expected to be premultiplied, so averaging is correct
+// across alpha. Values are filtered in whatever encoding the
+// source uses (e.g. sRGB gamma for integer images, PQ for
+// HDR10), matching how Direct2D scales an image source.
+//
+//*********************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include <cstdint>
+#include <vector>
+
+namespace DXRenderer
+{
+    /// <summary>
+    /// Pixel formats accepted as level 0; equivalent to the WIC formats ImageLoader decodes to.
+    /// </summary>
+    enum class MipSourceFormat
+    {
+        R16G16B16A16Float, // GUID_WICPixelFormat64bppPRGBAHalf
+        R16G16B16A16Unorm, // GUID_WICPixelFormat64bppPRGBA
+        B8G8R8A8Unorm,     // GUID_WICPixelFormat32bppPBGRA
+        R10G10B10A2Unorm,  // GUID_WICPixelFormat32bppR10G10B10A2HDR10
+        Rgbe               // GUID_WICPixelFormat32bppRGBE
+    };
+
+    struct MipLevel
+    {
+        unsigned int                                            width;
+        unsigned int                                            height;
+        std::vector<DirectX::PackedVector::XMHALF4>             pixels; // Tightly packed.
+    };
+
+    class MipPyramid
+    {
+    public:
+        MipPyramid() {}
+
+        /// <summary>
+        /// Generates levels from a full resolution image, which is not copied.
+        /// </summary>
+        /// <param name="minDimension">No level is generated whose width and height are both below this.</param>
+        /// <param name="threadCount">0 means use all hardware threads.</param>
+        void Build(
+            _In_ const void* pixels,
+            MipSourceFormat format,
+            unsigned int width,
+            unsigned int height,
+            size_t rowPitchBytes,
+            unsigned int minDimension,
+            unsigned int threadCount = 0);
+
+        /// <summary>
+        /// Computes a single half size level into dest. Also used for images that are never
+        /// held in memory as a whole, one tile at a time.
+        /// </summary>
+        static void Downsample(
+            _In_ const void* pixels,
+            MipSourceFormat format,
+            unsigned int width,
+            unsigned int height,
+            size_t rowPitchBytes,
+            MipLevel& dest,
+            unsigned int threadCount = 0);
+
+        void Clear() { m_levels.clear(); }
+
+        /// <summary>
+        /// Number of generated levels. Level 0 is the source image and is not stored.
+        /// </summary>
+        unsigned int GetLevelCount() const { return static_cast<unsigned int>(m_levels.size()); }
+
+        /// <summary>
+        /// Level must be between 1 and GetLevelCount() inclusive.
+        /// </summary>
+        const MipLevel& GetLevel(unsigned int level) const { return m_levels[level - 1]; }
+
+        uint64_t GetSizeInBytes() const;
+
+        /// <summary>
+        /// Returns the smallest level that is still at least as large as the image drawn at zoom,
+        /// i.e. one that is only ever scaled down. 0 means the source image.
+        /// </summary>
+        static unsigned int SelectLevel(float zoom, unsigned int levelCount);
+
+    private:
+        std::vector<MipLevel>                                   m_levels;
+    };
+}
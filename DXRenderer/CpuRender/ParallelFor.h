@@ -0,0 +1,129 @@
+//*********************************************************
+//
+// ParallelFor
+//
+// Minimal portable helper for splitting CPU image processing
+// work across threads. Uses only the C++ standard library so
+// that the CpuRender code can be built without the Windows
+// Runtime (e.g. for headless batch processing).
+//
+//*********************************************************
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DXRenderer
+{
+    // Default grainSize for passes over the rows of an image: rows in each unit of work handed
+    // to a thread. Passes with a reason to differ define their own next to it.
+    const size_t sc_DefaultRowsPerBand = 16;
+
+    /// <summary>
+    /// Returns the number of threads to use for CPU image processing.
+    /// </summary>
+    /// <param name="requested">0 means use all hardware threads.</param>
+    inline unsigned int GetCpuThreadCount(unsigned int requested = 0)
+    {
+        if (requested != 0) return requested;
+
+        unsigned int count = std::thread::hardware_concurrency();
+        return count != 0 ? count : 1;
+    }
+
+    /// <summary>
+    /// Returns how many workers ParallelForWorkers will use for a given range. Use this to size
+    /// any per-worker state (e.g. partial histograms) that are merged after the loop.
+    /// </summary>
+    inline unsigned int GetParallelForWorkerCount(size_t begin, size_t end, size_t grainSize, unsigned int threadCount)
+    {
+        if (end <= begin) return 0;
+
+        grainSize = std::max<size_t>(grainSize, 1);
+        size_t numChunks = (end - begin + grainSize - 1) / grainSize;
+
+        return static_cast<unsigned int>(std::min<size_t>(GetCpuThreadCount(threadCount), numChunks));
+    }
+
+    /// <summary>
+    /// Calls func(first, last, workerIndex) for contiguous chunks of [begin, end), each at most
+    /// grainSize long. Chunks are handed out dynamically so uneven work is balanced across threads.
+    /// The calling thread participates as worker 0. The first exception thrown by func is rethrown
+    /// after all workers have finished.
+    /// </summary>
+    /// <param name="threadCount">0 means use all hardware threads.</param>
+    template <typename Func>
+    void ParallelForWorkers(size_t begin, size_t end, size_t grainSize, unsigned int threadCount, Func func)
+    {
+        unsigned int numWorkers = GetParallelForWorkerCount(begin, end, grainSize, threadCount);
+        if (numWorkers == 0) return;
+
+        grainSize = std::max<size_t>(grainSize, 1);
+        size_t numChunks = (end - begin + grainSize - 1) / grainSize;
+
+        std::atomic<size_t> nextChunk(0);
+        std::exception_ptr error;
+        std::mutex errorLock;
+
+        auto worker = [&](unsigned int workerIndex)
+        {
+            try
+            {
+                for (size_t chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++)
+                {
+                    size_t first = begin + chunk * grainSize;
+                    func(first, std::min(first + grainSize, end), workerIndex);
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(errorLock);
+                if (!error) error = std::current_exception();
+
+                // Drain the remaining chunks so other workers stop early.
+                nextChunk = numChunks;
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(numWorkers - 1);
+
+        for (unsigned int i = 1; i < numWorkers; i++)
+        {
+            try
+            {
+                threads.emplace_back(worker, i);
+            }
+            catch (...)
+            {
+                // Could not create more threads; the remaining workers pick up the slack.
+                break;
+            }
+        }
+
+        worker(0);
+
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+
+        if (error) std::rethrow_exception(error);
+    }
+
+    /// <summary>
+    /// Calls func(first, last) for contiguous chunks of [begin, end) across threads.
+    /// See ParallelForWorkers.
+    /// </summary>
+    template <typename Func>
+    void ParallelFor(size_t begin, size_t end, size_t grainSize, unsigned int threadCount, Func func)
+    {
+        ParallelForWorkers(begin, end, grainSize, threadCount,
+            [&func](size_t first, size_t last, unsigned int) { func(first, last); });
+    }
+}
@@ -0,0 +1,186 @@
+//*********************************************************
+//
+// PixelDecoders
+//
+// See PixelDecoders.h. Tables are built on first use; C++11
+// guarantees function local statics are initialized once
+// even when first used from several threads.
+//
+//*********************************************************
+
+#include "PixelDecoders.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+using namespace DXRenderer;
+
+namespace
+{
+    struct Unorm8Tables
+    {
+        float normalized[256];
+
+        Unorm8Tables()
+        {
+            for (unsigned int i = 0; i < 256; i++)
+            {
+                normalized[i] = static_cast<float>(i) / 255.0f;
+            }
+        }
+    };
+
+    struct Unorm10Tables
+    {
+        float normalized[1024];
+        float alpha[4];
+
+        Unorm10Tables()
+        {
+            for (unsigned int i = 0; i < 1024; i++)
+            {
+                normalized[i] = static_cast<float>(i) / 1023.0f;
+            }
+
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                alpha[i] = static_cast<float>(i) / 3.0f;
+            }
+        }
+    };
+
+    // Pixels converted per batch by DecodeRowRgbeToHalf.
+    const unsigned int sc_rgbeBatchPixels = 64;
+
+    // Largest finite FP16 value.
+    const float sc_halfMax = 65504.0f;
+
+    struct RgbeTables
+    {
+        // 2^(e - 136), i.e. the exponent bias of 128 plus 8 mantissa bits. 0 for e == 0,
+        // which Radiance reserves for black, so no special case is needed.
+        float scale[256];
+
+        RgbeTables()
+        {
+            scale[0] = 0.0f;
+            for (int e = 1; e < 256; e++)
+            {
+                scale[e] = ldexpf(1.0f, e - 136);
+            }
+        }
+    };
+
+    const Unorm8Tables& GetUnorm8Tables()
+    {
+        static const Unorm8Tables s_tables;
+        return s_tables;
+    }
+
+    const Unorm10Tables& GetUnorm10Tables()
+    {
+        static const Unorm10Tables s_tables;
+        return s_tables;
+    }
+
+    const RgbeTables& GetRgbeTables()
+    {
+        static const RgbeTables s_tables;
+        return s_tables;
+    }
+
+    /// <summary>
+    /// Mantissas are reconstructed at the center of their quantization step, as Radiance does.
+    /// </summary>
+    inline XMVECTOR XM_CALLCONV LoadRgbe(const uint8_t* rgbe, const float* scale)
+    {
+        XMVECTOR mantissa = XMVectorAdd(
+            XMLoadUByte4(reinterpret_cast<const XMUBYTE4*>(rgbe)),
+            XMVectorReplicate(0.5f));
+
+        XMVECTOR color = XMVectorMultiply(mantissa, XMVectorReplicate(scale[rgbe[3]]));
+        return XMVectorSelect(g_XMOne, color, g_XMSelect1110);
+    }
+}
+
+void DXRenderer::DecodeRowB8G8R8A8(const uint8_t* row, unsigned int width, XMFLOAT4A* output)
+{
+    const float* normalized = GetUnorm8Tables().normalized;
+
+    for (unsigned int x = 0; x < width; x++)
+    {
+        const uint8_t* bgra = row + x * 4;
+        XMStoreFloat4A(&output[x], XMVectorSet(normalized[bgra[2]], normalized[bgra[1]], normalized[bgra[0]], normalized[bgra[3]]));
+    }
+}
+
+void DXRenderer::DecodeRowR10G10B10A2(const uint32_t* row, unsigned int width, XMFLOAT4A* output)
+{
+    auto& tables = GetUnorm10Tables();
+
+    for (unsigned int x = 0; x < width; x++)
+    {
+        uint32_t packed = row[x];
+        XMStoreFloat4A(&output[x], XMVectorSet(
+            tables.normalized[packed & 0x3FF],
+            tables.normalized[(packed >> 10) & 0x3FF],
+            tables.normalized[(packed >> 20) & 0x3FF],
+            tables.alpha[packed >> 30]));
+    }
+}
+
+void DXRenderer::DecodeRowR16G16B16A16Unorm(const uint16_t* row, unsigned int width, XMFLOAT4A* output)
+{
+    auto unorm = reinterpret_cast<const XMUSHORTN4*>(row);
+    for (unsigned int x = 0; x < width; x++)
+    {
+        XMStoreFloat4A(&output[x], XMLoadUShortN4(&unorm[x]));
+    }
+}
+
+void DXRenderer::DecodeRowR16G16B16A16Float(const uint16_t* row, unsigned int width, XMFLOAT4A* output)
+{
+    XMConvertHalfToFloatStream(
+        &output[0].x,
+        sizeof(float),
+        reinterpret_cast<const HALF*>(row),
+        sizeof(HALF),
+        static_cast<size_t>(width) * 4);
+}
+
+void DXRenderer::DecodeRowRgbe(const uint8_t* row, unsigned int width, XMFLOAT4A* output)
+{
+    const float* scale = GetRgbeTables().scale;
+
+    for (unsigned int x = 0; x < width; x++)
+    {
+        XMStoreFloat4A(&output[x], LoadRgbe(row + x * 4, scale));
+    }
+}
+
+void DXRenderer::DecodeRowRgbeToHalf(const uint8_t* row, unsigned int width, XMHALF4* output)
+{
+    const float* scale = GetRgbeTables().scale;
+    const XMVECTOR halfMax = XMVectorReplicate(sc_halfMax);
+
+    XMFLOAT4A batch[sc_rgbeBatchPixels];
+
+    for (unsigned int first = 0; first < width; first += sc_rgbeBatchPixels)
+    {
+        unsigned int count = (std::min)(sc_rgbeBatchPixels, width - first);
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            XMStoreFloat4A(&batch[i], XMVectorMin(LoadRgbe(row + (first + i) * 4, scale), halfMax));
+        }
+
+        XMConvertFloatToHalfStream(
+            &output[first].x,
+            sizeof(HALF),
+            &batch[0].x,
+            sizeof(float),
+            static_cast<size_t>(count) * 4);
+    }
+}
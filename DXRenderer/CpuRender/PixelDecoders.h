@@ -0,0 +1,80 @@
+//*********************************************************
+//
+// PixelDecoders
+//
+// Expands rows of the packed pixel formats ImageLoader keeps
+// in memory to RGBA FP32 for CPU processing. Integer formats
+// are decoded through lookup tables indexed by the code value
+// (256 entries for 8 bit, 1024 for 10 bit), and are output
+// as normalized code values: any transfer function, e.g. sRGB
+// gamma, is left for the caller to apply.
+//
+// Radiance RGBE is kept packed at 32bpp and expanded a row at
+// a time; the shared exponent is also looked up in a table
+// instead of calling ldexp per pixel.
+//
+// Premultiplied formats stay premultiplied; alpha is never
+// linearized.
+//
+//*********************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include <cstdint>
+
+namespace DXRenderer
+{
+    /// <summary>
+    /// GUID_WICPixelFormat32bppPBGRA / DXGI_FORMAT_B8G8R8A8_UNORM. Outputs code values normalized
+    /// to [0, 1] in RGBA order.
+    /// </summary>
+    void DecodeRowB8G8R8A8(
+        _In_reads_(width * 4) const uint8_t* row,
+        unsigned int width,
+        _Out_writes_(width) DirectX::XMFLOAT4A* output);
+
+    /// <summary>
+    /// GUID_WICPixelFormat32bppR10G10B10A2HDR10 / DXGI_FORMAT_R10G10B10A2_UNORM. Outputs code values
+    /// normalized to [0, 1], e.g. still PQ encoded for HDR10.
+    /// </summary>
+    void DecodeRowR10G10B10A2(
+        _In_reads_(width) const uint32_t* row,
+        unsigned int width,
+        _Out_writes_(width) DirectX::XMFLOAT4A* output);
+
+    /// <summary>
+    /// GUID_WICPixelFormat64bppPRGBA / DXGI_FORMAT_R16G16B16A16_UNORM.
+    /// </summary>
+    void DecodeRowR16G16B16A16Unorm(
+        _In_reads_(width * 4) const uint16_t* row,
+        unsigned int width,
+        _Out_writes_(width) DirectX::XMFLOAT4A* output);
+
+    /// <summary>
+    /// GUID_WICPixelFormat64bppPRGBAHalf / DXGI_FORMAT_R16G16B16A16_FLOAT.
+    /// </summary>
+    void DecodeRowR16G16B16A16Float(
+        _In_reads_(width * 4) const uint16_t* row,
+        unsigned int width,
+        _Out_writes_(width) DirectX::XMFLOAT4A* output);
+
+    /// <summary>
+    /// Radiance RGBE (GUID_WICPixelFormat32bppRGBE): 8-bit mantissas with a shared 8-bit
+    /// exponent. Outputs linear values; alpha is 1.
+    /// </summary>
+    void DecodeRowRgbe(
+        _In_reads_(width * 4) const uint8_t* row,
+        unsigned int width,
+        _Out_writes_(width) DirectX::XMFLOAT4A* output);
+
+    /// <summary>
+    /// Same as DecodeRowRgbe, but outputs FP16. Values above the FP16 range are clamped to
+    /// its maximum rather than becoming infinity.
+    /// </summary>
+    void DecodeRowRgbeToHalf(
+        _In_reads_(width * 4) const uint8_t* row,
+        unsigned int width,
+        _Out_writes_(width) DirectX::PackedVector::XMHALF4* output);
+}
@@ -0,0 +1,62 @@
+//*********************************************************
+//
+// TonemapConstants
+//
+// Curve constants of the tonemapper family, shared by the CPU
+// implementation in Tonemappers.h and by
+// SimpleTonemapEffect.hlsl, which includes this file. It must
+// therefore stay valid HLSL as well as C++: only comments,
+// preprocessor directives and TONEMAP_CONSTANT scalars, which
+// are constexpr in C++ so they can parameterize templates.
+//
+//*********************************************************
+
+#ifndef DXRENDERER_TONEMAPCONSTANTS_H
+#define DXRENDERER_TONEMAPCONSTANTS_H
+
+#ifdef __cplusplus
+#define TONEMAP_CONSTANT constexpr
+#else
+#define TONEMAP_CONSTANT static const
+#endif
+
+// Operator IDs, as used by SimpleTonemapEffect's Operator property.
+TONEMAP_CONSTANT int sc_TonemapReinhard = 0;            // x / (1 + x), scaled from input max to output max.
+TONEMAP_CONSTANT int sc_TonemapReinhardExtended = 1;    // Reinhard et al. 2002 with the white point at input max.
+TONEMAP_CONSTANT int sc_TonemapBt2390 = 2;              // ITU-R BT.2390 EETF, in PQ.
+TONEMAP_CONSTANT int sc_TonemapAcesFitted = 3;          // Narkowicz 2015 fit of the ACES RRT + ODT.
+TONEMAP_CONSTANT int sc_TonemapHable = 4;               // Hable 2010 (Uncharted 2) filmic curve.
+TONEMAP_CONSTANT int sc_TonemapOperatorCount = 5;
+
+// scRGB (1.0 = 80 nits) to PQ linear light (1.0 = 10000 nits).
+TONEMAP_CONSTANT float sc_TonemapScRgbToPq = 80.0f / 10000.0f;
+
+// SMPTE ST.2084, as floats. Tonemappers.h checks they match TransferFunctions.h.
+TONEMAP_CONSTANT float sc_TonemapPqM1 = 2610.0f / 16384.0f;
+TONEMAP_CONSTANT float sc_TonemapPqM2 = 2523.0f / 4096.0f * 128.0f;
+TONEMAP_CONSTANT float sc_TonemapPqC1 = 3424.0f / 4096.0f;
+TONEMAP_CONSTANT float sc_TonemapPqC2 = 2413.0f / 4096.0f * 32.0f;
+TONEMAP_CONSTANT float sc_TonemapPqC3 = 2392.0f / 4096.0f * 32.0f;
+
+// BT.2390 knee start: KS = 1.5 * maxLum - 0.5.
+TONEMAP_CONSTANT float sc_Bt2390KneeScale = 1.5f;
+TONEMAP_CONSTANT float sc_Bt2390KneeOffset = 0.5f;
+
+// ACES fitted: x (a x + b) / (x (c x + d) + e).
+TONEMAP_CONSTANT float sc_AcesFittedA = 2.51f;
+TONEMAP_CONSTANT float sc_AcesFittedB = 0.03f;
+TONEMAP_CONSTANT float sc_AcesFittedC = 2.43f;
+TONEMAP_CONSTANT float sc_AcesFittedD = 0.59f;
+TONEMAP_CONSTANT float sc_AcesFittedE = 0.14f;
+
+// Hable: (x (a x + c b) + d e) / (x (a x + b) + d f) - e / f.
+TONEMAP_CONSTANT float sc_HableA = 0.15f;   // Shoulder strength.
+TONEMAP_CONSTANT float sc_HableB = 0.50f;   // Linear strength.
+TONEMAP_CONSTANT float sc_HableC = 0.10f;   // Linear angle.
+TONEMAP_CONSTANT float sc_HableD = 0.20f;   // Toe strength.
+TONEMAP_CONSTANT float sc_HableE = 0.02f;   // Toe numerator.
+TONEMAP_CONSTANT float sc_HableF = 0.30f;   // Toe denominator.
+
+#undef TONEMAP_CONSTANT
+
+#endif
@@ -0,0 +1,352 @@
+//*********************************************************
+//
+// Tonemappers
+//
+// A family of HDR tonemapping operators for CPU rendering:
+// Reinhard, extended Reinhard, the BT.2390 EETF, the fitted
+// ACES curve and Hable's filmic curve. Header only.
+//
+// The operator, and the curve parameters of the fitted
+// curves, are template arguments, so each Tonemapper<Curve>
+// compiles to its own branch free XMVECTOR kernel. Per image
+// values (input and output max) are computed once into
+// TonemapConstants, which SimpleTonemapEffect passes to its
+// shader unchanged. The shader implements the same curves
+// from the same TonemapConstants.h, so CPU and GPU output
+// match.
+//
+// Like SimpleTonemapEffect and the Direct2D HDR tonemapper,
+// input and output are scRGB (1.0 = 80 nits). Each color
+// channel is mapped independently, on its magnitude, so
+// negative (out of sRGB gamut) values keep their sign.
+//
+//*********************************************************
+
+#pragma once
+
+#include "CpuImage.h"
+#include "ParallelFor.h"
+#include "TonemapConstants.h"
+#include "TransferFunctions.h"
+
+#include <DirectXMath.h>
+#include <algorithm>
+
+namespace DXRenderer
+{
+    static_assert(sc_TonemapPqM1 == static_cast<float>(sc_PqM1) &&
+                  sc_TonemapPqM2 == static_cast<float>(sc_PqM2) &&
+                  sc_TonemapPqC1 == static_cast<float>(sc_PqC1) &&
+                  sc_TonemapPqC2 == static_cast<float>(sc_PqC2) &&
+                  sc_TonemapPqC3 == static_cast<float>(sc_PqC3),
+                  "The shader's PQ constants must match TransferFunctions.h");
+
+    enum class TonemapOperator
+    {
+        Reinhard = sc_TonemapReinhard,
+        ReinhardExtended = sc_TonemapReinhardExtended,
+        Bt2390 = sc_TonemapBt2390,
+        AcesFitted = sc_TonemapAcesFitted,
+        Hable = sc_TonemapHable
+    };
+
+    /// <summary>
+    /// Per image values shared by every operator. Same layout as the start of the constant
+    /// buffer in SimpleTonemapEffect.hlsl.
+    /// </summary>
+    struct TonemapConstants
+    {
+        float                                                   inputMax;       // scRGB.
+        float                                                   outputMax;      // scRGB.
+        float                                                   white;          // inputMax / outputMax, at least 1.
+        float                                                   curveScale;     // Operator specific, see Prepare.
+        float                                                   pqSourceMax;    // BT.2390: PQ code of inputMax.
+        float                                                   pqMaxLum;       // BT.2390: PQ code of outputMax / pqSourceMax.
+        float                                                   pqKneeStart;    // BT.2390: KS.
+        float                                                   pqKneeScale;    // BT.2390: 1 / (1 - KS), 0 if there is no knee.
+    };
+
+    //*********************************************************
+    // Curve parameters
+    //*********************************************************
+
+    struct AcesFittedNarkowicz
+    {
+        static constexpr float A = sc_AcesFittedA;
+        static constexpr float B = sc_AcesFittedB;
+        static constexpr float C = sc_AcesFittedC;
+        static constexpr float D = sc_AcesFittedD;
+        static constexpr float E = sc_AcesFittedE;
+    };
+
+    struct HableUncharted2
+    {
+        static constexpr float A = sc_HableA;
+        static constexpr float B = sc_HableB;
+        static constexpr float C = sc_HableC;
+        static constexpr float D = sc_HableD;
+        static constexpr float E = sc_HableE;
+        static constexpr float F = sc_HableF;
+    };
+
+    //*********************************************************
+    // Curves
+    //
+    // Prepare fills in the operator specific constants; Map
+    // takes non-negative scRGB values.
+    //*********************************************************
+
+    /// <summary>
+    /// x / (1 + x) with x relative to input max, scaled to output max. Never quite reaches output max.
+    /// </summary>
+    struct ReinhardCurve
+    {
+        static void Prepare(TonemapConstants&) {}
+
+        static DirectX::XMVECTOR XM_CALLCONV Map(DirectX::FXMVECTOR x, const TonemapConstants& c)
+        {
+            using namespace DirectX;
+
+            XMVECTOR t = XMVectorScale(x, 1.0f / c.inputMax);
+            return XMVectorScale(XMVectorDivide(t, XMVectorAdd(t, g_XMOne)), c.outputMax);
+        }
+    };
+
+    /// <summary>
+    /// x (1 + x / w^2) / (1 + x) with x relative to output max and the white point w at input
+    /// max, which maps to output max. The identity when input max is at most output max.
+    /// </summary>
+    struct ReinhardExtendedCurve
+    {
+        static void Prepare(TonemapConstants& c)
+        {
+            c.curveScale = 1.0f / (c.white * c.white);
+        }
+
+        static DirectX::XMVECTOR XM_CALLCONV Map(DirectX::FXMVECTOR x, const TonemapConstants& c)
+        {
+            using namespace DirectX;
+
+            XMVECTOR u = XMVectorScale(x, 1.0f / c.outputMax);
+            XMVECTOR y = XMVectorDivide(
+                XMVectorMultiply(u, XMVectorMultiplyAdd(u, XMVectorReplicate(c.curveScale), g_XMOne)),
+                XMVectorAdd(u, g_XMOne));
+
+            return XMVectorScale(XMVectorMin(y, g_XMOne), c.outputMax);
+        }
+    };
+
+    /// <summary>
+    /// ITU-R BT.2390 EETF: identity in PQ up to the knee start KS, then a Hermite spline that
+    /// reaches output max at input max. Black level lift is not applied (the target black is 0).
+    /// </summary>
+    struct Bt2390Curve
+    {
+        static void Prepare(TonemapConstants& c)
+        {
+            c.pqSourceMax = (std::max)(PqInverseEotf(c.inputMax * sc_TonemapScRgbToPq), 1e-6f);
+            c.pqMaxLum = PqInverseEotf(c.outputMax * sc_TonemapScRgbToPq) / c.pqSourceMax;
+            c.pqKneeStart = sc_Bt2390KneeScale * c.pqMaxLum - sc_Bt2390KneeOffset;
+            c.pqKneeScale = c.pqKneeStart < 1.0f ? 1.0f / (1.0f - c.pqKneeStart) : 0.0f;
+        }
+
+        static DirectX::XMVECTOR XM_CALLCONV Map(DirectX::FXMVECTOR x, const TonemapConstants& c)
+        {
+            using namespace DirectX;
+
+            // Normalized to the source range, which is clamped as the spline only covers [KS, 1].
+            XMVECTOR e = XMVectorScale(PqInverseEotf(XMVectorScale(x, sc_TonemapScRgbToPq)), 1.0f / c.pqSourceMax);
+            e = XMVectorMin(e, g_XMOne);
+
+            XMVECTOR ks = XMVectorReplicate(c.pqKneeStart);
+            XMVECTOR t = XMVectorScale(XMVectorSubtract(e, ks), c.pqKneeScale);
+            XMVECTOR t2 = XMVectorMultiply(t, t);
+            XMVECTOR t3 = XMVectorMultiply(t2, t);
+
+            // (2t^3 - 3t^2 + 1) KS + (t^3 - 2t^2 + t) (1 - KS) + (-2t^3 + 3t^2) maxLum.
+            XMVECTOR h01 = XMVectorSubtract(XMVectorScale(t2, 3.0f), XMVectorScale(t3, 2.0f));
+            XMVECTOR h00 = XMVectorSubtract(g_XMOne, h01);
+            XMVECTOR h10 = XMVectorAdd(XMVectorSubtract(t3, XMVectorScale(t2, 2.0f)), t);
+
+            XMVECTOR p = XMVectorMultiply(h00, ks);
+            p = XMVectorMultiplyAdd(h10, XMVectorReplicate(1.0f - c.pqKneeStart), p);
+            p = XMVectorMultiplyAdd(h01, XMVectorReplicate(c.pqMaxLum), p);
+
+            e = XMVectorSelect(e, p, XMVectorGreater(e, ks));
+
+            return XMVectorScale(PqEotf(XMVectorScale(e, c.pqSourceMax)), 1.0f / sc_TonemapScRgbToPq);
+        }
+    };
+
+    /// <summary>
+    /// Rational fit of the ACES filmic curve, x relative to output max and normalized so input
+    /// max maps to output max. Params supplies A to E.
+    /// </summary>
+    template <typename Params = AcesFittedNarkowicz>
+    struct AcesFittedCurve
+    {
+        static float Evaluate(float u)
+        {
+            return u * (Params::A * u + Params::B) / (u * (Params::C * u + Params::D) + Params::E);
+        }
+
+        static void Prepare(TonemapConstants& c)
+        {
+            c.curveScale = 1.0f / Evaluate(c.white);
+        }
+
+        static DirectX::XMVECTOR XM_CALLCONV Map(DirectX::FXMVECTOR x, const TonemapConstants& c)
+        {
+            using namespace DirectX;
+
+            XMVECTOR u = XMVectorScale(x, 1.0f / c.outputMax);
+            XMVECTOR numerator = XMVectorMultiply(u, XMVectorMultiplyAdd(u, XMVectorReplicate(Params::A), XMVectorReplicate(Params::B)));
+            XMVECTOR denominator = XMVectorMultiplyAdd(u, XMVectorMultiplyAdd(u, XMVectorReplicate(Params::C), XMVectorReplicate(Params::D)), XMVectorReplicate(Params::E));
+
+            XMVECTOR y = XMVectorScale(XMVectorDivide(numerator, denominator), c.curveScale);
+            return XMVectorScale(XMVectorMin(y, g_XMOne), c.outputMax);
+        }
+    };
+
+    /// <summary>
+    /// Hable's filmic curve, x relative to output max and normalized so input max maps to output
+    /// max. Params supplies A to F.
+    /// </summary>
+    template <typename Params = HableUncharted2>
+    struct HableCurve
+    {
+        static float Evaluate(float u)
+        {
+            return (u * (Params::A * u + Params::C * Params::B) + Params::D * Params::E) /
+                (u * (Params::A * u + Params::B) + Params::D * Params::F) - Params::E / Params::F;
+        }
+
+        static void Prepare(TonemapConstants& c)
+        {
+            c.curveScale = 1.0f / Evaluate(c.white);
+        }
+
+        static DirectX::XMVECTOR XM_CALLCONV Map(DirectX::FXMVECTOR x, const TonemapConstants& c)
+        {
+            using namespace DirectX;
+
+            XMVECTOR u = XMVectorScale(x, 1.0f / c.outputMax);
+            XMVECTOR a = XMVectorReplicate(Params::A);
+
+            XMVECTOR numerator = XMVectorMultiplyAdd(u, XMVectorMultiplyAdd(u, a, XMVectorReplicate(Params::C * Params::B)), XMVectorReplicate(Params::D * Params::E));
+            XMVECTOR denominator = XMVectorMultiplyAdd(u, XMVectorMultiplyAdd(u, a, XMVectorReplicate(Params::B)), XMVectorReplicate(Params::D * Params::F));
+
+            XMVECTOR y = XMVectorSubtract(XMVectorDivide(numerator, denominator), XMVectorReplicate(Params::E / Params::F));
+            y = XMVectorScale(y, c.curveScale);
+
+            return XMVectorScale(XMVectorMin(y, g_XMOne), c.outputMax);
+        }
+    };
+
+    //*********************************************************
+    // Tonemapper
+    //*********************************************************
+
+    template <typename Curve>
+    class Tonemapper
+    {
+    public:
+        /// <param name="inputMax">Input max luminance in scRGB, usually the image's MaxCLL.</param>
+        /// <param name="outputMax">Output max luminance in scRGB, usually the display's peak.</param>
+        Tonemapper(float inputMax, float outputMax)
+        {
+            m_constants = {};
+            m_constants.inputMax = inputMax;
+            m_constants.outputMax = outputMax;
+            m_constants.white = (std::max)(inputMax / outputMax, 1.0f);
+
+            Curve::Prepare(m_constants);
+        }
+
+        const TonemapConstants& GetConstants() const { return m_constants; }
+
+        /// <summary>
+        /// Tonemaps one scRGB pixel. Alpha is unchanged.
+        /// </summary>
+        DirectX::XMVECTOR XM_CALLCONV operator()(DirectX::FXMVECTOR color) const
+        {
+            using namespace DirectX;
+
+            XMVECTOR y = Curve::Map(XMVectorAbs(color), m_constants);
+
+            y = XMVectorSelect(y, XMVectorNegate(y), XMVectorLess(color, XMVectorZero()));
+            return XMVectorSelect(color, y, g_XMSelect1110);
+        }
+
+        /// <summary>
+        /// Tonemaps image in place.
+        /// </summary>
+        /// <param name="threadCount">0 means use all hardware threads.</param>
+        void Apply(CpuImage& image, unsigned int threadCount = 0) const
+        {
+            using namespace DirectX;
+
+            ParallelFor(0, image.GetHeight(), sc_DefaultRowsPerBand, threadCount, [&](size_t first, size_t last)
+            {
+                for (size_t y = first; y < last; y++)
+                {
+                    XMFLOAT4A* row = image.GetRow(static_cast<unsigned int>(y));
+
+                    for (unsigned int x = 0; x < image.GetWidth(); x++)
+                    {
+                        XMStoreFloat4A(&row[x], (*this)(XMLoadFloat4A(&row[x])));
+                    }
+                }
+            });
+        }
+
+    private:
+        TonemapConstants                                        m_constants;
+    };
+
+    /// <summary>
+    /// Calls func with the Tonemapper for op, so code generic over the curve is instantiated once
+    /// per operator and the choice is made once rather than per pixel.
+    /// </summary>
+    template <typename Func>
+    void DispatchTonemapper(TonemapOperator op, float inputMax, float outputMax, Func&& func)
+    {
+        switch (op)
+        {
+        case TonemapOperator::ReinhardExtended:
+            func(Tonemapper<ReinhardExtendedCurve>(inputMax, outputMax));
+            break;
+
+        case TonemapOperator::Bt2390:
+            func(Tonemapper<Bt2390Curve>(inputMax, outputMax));
+            break;
+
+        case TonemapOperator::AcesFitted:
+            func(Tonemapper<AcesFittedCurve<>>(inputMax, outputMax));
+            break;
+
+        case TonemapOperator::Hable:
+            func(Tonemapper<HableCurve<>>(inputMax, outputMax));
+            break;
+
+        case TonemapOperator::Reinhard:
+        default:
+            func(Tonemapper<ReinhardCurve>(inputMax, outputMax));
+            break;
+        }
+    }
+
+    /// <summary>
+    /// TonemapConstants for op, e.g. to pass to SimpleTonemapEffect's shader.
+    /// </summary>
+    inline TonemapConstants GetTonemapConstants(TonemapOperator op, float inputMax, float outputMax)
+    {
+        TonemapConstants constants = {};
+        DispatchTonemapper(op, inputMax, outputMax, [&](const auto& tonemapper)
+        {
+            constants = tonemapper.GetConstants();
+        });
+
+        return constants;
+    }
+}
@@ -0,0 +1,338 @@
+//*********************************************************
+//
+// TransferFunctions
+//
+// BT.2100 PQ (SMPTE ST.2084) and HLG transfer functions for
+// CPU decode, analysis and export. Header only, so HeifUtil
+// and the unit tests can use it without linking DXRenderer.
+//
+// Each function comes in three forms:
+//  - Scalar templates. The float instantiation is for one-off
+//    values; the double instantiation builds the tables.
+//  - XMVECTOR overloads, four values at a time. pow, exp and
+//    log are built from XMVectorLog2/XMVectorExp2, so these use
+//    SSE/AVX2 or NEON through DirectXMath, whichever the build
+//    targets.
+//  - Tables. Integer code values (10, 12 or 16 bit) decode
+//    through a table with one entry per code, the fastest path
+//    for HDR10 images. PqInverseEotfTable encodes floats with a
+//    piecewise linear table indexed by the float's exponent.
+//
+// PQ linear light is normalized so 1.0 = 10000 nits. HLG
+// scene light and display light are normalized so 1.0 = the
+// nominal peak.
+//
+// Maximum error against a double precision reference over
+// every 10, 12 and 16 bit code value, as enforced by
+// UnitTests/TransferFunctionTests.cpp:
+//
+//                            relative      absolute
+//  PQ EOTF        table      1e-7          -
+//                 scalar     1e-4          -
+//                 XMVECTOR   5e-4          -
+//  PQ inv. EOTF   table      -             1e-5
+//                 scalar     -             3e-5
+//                 XMVECTOR   -             5e-5
+//  HLG inv. OETF  table      1e-7          -
+//                 scalar     1e-6          -
+//                 XMVECTOR   2e-5          -
+//  HLG OETF       scalar     -             1e-6
+//                 XMVECTOR   -             2e-5
+//
+// PQ EOTF relative error is checked for outputs of at least
+// 1e-7 (0.001 nits), absolute error (1e-12) below that. Near
+// the top of the range c2 - c3 * p cancels, and the result is
+// raised to 1/m1 = 6.28, so a float rounding of p becomes a
+// relative error of ~6e-5; the table avoids this. 1e-5 is 2/3
+// of a 16 bit code, and every code decoded by the table is
+// encoded back to itself by PqInverseEotfTable.
+//
+//*********************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace DXRenderer
+{
+    // SMPTE ST.2084 constants.
+    constexpr double sc_PqM1 = 2610.0 / 16384.0;
+    constexpr double sc_PqM2 = 2523.0 / 4096.0 * 128.0;
+    constexpr double sc_PqC1 = 3424.0 / 4096.0;
+    constexpr double sc_PqC2 = 2413.0 / 4096.0 * 32.0;
+    constexpr double sc_PqC3 = 2392.0 / 4096.0 * 32.0;
+
+    // BT.2100 HLG constants. c = 0.5 - a * ln(4a).
+    const double sc_HlgA = 0.17883277;
+    const double sc_HlgB = 1.0 - 4.0 * sc_HlgA;
+    const double sc_HlgC = 0.55991073;
+
+    // Y row of the BT.2020 RGB to XYZ matrix, used by the HLG OOTF.
+    const DirectX::XMFLOAT3 sc_Bt2020Luminance = { 0.2627f, 0.6780f, 0.0593f };
+
+    enum class TransferFunction
+    {
+        Pq,
+        Hlg
+    };
+
+    //*********************************************************
+    // Scalar
+    //*********************************************************
+
+    /// <summary>
+    /// ST.2084 EOTF. Code value [0, 1] to linear light where 1.0 = 10000 nits.
+    /// </summary>
+    template <typename T>
+    inline T PqEotf(T e)
+    {
+        e = (std::min)((std::max)(e, T(0)), T(1));
+        T p = std::pow(e, T(1.0 / sc_PqM2));
+
+        return std::pow((std::max)(p - T(sc_PqC1), T(0)) / (T(sc_PqC2) - T(sc_PqC3) * p), T(1.0 / sc_PqM1));
+    }
+
+    /// <summary>
+    /// ST.2084 inverse EOTF. Linear light where 1.0 = 10000 nits to code value [0, 1].
+    /// </summary>
+    template <typename T>
+    inline T PqInverseEotf(T y)
+    {
+        y = (std::min)((std::max)(y, T(0)), T(1));
+        T ym = std::pow(y, T(sc_PqM1));
+
+        return std::pow((T(sc_PqC1) + T(sc_PqC2) * ym) / (T(1) + T(sc_PqC3) * ym), T(sc_PqM2));
+    }
+
+    /// <summary>
+    /// HLG OETF. Scene light [0, 1] to code value [0, 1].
+    /// </summary>
+    template <typename T>
+    inline T HlgOetf(T e)
+    {
+        e = (std::min)((std::max)(e, T(0)), T(1));
+
+        return (e <= T(1.0 / 12.0))
+            ? std::sqrt(T(3) * e)
+            : T(sc_HlgA) * std::log(T(12) * e - T(sc_HlgB)) + T(sc_HlgC);
+    }
+
+    /// <summary>
+    /// HLG inverse OETF. Code value [0, 1] to scene light [0, 1]. Apply HlgOotf to get display light.
+    /// </summary>
+    template <typename T>
+    inline T HlgInverseOetf(T v)
+    {
+        v = (std::min)((std::max)(v, T(0)), T(1));
+
+        return (v <= T(0.5))
+            ? v * v / T(3)
+            : (std::exp((v - T(sc_HlgC)) / T(sc_HlgA)) + T(sc_HlgB)) / T(12);
+    }
+
+    /// <summary>
+    /// HLG system gamma for a display with the given peak luminance, 1.2 at 1000 nits.
+    /// </summary>
+    inline float HlgSystemGamma(float peakNits)
+    {
+        return 1.2f + 0.42f * std::log10(peakNits / 1000.0f);
+    }
+
+    //*********************************************************
+    // XMVECTOR
+    //*********************************************************
+
+    namespace TransferFunctionsDetail
+    {
+        const float sc_Ln2 = 0.693147180559945f;
+        const float sc_Log2E = 1.44269504088896f;
+
+        /// <summary>
+        /// x^y for x > 0; returns 0 where x <= 0 instead of relying on log2(0) = -inf.
+        /// </summary>
+        inline DirectX::XMVECTOR XM_CALLCONV PowPositive(DirectX::FXMVECTOR x, float y)
+        {
+            using namespace DirectX;
+
+            XMVECTOR result = XMVectorExp2(XMVectorScale(XMVectorLog2(x), y));
+            return XMVectorSelect(XMVectorZero(), result, XMVectorGreater(x, XMVectorZero()));
+        }
+    }
+
+    /// <summary>
+    /// ST.2084 EOTF of each component.
+    /// </summary>
+    inline DirectX::XMVECTOR XM_CALLCONV PqEotf(DirectX::FXMVECTOR e)
+    {
+        using namespace DirectX;
+        using namespace TransferFunctionsDetail;
+
+        XMVECTOR p = PowPositive(XMVectorSaturate(e), static_cast<float>(1.0 / sc_PqM2));
+
+        XMVECTOR numerator = XMVectorMax(XMVectorSubtract(p, XMVectorReplicate(static_cast<float>(sc_PqC1))), XMVectorZero());
+        XMVECTOR denominator = XMVectorNegativeMultiplySubtract(
+            XMVectorReplicate(static_cast<float>(sc_PqC3)),
+            p,
+            XMVectorReplicate(static_cast<float>(sc_PqC2)));
+
+        return PowPositive(XMVectorDivide(numerator, denominator), static_cast<float>(1.0 / sc_PqM1));
+    }
+
+    /// <summary>
+    /// ST.2084 inverse EOTF of each component.
+    /// </summary>
+    inline DirectX::XMVECTOR XM_CALLCONV PqInverseEotf(DirectX::FXMVECTOR y)
+    {
+        using namespace DirectX;
+        using namespace TransferFunctionsDetail;
+
+        XMVECTOR ym = PowPositive(XMVectorSaturate(y), static_cast<float>(sc_PqM1));
+
+        XMVECTOR numerator = XMVectorMultiplyAdd(XMVectorReplicate(static_cast<float>(sc_PqC2)), ym, XMVectorReplicate(static_cast<float>(sc_PqC1)));
+        XMVECTOR denominator = XMVectorMultiplyAdd(XMVectorReplicate(static_cast<float>(sc_PqC3)), ym, XMVectorSplatOne());
+
+        // The base is at least c1, so unlike the first power this needs no special case for 0.
+        return XMVectorExp2(XMVectorScale(XMVectorLog2(XMVectorDivide(numerator, denominator)), static_cast<float>(sc_PqM2)));
+    }
+
+    /// <summary>
+    /// HLG OETF of each component.
+    /// </summary>
+    inline DirectX::XMVECTOR XM_CALLCONV HlgOetf(DirectX::FXMVECTOR e)
+    {
+        using namespace DirectX;
+        using namespace TransferFunctionsDetail;
+
+        XMVECTOR x = XMVectorSaturate(e);
+
+        XMVECTOR low = XMVectorSqrt(XMVectorScale(x, 3.0f));
+
+        // a * ln(12x - b) + c; the lanes this is invalid for are discarded by the select.
+        XMVECTOR high = XMVectorLog2(XMVectorSubtract(XMVectorScale(x, 12.0f), XMVectorReplicate(static_cast<float>(sc_HlgB))));
+        high = XMVectorMultiplyAdd(high, XMVectorReplicate(static_cast<float>(sc_HlgA) * sc_Ln2), XMVectorReplicate(static_cast<float>(sc_HlgC)));
+
+        return XMVectorSelect(low, high, XMVectorGreater(x, XMVectorReplicate(1.0f / 12.0f)));
+    }
+
+    /// <summary>
+    /// HLG inverse OETF of each component.
+    /// </summary>
+    inline DirectX::XMVECTOR XM_CALLCONV HlgInverseOetf(DirectX::FXMVECTOR v)
+    {
+        using namespace DirectX;
+        using namespace TransferFunctionsDetail;
+
+        XMVECTOR x = XMVectorSaturate(v);
+
+        XMVECTOR low = XMVectorScale(XMVectorMultiply(x, x), 1.0f / 3.0f);
+
+        // (exp((x - c) / a) + b) / 12
+        XMVECTOR high = XMVectorExp2(XMVectorScale(XMVectorSubtract(x, XMVectorReplicate(static_cast<float>(sc_HlgC))), sc_Log2E / static_cast<float>(sc_HlgA)));
+        high = XMVectorScale(XMVectorAdd(high, XMVectorReplicate(static_cast<float>(sc_HlgB))), 1.0f / 12.0f);
+
+        return XMVectorSelect(low, high, XMVectorGreater(x, XMVectorReplicate(0.5f)));
+    }
+
+    /// <summary>
+    /// HLG OOTF. Scene light BT.2020 RGB in xyz to display light relative to the nominal peak;
+    /// w is passed through.
+    /// </summary>
+    /// <param name="systemGamma">See HlgSystemGamma.</param>
+    inline DirectX::XMVECTOR XM_CALLCONV HlgOotf(DirectX::FXMVECTOR rgb, float systemGamma)
+    {
+        using namespace DirectX;
+        using namespace TransferFunctionsDetail;
+
+        XMVECTOR ys = XMVector3Dot(rgb, XMLoadFloat3(&sc_Bt2020Luminance));
+        XMVECTOR scale = PowPositive(ys, systemGamma - 1.0f);
+
+        return XMVectorSelect(rgb, XMVectorMultiply(rgb, scale), g_XMSelect1110);
+    }
+
+    //*********************************************************
+    // Tables
+    //*********************************************************
+
+    /// <summary>
+    /// Fills table with the linear value of every code value of a bits deep signal, computed in
+    /// double precision: the PQ EOTF, or the HLG inverse OETF (scene light).
+    /// </summary>
+    inline void BuildLinearizeTable(TransferFunction function, unsigned int bits, std::vector<float>& table)
+    {
+        unsigned int maxCode = (1u << bits) - 1;
+        table.resize(static_cast<size_t>(maxCode) + 1);
+
+        for (unsigned int i = 0; i <= maxCode; i++)
+        {
+            double v = static_cast<double>(i) / maxCode;
+            table[i] = static_cast<float>(function == TransferFunction::Pq ? PqEotf(v) : HlgInverseOetf(v));
+        }
+    }
+
+    /// <summary>
+    /// ST.2084 inverse EOTF without pow: each octave of input from 2^-40 to 1 is split into
+    /// 2^sc_MantissaBits segments, indexed by the top mantissa bits, and linearly interpolated.
+    /// Inputs below 2^-40 (1e-8 nits) interpolate between 0 and the first entry; NaN encodes the same as 0.
+    /// </summary>
+    class PqInverseEotfTable
+    {
+    public:
+        PqInverseEotfTable()
+        {
+            m_table.resize((static_cast<size_t>(sc_Octaves) << sc_MantissaBits) + 1);
+
+            for (size_t i = 0; i < m_table.size(); i++)
+            {
+                double y = std::ldexp(1.0 + static_cast<double>(i & sc_SegmentMask) / (1u << sc_MantissaBits),
+                    static_cast<int>(i >> sc_MantissaBits) - sc_Octaves);
+
+                m_table[i] = static_cast<float>(PqInverseEotf((std::min)(y, 1.0)));
+            }
+
+            m_zero = static_cast<float>(PqInverseEotf(0.0));
+        }
+
+        float operator()(float y) const
+        {
+            if (std::isnan(y))
+            {
+                return m_zero;
+            }
+
+            if (y < sc_MinInput)
+            {
+                float t = (std::max)(y, 0.0f) / sc_MinInput;
+                return m_zero + t * (m_table[0] - m_zero);
+            }
+
+            if (y >= 1.0f)
+            {
+                return m_table.back();
+            }
+
+            uint32_t bits;
+            std::memcpy(&bits, &y, sizeof(bits));
+
+            // Exponent and top mantissa bits, rebased so 2^-sc_Octaves is entry 0.
+            uint32_t index = (bits >> (23 - sc_MantissaBits)) - ((127u - sc_Octaves) << sc_MantissaBits);
+            float t = static_cast<float>(bits & sc_FractionMask) * (1.0f / (sc_FractionMask + 1));
+
+            return m_table[index] + t * (m_table[index + 1] - m_table[index]);
+        }
+
+    private:
+        static const int                                        sc_Octaves = 40;
+        static const int                                        sc_MantissaBits = 6;
+        static const uint32_t                                   sc_SegmentMask = (1u << sc_MantissaBits) - 1;
+        static const uint32_t                                   sc_FractionMask = (1u << (23 - sc_MantissaBits)) - 1;
+        static constexpr float                                  sc_MinInput = 1.0f / (1ull << sc_Octaves);
+
+        std::vector<float>                                      m_table;
+        float                                                   m_zero;
+    };
+}
@@ -0,0 +1,241 @@
+//*********************************************************
+//
+// YuvConverter
+//
+// See YuvConverter.h. Each worker blends the two chroma rows
+// nearest a luma row into scratch, then converts the row a
+// pixel at a time: R'G'B' is quantized to 16 bits and
+// linearized through a PQ table, and the primaries matrix is
+// applied with DirectXMath before the row is packed to FP16.
+//
+//*********************************************************
+
+#include "YuvConverter.h"
+#include "ParallelFor.h"
+#include "TransferFunctions.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+using namespace DXRenderer;
+
+namespace
+{
+    // BT.2020 non-constant luminance Y'CbCr to R'G'B', from Kr = 0.2627 and Kb = 0.0593.
+    const float sc_crToR = 1.4746f;
+    const float sc_cbToG = -0.164553f;
+    const float sc_crToG = -0.571353f;
+    const float sc_cbToB = 1.8814f;
+
+    // PQ values are looked up with 16 bits of precision, which is well below FP16's.
+    const unsigned int sc_pqTableBits = 16;
+    const float sc_pqTableMaxCode = static_cast<float>((1u << sc_pqTableBits) - 1);
+
+    // PQ linear light is 1.0 = 10000 nits, scRGB is 1.0 = 80 nits.
+    const float sc_pqToScRgb = 10000.0f / 80.0f;
+
+    const std::vector<float>& GetPqTable()
+    {
+        static const std::vector<float> s_table = []
+        {
+            std::vector<float> table;
+            BuildLinearizeTable(TransferFunction::Pq, sc_pqTableBits, table);
+            return table;
+        }();
+
+        return s_table;
+    }
+
+    /// <summary>
+    /// Maps code values to [0, 1] for luma and alpha, [-0.5, 0.5] for chroma.
+    /// </summary>
+    struct SampleScale
+    {
+        float lumaOffset;
+        float lumaScale;
+        float chromaOffset;
+        float chromaScale;
+        float alphaScale;
+
+        explicit SampleScale(const YuvPlanes& planes)
+        {
+            float maxCode = static_cast<float>((1u << planes.bitDepth) - 1);
+            float rangeScale = static_cast<float>(1u << (planes.bitDepth - 8));
+
+            chromaOffset = static_cast<float>(1u << (planes.bitDepth - 1));
+            alphaScale = 1.0f / maxCode;
+
+            if (planes.fullRange)
+            {
+                lumaOffset = 0.0f;
+                lumaScale = 1.0f / maxCode;
+                chromaScale = 1.0f / maxCode;
+            }
+            else
+            {
+                lumaOffset = 16.0f * rangeScale;
+                lumaScale = 1.0f / (219.0f * rangeScale);
+                chromaScale = 1.0f / (224.0f * rangeScale);
+            }
+        }
+    };
+
+    inline float ReadSample(const uint8_t* row, unsigned int x, bool wide)
+    {
+        return wide ? static_cast<float>(reinterpret_cast<const uint16_t*>(row)[x]) : static_cast<float>(row[x]);
+    }
+
+    inline float LookupPq(const float* table, float value)
+    {
+        value = (std::min)((std::max)(value, 0.0f), 1.0f);
+        return table[static_cast<unsigned int>(value * sc_pqTableMaxCode + 0.5f)];
+    }
+
+    /// <summary>
+    /// Normalized chroma for luma row y. With vertical subsampling, chroma sits a quarter of a
+    /// chroma row away from each luma row, so the nearest two chroma rows are blended 3:1.
+    /// </summary>
+    void LoadChromaRow(
+        const uint8_t* plane,
+        const YuvPlanes& planes,
+        const SampleScale& scale,
+        unsigned int chromaWidth,
+        unsigned int chromaHeight,
+        unsigned int y,
+        float* output)
+    {
+        bool wide = planes.bitDepth > 8;
+
+        unsigned int nearest = y >> planes.chromaShiftY;
+        const uint8_t* row0 = plane + nearest * planes.chromaStride;
+
+        if (planes.chromaShiftY == 0)
+        {
+            for (unsigned int x = 0; x < chromaWidth; x++)
+            {
+                output[x] = (ReadSample(row0, x, wide) - scale.chromaOffset) * scale.chromaScale;
+            }
+
+            return;
+        }
+
+        unsigned int other = (y & 1) ? (std::min)(nearest + 1, chromaHeight - 1) : (nearest > 0 ? nearest - 1 : 0);
+        const uint8_t* row1 = plane + other * planes.chromaStride;
+
+        for (unsigned int x = 0; x < chromaWidth; x++)
+        {
+            float blended = 0.75f * ReadSample(row0, x, wide) + 0.25f * ReadSample(row1, x, wide);
+            output[x] = (blended - scale.chromaOffset) * scale.chromaScale;
+        }
+    }
+
+    /// <summary>
+    /// Converts rows [first, last).
+    /// </summary>
+    /// <param name="chromaScratch">Room for two chroma rows.</param>
+    /// <param name="rowScratch">Room for one output row.</param>
+    void ConvertRows(
+        const YuvPlanes& planes,
+        const SampleScale& scale,
+        const float* pqTable,
+        uint8_t* output,
+        size_t outputStride,
+        size_t first,
+        size_t last,
+        float* chromaScratch,
+        XMFLOAT4A* rowScratch)
+    {
+        unsigned int chromaWidth = (planes.width + (1u << planes.chromaShiftX) - 1) >> planes.chromaShiftX;
+        unsigned int chromaHeight = (planes.height + (1u << planes.chromaShiftY) - 1) >> planes.chromaShiftY;
+
+        float* cbRow = chromaScratch;
+        float* crRow = chromaScratch + chromaWidth;
+
+        bool wide = planes.bitDepth > 8;
+
+        // BT.2020 to BT.709 primaries, including the change of scale. Row n is input channel n.
+        const XMMATRIX toScRgb = XMMatrixMultiply(
+            XMMatrixSet(
+                1.660491f, -0.124550f, -0.018151f, 0.0f,
+                -0.587641f, 1.132900f, -0.100579f, 0.0f,
+                -0.072850f, -0.008349f, 1.118730f, 0.0f,
+                0.0f, 0.0f, 0.0f, 1.0f),
+            XMMatrixScaling(sc_pqToScRgb, sc_pqToScRgb, sc_pqToScRgb));
+
+        for (size_t y = first; y < last; y++)
+        {
+            unsigned int row = static_cast<unsigned int>(y);
+
+            LoadChromaRow(planes.cb, planes, scale, chromaWidth, chromaHeight, row, cbRow);
+            LoadChromaRow(planes.cr, planes, scale, chromaWidth, chromaHeight, row, crRow);
+
+            const uint8_t* lumaRow = planes.y + y * planes.yStride;
+            const uint8_t* alphaRow = planes.alpha ? planes.alpha + y * planes.alphaStride : nullptr;
+
+            for (unsigned int x = 0; x < planes.width; x++)
+            {
+                // Chroma is co-sited with even luma samples; odd ones fall halfway between two.
+                unsigned int cx = x >> planes.chromaShiftX;
+                float cb = cbRow[cx];
+                float cr = crRow[cx];
+
+                if (planes.chromaShiftX != 0 && (x & 1) && cx + 1 < chromaWidth)
+                {
+                    cb = 0.5f * (cb + cbRow[cx + 1]);
+                    cr = 0.5f * (cr + crRow[cx + 1]);
+                }
+
+                float luma = (ReadSample(lumaRow, x, wide) - scale.lumaOffset) * scale.lumaScale;
+
+                XMVECTOR linear = XMVectorSet(
+                    LookupPq(pqTable, luma + sc_crToR * cr),
+                    LookupPq(pqTable, luma + sc_cbToG * cb + sc_crToG * cr),
+                    LookupPq(pqTable, luma + sc_cbToB * cb),
+                    0.0f);
+
+                XMVECTOR color = XMVector3TransformNormal(linear, toScRgb);
+
+                float alpha = alphaRow ? ReadSample(alphaRow, x, wide) * scale.alphaScale : 1.0f;
+                XMStoreFloat4A(&rowScratch[x], XMVectorSetW(XMVectorScale(color, alpha), alpha));
+            }
+
+            XMConvertFloatToHalfStream(
+                reinterpret_cast<HALF*>(output + y * outputStride),
+                sizeof(HALF),
+                &rowScratch[0].x,
+                sizeof(float),
+                static_cast<size_t>(planes.width) * 4);
+        }
+    }
+}
+
+void DXRenderer::ConvertHdr10YuvToScRgb(const YuvPlanes& planes, void* output, size_t outputStride, unsigned int threadCount)
+{
+    SampleScale scale(planes);
+    const float* pqTable = GetPqTable().data();
+
+    unsigned int chromaWidth = (planes.width + (1u << planes.chromaShiftX) - 1) >> planes.chromaShiftX;
+    size_t chromaScratchPerWorker = 2 * static_cast<size_t>(chromaWidth);
+
+    unsigned int numWorkers = GetParallelForWorkerCount(0, planes.height, sc_DefaultRowsPerBand, threadCount);
+    std::vector<float> chromaScratch(chromaScratchPerWorker * numWorkers);
+    std::vector<XMFLOAT4A> rowScratch(static_cast<size_t>(planes.width) * numWorkers);
+
+    auto dest = static_cast<uint8_t*>(output);
+
+    ParallelForWorkers(0, planes.height, sc_DefaultRowsPerBand, threadCount, [&](size_t first, size_t last, unsigned int worker)
+    {
+        ConvertRows(
+            planes,
+            scale,
+            pqTable,
+            dest,
+            outputStride,
+            first,
+            last,
+            &chromaScratch[chromaScratchPerWorker * worker],
+            &rowScratch[static_cast<size_t>(planes.width) * worker]);
+    });
+}
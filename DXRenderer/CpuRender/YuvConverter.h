@@ -0,0 +1,56 @@
+//*********************************************************
+//
+// YuvConverter
+//
+// Converts HDR10 (BT.2100 PQ, BT.2020 non-constant luminance)
+// Y'CbCr planes, as decoded by libheif, straight to FP16
+// scRGB. One pass per row does chroma upsampling, the Y'CbCr
+// to R'G'B' matrix, the PQ EOTF and the BT.2020 to BT.709
+// primaries conversion, so the only full frame buffers are
+// the decoder's planes and the output. Rows are split across
+// threads.
+//
+//*********************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include <cstdint>
+
+namespace DXRenderer
+{
+    /// <summary>
+    /// One plane per channel, as libheif returns them. Samples are little endian uint16 for bit
+    /// depths above 8 and bytes otherwise.
+    /// </summary>
+    struct YuvPlanes
+    {
+        unsigned int                                            width;
+        unsigned int                                            height;
+        unsigned int                                            bitDepth;       // Same for all planes.
+        unsigned int                                            chromaShiftX;   // 1 for 4:2:0 and 4:2:2.
+        unsigned int                                            chromaShiftY;   // 1 for 4:2:0.
+        bool                                                    fullRange;
+
+        const uint8_t*                                          y;
+        size_t                                                  yStride;        // Bytes.
+        const uint8_t*                                          cb;
+        const uint8_t*                                          cr;
+        size_t                                                  chromaStride;   // Bytes, both chroma planes.
+        const uint8_t*                                          alpha;          // Optional, always full range.
+        size_t                                                  alphaStride;
+    };
+
+    /// <summary>
+    /// Writes premultiplied scRGB (1.0 = 80 nits) to a GUID_WICPixelFormat64bppPRGBAHalf buffer.
+    /// Chroma is assumed to be sited as the HEVC default: co-sited horizontally with even luma
+    /// samples and midway between luma rows vertically.
+    /// </summary>
+    /// <param name="threadCount">0 means use all hardware threads.</param>
+    void ConvertHdr10YuvToScRgb(
+        const YuvPlanes& planes,
+        _Out_writes_bytes_(outputStride * planes.height) void* output,
+        size_t outputStride,
+        unsigned int threadCount = 0);
+}
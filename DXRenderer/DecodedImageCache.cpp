@@ -0,0 +1,211 @@
+#include "pch.h"
+#include "DecodedImageCache.h"
+
+using namespace DXRenderer;
+
+using namespace concurrency;
+using namespace std;
+
+DecodedImageCache::DecodedImageCache(uint64_t budgetBytes) :
+    m_budgetBytes(budgetBytes),
+    m_sizeBytes(0),
+    m_countInFlight(0)
+{
+}
+
+DecodedImageCache::~DecodedImageCache()
+{
+    // Prefetch tasks reference this object.
+    unique_lock<mutex> lock(m_lock);
+    m_idle.wait(lock, [this] { return m_countInFlight == 0; });
+}
+
+/// <summary>
+/// The key includes every ImageLoaderOptions field that affects the decoded result.
+/// </summary>
+wstring DecodedImageCache::MakeKey(ImageCacheKey key, const ImageLoaderOptions& options)
+{
+    if (key.path == nullptr || key.path->IsEmpty())
+    {
+        return wstring();
+    }
+
+    wostringstream str;
+    str << key.path->Data() << L'|' << key.lastModified.UniversalTime << L'|' << static_cast<int>(options.type);
+
+    if (options.type == ImageLoaderOptionsType::CustomSdrColorSpace)
+    {
+        auto& cs = options.customColorSpace;
+        str << L'|' << cs.red.X << L',' << cs.red.Y
+            << L',' << cs.green.X << L',' << cs.green.Y
+            << L',' << cs.blue.X << L',' << cs.blue.Y
+            << L',' << cs.whitePt_XZ.X << L',' << cs.whitePt_XZ.Y
+            << L',' << static_cast<int>(cs.Gamma);
+    }
+
+    if (options.fitSize.Width > 0.0f && options.fitSize.Height > 0.0f)
+    {
+        str << L'|' << options.fitSize.Width << L'x' << options.fitSize.Height;
+    }
+
+    return str.str();
+}
+
+void DecodedImageCache::SetBudget(uint64_t budgetBytes)
+{
+    lock_guard<mutex> lock(m_lock);
+
+    m_budgetBytes = budgetBytes;
+    TrimLocked();
+}
+
+bool DecodedImageCache::Contains(const wstring& key)
+{
+    lock_guard<mutex> lock(m_lock);
+
+    return m_index.find(key) != m_index.end() ||
+           m_pending.find(key) != m_pending.end();
+}
+
+shared_ptr<ImageLoader> DecodedImageCache::Find(const wstring& key)
+{
+    if (key.empty())
+    {
+        return nullptr;
+    }
+
+    lock_guard<mutex> lock(m_lock);
+
+    auto it = m_index.find(key);
+    if (it == m_index.end())
+    {
+        return nullptr;
+    }
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return it->second->loader;
+}
+
+task<void> DecodedImageCache::WhenPrefetched(const wstring& key)
+{
+    lock_guard<mutex> lock(m_lock);
+
+    auto inFlight = m_pending.find(key);
+    if (inFlight == m_pending.end())
+    {
+        return task_from_result();
+    }
+
+    return create_task(inFlight->second);
+}
+
+void DecodedImageCache::Insert(const wstring& key, const shared_ptr<ImageLoader>& loader)
+{
+    lock_guard<mutex> lock(m_lock);
+
+    InsertLocked(key, loader);
+}
+
+void DecodedImageCache::Prefetch(const wstring& key, LoadFunction load)
+{
+    if (key.empty())
+    {
+        return;
+    }
+
+    lock_guard<mutex> lock(m_lock);
+
+    if (m_index.find(key) != m_index.end() ||
+        m_pending.find(key) != m_pending.end())
+    {
+        return;
+    }
+
+    // Completion is signaled through a separate event so that waiters don't hold a thread.
+    task_completion_event<void> completed;
+    m_pending[key] = completed;
+    m_countInFlight++;
+
+    create_task([this, key, load, completed]()
+    {
+        shared_ptr<ImageLoader> loader;
+
+        try
+        {
+            loader = load();
+        }
+        catch (...)
+        {
+            // A prefetch failure is not reported; the image is simply loaded again when it is opened.
+            loader = nullptr;
+        }
+
+        lock_guard<mutex> lock(m_lock);
+
+        InsertLocked(key, loader);
+        m_pending.erase(key);
+        completed.set();
+
+        m_countInFlight--;
+        m_idle.notify_all();
+    });
+}
+
+/// <summary>
+/// Releases all cached images. Prefetches already in flight still complete and are added.
+/// </summary>
+void DecodedImageCache::Clear()
+{
+    lock_guard<mutex> lock(m_lock);
+
+    m_index.clear();
+    m_entries.clear();
+    m_sizeBytes = 0;
+}
+
+void DecodedImageCache::InsertLocked(const wstring& key, const shared_ptr<ImageLoader>& loader)
+{
+    if (key.empty() || loader == nullptr)
+    {
+        return;
+    }
+
+    auto state = loader->GetState();
+    if (state != ImageLoaderState::NeedDeviceResources &&
+        state != ImageLoaderState::LoadingSucceeded)
+    {
+        return;
+    }
+
+    uint64_t sizeBytes = loader->GetDecodedSizeInBytes();
+    if (sizeBytes > m_budgetBytes)
+    {
+        return;
+    }
+
+    auto existing = m_index.find(key);
+    if (existing != m_index.end())
+    {
+        m_sizeBytes -= existing->second->sizeBytes;
+        m_entries.erase(existing->second);
+        m_index.erase(existing);
+    }
+
+    m_entries.push_front(Entry{ key, loader, sizeBytes });
+    m_index[key] = m_entries.begin();
+    m_sizeBytes += sizeBytes;
+
+    TrimLocked();
+}
+
+void DecodedImageCache::TrimLocked()
+{
+    while (m_sizeBytes > m_budgetBytes && !m_entries.empty())
+    {
+        auto& lru = m_entries.back();
+
+        m_sizeBytes -= lru.sizeBytes;
+        m_index.erase(lru.key);
+        m_entries.pop_back();
+    }
+}
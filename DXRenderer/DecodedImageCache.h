@@ -0,0 +1,100 @@
+//*********************************************************
+//
+// DecodedImageCache
+//
+// Keeps recently viewed images decoded in memory so switching
+// back to them skips the decode entirely. Entries are
+// ImageLoaders holding only device-independent resources and
+// are evicted least recently used first once the total decoded
+// size exceeds a byte budget.
+//
+// Also decodes images in the background (Prefetch), typically
+// the neighbors of the displayed image in its folder. Callers
+// can wait asynchronously for an image that is still being
+// prefetched instead of starting another decode.
+//
+// All methods are thread safe.
+//
+//*********************************************************
+
+#pragma once
+#include "ImageLoader.h"
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <ppltasks.h>
+#include <unordered_map>
+
+namespace DXRenderer
+{
+    class DecodedImageCache
+    {
+    public:
+        // Runs on a worker thread; returns an ImageLoader that has finished loading (successfully or not).
+        typedef std::function<std::shared_ptr<ImageLoader>()> LoadFunction;
+
+        DecodedImageCache(uint64_t budgetBytes);
+        ~DecodedImageCache();
+
+        /// <summary>
+        /// Builds the key for an image. Returns an empty string if the image should not be cached.
+        /// </summary>
+        static std::wstring MakeKey(ImageCacheKey key, const ImageLoaderOptions& options);
+
+        void SetBudget(uint64_t budgetBytes);
+
+        /// <summary>
+        /// True if the image is cached or being prefetched.
+        /// </summary>
+        bool Contains(const std::wstring& key);
+
+        /// <summary>
+        /// Returns the cached image and marks it most recently used. Never blocks: an image that
+        /// is still being prefetched is a miss, see WhenPrefetched.
+        /// </summary>
+        /// <returns>nullptr if the image isn't cached or failed to load.</returns>
+        std::shared_ptr<ImageLoader> Find(const std::wstring& key);
+
+        /// <summary>
+        /// Completes when the image is no longer being prefetched, or immediately if it isn't.
+        /// Successful prefetches are then in the cache, unless they were larger than the budget.
+        /// </summary>
+        concurrency::task<void> WhenPrefetched(const std::wstring& key);
+
+        /// <summary>
+        /// Adds a successfully loaded image. Failed loads and images larger than the whole
+        /// budget are ignored.
+        /// </summary>
+        void Insert(const std::wstring& key, const std::shared_ptr<ImageLoader>& loader);
+
+        /// <summary>
+        /// Starts loading an image on a worker thread unless it is already cached or in flight.
+        /// </summary>
+        void Prefetch(const std::wstring& key, LoadFunction load);
+
+        void Clear();
+
+    private:
+        struct Entry
+        {
+            std::wstring                                        key;
+            std::shared_ptr<ImageLoader>                        loader;
+            uint64_t                                            sizeBytes;
+        };
+
+        // Callers must hold m_lock.
+        void InsertLocked(const std::wstring& key, const std::shared_ptr<ImageLoader>& loader);
+        void TrimLocked();
+
+        std::mutex                                              m_lock;
+        std::condition_variable                                 m_idle;
+        std::list<Entry>                                        m_entries; // Most recently used first.
+        std::unordered_map<std::wstring, std::list<Entry>::iterator> m_index;
+        std::unordered_map<std::wstring, concurrency::task_completion_event<void>> m_pending;
+        uint64_t                                                m_budgetBytes;
+        uint64_t                                                m_sizeBytes;
+        unsigned int                                            m_countInFlight;
+    };
+}
@@ -12,12 +12,17 @@
 #include "pch.h"
 
 #include "DirectXTexEXR.h"
+#include "..\Common\MemoryMappedFile.h"
 
 #include <DirectXPackedVector.h>
 
+#include <algorithm>
 #include <assert.h>
 #include <exception>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 //
 // Requires the OpenEXR library <http://www.openexr.com/> and ZLIB <http://www.zlib.net>
@@ -29,6 +34,7 @@
 #include <ImfIO.h>
 #include <ImfChromaticities.h>
 #include <ImfChromaticitiesAttribute.h>
+#include <ImfThreading.h>
 #pragma warning(pop)
 
 static_assert(sizeof(Imf::Rgba) == 8, "Mismatch size");
@@ -163,6 +169,182 @@ namespace
         LONGLONG m_EOF;
     };
 
+    // Serves reads directly out of a memory mapped file. OpenEXR detects this via isMemoryMapped()
+    // and decodes from the returned pointers without copying or issuing any I/O calls.
+    class MappedInputStream : public Imf::IStream
+    {
+    public:
+        MappedInputStream(const DXRenderer::MemoryMappedFile& file, const char fileName[]) :
+            IStream(fileName),
+            m_data(reinterpret_cast<char*>(const_cast<uint8_t*>(file.GetData()))),
+            m_size(file.GetSize()),
+            m_position(0)
+        {
+        }
+
+        MappedInputStream(const MappedInputStream &) = delete;
+        MappedInputStream& operator = (const MappedInputStream &) = delete;
+
+        virtual bool isMemoryMapped() const override
+        {
+            return true;
+        }
+
+        // OpenEXR never writes through the returned pointer.
+        virtual char* readMemoryMapped(int n) override
+        {
+            if (n < 0 || m_position > m_size || static_cast<uint64_t>(n) > m_size - m_position)
+            {
+                throw com_exception(HRESULT_FROM_WIN32(ERROR_HANDLE_EOF));
+            }
+
+            char* data = m_data + m_position;
+            m_position += static_cast<uint64_t>(n);
+
+            return data;
+        }
+
+        virtual bool read(char c[], int n) override
+        {
+            memcpy(c, readMemoryMapped(n), static_cast<size_t>(n));
+
+            return m_position < m_size;
+        }
+
+        virtual Imf::Int64 tellg() override
+        {
+            return m_position;
+        }
+
+        virtual void seekg(Imf::Int64 pos) override
+        {
+            m_position = pos;
+        }
+
+        virtual void clear() override
+        {
+        }
+
+    private:
+        char*    m_data;
+        uint64_t m_size;
+        uint64_t m_position;
+    };
+
+    // Prefers a memory mapped stream; falls back to ReadFile if the file can't be mapped
+    // (e.g. it is too large for the address space).
+    std::unique_ptr<Imf::IStream> CreateInputStream(HANDLE hFile, const char fileName[], DXRenderer::MemoryMappedFile& mappedFile)
+    {
+        if (mappedFile.Map(hFile))
+        {
+            return std::make_unique<MappedInputStream>(mappedFile, fileName);
+        }
+
+        return std::make_unique<InputStream>(hFile, fileName);
+    }
+
+    // An Imf file constructed with numThreads keeps 2 * numThreads line (or tile) buffers, and
+    // never has more blocks than that being (de)compressed at once.
+    const int c_blocksInFlightPerThread = 2;
+
+    // Resolves a caller's thread budget and makes sure OpenEXR's global thread pool is large enough
+    // to honor it. Returns the numThreads value to pass to the Imf file constructors; 0 means one
+    // block at a time.
+    int PrepareThreadPool(unsigned int threadCount)
+    {
+        if (threadCount == 0)
+        {
+            threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        if (threadCount <= 1)
+        {
+            return 0;
+        }
+
+        threadCount = std::min(threadCount, 256u);
+
+        // The pool is shared by all files; only ever grow it so concurrent callers with different
+        // budgets don't shrink it out from under each other. A smaller budget is instead enforced
+        // per file, by the number of blocks it has in flight.
+        static std::mutex s_poolLock;
+        std::lock_guard<std::mutex> lock(s_poolLock);
+
+        if (Imf::globalThreadCount() < static_cast<int>(threadCount))
+        {
+            Imf::setGlobalThreadCount(static_cast<int>(threadCount));
+        }
+
+        return std::max(static_cast<int>(threadCount) / c_blocksInFlightPerThread, 1);
+    }
+
+    // Target size of each band buffer used by ScanEXRFile.
+    const size_t c_scanBandBytes = 2 * 1024 * 1024;
+
+    // Number of band buffers used by ScanEXRFile: one being decoded and one being consumed.
+    const size_t c_scanRingSlots = 2;
+
+    // Number of scanlines compressed together by each OpenEXR compression method.
+    int LinesPerBlock(Imf::Compression compression)
+    {
+        switch (compression)
+        {
+        case Imf::ZIP_COMPRESSION:
+        case Imf::PXR24_COMPRESSION:
+            return 16;
+
+        case Imf::PIZ_COMPRESSION:
+        case Imf::B44_COMPRESSION:
+        case Imf::B44A_COMPRESSION:
+        case Imf::DWAA_COMPRESSION:
+            return 32;
+
+        case Imf::DWAB_COMPRESSION:
+            return 256;
+
+        case Imf::NO_COMPRESSION:
+        case Imf::RLE_COMPRESSION:
+        case Imf::ZIPS_COMPRESSION:
+        default:
+            return 1;
+        }
+    }
+
+    // Reads the optional chromaticities attribute, with the white point converted to XYZ normalized to Y = 1.
+    void ReadChromaticities(const Imf::Header& header, EXRChromaticities& chromaticities)
+    {
+        chromaticities.Valid = false;
+        auto chromaticitiesAttrib = header.findTypedAttribute<Imf::ChromaticitiesAttribute>(Imf::ChromaticitiesAttribute::staticTypeName());
+        if (chromaticitiesAttrib)
+        {
+            auto& chromaticitiesAttribVal = chromaticitiesAttrib->value();
+
+            chromaticities.Valid = true;
+            chromaticities.RedX = chromaticitiesAttribVal.red.x;
+            chromaticities.RedY = chromaticitiesAttribVal.red.y;
+            chromaticities.BlueX = chromaticitiesAttribVal.blue.x;
+            chromaticities.BlueY = chromaticitiesAttribVal.blue.y;
+            chromaticities.GreenX = chromaticitiesAttribVal.green.x;
+            chromaticities.GreenY = chromaticitiesAttribVal.green.y;
+
+            // Convert xyY white point data to XYZ, and scale/normalize against Y = 1.0 for DirectX use.
+            // http://www.brucelindbloom.com/index.html?Eqn_xyY_to_XYZ.html
+            if (chromaticitiesAttribVal.white.y != 0.0f)
+            {
+                chromaticities.WhiteY = 1.0f;
+                chromaticities.WhiteX = (chromaticitiesAttribVal.white.x * chromaticities.WhiteY) / chromaticitiesAttribVal.white.y;
+                chromaticities.WhiteZ = ((1 - chromaticitiesAttribVal.white.x - chromaticitiesAttribVal.white.y) * chromaticities.WhiteY) / chromaticitiesAttribVal.white.y;
+            }
+            else
+            {
+                // Assume D65 (normalized luminance) whitepoint to at least produce some visible color values.
+                chromaticities.WhiteX = 0.9504f;
+                chromaticities.WhiteY = 1.0000f;
+                chromaticities.WhiteZ = 1.0888f;
+            }
+        }
+    }
+
     class OutputStream : public Imf::OStream
     {
     public:
@@ -216,7 +398,7 @@ namespace
 // Obtain metadata from EXR file on disk
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT DirectX::GetMetadataFromEXRFile(const wchar_t* szFile, TexMetadata& metadata)
+HRESULT DirectX::GetMetadataFromEXRFile(const wchar_t* szFile, TexMetadata& metadata, EXRChromaticities* chromaticities)
 {
     if (!szFile)
         return E_INVALIDARG;
@@ -239,13 +421,14 @@ HRESULT DirectX::GetMetadataFromEXRFile(const wchar_t* szFile, TexMetadata& meta
         return HRESULT_FROM_WIN32(GetLastError());
     }
 
-    InputStream stream(hFile.get(), fileName);
+    DXRenderer::MemoryMappedFile mappedFile;
+    auto stream = CreateInputStream(hFile.get(), fileName, mappedFile);
 
     HRESULT hr = S_OK;
 
     try
     {
-        Imf::RgbaInputFile file(stream);
+        Imf::RgbaInputFile file(*stream);
 
         auto dw = file.dataWindow();
 
@@ -260,6 +443,11 @@ HRESULT DirectX::GetMetadataFromEXRFile(const wchar_t* szFile, TexMetadata& meta
         metadata.depth = metadata.arraySize = metadata.mipLevels = 1;
         metadata.format = DXGI_FORMAT_R16G16B16A16_FLOAT;
         metadata.dimension = TEX_DIMENSION_TEXTURE2D;
+
+        if (chromaticities)
+        {
+            ReadChromaticities(file.header(), *chromaticities);
+        }
     }
     catch (const com_exception& exc)
     {
@@ -289,7 +477,7 @@ HRESULT DirectX::GetMetadataFromEXRFile(const wchar_t* szFile, TexMetadata& meta
 // Load a EXR file from disk
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT DirectX::LoadFromEXRFile(const wchar_t* szFile, TexMetadata* metadata, _Out_opt_ EXRChromaticities* chromaticities, ScratchImage& image)
+HRESULT DirectX::LoadFromEXRFile(const wchar_t* szFile, TexMetadata* metadata, _Out_opt_ EXRChromaticities* chromaticities, ScratchImage& image, unsigned int threadCount)
 {
     if (!szFile)
         return E_INVALIDARG;
@@ -319,13 +507,14 @@ HRESULT DirectX::LoadFromEXRFile(const wchar_t* szFile, TexMetadata* metadata, _
         return HRESULT_FROM_WIN32(GetLastError());
     }
 
-    InputStream stream(hFile.get(), fileName);
+    DXRenderer::MemoryMappedFile mappedFile;
+    auto stream = CreateInputStream(hFile.get(), fileName, mappedFile);
 
     HRESULT hr = S_OK;
 
     try
     {
-        Imf::RgbaInputFile file(stream);
+        Imf::RgbaInputFile file(*stream, PrepareThreadPool(threadCount));
 
         auto dw = file.dataWindow();
         auto header = file.header();
@@ -347,36 +536,7 @@ HRESULT DirectX::LoadFromEXRFile(const wchar_t* szFile, TexMetadata* metadata, _
 
         if (chromaticities)
         {
-            chromaticities->Valid = false;
-            auto chromaticitiesAttrib = header.findTypedAttribute<Imf::ChromaticitiesAttribute>(Imf::ChromaticitiesAttribute::staticTypeName());
-            if (chromaticitiesAttrib)
-            {
-                auto& chromaticitiesAttribVal = chromaticitiesAttrib->value();
-
-                chromaticities->Valid = true;
-                chromaticities->RedX = chromaticitiesAttribVal.red.x;
-                chromaticities->RedY = chromaticitiesAttribVal.red.y;
-                chromaticities->BlueX = chromaticitiesAttribVal.blue.x;
-                chromaticities->BlueY = chromaticitiesAttribVal.blue.y;
-                chromaticities->GreenX = chromaticitiesAttribVal.green.x;
-                chromaticities->GreenY = chromaticitiesAttribVal.green.y;
-
-                // Convert xyY white point data to XYZ, and scale/normalize against Y = 1.0 for DirectX use.
-                // http://www.brucelindbloom.com/index.html?Eqn_xyY_to_XYZ.html
-                if (chromaticitiesAttribVal.white.y != 0.0f)
-                {
-                    chromaticities->WhiteY = 1.0f;
-                    chromaticities->WhiteX = (chromaticitiesAttribVal.white.x * chromaticities->WhiteY) / chromaticitiesAttribVal.white.y;
-                    chromaticities->WhiteZ = ((1 - chromaticitiesAttribVal.white.x - chromaticitiesAttribVal.white.y) * chromaticities->WhiteY) / chromaticitiesAttribVal.white.y;
-                }
-                else
-                {
-                    // Assume D65 (normalized luminance) whitepoint to at least produce some visible color values.
-                    chromaticities->WhiteX = 0.9504f;
-                    chromaticities->WhiteY = 1.0000f;
-                    chromaticities->WhiteZ = 1.0888f;
-                }
-            }
+            ReadChromaticities(header, *chromaticities);
         }
 
         hr = image.Initialize2D(DXGI_FORMAT_R16G16B16A16_FLOAT, width, height, 1, 1);
@@ -415,11 +575,321 @@ HRESULT DirectX::LoadFromEXRFile(const wchar_t* szFile, TexMetadata* metadata, _
 }
 
 
+//-------------------------------------------------------------------------------------
+// Stream a EXR file from disk a band of scanlines at a time
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::ScanEXRFile(const wchar_t* szFile, TexMetadata* metadata, EXRChromaticities* chromaticities, const EXRScanlineCallback& callback, unsigned int threadCount)
+{
+    if (!szFile || !callback)
+        return E_INVALIDARG;
+
+    if (metadata)
+    {
+        memset(metadata, 0, sizeof(TexMetadata));
+    }
+
+    char fileName[MAX_PATH];
+    int result = WideCharToMultiByte(CP_ACP, 0, szFile, -1, fileName, MAX_PATH, nullptr, nullptr);
+    if (result <= 0)
+    {
+        *fileName = 0;
+    }
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    ScopedHandle hFile(safe_handle(CreateFile2(szFile, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr)));
+#else
+    ScopedHandle hFile(safe_handle(CreateFileW(szFile, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr)));
+#endif
+    if (!hFile)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    DXRenderer::MemoryMappedFile mappedFile;
+    auto stream = CreateInputStream(hFile.get(), fileName, mappedFile);
+
+    HRESULT hr = S_OK;
+
+    try
+    {
+        Imf::RgbaInputFile file(*stream, PrepareThreadPool(threadCount));
+
+        auto dw = file.dataWindow();
+        auto header = file.header();
+
+        int width = dw.max.x - dw.min.x + 1;
+        int height = dw.max.y - dw.min.y + 1;
+
+        if (width < 1 || height < 1)
+            return E_FAIL;
+
+        if (metadata)
+        {
+            metadata->width = static_cast<size_t>(width);
+            metadata->height = static_cast<size_t>(height);
+            metadata->depth = metadata->arraySize = metadata->mipLevels = 1;
+            metadata->format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+            metadata->dimension = TEX_DIMENSION_TEXTURE2D;
+        }
+
+        if (chromaticities)
+        {
+            ReadChromaticities(header, *chromaticities);
+        }
+
+        // Bands are whole line blocks so no block is decompressed twice.
+        int linesPerBlock = LinesPerBlock(file.compression());
+        size_t rowBytes = static_cast<size_t>(width) * sizeof(Imf::Rgba);
+        int bandHeight = static_cast<int>(std::max<size_t>(c_scanBandBytes / rowBytes / linesPerBlock, 1)) * linesPerBlock;
+        bandHeight = std::min(bandHeight, height);
+
+        ScratchImage ring[c_scanRingSlots];
+        for (auto& slot : ring)
+        {
+            hr = slot.Initialize2D(DXGI_FORMAT_R16G16B16A16_FLOAT, width, bandHeight, 1, 1);
+            if (FAILED(hr))
+                return hr;
+        }
+
+        // Callback for the previously decoded band, running while the next band is decoded.
+        std::future<HRESULT> pending;
+
+        size_t slotIndex = 0;
+        for (int y = dw.min.y; y <= dw.max.y; y += bandHeight)
+        {
+            int rows = std::min(bandHeight, dw.max.y - y + 1);
+
+            auto& slot = ring[slotIndex];
+            slotIndex = (slotIndex + 1) % c_scanRingSlots;
+
+            file.setFrameBuffer(reinterpret_cast<Imf::Rgba*>(slot.GetPixels()) - dw.min.x - static_cast<ptrdiff_t>(y) * width, 1, width);
+            file.readPixels(y, y + rows - 1);
+
+            if (pending.valid())
+            {
+                hr = pending.get();
+                if (FAILED(hr))
+                    return hr;
+            }
+
+            Image band = *slot.GetImage(0, 0, 0);
+            band.height = static_cast<size_t>(rows);
+            band.slicePitch = band.rowPitch * band.height;
+
+            size_t firstRow = static_cast<size_t>(y - dw.min.y);
+            pending = std::async(std::launch::async, [&callback, band, firstRow]()
+            {
+                return callback(band, firstRow);
+            });
+        }
+
+        if (pending.valid())
+        {
+            hr = pending.get();
+        }
+    }
+    catch (const com_exception& exc)
+    {
+#ifdef _DEBUG
+        OutputDebugStringA(exc.what());
+#endif
+        hr = exc.hr();
+    }
+    catch (const std::exception& exc)
+    {
+        exc;
+#ifdef _DEBUG
+        OutputDebugStringA(exc.what());
+#endif
+        hr = E_FAIL;
+    }
+    catch (...)
+    {
+        hr = E_UNEXPECTED;
+    }
+
+    return hr;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Random access reader
+//-------------------------------------------------------------------------------------
+
+// Members are destroyed in reverse order: the Imf file before its stream, the stream before the mapping.
+struct EXRFileReader::Impl
+{
+    ScopedHandle                        hFile;
+    DXRenderer::MemoryMappedFile        mappedFile;
+    std::unique_ptr<Imf::IStream>       stream;
+    std::unique_ptr<Imf::RgbaInputFile> file;
+    Imath::Box2i                        dw;
+    size_t                              linesPerBlock = 1;
+};
+
+EXRFileReader::EXRFileReader() = default;
+
+EXRFileReader::~EXRFileReader() = default;
+
+_Use_decl_annotations_
+HRESULT EXRFileReader::Open(const wchar_t* szFile, TexMetadata* metadata, EXRChromaticities* chromaticities, unsigned int threadCount)
+{
+    if (!szFile)
+        return E_INVALIDARG;
+
+    m_impl.reset();
+
+    if (metadata)
+    {
+        memset(metadata, 0, sizeof(TexMetadata));
+    }
+
+    char fileName[MAX_PATH];
+    int result = WideCharToMultiByte(CP_ACP, 0, szFile, -1, fileName, MAX_PATH, nullptr, nullptr);
+    if (result <= 0)
+    {
+        *fileName = 0;
+    }
+
+    auto impl = std::make_unique<Impl>();
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    impl->hFile.reset(safe_handle(CreateFile2(szFile, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr)));
+#else
+    impl->hFile.reset(safe_handle(CreateFileW(szFile, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_RANDOM_ACCESS, nullptr)));
+#endif
+    if (!impl->hFile)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    HRESULT hr = S_OK;
+
+    try
+    {
+        impl->stream = CreateInputStream(impl->hFile.get(), fileName, impl->mappedFile);
+        impl->file = std::make_unique<Imf::RgbaInputFile>(*impl->stream, PrepareThreadPool(threadCount));
+
+        impl->dw = impl->file->dataWindow();
+
+        int width = impl->dw.max.x - impl->dw.min.x + 1;
+        int height = impl->dw.max.y - impl->dw.min.y + 1;
+
+        if (width < 1 || height < 1)
+            return E_FAIL;
+
+        impl->linesPerBlock = static_cast<size_t>(LinesPerBlock(impl->file->compression()));
+
+        if (metadata)
+        {
+            metadata->width = static_cast<size_t>(width);
+            metadata->height = static_cast<size_t>(height);
+            metadata->depth = metadata->arraySize = metadata->mipLevels = 1;
+            metadata->format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+            metadata->dimension = TEX_DIMENSION_TEXTURE2D;
+        }
+
+        if (chromaticities)
+        {
+            ReadChromaticities(impl->file->header(), *chromaticities);
+        }
+    }
+    catch (const com_exception& exc)
+    {
+#ifdef _DEBUG
+        OutputDebugStringA(exc.what());
+#endif
+        hr = exc.hr();
+    }
+    catch (const std::exception& exc)
+    {
+        exc;
+#ifdef _DEBUG
+        OutputDebugStringA(exc.what());
+#endif
+        hr = E_FAIL;
+    }
+    catch (...)
+    {
+        hr = E_UNEXPECTED;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        m_impl = std::move(impl);
+    }
+
+    return hr;
+}
+
+_Use_decl_annotations_
+HRESULT EXRFileReader::ReadRows(size_t firstRow, const Image& band)
+{
+    if (!m_impl)
+        return E_UNEXPECTED;
+
+    if (!band.pixels)
+        return E_POINTER;
+
+    auto& dw = m_impl->dw;
+    size_t width = static_cast<size_t>(dw.max.x - dw.min.x + 1);
+    size_t height = static_cast<size_t>(dw.max.y - dw.min.y + 1);
+
+    if (band.format != DXGI_FORMAT_R16G16B16A16_FLOAT || band.width != width ||
+        (band.rowPitch % sizeof(Imf::Rgba)) > 0 || band.height == 0 ||
+        firstRow >= height || band.height > height - firstRow)
+        return E_INVALIDARG;
+
+    HRESULT hr = S_OK;
+
+    try
+    {
+        int y = dw.min.y + static_cast<int>(firstRow);
+        size_t yStride = band.rowPitch / sizeof(Imf::Rgba);
+
+        m_impl->file->setFrameBuffer(
+            reinterpret_cast<Imf::Rgba*>(band.pixels) - dw.min.x - static_cast<ptrdiff_t>(y) * static_cast<ptrdiff_t>(yStride),
+            1,
+            yStride);
+        m_impl->file->readPixels(y, y + static_cast<int>(band.height) - 1);
+    }
+    catch (const com_exception& exc)
+    {
+#ifdef _DEBUG
+        OutputDebugStringA(exc.what());
+#endif
+        hr = exc.hr();
+    }
+    catch (const std::exception& exc)
+    {
+        exc;
+#ifdef _DEBUG
+        OutputDebugStringA(exc.what());
+#endif
+        hr = E_FAIL;
+    }
+    catch (...)
+    {
+        hr = E_UNEXPECTED;
+    }
+
+    return hr;
+}
+
+size_t EXRFileReader::GetLinesPerBlock() const
+{
+    return m_impl ? m_impl->linesPerBlock : 1;
+}
+
+
 //-------------------------------------------------------------------------------------
 // Save a EXR file to disk
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT DirectX::SaveToEXRFile(const Image& image, const wchar_t* szFile)
+HRESULT DirectX::SaveToEXRFile(const Image& image, const wchar_t* szFile, unsigned int threadCount)
 {
     if (!szFile)
         return E_INVALIDARG;
@@ -473,7 +943,10 @@ HRESULT DirectX::SaveToEXRFile(const Image& image, const wchar_t* szFile)
         int width = static_cast<int>(image.width);
         int height = static_cast<int>(image.height);
 
-        Imf::RgbaOutputFile file(stream, Imf::Header(width, height), Imf::WRITE_RGBA);
+        int numThreads = PrepareThreadPool(threadCount);
+
+        Imf::Header header(width, height);
+        Imf::RgbaOutputFile file(stream, header, Imf::WRITE_RGBA, numThreads);
 
         if (image.format == DXGI_FORMAT_R16G16B16A16_FLOAT)
         {
@@ -482,52 +955,50 @@ HRESULT DirectX::SaveToEXRFile(const Image& image, const wchar_t* szFile)
         }
         else
         {
-            std::unique_ptr<XMHALF4> temp(new (std::nothrow) XMHALF4[width * height]);
+            // Convert and write in bands of whole line blocks, enough to fill every line buffer, instead
+            // of one scanline at a time.
+            int bandHeight = std::min(height, LinesPerBlock(header.compression()) * std::max(numThreads * c_blocksInFlightPerThread, 1));
+
+            std::unique_ptr<XMHALF4[]> temp(new (std::nothrow) XMHALF4[static_cast<size_t>(width) * bandHeight]);
             if (!temp)
                 return E_OUTOFMEMORY;
 
-            file.setFrameBuffer(reinterpret_cast<const Imf::Rgba*>(temp.get()), 1, width);
-
             auto sPtr = image.pixels;
-            auto dPtr = temp.get();
-            if (image.format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+            for (int y = 0; y < height; y += bandHeight)
             {
-                for (int j = 0; j < height; ++j)
+                int rows = std::min(bandHeight, height - y);
+
+                auto dPtr = temp.get();
+                for (int j = 0; j < rows; ++j)
                 {
-                    auto srcPtr = reinterpret_cast<const XMFLOAT4*>(sPtr);
-                    auto destPtr = dPtr;
-                    for (int k = 0; k < width; ++k, ++srcPtr, ++destPtr)
+                    if (image.format == DXGI_FORMAT_R32G32B32A32_FLOAT)
                     {
-                        XMVECTOR v = XMLoadFloat4(srcPtr);
-                        PackedVector::XMStoreHalf4(destPtr, v);
+                        PackedVector::XMConvertFloatToHalfStream(
+                            &dPtr->x, sizeof(PackedVector::HALF),
+                            reinterpret_cast<const float*>(sPtr), sizeof(float),
+                            static_cast<size_t>(width) * 4);
                     }
-
-                    sPtr += image.rowPitch;
-                    dPtr += width;
-
-                    file.writePixels(1);
-                }
-            }
-            else
-            {
-                assert(image.format == DXGI_FORMAT_R32G32B32_FLOAT);
-
-                for (int j = 0; j < height; ++j)
-                {
-                    auto srcPtr = reinterpret_cast<const XMFLOAT3*>(sPtr);
-                    auto destPtr = dPtr;
-                    for (int k = 0; k < width; ++k, ++srcPtr, ++destPtr)
+                    else
                     {
-                        XMVECTOR v = XMLoadFloat3(srcPtr);
-                        v = XMVectorSelect(g_XMIdentityR3, v, g_XMSelect1110);
-                        PackedVector::XMStoreHalf4(destPtr, v);
+                        assert(image.format == DXGI_FORMAT_R32G32B32_FLOAT);
+
+                        auto srcPtr = reinterpret_cast<const XMFLOAT3*>(sPtr);
+                        auto destPtr = dPtr;
+                        for (int k = 0; k < width; ++k, ++srcPtr, ++destPtr)
+                        {
+                            XMVECTOR v = XMLoadFloat3(srcPtr);
+                            v = XMVectorSelect(g_XMIdentityR3, v, g_XMSelect1110);
+                            PackedVector::XMStoreHalf4(destPtr, v);
+                        }
                     }
 
                     sPtr += image.rowPitch;
                     dPtr += width;
-
-                    file.writePixels(1);
                 }
+
+                // The frame buffer is addressed by absolute scanline, so offset it to the start of this band.
+                file.setFrameBuffer(reinterpret_cast<const Imf::Rgba*>(temp.get()) - static_cast<ptrdiff_t>(y) * width, 1, width);
+                file.writePixels(rows);
             }
         }
     }
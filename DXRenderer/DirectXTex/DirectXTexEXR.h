@@ -6,8 +6,13 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 //--------------------------------------------------------------------------------------
 
+#pragma once
+
 #include "directxtex.h"
 
+#include <functional>
+#include <memory>
+
 #pragma comment(lib,"IlmImf-2_2.lib")
 
 namespace DirectX
@@ -28,12 +33,64 @@ namespace DirectX
 
     HRESULT __cdecl GetMetadataFromEXRFile(
         _In_z_ const wchar_t* szFile,
-        _Out_ TexMetadata& metadata);
+        _Out_ TexMetadata& metadata,
+        _Out_opt_ EXRChromaticities* chromaticities = nullptr);
+
+    // threadCount, taken by LoadFromEXRFile, ScanEXRFile, EXRFileReader::Open and SaveToEXRFile, is
+    // the most line blocks OpenEXR (de)compresses at once for that file. 0 uses one per hardware
+    // thread; 1 processes one block at a time. OpenEXR's thread pool is shared by all files and
+    // grows to the largest threadCount requested.
 
     HRESULT __cdecl LoadFromEXRFile(
         _In_z_ const wchar_t* szFile,
         _Out_opt_ TexMetadata* metadata,
-        _Out_opt_ EXRChromaticities* chromaticities, _Out_ ScratchImage& image);
+        _Out_opt_ EXRChromaticities* chromaticities, _Out_ ScratchImage& image,
+        _In_ unsigned int threadCount = 0);
+
+    // Receives consecutive bands of R16G16B16A16_FLOAT scanlines; firstRow is relative to the top of
+    // the image. Return a failure HRESULT to stop scanning.
+    typedef std::function<HRESULT(const Image& band, size_t firstRow)> EXRScanlineCallback;
+
+    // Streams the image through callback a band at a time instead of decoding the whole frame into
+    // a ScratchImage. At most two bands of a few MB each are held in memory, and the next band is
+    // decoded while callback processes the previous one. Callbacks are made in order, one at a time,
+    // but not necessarily on the calling thread.
+    HRESULT __cdecl ScanEXRFile(
+        _In_z_ const wchar_t* szFile,
+        _Out_opt_ TexMetadata* metadata,
+        _Out_opt_ EXRChromaticities* chromaticities,
+        _In_ const EXRScanlineCallback& callback,
+        _In_ unsigned int threadCount = 0);
+
+    // Random access to the scanlines of an EXR file that stays open between reads, so a viewer can
+    // decode only the region it needs from an image too large to hold in memory. Reads are most
+    // efficient when they start and end on a multiple of GetLinesPerBlock(). Not thread safe.
+    class EXRFileReader
+    {
+    public:
+        EXRFileReader();
+        ~EXRFileReader();
+
+        EXRFileReader(const EXRFileReader&) = delete;
+        EXRFileReader& operator=(const EXRFileReader&) = delete;
+
+        HRESULT __cdecl Open(
+            _In_z_ const wchar_t* szFile,
+            _Out_opt_ TexMetadata* metadata,
+            _Out_opt_ EXRChromaticities* chromaticities,
+            _In_ unsigned int threadCount = 0);
+
+        // Decodes band.height full width rows starting at firstRow (relative to the top of the image).
+        // band must be R16G16B16A16_FLOAT and as wide as the image; any rowPitch is allowed.
+        HRESULT __cdecl ReadRows(size_t firstRow, _In_ const Image& band);
+
+        // Number of scanlines OpenEXR decompresses together.
+        size_t __cdecl GetLinesPerBlock() const;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+    };
 
-    HRESULT __cdecl SaveToEXRFile(_In_ const Image& image, _In_z_ const wchar_t* szFile);
+    HRESULT __cdecl SaveToEXRFile(_In_ const Image& image, _In_z_ const wchar_t* szFile, _In_ unsigned int threadCount = 0);
 };
@@ -0,0 +1,506 @@
+//--------------------------------------------------------------------------------------
+// File: DirectXTexRGBE.cpp
+//
+// DirectXTex Auxillary functions for reading Radiance RGBE (.hdr) files without
+// expanding them to floating point
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+
+#include "DirectXTexRGBE.h"
+#include "..\Common\MemoryMappedFile.h"
+#include "..\CpuRender\ParallelFor.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+//
+// Implements the Radiance picture format as written by Radiance's own color.c:
+// a text header, a resolution string, then one scanline after another. Each
+// scanline is flat RGBE, the original run length encoding, or (most commonly) the
+// adaptive run length encoding where the four channels are stored as separate
+// planes of runs and literals.
+//
+
+using namespace DirectX;
+
+namespace
+{
+    // Widths the adaptive run length encoding can be used for.
+    const size_t c_MinRleWidth = 8;
+    const size_t c_MaxRleWidth = 0x7fff;
+
+    // Marks a scanline that the pre-scan already decoded.
+    const size_t c_Decoded = SIZE_MAX;
+
+    struct ParsedHeader
+    {
+        size_t width;
+        size_t height;
+        bool bottomUp;
+        size_t dataOffset;
+        float exposure;
+    };
+
+    // Reads one '\n' terminated line starting at offset, without its terminator.
+    bool ReadLine(const uint8_t* data, size_t size, size_t& offset, std::string& line)
+    {
+        if (offset >= size)
+            return false;
+
+        auto start = data + offset;
+        auto end = static_cast<const uint8_t*>(memchr(start, '\n', size - offset));
+        if (!end)
+            return false;
+
+        line.assign(reinterpret_cast<const char*>(start), static_cast<size_t>(end - start));
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+
+        offset = static_cast<size_t>(end - data) + 1;
+        return true;
+    }
+
+    bool StartsWith(const std::string& line, const char* prefix)
+    {
+        return line.compare(0, strlen(prefix), prefix) == 0;
+    }
+
+    HRESULT ParseHeader(const uint8_t* data, size_t size, ParsedHeader& header)
+    {
+        header = {};
+        header.exposure = 1.0f;
+
+        size_t offset = 0;
+        std::string line;
+
+        // "#?RADIANCE" and "#?RGBE" are both common.
+        if (!ReadLine(data, size, offset, line) || !StartsWith(line, "#?"))
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+        // Variables, terminated by an empty line. Unknown ones are ignored.
+        for (;;)
+        {
+            if (!ReadLine(data, size, offset, line))
+                return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+
+            if (line.empty())
+                break;
+
+            if (StartsWith(line, "FORMAT="))
+            {
+                // 32-bit_rle_xyze would need converting to RGB, so it can't stay packed.
+                if (line.compare(7, std::string::npos, "32-bit_rle_rgbe") != 0)
+                    return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+            }
+            else if (StartsWith(line, "EXPOSURE="))
+            {
+                // Exposures are cumulative. Like Radiance, ignore nonsensical values such as 0.
+                double exposure = atof(line.c_str() + 9);
+                if (exposure >= 1e-12 && exposure <= 1e12)
+                {
+                    header.exposure *= static_cast<float>(exposure);
+                }
+            }
+        }
+
+        // Resolution string, e.g. "-Y 1080 +X 1920" for the usual top-down order. Orientations
+        // that transpose the image or mirror it horizontally are rare and not supported.
+        if (!ReadLine(data, size, offset, line))
+            return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+
+        const char* text = line.c_str();
+        if ((text[0] != '-' && text[0] != '+') || text[1] == 0)
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+        if (text[1] != 'Y' || text[2] != ' ')
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+        char* next = nullptr;
+        unsigned long height = strtoul(text + 3, &next, 10);
+        if (strncmp(next, " +X ", 4) != 0)
+            return HRESULT_FROM_WIN32(strncmp(next, " -X ", 4) == 0 ? ERROR_NOT_SUPPORTED : ERROR_INVALID_DATA);
+
+        unsigned long width = strtoul(next + 4, &next, 10);
+        if (*next != 0)
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+        // Every scanline takes at least 4 bytes, which rejects absurd sizes before allocating.
+        if (width == 0 || height == 0 || width > INT32_MAX || height > INT32_MAX ||
+            height > (size - offset) / 4)
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+        header.width = width;
+        header.height = height;
+        header.bottomUp = text[0] == '+';
+        header.dataOffset = offset;
+
+        return S_OK;
+    }
+
+    void SetMetadata(const ParsedHeader& header, TexMetadata& metadata)
+    {
+        metadata = {};
+        metadata.width = header.width;
+        metadata.height = header.height;
+        metadata.depth = metadata.arraySize = metadata.mipLevels = 1;
+        metadata.format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+        metadata.dimension = TEX_DIMENSION_TEXTURE2D;
+    }
+
+    bool IsRleScanline(const uint8_t* data, size_t size, size_t width)
+    {
+        return width >= c_MinRleWidth && width <= c_MaxRleWidth && size >= 4 &&
+            data[0] == 2 && data[1] == 2 && ((size_t(data[2]) << 8) | data[3]) == width;
+    }
+
+    // Finds the length of an adaptive run length encoded scanline by reading only the run headers.
+    HRESULT MeasureRleScanline(const uint8_t* data, size_t size, size_t width, size_t& length)
+    {
+        size_t offset = 4;
+
+        for (unsigned int channel = 0; channel < 4; channel++)
+        {
+            size_t x = 0;
+            while (x < width)
+            {
+                if (offset >= size)
+                    return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+
+                size_t count = data[offset++];
+                if (count > 128)
+                {
+                    // A run of one byte.
+                    count -= 128;
+                    offset++;
+                }
+                else
+                {
+                    // A literal of count bytes.
+                    if (count == 0)
+                        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+                    offset += count;
+                }
+
+                x += count;
+            }
+
+            if (x != width)
+                return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+
+        if (offset > size)
+            return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+
+        length = offset;
+        return S_OK;
+    }
+
+    // Expands a scanline already validated by MeasureRleScanline into four planes of width bytes.
+    void DecodeRleScanline(const uint8_t* data, size_t width, uint8_t* planes)
+    {
+        data += 4;
+
+        for (unsigned int channel = 0; channel < 4; channel++)
+        {
+            uint8_t* plane = planes + channel * width;
+
+            size_t x = 0;
+            while (x < width)
+            {
+                size_t count = *data++;
+                if (count > 128)
+                {
+                    count -= 128;
+                    memset(plane + x, *data++, count);
+                }
+                else
+                {
+                    memcpy(plane + x, data, count);
+                    data += count;
+                }
+
+                x += count;
+            }
+        }
+    }
+
+    // Interleaves the R, G, B and E planes written by DecodeRleScanline into RGBE pixels.
+    void InterleavePlanes(const uint8_t* planes, size_t width, uint8_t* rgbe)
+    {
+        const uint8_t* r = planes;
+        const uint8_t* g = r + width;
+        const uint8_t* b = g + width;
+        const uint8_t* e = b + width;
+
+        size_t x = 0;
+
+#if defined(_XM_SSE_INTRINSICS_)
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i vr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + x));
+            __m128i vg = _mm_loadu_si128(reinterpret_cast<const __m128i*>(g + x));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+            __m128i ve = _mm_loadu_si128(reinterpret_cast<const __m128i*>(e + x));
+
+            __m128i rgLow = _mm_unpacklo_epi8(vr, vg);
+            __m128i rgHigh = _mm_unpackhi_epi8(vr, vg);
+            __m128i beLow = _mm_unpacklo_epi8(vb, ve);
+            __m128i beHigh = _mm_unpackhi_epi8(vb, ve);
+
+            auto output = reinterpret_cast<__m128i*>(rgbe + x * 4);
+            _mm_storeu_si128(output + 0, _mm_unpacklo_epi16(rgLow, beLow));
+            _mm_storeu_si128(output + 1, _mm_unpackhi_epi16(rgLow, beLow));
+            _mm_storeu_si128(output + 2, _mm_unpacklo_epi16(rgHigh, beHigh));
+            _mm_storeu_si128(output + 3, _mm_unpackhi_epi16(rgHigh, beHigh));
+        }
+#elif defined(_XM_ARM_NEON_INTRINSICS_)
+        for (; x + 16 <= width; x += 16)
+        {
+            uint8x16x4_t v;
+            v.val[0] = vld1q_u8(r + x);
+            v.val[1] = vld1q_u8(g + x);
+            v.val[2] = vld1q_u8(b + x);
+            v.val[3] = vld1q_u8(e + x);
+
+            vst4q_u8(rgbe + x * 4, v);
+        }
+#endif
+
+        for (; x < width; x++)
+        {
+            rgbe[x * 4 + 0] = r[x];
+            rgbe[x * 4 + 1] = g[x];
+            rgbe[x * 4 + 2] = b[x];
+            rgbe[x * 4 + 3] = e[x];
+        }
+    }
+
+    // Decodes a flat scanline, or one in the original run length encoding where a pixel of
+    // (1, 1, 1, n) repeats the previous pixel. Its length is only known after decoding it.
+    HRESULT DecodeOldScanline(const uint8_t* data, size_t size, size_t& offset, size_t width, uint8_t* rgbe)
+    {
+        unsigned int shift = 0;
+        size_t x = 0;
+
+        while (x < width)
+        {
+            if (size - offset < 4)
+                return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+
+            const uint8_t* pixel = data + offset;
+            offset += 4;
+
+            if (pixel[0] == 1 && pixel[1] == 1 && pixel[2] == 1)
+            {
+                // Consecutive repeats form a longer count, least significant byte first.
+                if (x == 0 || shift > 24)
+                    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+                size_t count = size_t(pixel[3]) << shift;
+                if (count > width - x)
+                    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    memcpy(rgbe + (x + i) * 4, rgbe + (x - 1) * 4, 4);
+                }
+
+                x += count;
+                shift += 8;
+            }
+            else
+            {
+                memcpy(rgbe + x * 4, pixel, 4);
+                x++;
+                shift = 0;
+            }
+        }
+
+        return S_OK;
+    }
+
+    HRESULT DecodePixels(
+        const uint8_t* data,
+        size_t size,
+        const ParsedHeader& header,
+        std::vector<uint8_t>& pixels,
+        unsigned int threadCount)
+    {
+        size_t width = header.width;
+        size_t height = header.height;
+        size_t rowBytes = width * 4;
+
+        pixels.resize(rowBytes * height);
+
+        // Pre-scan in file order. Adaptive RLE scanlines are only measured, so they can be
+        // decoded in any order afterwards; anything else has to be decoded to find its end.
+        std::vector<size_t> offsets(height);
+        size_t offset = header.dataOffset;
+
+        for (size_t i = 0; i < height; i++)
+        {
+            size_t y = header.bottomUp ? height - 1 - i : i;
+
+            if (IsRleScanline(data + offset, size - offset, width))
+            {
+                size_t length = 0;
+                HRESULT hr = MeasureRleScanline(data + offset, size - offset, width, length);
+                if (FAILED(hr))
+                    return hr;
+
+                offsets[y] = offset;
+                offset += length;
+            }
+            else
+            {
+                HRESULT hr = DecodeOldScanline(data, size, offset, width, &pixels[y * rowBytes]);
+                if (FAILED(hr))
+                    return hr;
+
+                offsets[y] = c_Decoded;
+            }
+        }
+
+        unsigned int numWorkers = DXRenderer::GetParallelForWorkerCount(0, height, DXRenderer::sc_DefaultRowsPerBand, threadCount);
+        std::vector<uint8_t> planes(rowBytes * numWorkers);
+
+        DXRenderer::ParallelForWorkers(0, height, DXRenderer::sc_DefaultRowsPerBand, threadCount, [&](size_t first, size_t last, unsigned int worker)
+        {
+            uint8_t* scratch = &planes[rowBytes * worker];
+
+            for (size_t y = first; y < last; y++)
+            {
+                if (offsets[y] != c_Decoded)
+                {
+                    DecodeRleScanline(data + offsets[y], width, scratch);
+                    InterleavePlanes(scratch, width, &pixels[y * rowBytes]);
+                }
+            }
+        });
+
+        return S_OK;
+    }
+}
+
+
+//=====================================================================================
+// Entry-points
+//=====================================================================================
+
+//-------------------------------------------------------------------------------------
+// Obtain metadata from RGBE file in memory/on disk
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::GetMetadataFromRGBEMemory(const void* pSource, size_t size, TexMetadata& metadata, RGBEHeader* header)
+{
+    if (!pSource || !size)
+        return E_INVALIDARG;
+
+    ParsedHeader parsed;
+    HRESULT hr = ParseHeader(static_cast<const uint8_t*>(pSource), size, parsed);
+    if (FAILED(hr))
+        return hr;
+
+    SetMetadata(parsed, metadata);
+
+    if (header)
+    {
+        header->Exposure = parsed.exposure;
+    }
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::GetMetadataFromRGBEFile(const wchar_t* szFile, TexMetadata& metadata, RGBEHeader* header)
+{
+    if (!szFile)
+        return E_INVALIDARG;
+
+    DXRenderer::MemoryMappedFile mappedFile;
+    if (!mappedFile.Open(szFile))
+    {
+        DWORD error = GetLastError();
+        return error ? HRESULT_FROM_WIN32(error) : E_FAIL;
+    }
+
+    return GetMetadataFromRGBEMemory(mappedFile.GetData(), static_cast<size_t>(mappedFile.GetSize()), metadata, header);
+}
+
+
+//-------------------------------------------------------------------------------------
+// Load a RGBE file in memory/on disk
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::LoadFromRGBEMemory(const void* pSource, size_t size, TexMetadata* metadata, RGBEHeader* header, std::vector<uint8_t>& pixels, unsigned int threadCount)
+{
+    pixels.clear();
+
+    if (!pSource || !size)
+        return E_INVALIDARG;
+
+    auto data = static_cast<const uint8_t*>(pSource);
+
+    ParsedHeader parsed;
+    HRESULT hr = ParseHeader(data, size, parsed);
+    if (FAILED(hr))
+        return hr;
+
+    try
+    {
+        hr = DecodePixels(data, size, parsed, pixels, threadCount);
+    }
+    catch (const std::bad_alloc&)
+    {
+        hr = E_OUTOFMEMORY;
+    }
+    catch (...)
+    {
+        hr = E_UNEXPECTED;
+    }
+
+    if (FAILED(hr))
+    {
+        pixels.clear();
+        return hr;
+    }
+
+    if (metadata)
+    {
+        SetMetadata(parsed, *metadata);
+    }
+
+    if (header)
+    {
+        header->Exposure = parsed.exposure;
+    }
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::LoadFromRGBEFile(const wchar_t* szFile, TexMetadata* metadata, RGBEHeader* header, std::vector<uint8_t>& pixels, unsigned int threadCount)
+{
+    pixels.clear();
+
+    if (!szFile)
+        return E_INVALIDARG;
+
+    // Scanlines are decoded straight out of the page cache.
+    DXRenderer::MemoryMappedFile mappedFile;
+    if (!mappedFile.Open(szFile))
+    {
+        DWORD error = GetLastError();
+        return error ? HRESULT_FROM_WIN32(error) : E_FAIL;
+    }
+
+    return LoadFromRGBEMemory(mappedFile.GetData(), static_cast<size_t>(mappedFile.GetSize()), metadata, header, pixels, threadCount);
+}
@@ -0,0 +1,55 @@
+//--------------------------------------------------------------------------------------
+// File: DirectXTexRGBE.h
+//
+// DirectXTex Auxillary functions for reading Radiance RGBE (.hdr) files without
+// expanding them to floating point
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "directxtex.h"
+
+#include <vector>
+
+namespace DirectX
+{
+    struct RGBEHeader
+    {
+        // Product of all EXPOSURE lines, 1 if there are none. Pixels are returned as stored,
+        // i.e. already multiplied by this; divide by it to recover the original radiance.
+        float Exposure;
+    };
+
+    // metadata describes the image once expanded (R32G32B32A32_FLOAT), the same as
+    // GetMetadataFromHDRFile. Only 32-bit_rle_rgbe files with standard (-Y or +Y, +X)
+    // orientation are supported.
+
+    HRESULT __cdecl GetMetadataFromRGBEMemory(
+        _In_reads_bytes_(size) const void* pSource, _In_ size_t size,
+        _Out_ TexMetadata& metadata,
+        _Out_opt_ RGBEHeader* header = nullptr);
+
+    HRESULT __cdecl GetMetadataFromRGBEFile(
+        _In_z_ const wchar_t* szFile,
+        _Out_ TexMetadata& metadata,
+        _Out_opt_ RGBEHeader* header = nullptr);
+
+    // Decodes to packed RGBE, 4 bytes per pixel, tightly packed with the top row first.
+    // A quick pre-scan finds where each run length encoded scanline starts, then scanlines are
+    // decoded in parallel. threadCount of 0 uses one thread per hardware thread; 1 decodes on
+    // the calling thread.
+
+    HRESULT __cdecl LoadFromRGBEMemory(
+        _In_reads_bytes_(size) const void* pSource, _In_ size_t size,
+        _Out_opt_ TexMetadata* metadata,
+        _Out_opt_ RGBEHeader* header,
+        _Out_ std::vector<uint8_t>& pixels,
+        _In_ unsigned int threadCount = 0);
+
+    HRESULT __cdecl LoadFromRGBEFile(
+        _In_z_ const wchar_t* szFile,
+        _Out_opt_ TexMetadata* metadata,
+        _Out_opt_ RGBEHeader* header,
+        _Out_ std::vector<uint8_t>& pixels,
+        _In_ unsigned int threadCount = 0);
+};
@@ -6,11 +6,15 @@
 #include "MagicConstants.h"
 #include "RenderEffects\SimpleTonemapEffect.h"
 #include "DirectXTex\DirectXTexEXR.h"
+#include "CpuRender\LuminanceHistogram.h"
+
+#include <WindowsStorageCOM.h>
 
 using namespace DXRenderer;
 
 using namespace DirectX;
 using namespace Microsoft::WRL;
+using namespace Microsoft::WRL::Wrappers;
 using namespace Platform;
 using namespace std;
 using namespace Windows::Foundation;
@@ -61,13 +65,15 @@ void HDRImageViewerRenderer::CreateDeviceIndependentResources()
     auto fact = m_deviceResources->GetD2DFactory();
 
     // TODO: This instance never does anything as it gets overwritten upon image load.
-    m_imageLoader = std::make_unique<ImageLoader>(m_deviceResources, ImageLoaderOptions{});
+    m_imageLoader = std::make_shared<ImageLoader>(m_deviceResources, ImageLoaderOptions{});
+    m_imageCache = std::make_unique<DecodedImageCache>(sc_DefaultImageCacheBudgetBytes);
 
     // Register the custom render effects.
     IFT(SimpleTonemapEffect::Register(fact));
     IFT(SdrOverlayEffect::Register(fact));
     IFT(LuminanceHeatmapEffect::Register(fact));
     IFT(MaxLuminanceEffect::Register(fact));
+    IFT(GamutCompressionEffect::Register(fact));
     IFT(SphereMapEffect::Register(fact));
 }
 
@@ -231,15 +237,14 @@ void HDRImageViewerRenderer::SetRenderOptions(
         IFT(m_sdrWhiteScaleEffect->SetValue(D2D1_WHITELEVELADJUSTMENT_PROP_OUTPUT_WHITE_LEVEL, min(targetMaxNits, maxCLL)));
     }
 
-    // If the gamut map conversion is enabled, insert the 2 color matrix effects needed to perform that operation.
-    // What we're doing here is transforming the colors from scRGB colors to panel-relative colors, and clamping 
-    // that output to 0-1, then a second effect converts back to rec 709 colorimetry without clipping.
+    // If the gamut map conversion is enabled, insert the gamut compression effect. It transforms the colors from
+    // scRGB to panel-relative colors, compresses out of gamut colors toward the panel's gamut boundary instead of
+    // clipping them, and converts back to rec 709 colorimetry, all in one pass.
     if (m_constrainGamut)
     {
-        m_mapGamutToPanel->SetInputEffect(0, m_finalOutput.Get());
-        m_mapGamutToScRGB->SetInputEffect(0, m_mapGamutToPanel.Get());
+        m_gamutCompressionEffect->SetInputEffect(0, m_finalOutput.Get());
 
-        m_finalOutput = m_mapGamutToScRGB.Get();
+        m_finalOutput = m_gamutCompressionEffect.Get();
     }
 
     Draw();
@@ -259,20 +264,145 @@ void HDRImageViewerRenderer::SetRenderOptions(
     }
 }
 
-ImageInfo HDRImageViewerRenderer::LoadImageFromWic(_In_ IRandomAccessStream^ imageStream, ImageLoaderOptions options)
+// Opens a read handle to imageFile, through which ImageLoader can memory-map the file instead of
+// copying it from the stream. The handle is invalid if imageFile is null or not a local file.
+static std::shared_ptr<FileHandle> OpenImageFileHandle(_In_opt_ StorageFile^ imageFile)
+{
+    auto handle = std::make_shared<FileHandle>();
+
+    ComPtr<IStorageItemHandleAccess> handleAccess;
+    if (imageFile != nullptr &&
+        SUCCEEDED(reinterpret_cast<IUnknown*>(imageFile)->QueryInterface(IID_PPV_ARGS(&handleAccess))))
+    {
+        HANDLE hFile = INVALID_HANDLE_VALUE;
+        if (SUCCEEDED(handleAccess->Create(HAO_READ, HSO_SHARE_READ, HO_NONE, nullptr, &hFile)))
+        {
+            handle->Attach(hFile);
+        }
+    }
+
+    return handle;
+}
+
+// Loader of filename, a temporary copy that DirectXTex reads, which deletes the copy once the last
+// reference to the loader is released: it has left the cache and is no longer displayed or prefetching.
+// The loader is destroyed first so a tiled image's store has closed the file.
+static std::shared_ptr<ImageLoader> MakeTemporaryFileLoader(const std::shared_ptr<DeviceResources>& deviceResources, ImageLoaderOptions& options, _In_ String^ filename)
+{
+    std::wstring path(filename->Data());
+
+    return std::shared_ptr<ImageLoader>(new ImageLoader(deviceResources, options), [path](ImageLoader* loader)
+    {
+        delete loader;
+
+        // Best effort; the OS clears out the temporary folder if the copy is still open elsewhere.
+        DeleteFileW(path.c_str());
+    });
+}
+
+ImageInfo HDRImageViewerRenderer::LoadImageFromWic(_In_opt_ StorageFile^ imageFile, _In_ IRandomAccessStream^ imageStream, ImageLoaderOptions options, ImageCacheKey cacheKey)
 {
     ComPtr<IStream> iStream;
     IFT(CreateStreamOverRandomAccessStream(imageStream, IID_PPV_ARGS(&iStream)));
 
-    m_imageLoader = std::make_unique<ImageLoader>(m_deviceResources, options);
-    m_imageInfo = m_imageLoader->LoadImageFromWic(iStream.Get());
-    return m_imageInfo;
+    auto fileHandle = OpenImageFileHandle(imageFile);
+
+    auto loader = std::make_shared<ImageLoader>(m_deviceResources, options);
+    auto info = loader->LoadImageFromWic(iStream.Get(), fileHandle->Get());
+    m_imageCache->Insert(DecodedImageCache::MakeKey(cacheKey, options), loader);
+
+    return SetImageLoader(loader, info);
+}
+
+ImageInfo HDRImageViewerRenderer::LoadImageFromDirectXTex(String ^ filename, String ^ extension, ImageLoaderOptions options, ImageCacheKey cacheKey)
+{
+    auto loader = MakeTemporaryFileLoader(m_deviceResources, options, filename);
+    auto info = loader->LoadImageFromDirectXTex(filename, extension);
+    m_imageCache->Insert(DecodedImageCache::MakeKey(cacheKey, options), loader);
+
+    return SetImageLoader(loader, info);
+}
+
+ImageInfo HDRImageViewerRenderer::LoadImageFromCache(ImageCacheKey cacheKey, ImageLoaderOptions options)
+{
+    auto loader = m_imageCache->Find(DecodedImageCache::MakeKey(cacheKey, options));
+    if (loader == nullptr)
+    {
+        ImageInfo info = {};
+        info.isValid = false;
+        return info;
+    }
+
+    return SetImageLoader(loader, loader->GetImageInfo());
 }
 
-ImageInfo HDRImageViewerRenderer::LoadImageFromDirectXTex(String ^ filename, String ^ extension, ImageLoaderOptions options)
+IAsyncAction^ HDRImageViewerRenderer::WaitForImagePrefetchAsync(ImageCacheKey cacheKey, ImageLoaderOptions options)
 {
-    m_imageLoader = std::make_unique<ImageLoader>(m_deviceResources, options);
-    m_imageInfo = m_imageLoader->LoadImageFromDirectXTex(filename, extension);
+    auto prefetched = m_imageCache->WhenPrefetched(DecodedImageCache::MakeKey(cacheKey, options));
+
+    return concurrency::create_async([prefetched]() { return prefetched; });
+}
+
+void HDRImageViewerRenderer::PrefetchImageFromWic(_In_opt_ StorageFile^ imageFile, _In_ IRandomAccessStream^ imageStream, ImageLoaderOptions options, ImageCacheKey cacheKey)
+{
+    // Wrap the stream and open the file here, on the caller's thread, rather than on the worker thread.
+    ComPtr<IStream> iStream;
+    IFT(CreateStreamOverRandomAccessStream(imageStream, IID_PPV_ARGS(&iStream)));
+
+    auto fileHandle = OpenImageFileHandle(imageFile);
+
+    auto deviceResources = m_deviceResources;
+    m_imageCache->Prefetch(DecodedImageCache::MakeKey(cacheKey, options), [deviceResources, iStream, fileHandle, options]()
+    {
+        ImageLoaderOptions loaderOptions = options;
+        auto loader = std::make_shared<ImageLoader>(deviceResources, loaderOptions);
+        loader->LoadImageFromWic(iStream.Get(), fileHandle->Get());
+        return loader;
+    });
+}
+
+void HDRImageViewerRenderer::PrefetchImageFromDirectXTex(String^ filename, String^ extension, ImageLoaderOptions options, ImageCacheKey cacheKey)
+{
+    auto deviceResources = m_deviceResources;
+    m_imageCache->Prefetch(DecodedImageCache::MakeKey(cacheKey, options), [deviceResources, filename, extension, options]()
+    {
+        ImageLoaderOptions loaderOptions = options;
+        auto loader = MakeTemporaryFileLoader(deviceResources, loaderOptions, filename);
+        loader->LoadImageFromDirectXTex(filename, extension);
+        return loader;
+    });
+}
+
+// Lets the caller skip preparing a prefetch (e.g. copying the file) that would be a no-op.
+bool HDRImageViewerRenderer::IsImageCached(ImageCacheKey cacheKey, ImageLoaderOptions options)
+{
+    return m_imageCache->Contains(DecodedImageCache::MakeKey(cacheKey, options));
+}
+
+void HDRImageViewerRenderer::SetImageCacheBudget(uint64 budgetBytes)
+{
+    m_imageCache->SetBudget(budgetBytes);
+}
+
+// Makes loader the displayed image. If loading failed, the previous image is kept so the
+// caller can continue to display it.
+ImageInfo HDRImageViewerRenderer::SetImageLoader(const std::shared_ptr<ImageLoader>& loader, const ImageInfo& info)
+{
+    if (info.isValid == false)
+    {
+        return info;
+    }
+
+    // Only the displayed image holds device resources; the previous one may stay in the cache and
+    // recreates them if it is displayed again.
+    if (m_imageLoader != loader &&
+        m_imageLoader->GetState() == ImageLoaderState::LoadingSucceeded)
+    {
+        m_imageLoader->ReleaseDeviceDependentResources();
+    }
+
+    m_imageLoader = loader;
+    m_imageInfo = info;
     return m_imageInfo;
 }
 
@@ -287,7 +417,7 @@ void HDRImageViewerRenderer::ExportImageToSdr(_In_ IRandomAccessStream^ outputSt
 // Test only. Exports to DXGI encoded DDS.
 void HDRImageViewerRenderer::ExportAsDdsTest(_In_ IRandomAccessStream^ outputStream)
 {
-    auto wicSource = m_imageLoader->GetWicSourceTest();
+    auto wicSource = m_imageLoader->GetDecodedImage();
     ComPtr<IWICBitmap> bitmap;
     IFT(wicSource->QueryInterface(IID_PPV_ARGS(&bitmap)));
 
@@ -297,6 +427,19 @@ void HDRImageViewerRenderer::ExportAsDdsTest(_In_ IRandomAccessStream^ outputStr
     ImageExporter::ExportToDds(bitmap.Get(), iStream.Get(), DXGI_FORMAT_R10G10B10A2_UNORM);
 }
 
+/// <summary>
+/// Saves the decoded image as BC6H (HDR) or BC7 (SDR) DDS, without running the render pipeline.
+/// Gain maps are not included, and HDR10 HEIF images are not supported.
+/// </summary>
+/// <param name="quality">0 to 1, trading encode time for quality; -1 is the default.</param>
+void HDRImageViewerRenderer::ExportImageToDds(Windows::Storage::Streams::IRandomAccessStream^ outputStream, float quality)
+{
+    ComPtr<IStream> iStream;
+    IFT(CreateStreamOverRandomAccessStream(outputStream, IID_PPV_ARGS(&iStream)));
+
+    ImageExporter::ExportToCompressedDds(m_imageLoader->GetDecodedImage(), iStream.Get(), quality);
+}
+
 /// <summary>
 /// Save any supported HDR format as HDR JPEG XR. Not guaranteed to be lossless since we run the
 /// full render pipeline.
@@ -361,7 +504,8 @@ void HDRImageViewerRenderer::ExportImageToJxr(Windows::Storage::Streams::IRandom
 // tonemapping, and white level, based on the loaded image. Also responsible for m_imageLoader.
 void HDRImageViewerRenderer::CreateImageDependentResources()
 {
-    // If we just came from device lost/restored, we need to manually re-setup ImageLoader.
+    // A newly loaded or cached image, or we just came from device lost/restored: ImageLoader
+    // doesn't have device resources yet.
     if (m_imageLoader->GetState() == ImageLoaderState::NeedDeviceResources)
     {
         m_imageLoader->CreateDeviceDependentResources();
@@ -476,8 +620,7 @@ void HDRImageViewerRenderer::CreateImageDependentResources()
     IFT(context->CreateEffect(CLSID_CustomMaxLuminanceEffect, &m_maxLuminanceEffect));
     IFT(context->CreateEffect(CLSID_CustomSphereMapEffect, &m_sphereMapEffect));
 
-    IFT(context->CreateEffect(CLSID_D2D1ColorMatrix, &m_mapGamutToPanel));
-    IFT(context->CreateEffect(CLSID_D2D1ColorMatrix, &m_mapGamutToScRGB));
+    IFT(context->CreateEffect(CLSID_CustomGamutCompressionEffect, &m_gamutCompressionEffect));
 
     // TEST: border effect to remove seam at the boundary of the image (subpixel sampling)
     // Unclear if we can force D2D_BORDER_MODE_HARD somewhere to avoid the seam.
@@ -609,8 +752,7 @@ void HDRImageViewerRenderer::ReleaseImageDependentResources()
     m_histogramPrescale.Reset();
     m_histogramEffect.Reset();
     m_sphereMapEffect.Reset();
-    m_mapGamutToPanel.Reset();
-    m_mapGamutToScRGB.Reset();
+    m_gamutCompressionEffect.Reset();
     m_finalOutput.Reset();
 }
 
@@ -800,68 +942,32 @@ void HDRImageViewerRenderer::UpdateWhiteLevelScale(float brightnessAdjustment, f
     IFT(m_whiteScaleEffect->SetValue(D2D1_COLORMATRIX_PROP_COLOR_MATRIX, matrix));
 }
 
-D2D1_MATRIX_5X4_F MatrixToD2D(Matrix m)
+// ColorMatrix multiplies column vectors, D2D matrices multiply row vectors, so the 3x3 part is transposed.
+D2D1_MATRIX_4X4_F MatrixToD2D(const ColorMatrix& m)
 {
-    return D2D1::Matrix5x4F(
-        (float)m.M[0], (float)m.M[1], (float)m.M[2], 0,
-        (float)m.M[3], (float)m.M[4], (float)m.M[5], 0,
-        (float)m.M[6], (float)m.M[7], (float)m.M[8], 0,
-                    0,             0,             0, 1,
-                    0,             0,             0, 0 );
+    auto t = m.Transpose();
 
+    return D2D1::Matrix4x4F(
+        (float)t(0, 0), (float)t(0, 1), (float)t(0, 2), 0,
+        (float)t(1, 0), (float)t(1, 1), (float)t(1, 2), 0,
+        (float)t(2, 0), (float)t(2, 1), (float)t(2, 2), 0,
+                     0,              0,              0, 1);
 }
 
-// If we need to constrain the gamut of the output to specified colorimetry, calculate and set the matrices
+// If we need to constrain the gamut of the output to specified colorimetry, calculate and set the matrix.
+// The effect derives the inverse and the compression parameters from it.
 void HDRImageViewerRenderer::UpdateGamutTransforms()
 {
-    // Clamping the colors in panel space should have the effect of a colorimetric clip
-    IFT(m_mapGamutToPanel->SetValue(D2D1_COLORMATRIX_PROP_CLAMP_OUTPUT, TRUE));
-    IFT(m_mapGamutToScRGB->SetValue(D2D1_COLORMATRIX_PROP_CLAMP_OUTPUT, FALSE));
-
-    auto M709 = Matrix(3, 3);
-    auto XYZDisplay = Matrix(3, 3);
-    auto WhiteDisplay = Matrix(1, 3);
-    auto MDisplay = Matrix(3, 3);
-
-    M709.M = {
-        0.4124564, 0.3575761, 0.1804375,
-        0.2126729, 0.7151522, 0.0721750,
-        0.0193339, 0.1191920, 0.9503041
-    };
+    auto MDisplay = ColorMatrix::RgbToXyzD65(
+        m_dispInfo->RedPrimary.X, m_dispInfo->RedPrimary.Y,
+        m_dispInfo->GreenPrimary.X, m_dispInfo->GreenPrimary.Y,
+        m_dispInfo->BluePrimary.X, m_dispInfo->BluePrimary.Y,
+        m_dispInfo->WhitePoint.X, m_dispInfo->WhitePoint.Y);
 
-    XYZDisplay.M[0] = m_dispInfo->RedPrimary.X / m_dispInfo->RedPrimary.Y;
-    XYZDisplay.M[1] = m_dispInfo->GreenPrimary.X / m_dispInfo->GreenPrimary.Y;
-    XYZDisplay.M[2] = m_dispInfo->BluePrimary.X / m_dispInfo->BluePrimary.Y;
-    XYZDisplay.M[3] = 1.f;
-    XYZDisplay.M[4] = 1.f;
-    XYZDisplay.M[5] = 1.f;
-    XYZDisplay.M[6] = (1.f - m_dispInfo->RedPrimary.X   - m_dispInfo->RedPrimary.Y)   / m_dispInfo->RedPrimary.Y;
-    XYZDisplay.M[7] = (1.f - m_dispInfo->GreenPrimary.X - m_dispInfo->GreenPrimary.Y) / m_dispInfo->GreenPrimary.Y;
-    XYZDisplay.M[8] = (1.f - m_dispInfo->BluePrimary.X  - m_dispInfo->BluePrimary.Y)  / m_dispInfo->BluePrimary.Y;
-
-    WhiteDisplay.M[0] = m_dispInfo->WhitePoint.X / m_dispInfo->WhitePoint.Y;
-    WhiteDisplay.M[1] = 1.f;
-    WhiteDisplay.M[2] = (1.f - m_dispInfo->WhitePoint.X - m_dispInfo->WhitePoint.Y) / m_dispInfo->WhitePoint.Y;
-
-    auto S = XYZDisplay.Invert() * WhiteDisplay;
-
-    MDisplay.M[0] = S.M[0] * XYZDisplay.M[0];
-    MDisplay.M[1] = S.M[1] * XYZDisplay.M[1];
-    MDisplay.M[2] = S.M[2] * XYZDisplay.M[2];
-    MDisplay.M[3] = S.M[0] * XYZDisplay.M[3];
-    MDisplay.M[4] = S.M[1] * XYZDisplay.M[4];
-    MDisplay.M[5] = S.M[2] * XYZDisplay.M[5];
-    MDisplay.M[6] = S.M[0] * XYZDisplay.M[6];
-    MDisplay.M[7] = S.M[1] * XYZDisplay.M[7];
-    MDisplay.M[8] = S.M[2] * XYZDisplay.M[8];
-
-    auto transform = MDisplay.Invert() * M709;
-
-    auto gamutToPanel = MatrixToD2D(transform);
-    m_mapGamutToPanel->SetValue(D2D1_COLORMATRIX_PROP_COLOR_MATRIX, gamutToPanel);
-
-    auto panelToScRGB = MatrixToD2D(transform.Invert());
-    m_mapGamutToScRGB->SetValue(D2D1_COLORMATRIX_PROP_COLOR_MATRIX, panelToScRGB);
+    auto transform = MDisplay.Invert() * sc_ScRgbToXyz;
+
+    auto scRgbToPanel = MatrixToD2D(transform);
+    IFT(m_gamutCompressionEffect->SetValue(GAMUTCOMPRESSION_PROP_SCRGB_TO_PANEL, scRgbToPanel));
 }
 
 // Call this after updating any spatial transform state to regenerate the effect graph.
@@ -890,17 +996,48 @@ void HDRImageViewerRenderer::ComputeHdrMetadata()
     m_imageCLL = { -1.0f, -1.0f, false };
 
     // HDR metadata is not meaningful for SDR or WCG images.
-    if ((!m_isComputeSupported) ||
-        (m_imageInfo.imageKind != AdvancedColorKind::HighDynamicRange))
+    if (m_imageInfo.imageKind != AdvancedColorKind::HighDynamicRange)
     {
         return;
     }
 
-    // MaxCLL is nominally calculated for the single brightest pixel in a frame.
-    // But we take a slightly more conservative definition that takes the 99.99th percentile
-    // to account for extreme outliers in the image.
-    float maxCLLPercent = 0.9999f;
+    // OpenEXR files are histogrammed at full resolution as they are decoded.
+    HistogramCLL cll = m_imageLoader->GetFileCLL();
+    if (cll.maxNits < 0.0f)
+    {
+        cll = m_isComputeSupported ? ComputeHistogramGpu() : ComputeHistogramCpu();
+    }
+
+    m_imageCLL.maxNits = cll.maxNits;
+    m_imageCLL.medianNits = cll.medianNits;
+
+    // Some drivers have a bug where histogram will always return 0. Or some images are pure black.
+    // Treat these cases as unknown.
+    if (m_imageCLL.maxNits == 0.0f)
+    {
+        m_imageCLL = { -1.0f, -1.0f };
+    }
+
+    // Certain HDR image types use recovered luminance and therefore are display/output-referred.
+    // You can't interpret the histogram for these images as physical nits; they are only useful
+    // to understand relative intensity.
+    if (m_imageInfo.hasAppleHdrGainMap == true)
+    {
+        m_imageCLL.isSceneReferred = false;
+    }
+    else
+    {
+        m_imageCLL.isSceneReferred = true;
+    }
+
+    // HDR metadata computation is completed before the app rendering options are known, so don't
+    // attempt to draw yet.
+}
 
+// Runs the Direct2D histogram effect on the downscaled image.
+// Performs Begin/EndDraw on the D2D context.
+HistogramCLL HDRImageViewerRenderer::ComputeHistogramGpu()
+{
     auto ctx = m_deviceResources->GetD2DDeviceContext();
 
     // Histogram rendering should always occur without DPI scaling
@@ -919,61 +1056,52 @@ void HDRImageViewerRenderer::ComputeHdrMetadata()
         IFT(hr);
     }
 
-    float *histogramData = new float[sc_histNumBins];
+    std::vector<float> histogramData(sc_histNumBins);
     IFT(m_histogramEffect->GetValue(D2D1_HISTOGRAM_PROP_HISTOGRAM_OUTPUT,
-            reinterpret_cast<BYTE*>(histogramData),
+            reinterpret_cast<BYTE*>(histogramData.data()),
             sc_histNumBins * sizeof(float)
             )
         );
 
-    unsigned int maxCLLbin = 0;
-    unsigned int avgCLLbin = 0; // Average is defined as 50th percentile.
-    float runningSum = 0.0f; // Cumulative sum of values in histogram is 1.0.
-    for (int i = sc_histNumBins - 1; i >= 0; i--)
-    {
-        runningSum += histogramData[i];
+    return LuminanceHistogram::ComputeCLL(histogramData.data());
+}
 
-        // Note the inequality (<) is the opposite of the next if block.
-        if (runningSum < 1.0f - maxCLLPercent)
-        {
-            maxCLLbin = i;
-        }
+// Used when the GPU does not support the Direct2D histogram effect. Reads back the full resolution
+// image in tiles and histograms it on the CPU; this is exact as no downscale is needed.
+// Performs Begin/EndDraw on the D2D context.
+HistogramCLL HDRImageViewerRenderer::ComputeHistogramCpu()
+{
+    // The histogram input is the same as the GPU path: after color management and the gain map merge,
+    // but at 1:1 scale instead of the current zoom.
+    ComPtr<ID2D1TransformedImageSource> fullResImage;
+    fullResImage.Attach(m_imageLoader->GetLoadedImage(1.0f, false));
+    m_colorManagementEffect->SetInput(0, fullResImage.Get());
 
-        if (runningSum > 0.5f)
-        {
-            // Note if the entire histogram is 0, avgCLLbin remains at -1.
-            avgCLLbin = i;
-            break;
-        }
+    ComPtr<ID2D1TransformedImageSource> fullResGainMap;
+    if (m_imageInfo.hasAppleHdrGainMap == true)
+    {
+        fullResGainMap.Attach(m_imageLoader->GetLoadedImage(1.0f, true));
+        m_gainmapLinearEffect->SetInput(0, fullResGainMap.Get());
     }
 
-    float binNormMax = static_cast<float>(maxCLLbin) / static_cast<float>(sc_histNumBins);
-    m_imageCLL.maxNits = powf(binNormMax, 1 / sc_histGamma) * sc_histMaxNits;
+    ComPtr<ID2D1Image> image;
+    m_gainMapMergeEffect->GetOutput(&image);
 
-    float binNormAvg = static_cast<float>(avgCLLbin) / static_cast<float>(sc_histNumBins);
-    m_imageCLL.medianNits = powf(binNormAvg, 1 / sc_histGamma) * sc_histMaxNits;
+    auto size = D2D1::SizeU(
+        static_cast<UINT32>(m_imageInfo.pixelSize.Width),
+        static_cast<UINT32>(m_imageInfo.pixelSize.Height));
 
-    // Some drivers have a bug where histogram will always return 0. Or some images are pure black.
-    // Treat these cases as unknown.
-    if (m_imageCLL.maxNits == 0.0f)
+    LuminanceHistogram histogram;
+    ImageExporter::ForEachImageTile(m_deviceResources.get(), image.Get(), size,
+        [&histogram](const DirectX::PackedVector::XMHALF4* pixels, unsigned int pitch, unsigned int width, unsigned int height)
     {
-        m_imageCLL = { -1.0f, -1.0f };
-    }
+        histogram.Merge(LuminanceHistogram::Compute(pixels, width, height, pitch));
+    });
 
-    // Certain HDR image types use recovered luminance and therefore are display/output-referred.
-    // You can't interpret the histogram for these images as physical nits; they are only useful
-    // to understand relative intensity.
-    if (m_imageInfo.hasAppleHdrGainMap == true)
-    {
-        m_imageCLL.isSceneReferred = false;
-    }
-    else
-    {
-        m_imageCLL.isSceneReferred = true;
-    }
+    // Restore the zoomed image sources.
+    UpdateImageTransformState();
 
-    // HDR metadata computation is completed before the app rendering options are known, so don't
-    // attempt to draw yet.
+    return histogram.ComputeCLL();
 }
 
 // Set HDR10 metadata to allow HDR displays to optimize behavior based on our content.
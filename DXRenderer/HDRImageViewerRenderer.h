@@ -13,9 +13,12 @@
 #include "RenderEffects\LuminanceHeatmapEffect.h"
 #include "RenderEffects\SphereMapEffect.h"
 #include "RenderEffects\MaxLuminanceEffect.h"
+#include "RenderEffects\GamutCompressionEffect.h"
 #include "RenderOptions.h"
 #include "ImageLoader.h"
+#include "DecodedImageCache.h"
 #include "Matrix.h"
+#include "CpuRender\LuminanceHistogram.h"
 
 namespace DXRenderer
 {
@@ -64,11 +67,28 @@ namespace DXRenderer
             bool constrainGamut
             );
 
-        ImageInfo LoadImageFromWic(_In_ Windows::Storage::Streams::IRandomAccessStream^ imageStream, ImageLoaderOptions options);
-        ImageInfo LoadImageFromDirectXTex(_In_ Platform::String^ filename, _In_ Platform::String^ extension, ImageLoaderOptions options);
+        // Successfully loaded images are added to the decoded image cache under cacheKey.
+        // imageFile is the file imageStream was opened from, if any; HEIF files are memory-mapped through it.
+        // For DirectXTex, filename is a copy in the app's temporary folder, deleted once its decoded image is released.
+        ImageInfo LoadImageFromWic(_In_opt_ Windows::Storage::StorageFile^ imageFile, _In_ Windows::Storage::Streams::IRandomAccessStream^ imageStream, ImageLoaderOptions options, ImageCacheKey cacheKey);
+        ImageInfo LoadImageFromDirectXTex(_In_ Platform::String^ filename, _In_ Platform::String^ extension, ImageLoaderOptions options, ImageCacheKey cacheKey);
+
+        // Returns ImageInfo::isValid == false if the image isn't cached, including while it is being prefetched.
+        ImageInfo LoadImageFromCache(ImageCacheKey cacheKey, ImageLoaderOptions options);
+
+        // Completes once the image is no longer being prefetched, without blocking the calling thread.
+        Windows::Foundation::IAsyncAction^ WaitForImagePrefetchAsync(ImageCacheKey cacheKey, ImageLoaderOptions options);
+
+        // Decodes an image into the cache in the background, e.g. the next image in the folder.
+        void      PrefetchImageFromWic(_In_opt_ Windows::Storage::StorageFile^ imageFile, _In_ Windows::Storage::Streams::IRandomAccessStream^ imageStream, ImageLoaderOptions options, ImageCacheKey cacheKey);
+        void      PrefetchImageFromDirectXTex(_In_ Platform::String^ filename, _In_ Platform::String^ extension, ImageLoaderOptions options, ImageCacheKey cacheKey);
+        bool      IsImageCached(ImageCacheKey cacheKey, ImageLoaderOptions options);
+        void      SetImageCacheBudget(uint64 budgetBytes);
+
         void      ExportImageToSdr(_In_ Windows::Storage::Streams::IRandomAccessStream^ outputStream, Platform::Guid wicFormat);
         void      ExportAsDdsTest(_In_ Windows::Storage::Streams::IRandomAccessStream^ outputStream);
         void      ExportImageToJxr(_In_ Windows::Storage::Streams::IRandomAccessStream^ outputStream);
+        void      ExportImageToDds(_In_ Windows::Storage::Streams::IRandomAccessStream^ outputStream, float quality);
 
         // IDeviceNotify methods handle device lost and restored.
         virtual void OnDeviceLost();
@@ -88,14 +108,18 @@ namespace DXRenderer
         void UpdateWhiteLevelScale(float brightnessAdjustment, float sdrWhiteLevel);
         void UpdateImageTransformState();
         void ComputeHdrMetadata();
+        HistogramCLL ComputeHistogramGpu();
+        HistogramCLL ComputeHistogramCpu();
         void EmitHdrMetadata();
         void UpdateGamutTransforms();
+        ImageInfo SetImageLoader(const std::shared_ptr<ImageLoader>& loader, const ImageInfo& info);
 
         float GetBestDispMaxLuminance();
 
         // Cached pointer to device resources.
         std::shared_ptr<DeviceResources>                        m_deviceResources;
-        std::unique_ptr<ImageLoader>                            m_imageLoader;
+        std::shared_ptr<ImageLoader>                            m_imageLoader; // May also be held by m_imageCache.
+        std::unique_ptr<DecodedImageCache>                      m_imageCache;
 
         // WIC and Direct2D resources.
         Microsoft::WRL::ComPtr<ID2D1TransformedImageSource>     m_loadedImage;
@@ -113,8 +137,7 @@ namespace DXRenderer
         Microsoft::WRL::ComPtr<ID2D1Effect>                     m_sphereMapEffect;
         Microsoft::WRL::ComPtr<ID2D1Effect>                     m_histogramPrescale;
         Microsoft::WRL::ComPtr<ID2D1Effect>                     m_histogramEffect;
-        Microsoft::WRL::ComPtr<ID2D1Effect>                     m_mapGamutToPanel;
-        Microsoft::WRL::ComPtr<ID2D1Effect>                     m_mapGamutToScRGB;
+        Microsoft::WRL::ComPtr<ID2D1Effect>                     m_gamutCompressionEffect;
         Microsoft::WRL::ComPtr<ID2D1Effect>                     m_finalOutput;
 
         std::vector<float>                                      m_renderTargetCpuPixels;
@@ -0,0 +1,241 @@
+//*********************************************************
+//
+// HeifTileDecoder
+//
+// See HeifTileDecoder.h. The grid layout comes from parsing
+// the file ourselves (HeifGridParser), then each tile is got
+// by its item ID from the worker's context and decoded as an
+// image of its own. Tiles are handed out one at a time because
+// their decode cost varies with content.
+//
+//*********************************************************
+
+#include "pch.h"
+#include "HeifTileDecoder.h"
+#include "CpuRender\HeifGridParser.h"
+#include "CpuRender\ParallelFor.h"
+
+#include <atomic>
+
+using namespace DXRenderer;
+
+namespace
+{
+    HRESULT HeifToHResult(const heif_error& herr)
+    {
+        return herr.code == heif_error_Ok ? S_OK : WINCODEC_ERR_GENERIC_ERROR;
+    }
+
+    /// <summary>
+    /// Tile columns or rows [first, last) covering [start, start + length) of an axis.
+    /// </summary>
+    void GetTileSpan(uint32_t start, uint32_t length, uint32_t tileSize, uint32_t tileCount, uint32_t& first, uint32_t& last)
+    {
+        first = (std::min)(start / tileSize, tileCount);
+        last = (std::min)(static_cast<uint32_t>((static_cast<uint64_t>(start) + length + tileSize - 1) / tileSize), tileCount);
+    }
+
+    /// <summary>
+    /// heif_reader over the bytes of a HEIF file that clears the hidden flag of a grid's tiles
+    /// as libheif reads their infe boxes. Keeps its own read position, so each heif_context
+    /// needs one of its own.
+    /// </summary>
+    class UnhiddenTileReader
+    {
+    public:
+        UnhiddenTileReader(const CHeifFileData& file, const std::vector<uint64_t>& hiddenFlagOffsets) :
+            m_file(file), m_hiddenFlagOffsets(hiddenFlagOffsets), m_position(0) {}
+
+        static const heif_reader* GetReader()
+        {
+            static const heif_reader s_reader = { 1, &GetPosition, &Read, &Seek, &WaitForFileSize };
+            return &s_reader;
+        }
+
+    private:
+        static int64_t GetPosition(void* userdata)
+        {
+            return static_cast<UnhiddenTileReader*>(userdata)->m_position;
+        }
+
+        static int Read(void* data, size_t size, void* userdata)
+        {
+            auto reader = static_cast<UnhiddenTileReader*>(userdata);
+
+            uint64_t position = static_cast<uint64_t>(reader->m_position);
+            uint64_t fileSize = reader->m_file.GetSize();
+            if (position > fileSize || size > fileSize - position) return 1;
+
+            auto dest = static_cast<uint8_t*>(data);
+            memcpy(dest, reader->m_file.GetData() + position, size);
+
+            const auto& offsets = reader->m_hiddenFlagOffsets;
+            for (auto flag = std::lower_bound(offsets.begin(), offsets.end(), position);
+                flag != offsets.end() && *flag < position + size;
+                ++flag)
+            {
+                dest[*flag - position] &= ~1;
+            }
+
+            reader->m_position += static_cast<int64_t>(size);
+            return 0;
+        }
+
+        static int Seek(int64_t position, void* userdata)
+        {
+            auto reader = static_cast<UnhiddenTileReader*>(userdata);
+            if (position < 0 || static_cast<uint64_t>(position) > reader->m_file.GetSize()) return 1;
+
+            reader->m_position = position;
+            return 0;
+        }
+
+        // The whole file is always available.
+        static heif_reader_grow_status WaitForFileSize(int64_t targetSize, void* userdata)
+        {
+            auto reader = static_cast<UnhiddenTileReader*>(userdata);
+            return targetSize >= 0 && static_cast<uint64_t>(targetSize) <= reader->m_file.GetSize() ?
+                heif_reader_grow_status_size_reached :
+                heif_reader_grow_status_size_beyond_eof;
+        }
+
+        const CHeifFileData&                                    m_file;
+        const std::vector<uint64_t>&                            m_hiddenFlagOffsets;
+        int64_t                                                 m_position;
+    };
+
+    /// <summary>
+    /// A worker thread's own context on the file, opened when it decodes its first tile.
+    /// The context is declared after the reader it reads through, so it is freed first.
+    /// </summary>
+    struct TileWorker
+    {
+        TileWorker(const CHeifFileData& file, const std::vector<uint64_t>& hiddenFlagOffsets) :
+            reader(file, hiddenFlagOffsets) {}
+
+        UnhiddenTileReader                                      reader;
+        CHeifContext                                            context;
+    };
+
+    /// <summary>
+    /// libheif converts an image from Y'CbCr with its own nclx profile, or defaults without one.
+    /// Tiles only come out as they would in the whole image if they agree with the grid.
+    /// </summary>
+    bool HasSameColorConversion(const heif_color_profile_nclx* imageNclx, heif_image_handle* tile)
+    {
+        CHeifNclx tileNclx;
+        bool tileHasNclx = heif_image_handle_get_nclx_color_profile(tile, &tileNclx.ptr).code == heif_error_Ok;
+
+        if (!imageNclx || !tileHasNclx) return !imageNclx && !tileHasNclx;
+
+        return imageNclx->matrix_coefficients == tileNclx.ptr->matrix_coefficients &&
+            imageNclx->color_primaries == tileNclx.ptr->color_primaries &&
+            imageNclx->full_range_flag == tileNclx.ptr->full_range_flag;
+    }
+}
+
+HRESULT HeifTileDecoder::Decode(
+    const CHeifFileData& file,
+    heif_image_handle* image,
+    heif_colorspace colorspace,
+    heif_chroma chroma,
+    const HeifRect* region,
+    const HeifTileCallback& onTile,
+    unsigned int threadCount)
+{
+    HeifGrid grid;
+    if (!heif_image_handle_has_alpha_channel(image) &&
+        ParseHeifGrid(file.GetData(), file.GetSize(), heif_image_handle_get_item_id(image), grid) &&
+        grid.tileIds.size() > 1)
+    {
+        HeifRect bounds = { 0, 0, grid.outputWidth, grid.outputHeight };
+        if (region)
+        {
+            bounds.x = (std::min)(region->x, grid.outputWidth);
+            bounds.y = (std::min)(region->y, grid.outputHeight);
+            bounds.width = (std::min)(region->width, grid.outputWidth - bounds.x);
+            bounds.height = (std::min)(region->height, grid.outputHeight - bounds.y);
+        }
+
+        if (bounds.width == 0 || bounds.height == 0) return S_OK;
+
+        uint32_t firstColumn = 0, lastColumn = 0, firstRow = 0, lastRow = 0;
+        GetTileSpan(bounds.x, bounds.width, grid.tileWidth, grid.columns, firstColumn, lastColumn);
+        GetTileSpan(bounds.y, bounds.height, grid.tileHeight, grid.rows, firstRow, lastRow);
+
+        size_t columns = lastColumn - firstColumn;
+        size_t tileCount = columns * (lastRow - firstRow);
+
+        // Undefined and monochrome output are the coded planes, so only RGB depends on the profile.
+        CHeifNclx imageNclx;
+        bool convertsColor = colorspace != heif_colorspace_undefined && colorspace != heif_colorspace_monochrome;
+        if (convertsColor) heif_image_handle_get_nclx_color_profile(image, &imageNclx.ptr);
+
+        std::vector<std::unique_ptr<TileWorker>> workers(GetParallelForWorkerCount(0, tileCount, 1, threadCount));
+        std::atomic<HRESULT> callbackResult(S_OK);
+        std::atomic<bool> tileFailed(false);
+
+        ParallelForWorkers(0, tileCount, 1, threadCount, [&](size_t first, size_t last, unsigned int workerIndex)
+        {
+            auto& worker = workers[workerIndex];
+
+            for (size_t i = first; i < last && SUCCEEDED(callbackResult.load()) && !tileFailed; i++)
+            {
+                if (!worker)
+                {
+                    worker = std::make_unique<TileWorker>(file, grid.hiddenFlagOffsets);
+
+                    if (FAILED(HeifToHResult(heif_context_read_from_reader(
+                        worker->context.ptr, UnhiddenTileReader::GetReader(), &worker->reader, nullptr))))
+                    {
+                        tileFailed = true;
+                        break;
+                    }
+                }
+
+                uint32_t column = firstColumn + static_cast<uint32_t>(i % columns);
+                uint32_t row = firstRow + static_cast<uint32_t>(i / columns);
+
+                CHeifHandle tileHandle;
+                CHeifImage tile;
+                if (FAILED(HeifToHResult(heif_context_get_image_handle(
+                        worker->context.ptr, grid.tileIds[static_cast<size_t>(row) * grid.columns + column], &tileHandle.ptr))) ||
+                    (convertsColor && !HasSameColorConversion(imageNclx.ptr, tileHandle.ptr)) ||
+                    FAILED(HeifToHResult(heif_decode_image(tileHandle.ptr, &tile.ptr, colorspace, chroma, nullptr))))
+                {
+                    tileFailed = true;
+                    break;
+                }
+
+                HeifRect rect = { column * grid.tileWidth, row * grid.tileHeight, 0, 0 };
+                rect.width = (std::min)(grid.tileWidth, grid.outputWidth - rect.x);
+                rect.height = (std::min)(grid.tileHeight, grid.outputHeight - rect.y);
+
+                // Each worker decodes a tile of its own, so the callback must not fan out further.
+                HRESULT hr = onTile(tile.ptr, rect, 1);
+                if (FAILED(hr))
+                {
+                    HRESULT expected = S_OK;
+                    callbackResult.compare_exchange_strong(expected, hr);
+                }
+            }
+        });
+
+        if (FAILED(callbackResult.load())) return callbackResult.load();
+        if (!tileFailed) return S_OK;
+
+        // Otherwise libheif decodes the whole image below, overwriting any tiles already passed on.
+    }
+
+    CHeifImage whole;
+    HRESULT hr = HeifToHResult(heif_decode_image(image, &whole.ptr, colorspace, chroma, nullptr));
+    if (FAILED(hr)) return hr;
+
+    HeifRect rect = {
+        0,
+        0,
+        static_cast<unsigned int>(heif_image_handle_get_width(image)),
+        static_cast<unsigned int>(heif_image_handle_get_height(image)) };
+
+    return onTile(whole.ptr, rect, threadCount);
+}
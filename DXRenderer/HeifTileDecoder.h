@@ -0,0 +1,69 @@
+//*********************************************************
+//
+// HeifTileDecoder
+//
+// Decodes HEIF images with libheif, a tile at a time when the
+// image is a grid. iPhone and camera HEICs store the primary
+// image as a grid of 512x512 HEVC tiles, which libheif 1.12
+// decodes one after another and can't hand out one by one.
+//
+// Each worker thread opens a heif_context of its own on the
+// file's bytes, so that tiles are read and decoded without
+// sharing a context. Tiles are hidden items, and libheif 1.12
+// only gives out handles to top-level items, so the workers'
+// contexts read the file with the tiles' hidden flag cleared.
+//
+//*********************************************************
+
+#pragma once
+#include "pch.h"
+#include "LibHeifHelpers.h"
+
+#include <functional>
+
+namespace DXRenderer
+{
+    /// <summary>
+    /// Rectangle in image pixels.
+    /// </summary>
+    struct HeifRect
+    {
+        unsigned int                                            x;
+        unsigned int                                            y;
+        unsigned int                                            width;
+        unsigned int                                            height;
+    };
+
+    /// <summary>
+    /// Called once for each decoded tile, with the part of the image it covers (clipped to the
+    /// image, not to the requested region). The tile's planes start at the top left of rect.
+    /// </summary>
+    /// <param name="threadCount">Threads the callback may use itself: 1 when tiles are being
+    /// decoded concurrently, otherwise 0 (all hardware threads).</param>
+    using HeifTileCallback = std::function<HRESULT(heif_image* tile, const HeifRect& rect, unsigned int threadCount)>;
+
+    class HeifTileDecoder
+    {
+    public:
+        /// <summary>
+        /// Decodes the tiles of image that intersect region, or all of it if region is null,
+        /// on up to threadCount threads. onTile may be called concurrently and must only write
+        /// to the area of its own tile. Returns the first failure of libheif or onTile.
+        /// </summary>
+        /// <remarks>
+        /// Images that aren't grids, have alpha, or whose grid or tiles are rotated, mirrored or
+        /// cropped are decoded whole, as is any grid whose tiles libheif fails to decode one by one.
+        /// onTile is then called once for the whole image, whatever region is.
+        /// </remarks>
+        /// <param name="file">The file image was read from.</param>
+        /// <param name="threadCount">0 means use all hardware threads.</param>
+        static HRESULT Decode(
+            const CHeifFileData& file,
+            _In_ heif_image_handle* image,
+            heif_colorspace colorspace,
+            heif_chroma chroma,
+            _In_opt_ const HeifRect* region,
+            const HeifTileCallback& onTile,
+            unsigned int threadCount = 0);
+    };
+}
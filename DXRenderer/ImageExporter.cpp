@@ -3,6 +3,7 @@
 #include "ImageExporter.h"
 #include "MagicConstants.h"
 #include "RenderEffects\SimpleTonemapEffect.h"
+#include "CpuRender\ParallelFor.h"
 #include "DirectXTex.h"
 
 using namespace Microsoft::WRL;
@@ -10,6 +11,13 @@ using namespace Windows::Storage;
 
 using namespace DXRenderer;
 
+// BC block rows (4 pixel rows each) in each unit of work handed to a thread by ExportToCompressedDds.
+static const size_t sc_DdsBlockRowsPerBand = 16;
+
+// ExportToCompressedDds quality thresholds; the default is in between.
+static const float sc_DdsFastQuality = 0.25f;
+static const float sc_DdsBestQuality = 0.75f;
+
 ImageExporter::ImageExporter()
 {
     throw ref new Platform::NotImplementedException;
@@ -160,6 +168,125 @@ void ImageExporter::ExportToDds(IWICBitmap* bitmap, IStream* stream, DXGI_FORMAT
     IFT(written == blob.GetBufferSize() ? S_OK : E_FAIL);
 }
 
+/// <summary>
+/// Saves an image decoded by ImageLoader as a block compressed DDS: BC6H for FP16 (HDR) images,
+/// BC7 for integer images. Either is 1 byte per pixel, 1/8 the size of FP16 RGBA.
+/// </summary>
+/// <remarks>
+/// Pixel values are kept as they are, e.g. scRGB or sRGB gamma. BC6H is the signed variant so that
+/// negative scRGB values (colors outside sRGB) survive, but has no alpha channel; BC7 keeps
+/// premultiplied alpha and marks it in the header.
+/// Bands of block rows are read from source one at a time and compressed in parallel.
+/// </remarks>
+/// <param name="quality">0 to 1, trading encode time for quality; only affects BC7. Default (-1)
+/// uses DirectXTex's default mode search.</param>
+/// <param name="threadCount">0 means use all hardware threads.</param>
+void ImageExporter::ExportToCompressedDds(IWICBitmapSource* source, IStream* stream, float quality, unsigned int threadCount)
+{
+    UINT width = 0, height = 0;
+    IFT(source->GetSize(&width, &height));
+
+    WICPixelFormatGUID wicFmt = {};
+    IFT(source->GetPixelFormat(&wicFmt));
+
+    DirectX::TexMetadata metadata = {};
+    metadata.width = width;
+    metadata.height = height;
+    metadata.depth = metadata.arraySize = metadata.mipLevels = 1;
+    metadata.dimension = DirectX::TEX_DIMENSION_TEXTURE2D;
+
+    DXGI_FORMAT sourceFmt = DXGI_FORMAT_UNKNOWN;
+    if (wicFmt == GUID_WICPixelFormat64bppPRGBAHalf)
+    {
+        sourceFmt = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        metadata.format = DXGI_FORMAT_BC6H_SF16;
+        metadata.SetAlphaMode(DirectX::TEX_ALPHA_MODE_OPAQUE);
+    }
+    else if (wicFmt == GUID_WICPixelFormat64bppPRGBA || wicFmt == GUID_WICPixelFormat32bppPBGRA)
+    {
+        sourceFmt = (wicFmt == GUID_WICPixelFormat32bppPBGRA) ? DXGI_FORMAT_B8G8R8A8_UNORM : DXGI_FORMAT_R16G16B16A16_UNORM;
+        metadata.format = DXGI_FORMAT_BC7_UNORM;
+        metadata.SetAlphaMode(DirectX::TEX_ALPHA_MODE_PREMULTIPLIED);
+    }
+    else
+    {
+        // Includes HDR10, which would first need to be linearized.
+        IFT(WINCODEC_ERR_UNSUPPORTEDPIXELFORMAT);
+    }
+
+    DirectX::TEX_COMPRESS_FLAGS flags = DirectX::TEX_COMPRESS_DEFAULT;
+    if (quality >= 0.0f && quality < sc_DdsFastQuality)
+    {
+        flags = DirectX::TEX_COMPRESS_BC7_QUICK;
+    }
+    else if (quality >= sc_DdsBestQuality)
+    {
+        flags = DirectX::TEX_COMPRESS_BC7_USE_3SUBSETS;
+    }
+
+    size_t headerSize = 0;
+    IFT(DirectX::EncodeDDSHeader(metadata, DirectX::DDS_FLAGS_NONE, nullptr, 0, headerSize));
+
+    size_t blockRows = (height + 3) / 4;
+    size_t blockRowBytes = (width + 3) / 4 * 16; // 16 bytes per 4x4 block for BC6H and BC7.
+    std::vector<uint8_t> output(headerSize + blockRowBytes * blockRows);
+    IFT(DirectX::EncodeDDSHeader(metadata, DirectX::DDS_FLAGS_NONE, output.data(), headerSize, headerSize));
+
+    size_t sourceStride = width * (DirectX::BitsPerPixel(sourceFmt) / 8);
+
+    // Each worker reuses one band of source pixels.
+    unsigned int numWorkers = GetParallelForWorkerCount(0, blockRows, sc_DdsBlockRowsPerBand, threadCount);
+    std::vector<std::vector<uint8_t>> bands(numWorkers);
+    std::mutex sourceLock;
+
+    ParallelForWorkers(0, blockRows, sc_DdsBlockRowsPerBand, threadCount, [&](size_t first, size_t last, unsigned int worker)
+    {
+        UINT y = static_cast<UINT>(first * 4);
+        UINT rows = (std::min)(static_cast<UINT>(last * 4), height) - y;
+
+        auto& band = bands[worker];
+        band.resize(sourceStride * rows);
+
+        {
+            // WIC doesn't guarantee bitmap sources are free threaded.
+            std::lock_guard<std::mutex> lock(sourceLock);
+
+            WICRect rect = { 0, static_cast<INT>(y), static_cast<INT>(width), static_cast<INT>(rows) };
+            IFT(source->CopyPixels(&rect, static_cast<UINT>(sourceStride), static_cast<UINT>(band.size()), band.data()));
+        }
+
+        DirectX::Image image = {};
+        image.width = width;
+        image.height = rows;
+        image.format = sourceFmt;
+        image.rowPitch = sourceStride;
+        image.slicePitch = band.size();
+        image.pixels = band.data();
+
+        // Single threaded; the bands already keep every thread busy.
+        DirectX::ScratchImage compressed;
+        IFT(DirectX::Compress(image, metadata.format, flags, DirectX::TEX_THRESHOLD_DEFAULT, compressed));
+
+        size_t bandBytes = (last - first) * blockRowBytes;
+        IFT(compressed.GetPixelsSize() == bandBytes ? S_OK : E_UNEXPECTED);
+
+        memcpy(output.data() + headerSize + first * blockRowBytes, compressed.GetPixels(), bandBytes);
+    });
+
+    // IStream::Write takes at most 4 GB at a time.
+    for (size_t offset = 0; offset < output.size();)
+    {
+        ULONG chunk = static_cast<ULONG>((std::min)(output.size() - offset, size_t(UINT32_MAX)));
+        ULONG written = 0;
+        IFT(stream->Write(output.data() + offset, chunk, &written));
+        IFT(written == chunk ? S_OK : E_FAIL);
+
+        offset += chunk;
+    }
+
+    IFT(stream->Commit(STGC_DEFAULT));
+}
+
 /// <summary>
 /// Encodes a buffer of pixels to a PNG in the target stream.
 /// </summary>
@@ -274,6 +401,74 @@ std::vector<float> ImageExporter::DumpImageToRGBFloat(_In_ DeviceResources* res,
     return pixels;
 }
 
+/// <summary>
+/// Renders an image in tiles and passes each tile's FP16 scRGB pixels to the callback.
+/// Unlike DumpImageToRGBFloat, this supports images larger than the maximum bitmap size
+/// and only holds one tile in memory at a time.
+/// </summary>
+/// <param name="callback">Pixels are premultiplied alpha. pitch is in bytes.</param>
+void ImageExporter::ForEachImageTile(_In_ DeviceResources* res, _In_ ID2D1Image* image, D2D1_SIZE_U size, const TileCallback& callback)
+{
+    auto ctx = res->GetD2DDeviceContext();
+
+    // 2048 x 2048 FP16 is 32 MB per tile.
+    unsigned int tileSize = min(2048u, ctx->GetMaximumBitmapSize());
+    D2D1_SIZE_U tileBitmapSize = D2D1::SizeU(min(tileSize, size.width), min(tileSize, size.height));
+
+    D2D1_BITMAP_PROPERTIES1 intermediateProps = {};
+    intermediateProps.pixelFormat = D2D1::PixelFormat(DXGI_FORMAT_R16G16B16A16_FLOAT, D2D1_ALPHA_MODE_PREMULTIPLIED);
+    intermediateProps.bitmapOptions = D2D1_BITMAP_OPTIONS_CANNOT_DRAW | D2D1_BITMAP_OPTIONS_TARGET;
+
+    ComPtr<ID2D1Bitmap1> intermediate;
+    IFT(ctx->CreateBitmap(tileBitmapSize, nullptr, 0, &intermediateProps, &intermediate));
+
+    D2D1_BITMAP_PROPERTIES1 props = {};
+    props.pixelFormat = D2D1::PixelFormat(DXGI_FORMAT_R16G16B16A16_FLOAT, D2D1_ALPHA_MODE_PREMULTIPLIED);
+    props.bitmapOptions = D2D1_BITMAP_OPTIONS_CANNOT_DRAW | D2D1_BITMAP_OPTIONS_CPU_READ;
+
+    ComPtr<ID2D1Bitmap1> staging;
+    IFT(ctx->CreateBitmap(tileBitmapSize, nullptr, 0, &props, &staging));
+
+    // Restored when this returns or throws.
+    CD2DTargetState savedState(ctx);
+
+    // Tiles are addressed in pixels.
+    ctx->SetTarget(intermediate.Get());
+    ctx->SetTransform(D2D1::Matrix3x2F::Identity());
+    ctx->SetDpi(96.0f, 96.0f);
+
+    for (unsigned int tileY = 0; tileY < size.height; tileY += tileSize)
+    {
+        for (unsigned int tileX = 0; tileX < size.width; tileX += tileSize)
+        {
+            unsigned int width = min(tileSize, size.width - tileX);
+            unsigned int height = min(tileSize, size.height - tileY);
+
+            ctx->BeginDraw();
+            ctx->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f));
+            ctx->DrawImage(image, D2D1::Point2F(-static_cast<float>(tileX), -static_cast<float>(tileY)));
+
+            // We ignore D2DERR_RECREATE_TARGET here. This error indicates that the device
+            // is lost. It will be handled during the next call to Present.
+            HRESULT hr = ctx->EndDraw();
+            if (hr != D2DERR_RECREATE_TARGET)
+            {
+                IFT(hr);
+            }
+
+            auto rect = D2D1::RectU(0, 0, width, height);
+            IFT(staging->CopyFromBitmap(&D2D1::Point2U(), intermediate.Get(), &rect));
+
+            D2D1_MAPPED_RECT mapped = {};
+            IFT(staging->Map(D2D1_MAP_OPTIONS_READ, &mapped));
+
+            callback(reinterpret_cast<const DirectX::PackedVector::XMHALF4*>(mapped.bits), mapped.pitch, width, height);
+
+            IFT(staging->Unmap());
+        }
+    }
+}
+
 /// <summary>
 /// Encodes to WIC using default encode options.
 /// </summary>
@@ -11,6 +11,9 @@
 #include "Common\DeviceResources.h"
 #include "ImageLoader.h"
 
+#include <DirectXPackedVector.h>
+#include <functional>
+
 namespace DXRenderer
 {
     /// <summary>
@@ -22,6 +25,37 @@ namespace DXRenderer
         ~CVariant() { VariantClear(this); }
     };
 
+    /// <summary>
+    /// RAII wrapper that restores a device context's target, transform and DPI when it goes
+    /// out of scope, including when drawing to an intermediate bitmap throws.
+    /// </summary>
+    class CD2DTargetState {
+    public:
+        CD2DTargetState(_In_ ID2D1DeviceContext* ctx) : m_ctx(ctx)
+        {
+            ctx->GetTarget(&m_target);
+            ctx->GetTransform(&m_transform);
+            ctx->GetDpi(&m_dpiX, &m_dpiY);
+        }
+
+        ~CD2DTargetState()
+        {
+            m_ctx->SetTarget(m_target.Get());
+            m_ctx->SetTransform(m_transform);
+            m_ctx->SetDpi(m_dpiX, m_dpiY);
+        }
+
+        CD2DTargetState(const CD2DTargetState&) = delete;
+        CD2DTargetState& operator=(const CD2DTargetState&) = delete;
+
+    private:
+        ID2D1DeviceContext*                                     m_ctx;
+        Microsoft::WRL::ComPtr<ID2D1Image>                      m_target;
+        D2D1_MATRIX_3X2_F                                       m_transform;
+        float                                                   m_dpiX;
+        float                                                   m_dpiY;
+    };
+
     class ImageExporter
     {
     public:
@@ -34,10 +68,16 @@ namespace DXRenderer
 
         static void ExportToDds(_In_ IWICBitmap* bitmap, _In_ IStream* stream, DXGI_FORMAT outputFmt);
 
+        static void ExportToCompressedDds(_In_ IWICBitmapSource* source, _In_ IStream* stream, float quality = -1.0f, unsigned int threadCount = 0);
+
         static void ExportPixels(_In_ IWICImagingFactory* fact, unsigned int pixelWidth, unsigned int pixelHeight, _In_ byte* buffer, unsigned int stride, unsigned int countBytes, WICPixelFormatGUID fmt, _In_ IStream* stream);
 
         static std::vector<float> DumpImageToRGBFloat(_In_ DeviceResources* res, _In_ ID2D1Image* image, D2D1_SIZE_U size);
 
+        typedef std::function<void(const DirectX::PackedVector::XMHALF4* pixels, unsigned int pitch, unsigned int width, unsigned int height)> TileCallback;
+
+        static void ForEachImageTile(_In_ DeviceResources* res, _In_ ID2D1Image* image, D2D1_SIZE_U size, const TileCallback& callback);
+
         static void ExportToWic(_In_ ID2D1Image* img, Windows::Foundation::Size size, _In_ DeviceResources* res, _In_ IStream* stream, GUID wicFormat, float quality = -1.0f);
     };
 }
@@ -3,6 +3,16 @@
 #include "Common\DirectXHelper.h"
 #include "DirectXTex.h"
 #include "DirectXTex\DirectXTexEXR.h"
+#include "DirectXTex\DirectXTexRGBE.h"
+#include "MagicConstants.h"
+#include "TiledWicBitmapSource.h"
+#include "HeifTileDecoder.h"
+#include "ImageStatistics.h"
+#include "CpuRender\JpegMpfParser.h"
+#include "CpuRender\ParallelFor.h"
+#include "CpuRender\YuvConverter.h"
+
+#include <future>
 
 using namespace DXRenderer;
 
@@ -14,6 +24,8 @@ using namespace Windows::Foundation;
 using namespace Windows::Graphics::Display;
 
 static const unsigned int sc_MaxBytesPerPixel = 16; // Covers all supported image formats (128bpp).
+static const size_t sc_DecompressBlockRowsPerBand = 16; // BC block rows (4 pixel rows each) decompressed by each unit of work in TryDecompressToBitmap.
+static const size_t sc_SwizzleRowsPerBand = 64; // Rows converted by each unit of work in TryLoadHeifSdr; more than sc_DefaultRowsPerBand as a row is only a copy.
 
 ImageLoader::ImageLoader(const std::shared_ptr<DeviceResources>& deviceResources, ImageLoaderOptions& options) :
     m_deviceResources(deviceResources),
@@ -21,6 +33,9 @@ ImageLoader::ImageLoader(const std::shared_ptr<DeviceResources>& deviceResources
     m_imageInfo{},
     m_customOrDerivedColorProfile{},
     m_options(options),
+    m_decodedByLibheif(false),
+    m_decodedSize{},
+    m_fileCLL{ -1.0f, -1.0f },
     // Data extracted from Xbox console HDR screen capture image
     m_xboxHdrIccSize(2676),
     m_xboxHdrIccHeaderBytes {
@@ -35,31 +50,7 @@ ImageLoader::ImageLoader(const std::shared_ptr<DeviceResources>& deviceResources
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-    },
-
-    // TODO: the APP2 MP Extensions block isn't guaranteed to be static, but
-    // assuming Apple doesn't change the format there should be basically no variation
-    // in these bytes apart from the 3 DWORDs of "dynamic bytes".
-    // Note that this APP2 block isn't really unique to Apple HDR gainmaps - it basically
-    // states there are two images, one primary and one unspecified secondary. The
-    // unspecified secondary type is the most unique and excludes things like stereo 3D images.
-    m_appleApp2MPBlock{
-        0xFF, 0xE2, 0x00, 0x58, 0x4D, 0x50, 0x46, 0x00, 0x4D, 0x4D, 0x00, 0x2A,
-        0x00, 0x00, 0x00, 0x08, 0x00, 0x03, 0xB0, 0x00, 0x00, 0x07, 0x00, 0x00,
-        0x00, 0x04, 0x30, 0x31, 0x30, 0x30, 0xB0, 0x01, 0x00, 0x04, 0x00, 0x00,
-        0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0xB0, 0x02, 0x00, 0x07, 0x00, 0x00,
-        0x00, 0x20, 0x00, 0x00, 0x00, 0x32, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
-        0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // All 0xFF's represent "dynamic bytes".
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-        0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00
-    },
-    // These bytes are expected to change from image to image so we exlude them from the memcmp.
-    m_appleApp2MPBlockDynamicBytes{
-        62, 63, 64, 65, // MPEntry 0: Count bytes of SOI to EOI (size of primary individual image)
-        78, 79, 80, 81, // MPEntry 1: Count bytes of SOI to EOI (size of gain map/second individual image)
-        82, 83, 84, 85  // MPEntry 1: Offset to SOI of second individual image
-    },
-    m_appleApp2MPBlockMagicOffset(62)
+    }
 {
 }
 
@@ -70,9 +61,11 @@ ImageLoader::~ImageLoader()
 /// <summary>
 /// Performs CPU-side decoding of an image using WIC and reads key image parameters.
 /// </summary>
-ImageInfo ImageLoader::LoadImageFromWic(_In_ IStream* imageStream)
+/// <param name="imageFile">Handle with read access to the file imageStream reads, or INVALID_HANDLE_VALUE.
+/// HEIF files are memory-mapped through it; without it they are copied from the stream.</param>
+ImageInfo ImageLoader::LoadImageFromWic(_In_ IStream* imageStream, _In_ HANDLE imageFile)
 {
-    LoadImageFromWicInt(imageStream);
+    LoadImageFromWicInt(imageStream, imageFile);
 
     return m_imageInfo;
 }
@@ -82,10 +75,54 @@ ImageInfo ImageLoader::LoadImageFromWic(_In_ IStream* imageStream)
 /// If any failure occurs during image loading, immediately exits with
 /// m_state and imageinfo set to failed.
 /// </summary>
-void ImageLoader::LoadImageFromWicInt(_In_ IStream* imageStream)
+void ImageLoader::LoadImageFromWicInt(_In_ IStream* imageStream, _In_ HANDLE imageFile)
 {
     EnforceStates(1, ImageLoaderState::NotInitialized);
 
+    // HEIF files are decoded by libheif, which parses the file in place: it is memory-mapped through
+    // imageFile rather than read from the stream. WIC is only used if libheif can't decode the image.
+    CHeifFileData heifFile;
+    CHeifContext heifContext;
+    CHeifHandle heifPrimary;
+    if (TryOpenHeif(imageStream, imageFile, heifFile, heifContext, heifPrimary))
+    {
+        m_imageInfo.isHeif = true;
+
+        ComPtr<IWICBitmap> heifBitmap;
+        if (TryLoadHeifHdr10(heifFile, heifPrimary.ptr, heifBitmap))
+        {
+            LoadHeifBitmap(heifBitmap.Get());
+            return;
+        }
+
+        // A heif_context reads coded data through a single unguarded position in the file, so the gain
+        // map is decoded from a second context on the same bytes, concurrently with the primary image.
+        // Only the boxes are parsed again.
+        CHeifContext gainMapContext;
+        CHeifHandle gainMapPrimary;
+        CHeifHandle gainMap;
+        std::future<bool> gainMapLoaded;
+        if (heif_image_handle_get_number_of_auxiliary_images(heifPrimary.ptr, 0) > 0 &&
+            TryReadHeif(heifFile, gainMapContext, gainMapPrimary) &&
+            TryGetAppleHdrGainMapHeic(gainMapPrimary.ptr, gainMap))
+        {
+            gainMapLoaded = std::async(std::launch::async, [&]() { return TryLoadAppleHdrGainMapHeic(gainMap.ptr); });
+        }
+
+        bool primaryLoaded = TryLoadHeifSdr(heifFile, heifPrimary.ptr, heifBitmap);
+
+        // NOTE: Pixel resolution check can't be done until the main image has been decoded (LoadImageCommon).
+        m_imageInfo.hasAppleHdrGainMap = gainMapLoaded.valid() && gainMapLoaded.get();
+
+        if (primaryLoaded)
+        {
+            LoadHeifBitmap(heifBitmap.Get());
+            return;
+        }
+
+        IFRIMG(imageStream->Seek({}, STREAM_SEEK_SET, nullptr));
+    }
+
     auto wicFactory = m_deviceResources->GetWicImagingFactory();
 
     // Decode the image using WIC.
@@ -112,6 +149,7 @@ void ImageLoader::LoadImageFromWicInt(_In_ IStream* imageStream)
 
         // HEIF/HEVC supports GUID_WICPixelFormat32bppR10G10B10A2HDR10.
         // We must specifically detect and request HDR10 via IWICBitmapSourceTransform.
+        // Only images libheif couldn't decode get here, e.g. AVIF.
         ComPtr<IWICBitmapSourceTransform> sourceTransform;
         IFRIMG(frame->QueryInterface(IID_PPV_ARGS(&sourceTransform)));
 
@@ -124,8 +162,7 @@ void ImageLoader::LoadImageFromWicInt(_In_ IStream* imageStream)
             m_imageInfo.forceBT2100ColorSpace = true;
         }
 
-        // NOTE: Pixel resolution check can't be done until the main image has been decoded (LoadImageCommon).
-        m_imageInfo.hasAppleHdrGainMap = TryLoadAppleHdrGainMapHeic(imageStream);
+        // Any Apple HDR gain map has already been loaded by libheif.
     }
     else if (fmt == GUID_ContainerFormatWmp)
     {
@@ -137,7 +174,7 @@ void ImageLoader::LoadImageFromWicInt(_In_ IStream* imageStream)
     }
     else if (fmt == GUID_ContainerFormatJpeg)
     {
-        m_imageInfo.hasAppleHdrGainMap = TryLoadAppleHdrGainMapJpegMpo(imageStream, frame.Get());
+        m_imageInfo.hasAppleHdrGainMap = TryLoadAppleHdrGainMapJpegMpo(imageStream);
     }
 
     LoadImageCommon(frame.Get());
@@ -168,46 +205,98 @@ void ImageLoader::LoadImageFromDirectXTexInt(String^ filename, String^ extension
 {
     EnforceStates(1, ImageLoaderState::NotInitialized);
 
+    // A reduced level is small enough to decode normally, even if the file is huge.
+    size_t mipLevel = SelectFittedMipLevel(filename, extension);
+
+    if (mipLevel == 0 && TryLoadTiledImage(filename, extension))
+    {
+        return;
+    }
+
     ComPtr<IWICBitmapSource> decodedSource;
 
-    auto dxtScratch = new ScratchImage();
+    // CreateBitmapFromMemory copies the pixels, so the DirectXTex images only need to live until then.
+    ScratchImage dxtScratch;
     auto filestr = filename->Data();
 
     if (extension == L".EXR" || extension == L".exr")
     {
-        EXRChromaticities exrChromaticities;
-        IFRIMG(LoadFromEXRFile(filestr, nullptr, &exrChromaticities, *dxtScratch));
-        if (exrChromaticities.Valid)
+        // Streamed a band at a time, so the HDR metadata is computed from the full resolution
+        // pixels as they are copied into place, without decoding the file twice.
+        EXRChromaticities exrChromaticities = {};
+        TexMetadata exrMetadata = {};
+        auto copyBand = [&](const Image& band, size_t firstRow)
         {
-            m_imageInfo.countColorProfiles = 1;
-            m_imageInfo.hasEXRChromaticitiesInfo = true;
-            m_customOrDerivedColorProfile.redPrimary = D2D1::Point2F(exrChromaticities.RedX, exrChromaticities.RedY);
-            m_customOrDerivedColorProfile.bluePrimary = D2D1::Point2F(exrChromaticities.BlueX, exrChromaticities.BlueY);
-            m_customOrDerivedColorProfile.greenPrimary = D2D1::Point2F(exrChromaticities.GreenX, exrChromaticities.GreenY);
-            m_customOrDerivedColorProfile.whitePointXZ = D2D1::Point2F(exrChromaticities.WhiteX, exrChromaticities.WhiteZ);
-            m_customOrDerivedColorProfile.gamma = D2D1_GAMMA1_G10; // OpenEXR is linear
+            if (!dxtScratch.GetPixels())
+            {
+                HRESULT hr = dxtScratch.Initialize2D(exrMetadata.format, exrMetadata.width, exrMetadata.height, 1, 1);
+                if (FAILED(hr)) return hr;
+            }
+
+            auto dest = dxtScratch.GetImage(0, 0, 0);
+            for (size_t y = 0; y < band.height; y++)
+            {
+                memcpy(dest->pixels + (firstRow + y) * dest->rowPitch, band.pixels + y * band.rowPitch, min(band.rowPitch, dest->rowPitch));
+            }
+
+            return S_OK;
+        };
+
+        HistogramCLL exrCLL = {};
+        IFRIMG(ScanExrFileCLL(filestr, &exrMetadata, &exrChromaticities, exrCLL, 0, copyBand));
+        SetEXRChromaticities(exrChromaticities);
+
+        // Overrides change the color space the histogram has to be computed in.
+        if (m_options.type == ImageLoaderOptionsType::NoOverrides)
+        {
+            m_fileCLL = exrCLL;
         }
     }
     else if (extension == L".HDR" || extension == L".hdr")
     {
-        IFRIMG(LoadFromHDRFile(filestr, nullptr, *dxtScratch));
+        // Kept packed as RGBE; rows are expanded to FP16 as Direct2D reads them.
+        TexMetadata hdrMetadata = {};
+        vector<uint8_t> rgbe;
+        IFRIMG(LoadFromRGBEFile(filestr, &hdrMetadata, nullptr, rgbe));
+
+        auto hdrWidth = static_cast<unsigned int>(hdrMetadata.width);
+        auto hdrHeight = static_cast<unsigned int>(hdrMetadata.height);
+
+        IFRIMG(RgbeBitmapSource::Create(hdrWidth, hdrHeight, std::move(rgbe), &m_rgbeSource));
+
+        LoadImageCommon(m_rgbeSource.Get());
+
+        // 16 bpc is not strictly accurate but best preserves the intent of RGBE.
+        m_imageInfo.bitsPerPixel = 32;
+        m_imageInfo.bitsPerChannel = 16;
+
+        return;
     }
     else
     {
-        IFRIMG(LoadFromDDSFile(filestr, DDS_FLAGS_NONE, nullptr, *dxtScratch));
+        IFRIMG(LoadFromDDSFile(filestr, DDS_FLAGS_NONE, nullptr, dxtScratch));
     }
 
-    auto image = dxtScratch->GetImage(0, 0, 0); // Always get the first image.
+    auto image = dxtScratch.GetImage(mipLevel, 0, 0); // Always the first array slice.
 
     // Decompress if the image uses block compression. This does not use WIC and Direct2D's
     // native support for BC1, BC2, and BC3 formats.
-    auto decompScratch = new ScratchImage();
+    ScratchImage decompScratch;
     if (DirectX::IsCompressed(image->format))
     {
-        IFRIMG(DirectX::Decompress(*image, DXGI_FORMAT_UNKNOWN, *decompScratch));
+        ComPtr<IWICBitmap> decompBitmap;
+        WICPixelFormatGUID nativeFmt = {};
+        if (TryDecompressToBitmap(*image, decompBitmap, nativeFmt))
+        {
+            LoadImageCommon(decompBitmap.Get(), &nativeFmt);
+            SetFullResolutionSize(dxtScratch.GetMetadata());
+            return;
+        }
+
+        IFRIMG(DirectX::Decompress(*image, DXGI_FORMAT_UNKNOWN, decompScratch));
 
         // Memory for each Image is managed by ScratchImage.
-        image = decompScratch->GetImage(0, 0, 0);
+        image = decompScratch.GetImage(0, 0, 0);
     }
 
     GUID wicFmt = TranslateDxgiFormatToWic(image->format);
@@ -227,22 +316,269 @@ void ImageLoader::LoadImageFromDirectXTexInt(String^ filename, String^ extension
         &dxtWicBitmap));
 
     LoadImageCommon(dxtWicBitmap.Get());
+    SetFullResolutionSize(dxtScratch.GetMetadata());
+}
 
-    // TODO: Common code to check file type?
-    if (extension == L".HDR" || extension == L".hdr")
+/// <summary>
+/// If ImageLoaderOptions::fitSize is set, picks the mip level of a DDS file that FitImageToWindow
+/// would draw, so only that level needs to be decompressed.
+/// </summary>
+/// <returns>0 (the full resolution image) if the option is off or the file has no mips.</returns>
+size_t ImageLoader::SelectFittedMipLevel(String^ filename, String^ extension)
+{
+    if ((extension != L".DDS" && extension != L".dds") ||
+        m_options.fitSize.Width <= 0.0f || m_options.fitSize.Height <= 0.0f)
     {
-        // Manually fix up Radiance RGBE image file bit depth as DirectXTex expands it to 128bpp.
-        // 16 bpc is not strictly accurate but best preserves the intent of RGBE.
-        m_imageInfo.bitsPerPixel = 32;
-        m_imageInfo.bitsPerChannel = 16;
+        return 0;
+    }
+
+    TexMetadata metadata = {};
+    if (FAILED(GetMetadataFromDDSFile(filename->Data(), DDS_FLAGS_NONE, metadata)) ||
+        metadata.dimension != TEX_DIMENSION_TEXTURE2D || metadata.mipLevels <= 1)
+    {
+        return 0;
     }
+
+    // Same letterboxing as FitImageToWindow.
+    float zoom = min(sc_MaxZoom, min(
+        m_options.fitSize.Width / static_cast<float>(metadata.width),
+        m_options.fitSize.Height / static_cast<float>(metadata.height)));
+
+    return MipPyramid::SelectLevel(zoom, static_cast<unsigned int>(metadata.mipLevels - 1));
+}
+
+/// <summary>
+/// Reports the size of the file's full resolution image in ImageInfo after a reduced mip level was
+/// decoded, so zoom limits and layout don't depend on fitSize. GetLoadedImage scales the level up.
+/// </summary>
+void ImageLoader::SetFullResolutionSize(const TexMetadata& metadata)
+{
+    if (m_state == ImageLoaderState::LoadingFailed) return;
+
+    m_imageInfo.pixelSize = Size(static_cast<float>(metadata.width), static_cast<float>(metadata.height));
+}
+
+/// <summary>
+/// Decompresses a BC image straight into an IWICBitmap in the format LoadImageCommon keeps,
+/// splitting block rows across threads. Avoids both a full size decompressed copy and a
+/// WIC format conversion pass.
+/// </summary>
+/// <param name="nativeFormat">What the pixels would have decompressed to by default, for ImageInfo.</param>
+/// <returns>false for formats this doesn't handle, which are decompressed the usual way.</returns>
+bool ImageLoader::TryDecompressToBitmap(const Image& image, ComPtr<IWICBitmap>& bitmap, WICPixelFormatGUID& nativeFormat)
+{
+    // Matches DirectX::Decompress with DXGI_FORMAT_UNKNOWN, and then LoadImageCommon's choice of format.
+    DXGI_FORMAT defaultFmt = DXGI_FORMAT_UNKNOWN;
+    DXGI_FORMAT bandFmt = DXGI_FORMAT_UNKNOWN;
+    WICPixelFormatGUID bitmapFmt = {};
+
+    switch (image.format)
+    {
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+        // Always opaque, so already premultiplied.
+        defaultFmt = bandFmt = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        bitmapFmt = GUID_WICPixelFormat64bppPRGBAHalf;
+        break;
+
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC7_UNORM:
+        defaultFmt = DXGI_FORMAT_R8G8B8A8_UNORM;
+        bandFmt = DXGI_FORMAT_B8G8R8A8_UNORM;
+        bitmapFmt = GUID_WICPixelFormat32bppPBGRA;
+        break;
+
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        // Both sRGB, so DirectXTex doesn't convert the values.
+        defaultFmt = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+        bandFmt = DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+        bitmapFmt = GUID_WICPixelFormat32bppPBGRA;
+        break;
+
+    default:
+        return false;
+    }
+
+    nativeFormat = TranslateDxgiFormatToWic(defaultFmt);
+
+    auto width = static_cast<UINT>(image.width);
+    auto height = static_cast<UINT>(image.height);
+
+    auto fact = m_deviceResources->GetWicImagingFactory();
+    IFRF(fact->CreateBitmap(width, height, bitmapFmt, WICBitmapCacheOnLoad, &bitmap));
+
+    ComPtr<IWICBitmapLock> lock;
+    IFRF(bitmap->Lock({}, WICBitmapLockWrite, &lock));
+
+    UINT lockStride = 0, lockSize = 0;
+    WICInProcPointer lockData = nullptr;
+    IFRF(lock->GetStride(&lockStride));
+    IFRF(lock->GetDataPointer(&lockSize, &lockData));
+
+    size_t bytesPerPixel = BitsPerPixel(bandFmt) / 8;
+    size_t blockRows = (image.height + 3) / 4;
+    std::atomic<HRESULT> result = S_OK;
+
+    ParallelFor(0, blockRows, sc_DecompressBlockRowsPerBand, 0, [&](size_t first, size_t last)
+    {
+        size_t y = first * 4;
+
+        Image band = image;
+        band.height = (std::min)(last * 4, image.height) - y;
+        band.pixels = image.pixels + first * image.rowPitch;
+        band.slicePitch = (last - first) * image.rowPitch;
+
+        // Only a band's worth of pixels is decompressed at once, then copied into place.
+        ScratchImage decompressed;
+        HRESULT hr = DirectX::Decompress(band, bandFmt, decompressed);
+        if (FAILED(hr))
+        {
+            result = hr;
+            return;
+        }
+
+        auto decompImage = decompressed.GetImage(0, 0, 0);
+        for (size_t row = 0; row < band.height; row++)
+        {
+            uint8_t* dest = lockData + (y + row) * lockStride;
+            memcpy(dest, decompImage->pixels + row * decompImage->rowPitch, width * bytesPerPixel);
+
+            if (bytesPerPixel == 4)
+            {
+                // Premultiply the same way WIC's 32bppRGBA to 32bppPBGRA converter does: in the
+                // gamma encoded values.
+                for (UINT x = 0; x < width; x++)
+                {
+                    uint8_t* pixel = dest + x * 4;
+                    unsigned int alpha = pixel[3];
+                    if (alpha != 255)
+                    {
+                        pixel[0] = static_cast<uint8_t>((pixel[0] * alpha + 127) / 255);
+                        pixel[1] = static_cast<uint8_t>((pixel[1] * alpha + 127) / 255);
+                        pixel[2] = static_cast<uint8_t>((pixel[2] * alpha + 127) / 255);
+                    }
+                }
+            }
+        }
+    });
+
+    IFRF(result.load());
+
+    return true;
+}
+
+/// <summary>
+/// Loads OpenEXR and DDS images whose decoded size would be at least sc_TiledImageMinBytes
+/// through TiledImageStore, so the pixels stay in the file until they are drawn.
+/// </summary>
+/// <returns>false if the image should be loaded normally instead; nothing has been changed.</returns>
+bool ImageLoader::TryLoadTiledImage(String^ filename, String^ extension)
+{
+    auto filestr = filename->Data();
+
+    shared_ptr<TiledImageStore> store;
+    EXRChromaticities exrChromaticities = {};
+    DXGI_FORMAT decodedFmt = DXGI_FORMAT_UNKNOWN;
+
+    if (extension == L".EXR" || extension == L".exr")
+    {
+        IFRF(TiledImageStore::OpenEXR(filestr, sc_TileCacheBudgetBytes, store, &exrChromaticities));
+        decodedFmt = DXGI_FORMAT_R16G16B16A16_FLOAT;
+    }
+    else if (extension == L".DDS" || extension == L".dds")
+    {
+        DXGI_FORMAT fileFmt = DXGI_FORMAT_UNKNOWN;
+        IFRF(TiledImageStore::OpenDDS(filestr, sc_TileCacheBudgetBytes, store, &fileFmt));
+
+        // Formats the untiled path can display, after it decompresses to the default format.
+        switch (fileFmt)
+        {
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            decodedFmt = DXGI_FORMAT_R16G16B16A16_FLOAT;
+            break;
+
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            decodedFmt = DXGI_FORMAT_R32G32B32A32_FLOAT;
+            break;
+
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+            decodedFmt = DXGI_FORMAT_R8G8B8A8_UNORM;
+            break;
+
+        default:
+            return false;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    uint64_t decodedBytes = uint64_t(store->GetWidth(0)) * store->GetHeight(0) * sizeof(DirectX::PackedVector::XMHALF4);
+    if (decodedBytes < sc_TiledImageMinBytes)
+    {
+        return false;
+    }
+
+    WICPixelFormatGUID nativeFmt = TranslateDxgiFormatToWic(decodedFmt);
+    bool isFloat = FormatDataType(decodedFmt) == FORMAT_TYPE_FLOAT;
+
+    ComPtr<IWICBitmapSource> source;
+    IFRF(TiledWicBitmapSource::Create(store, 0, isFloat, &source));
+
+    m_tiledStore = store;
+    SetEXRChromaticities(exrChromaticities);
+
+    LoadImageCommon(source.Get(), &nativeFmt);
+
+    return true;
+}
+
+void ImageLoader::SetEXRChromaticities(const EXRChromaticities& chromaticities)
+{
+    if (chromaticities.Valid)
+    {
+        m_imageInfo.countColorProfiles = 1;
+        m_imageInfo.hasEXRChromaticitiesInfo = true;
+        m_customOrDerivedColorProfile.redPrimary = D2D1::Point2F(chromaticities.RedX, chromaticities.RedY);
+        m_customOrDerivedColorProfile.bluePrimary = D2D1::Point2F(chromaticities.BlueX, chromaticities.BlueY);
+        m_customOrDerivedColorProfile.greenPrimary = D2D1::Point2F(chromaticities.GreenX, chromaticities.GreenY);
+        m_customOrDerivedColorProfile.whitePointXZ = D2D1::Point2F(chromaticities.WhiteX, chromaticities.WhiteZ);
+        m_customOrDerivedColorProfile.gamma = D2D1_GAMMA1_G10; // OpenEXR is linear
+    }
+}
+
+/// <summary>
+/// Common setup for a bitmap decoded by libheif, see TryLoadHeifHdr10 and TryLoadHeifSdr.
+/// </summary>
+void ImageLoader::LoadHeifBitmap(_In_ IWICBitmapSource* bitmap)
+{
+    m_decodedByLibheif = true;
+    LoadImageCommon(bitmap);
 }
 
 /// <summary>
 /// After initial decode, obtains image information and do common setup.
 /// Populates all members of ImageInfo.
 /// </summary>
-void ImageLoader::LoadImageCommon(_In_ IWICBitmapSource* source)
+/// <param name="nativeFormat">Format of the pixels in the file, if source has already converted them.</param>
+void ImageLoader::LoadImageCommon(_In_ IWICBitmapSource* source, _In_opt_ const WICPixelFormatGUID* nativeFormat)
 {
     EnforceStates(1, ImageLoaderState::NotInitialized);
 
@@ -250,7 +586,9 @@ void ImageLoader::LoadImageCommon(_In_ IWICBitmapSource* source)
     switch (m_options.type)
     {
     case ImageLoaderOptionsType::ForceBT2100:
-        m_imageInfo.forceBT2100ColorSpace = true;
+        // libheif has already decoded HDR10 images to scRGB, and the 10bpc WIC path can't read its
+        // bitmaps; see CreateHeifHdr10CpuResources.
+        m_imageInfo.forceBT2100ColorSpace = !m_decodedByLibheif;
         break;
 
     case ImageLoaderOptionsType::CustomSdrColorSpace:
@@ -283,6 +621,11 @@ void ImageLoader::LoadImageCommon(_In_ IWICBitmapSource* source)
     WICPixelFormatGUID imageFmt;
     IFRIMG(source->GetPixelFormat(&imageFmt));
 
+    if (nativeFormat != nullptr)
+    {
+        imageFmt = *nativeFormat;
+    }
+
     if (m_imageInfo.forceBT2100ColorSpace == true &&
         m_imageInfo.isHeif == true)
     {
@@ -297,6 +640,7 @@ void ImageLoader::LoadImageCommon(_In_ IWICBitmapSource* source)
     UINT width = 0, height = 0;
     IFRIMG(source->GetSize(&width, &height));
     m_imageInfo.pixelSize = Size(static_cast<float>(width), static_cast<float>(height));
+    m_decodedSize = D2D1::SizeU(width, height);
 
     // Gainmaps generally are 1/2 pixel size of the main image, but we don't restrict this.
     if (m_imageInfo.hasAppleHdrGainMap == true)
@@ -312,6 +656,8 @@ void ImageLoader::LoadImageCommon(_In_ IWICBitmapSource* source)
         CreateHeifHdr10CpuResources(source);
 
         if (m_state == ImageLoaderState::LoadingFailed) return;
+
+        TryBuildMipPyramid();
     }
     else
     {
@@ -328,42 +674,80 @@ void ImageLoader::LoadImageCommon(_In_ IWICBitmapSource* source)
                 &m_imageInfo.countColorProfiles));
         }
 
-        // When decoding, preserve the numeric representation (float vs. non-float)
-        // of the native image data. This avoids WIC performing an implicit gamma conversion
-        // which occurs when converting between a fixed-point/integer pixel format (sRGB gamma)
-        // and a float-point pixel format (linear gamma). Gamma adjustment, if specified by
-        // the ICC profile, will be performed by the Direct2D color management effect.
-
-        WICPixelFormatGUID fmt = {};
-        if (m_imageInfo.isFloat)
+        if (m_tiledStore)
         {
-            fmt = GUID_WICPixelFormat64bppPRGBAHalf; // Equivalent to DXGI_FORMAT_R16G16B16A16_FLOAT.
+            // TiledWicBitmapSource already provides the format chosen below, and its levels
+            // replace the mip pyramid. Decoding it up front is exactly what tiling avoids.
+            m_wicCachedSource = source;
         }
-        else
+        else if (m_rgbeSource)
         {
-            fmt = GUID_WICPixelFormat64bppPRGBA; // Equivalent to DXGI_FORMAT_R16G16B16A16_UNORM.
-                                                 // Many SDR images (e.g. JPEG) use <=32bpp, so it
-                                                 // is possible to further optimize this for memory usage.
+            // Already FP16 as seen by WIC; copying it to an IWICBitmap would quadruple its size.
+            m_wicCachedSource = source;
+
+            TryBuildMipPyramid();
         }
+        else
+        {
+            // When decoding, preserve the numeric representation (float vs. non-float)
+            // of the native image data. This avoids WIC performing an implicit gamma conversion
+            // which occurs when converting between a fixed-point/integer pixel format (sRGB gamma)
+            // and a float-point pixel format (linear gamma). Gamma adjustment, if specified by
+            // the ICC profile, will be performed by the Direct2D color management effect.
+
+            // Integer images are kept at the smallest precision that holds them; Direct2D
+            // linearizes them on the GPU when drawing.
+            WICPixelFormatGUID fmt = {};
+            if (m_imageInfo.isFloat)
+            {
+                fmt = GUID_WICPixelFormat64bppPRGBAHalf; // Equivalent to DXGI_FORMAT_R16G16B16A16_FLOAT.
+            }
+            else if (m_imageInfo.bitsPerChannel <= 8)
+            {
+                fmt = GUID_WICPixelFormat32bppPBGRA; // Equivalent to DXGI_FORMAT_B8G8R8A8_UNORM.
+            }
+            else
+            {
+                fmt = GUID_WICPixelFormat64bppPRGBA; // Equivalent to DXGI_FORMAT_R16G16B16A16_UNORM.
+            }
 
-        ComPtr<IWICFormatConverter> format;
-        IFRIMG(wicFactory->CreateFormatConverter(&format));
+            WICPixelFormatGUID sourceFmt = {};
+            IFRIMG(source->GetPixelFormat(&sourceFmt));
 
-        IFRIMG(format->Initialize(
-            source,
-            fmt,
-            WICBitmapDitherTypeNone,
-            nullptr,
-            0.0f,
-            WICBitmapPaletteTypeCustom));
+            ComPtr<IWICBitmap> sourceBitmap;
+            if (sourceFmt == fmt && SUCCEEDED(source->QueryInterface(IID_PPV_ARGS(&sourceBitmap))))
+            {
+                // Already decoded to the right format, e.g. by TryDecompressToBitmap.
+                m_wicCachedSource = source;
+            }
+            else
+            {
+                ComPtr<IWICFormatConverter> format;
+                IFRIMG(wicFactory->CreateFormatConverter(&format));
+
+                IFRIMG(format->Initialize(
+                    source,
+                    fmt,
+                    WICBitmapDitherTypeNone,
+                    nullptr,
+                    0.0f,
+                    WICBitmapPaletteTypeCustom));
+
+                // Decode now rather than lazily when Direct2D first draws the image: this keeps the work on
+                // the loading thread, and a loaded image no longer depends on the source stream or file.
+                ComPtr<IWICBitmap> decoded;
+                IFRIMG(wicFactory->CreateBitmapFromSource(format.Get(), WICBitmapCacheOnLoad, &decoded));
+                IFRIMG(decoded.As(&m_wicCachedSource));
+            }
 
-        IFRIMG(format.As(&m_wicCachedSource));
+            // Optional; if this fails the full resolution image is drawn at every zoom level.
+            TryBuildMipPyramid();
+        }
     }
 
+    // Device resources are created by CreateDeviceDependentResources, on the rendering thread.
     m_state = ImageLoaderState::NeedDeviceResources;
 
-    CreateDeviceDependentResourcesInternal();
-
     m_imageInfo.isValid = true;
 }
 
@@ -480,169 +864,521 @@ void ImageLoader::CreateHeifHdr10GpuResources()
 }
 
 /// <summary>
-/// Checks if the HEIC image contains an Apple HDR gainmap. If true, initializes the gainmap bitmap.
+/// Generates reduced resolution copies of m_wicCachedSource for drawing at low zoom levels.
 /// </summary>
-/// <param name="imageStream"></param>
-/// <returns></returns>
-bool ImageLoader::TryLoadAppleHdrGainMapHeic(IStream* imageStream)
+bool ImageLoader::TryBuildMipPyramid()
 {
-    STATSTG stats = {};
-    HRESULT hr = imageStream->Stat(&stats, STATFLAG_NONAME);
+    if (m_rgbeSource)
+    {
+        UINT rgbeWidth = 0, rgbeHeight = 0;
+        IFRF(m_rgbeSource->GetSize(&rgbeWidth, &rgbeHeight));
 
-    unsigned int sizeBytes = static_cast<unsigned int>(stats.cbSize.QuadPart);
+        m_mipPyramid.Build(m_rgbeSource->GetPixels(), MipSourceFormat::Rgbe, rgbeWidth, rgbeHeight, m_rgbeSource->GetStride(), sc_MipMinDimension);
 
-    // Image is too large, give up.
-    IFRF(sizeBytes != stats.cbSize.QuadPart ? E_FAIL : S_OK);
+        return true;
+    }
 
-    std::vector<byte> fileBuf(sizeBytes);
+    ComPtr<IWICBitmap> bitmap;
+    IFRF(m_wicCachedSource.As(&bitmap));
 
-    ULARGE_INTEGER seeked = {};
-    imageStream->Seek({}, STREAM_SEEK_SET, &seeked);
+    WICPixelFormatGUID fmt = {};
+    IFRF(bitmap->GetPixelFormat(&fmt));
 
-    ULONG cbRead = 0;
-    hr = imageStream->Read(fileBuf.data(), static_cast<ULONG>(fileBuf.size()), &cbRead);
+    MipSourceFormat mipFmt;
+    if (fmt == GUID_WICPixelFormat64bppPRGBAHalf)
+    {
+        mipFmt = MipSourceFormat::R16G16B16A16Float;
+    }
+    else if (fmt == GUID_WICPixelFormat64bppPRGBA)
+    {
+        mipFmt = MipSourceFormat::R16G16B16A16Unorm;
+    }
+    else if (fmt == GUID_WICPixelFormat32bppPBGRA)
+    {
+        mipFmt = MipSourceFormat::B8G8R8A8Unorm;
+    }
+    else if (fmt == GUID_WICPixelFormat32bppR10G10B10A2HDR10)
+    {
+        // Filtered while still PQ encoded, like the full resolution HDR10 texture is sampled.
+        mipFmt = MipSourceFormat::R10G10B10A2Unorm;
+    }
+    else
+    {
+        return false;
+    }
 
-    CHeifContext ctx;
-    IFRF(HEIFHR(heif_context_read_from_memory_without_copy(ctx.ptr, fileBuf.data(), fileBuf.size(), nullptr)));
+    ComPtr<IWICBitmapLock> lock;
+    IFRF(bitmap->Lock({}, WICBitmapLockRead, &lock));
 
-    CHeifHandle mainHandle;
-    IFRF(HEIFHR(heif_context_get_primary_image_handle(ctx.ptr, &mainHandle.ptr)));
+    UINT width = 0, height = 0, lockStride = 0, lockSize = 0;
+    WICInProcPointer lockData = nullptr;
+    IFRF(lock->GetSize(&width, &height));
+    IFRF(lock->GetStride(&lockStride));
+    IFRF(lock->GetDataPointer(&lockSize, &lockData));
 
-    int countAux = heif_image_handle_get_number_of_auxiliary_images(mainHandle.ptr, 0);
-    std::vector<heif_item_id> auxIds(countAux);
-    heif_image_handle_get_list_of_auxiliary_image_IDs(mainHandle.ptr, 0, auxIds.data(), static_cast<int>(auxIds.size()));
+    m_mipPyramid.Build(lockData, mipFmt, width, height, lockStride, sc_MipMinDimension);
 
-    for (auto i : auxIds)
+    return true;
+}
+
+/// <summary>
+/// Uploads each mip pyramid level to an immutable FP16 texture. For tiled images, wraps each
+/// TiledImageStore level in an image source that is filled on demand instead.
+/// </summary>
+bool ImageLoader::TryCreateMipImageSources()
+{
+    m_mipImageSources.clear();
+
+    auto d3dDevice = m_deviceResources->GetD3DDevice();
+    auto context = m_deviceResources->GetD2DDeviceContext();
+
+    if (m_tiledStore)
     {
-        CHeifHandle auxHandle;
-        IFRF(HEIFHR(heif_image_handle_get_auxiliary_image_handle(mainHandle.ptr, i, &auxHandle.ptr)));
+        WICPixelFormatGUID fmt = {};
+        IFRF(m_wicCachedSource->GetPixelFormat(&fmt));
 
-        CHeifAuxType type;
-        IFRF(HEIFHR(heif_image_handle_get_auxiliary_type(auxHandle.ptr, &type.ptr)));
+        for (unsigned int i = 1; i < m_tiledStore->GetLevelCount(); i++)
+        {
+            ComPtr<IWICBitmapSource> levelWicSource;
+            IFRF(TiledWicBitmapSource::Create(m_tiledStore, i, fmt == GUID_WICPixelFormat64bppPRGBAHalf, &levelWicSource));
 
-        if (type.IsAppleHdrGainMap())
+            ComPtr<ID2D1ImageSourceFromWic> levelSource;
+            IFRF(context->CreateImageSourceFromWic(
+                levelWicSource.Get(),
+                D2D1_IMAGE_SOURCE_LOADING_OPTIONS_CACHE_ON_DEMAND,
+                D2D1_ALPHA_MODE_UNKNOWN,
+                &levelSource));
+
+            m_mipImageSources.push_back(levelSource);
+        }
+
+        return true;
+    }
+
+    for (unsigned int i = 1; i <= m_mipPyramid.GetLevelCount(); i++)
+    {
+        auto& level = m_mipPyramid.GetLevel(i);
+
+        // Only the largest levels of huge images can hit this; GetLoadedImage uses the full resolution
+        // image, which Direct2D tiles, instead.
+        if (level.width > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+            level.height > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION)
         {
-            IFRF(HEIFHR(heif_decode_image(auxHandle.ptr, &m_appleHdrGainMap.ptr, heif_colorspace_monochrome, heif_chroma_monochrome, 0)));
+            m_mipImageSources.push_back(nullptr);
+            continue;
+        }
 
-            int width = heif_image_get_primary_width(m_appleHdrGainMap.ptr);
-            int height = heif_image_get_primary_height(m_appleHdrGainMap.ptr);
-            int bitdepth = heif_image_get_bits_per_pixel_range(m_appleHdrGainMap.ptr, heif_channel_Y);
+        D3D11_SUBRESOURCE_DATA initData = {};
+        initData.pSysMem = level.pixels.data();
+        initData.SysMemPitch = level.width * sizeof(DirectX::PackedVector::XMHALF4);
+
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = level.width;
+        desc.Height = level.height;
+        desc.MipLevels = desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_IMMUTABLE;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+        ComPtr<ID3D11Texture2D> tex;
+        IFRF(d3dDevice->CreateTexture2D(&desc, &initData, &tex));
+
+        ComPtr<IDXGISurface> dxgiSurface;
+        IFRF(tex.As(&dxgiSurface));
+        IDXGISurface* arrSurfaces[] = { dxgiSurface.Get() };
+
+        // Like CreateHeifHdr10GpuResources, the image's actual color space is applied by GetImageColorContext.
+        ComPtr<ID2D1ImageSource> levelSource;
+        IFRF(context->CreateImageSourceFromDxgi(
+            arrSurfaces,
+            ARRAYSIZE(arrSurfaces),
+            DXGI_COLOR_SPACE_RGB_FULL_G10_NONE_P709,
+            D2D1_IMAGE_SOURCE_FROM_DXGI_OPTIONS_NONE,
+            &levelSource));
+
+        m_mipImageSources.push_back(levelSource);
+    }
 
-            if (bitdepth != 8) return false; // Defer checking main image resolution until it is available later in decode process.
+    return true;
+}
 
-            int stride = 0;
-            uint8_t* data = heif_image_get_plane(m_appleHdrGainMap.ptr, heif_channel_Y, &stride);
+/// <summary>
+/// If the stream is a HEIF file, loads its bytes into file and parses them with libheif.
+/// </summary>
+/// <returns>False if the stream isn't HEIF or libheif can't parse it.</returns>
+bool ImageLoader::TryOpenHeif(IStream* imageStream, HANDLE imageFile, CHeifFileData& file, CHeifContext& ctx, CHeifHandle& primary)
+{
+    // The brand in the leading ftyp box identifies the file type.
+    byte header[12] = {};
+    ULONG cbRead = 0;
+    IFRF(imageStream->Seek({}, STREAM_SEEK_SET, nullptr));
+    HRESULT hr = imageStream->Read(header, sizeof(header), &cbRead);
+    IFRF(imageStream->Seek({}, STREAM_SEEK_SET, nullptr));
+    IFRF(hr);
 
-            auto fact = m_deviceResources->GetWicImagingFactory();
+    if (cbRead != sizeof(header) ||
+        heif_check_filetype(header, sizeof(header)) != heif_filetype_yes_supported)
+    {
+        return false;
+    }
 
-            // Memory and object lifetime is synchronized with CHeifImageWithWicBitmap.
-            ComPtr<IWICBitmap> bitmap;
+    IFRF(file.Load(imageFile, imageStream));
+    IFRF(imageStream->Seek({}, STREAM_SEEK_SET, nullptr));
 
-            IFRF(fact->CreateBitmapFromMemory(
-                width,
-                height,
-                GUID_WICPixelFormat8bppGray,
-                stride,
-                stride * height,
-                static_cast<BYTE *>(data),
-                &bitmap));
+    return TryReadHeif(file, ctx, primary);
+}
 
-            ComPtr<IWICFormatConverter> fmt;
-            IFRF(fact->CreateFormatConverter(&fmt));
-            IFRF(fmt->Initialize(bitmap.Get(), GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, nullptr, 0.0f, WICBitmapPaletteTypeCustom));
+/// <summary>
+/// Parses a HEIF file with libheif, which keeps reading from file's bytes without copying them.
+/// </summary>
+bool ImageLoader::TryReadHeif(const CHeifFileData& file, CHeifContext& ctx, CHeifHandle& primary)
+{
+    IFRF(HEIFHR(heif_context_read_from_memory_without_copy(ctx.ptr, file.GetData(), file.GetSize(), nullptr)));
+    IFRF(HEIFHR(heif_context_get_primary_image_handle(ctx.ptr, &primary.ptr)));
 
-            IFRF(fmt.As(&m_appleHdrGainMap.wicSource));
+    return true;
+}
 
-            // Immediately return once we have a gain map.
-            return true;
-        }
+/// <summary>
+/// Describes the planes of an HDR10 image (or tile) decoded by libheif with undefined colorspace and chroma.
+/// </summary>
+/// <returns>False if the planes aren't Y'CbCr that ConvertHdr10YuvToScRgb supports.</returns>
+static bool TryGetHdr10Planes(heif_image* image, bool fullRange, YuvPlanes& planes)
+{
+    if (heif_image_get_colorspace(image) != heif_colorspace_YCbCr) return false;
+
+    planes = {};
+
+    switch (heif_image_get_chroma_format(image))
+    {
+    case heif_chroma_420:
+        planes.chromaShiftX = planes.chromaShiftY = 1;
+        break;
+
+    case heif_chroma_422:
+        planes.chromaShiftX = 1;
+        break;
+
+    case heif_chroma_444:
+        break;
+
+    default:
+        return false;
     }
 
-    return false;
+    int bitDepth = heif_image_get_bits_per_pixel_range(image, heif_channel_Y);
+    if (bitDepth <= 8 || bitDepth > 16 ||
+        heif_image_get_bits_per_pixel_range(image, heif_channel_Cb) != bitDepth ||
+        heif_image_get_bits_per_pixel_range(image, heif_channel_Cr) != bitDepth)
+    {
+        return false;
+    }
+
+    int yStride = 0, cbStride = 0, crStride = 0, alphaStride = 0;
+    planes.y = heif_image_get_plane_readonly(image, heif_channel_Y, &yStride);
+    planes.cb = heif_image_get_plane_readonly(image, heif_channel_Cb, &cbStride);
+    planes.cr = heif_image_get_plane_readonly(image, heif_channel_Cr, &crStride);
+
+    if (!planes.y || !planes.cb || !planes.cr || cbStride != crStride) return false;
+
+    // An alpha plane of a different depth is ignored and the image is drawn opaque.
+    if (heif_image_has_channel(image, heif_channel_Alpha) &&
+        heif_image_get_bits_per_pixel_range(image, heif_channel_Alpha) == bitDepth)
+    {
+        planes.alpha = heif_image_get_plane_readonly(image, heif_channel_Alpha, &alphaStride);
+    }
+
+    planes.width = static_cast<unsigned int>(heif_image_get_width(image, heif_channel_Y));
+    planes.height = static_cast<unsigned int>(heif_image_get_height(image, heif_channel_Y));
+    planes.bitDepth = static_cast<unsigned int>(bitDepth);
+    planes.fullRange = fullRange;
+    planes.yStride = static_cast<size_t>(yStride);
+    planes.chromaStride = static_cast<size_t>(cbStride);
+    planes.alphaStride = static_cast<size_t>(alphaStride);
+
+    return true;
 }
 
 /// <summary>
-/// Checks if a JPEG image contains an Apple HDR gainmap stored in an MPO (Multi picture object). If true, initializes the gainmap bitmap.
+/// Decodes an HDR10 HEIF image with libheif straight to FP16 scRGB, see ConvertHdr10YuvToScRgb.
+/// Unlike WIC, this needs neither the HEVC codec nor a full resolution HDR10 copy of the image.
+/// Grid images are decoded a tile at a time on all cores, each tile converted into its place
+/// in the bitmap as soon as it is ready, see HeifTileDecoder.
 /// </summary>
-/// <param name="imageStream">Underlying stream is needed since we have to manually setup WIC to read the second Individual Image.</param>
-/// <param name="frame"></param>
-/// <returns></returns>
-bool ImageLoader::TryLoadAppleHdrGainMapJpegMpo(IStream* imageStream, IWICBitmapFrameDecode* frame)
+/// <returns>False if the image isn't HDR10 or libheif can't decode it, in which case WIC is used.</returns>
+bool ImageLoader::TryLoadHeifHdr10(const CHeifFileData& file, heif_image_handle* primary, ComPtr<IWICBitmap>& bitmap)
 {
+    bool fullRange = false;
+    if (!IsHeifHdr10(primary, &fullRange)) return false;
+
+    UINT width = static_cast<UINT>(heif_image_handle_get_width(primary));
+    UINT height = static_cast<UINT>(heif_image_handle_get_height(primary));
+
     auto fact = m_deviceResources->GetWicImagingFactory();
 
-    // Heuristic: Allow any Apple manufactured device.
-    ComPtr<IWICMetadataQueryReader> query;
-    CPropVariant appleMftr;
+    IFRF(fact->CreateBitmap(width, height, GUID_WICPixelFormat64bppPRGBAHalf, WICBitmapCacheOnLoad, &bitmap));
 
-    IFRF(frame->GetMetadataQueryReader(&query));
-    IFRF(query->GetMetadataByName(L"/app1/ifd/{ushort=271}", &appleMftr));
+    ComPtr<IWICBitmapLock> lock;
+    IFRF(bitmap->Lock({}, WICBitmapLockWrite, &lock));
 
-    if (appleMftr.vt != VT_LPSTR) return false;
-    if (strcmp("Apple", appleMftr.pszVal) != 0) return false;
+    UINT lockStride = 0, lockSize = 0;
+    WICInProcPointer lockData = nullptr;
+    IFRF(lock->GetStride(&lockStride));
+    IFRF(lock->GetDataPointer(&lockSize, &lockData));
+
+    // Undefined colorspace and chroma keep the planes as the codec produced them.
+    IFRF(HeifTileDecoder::Decode(
+        file,
+        primary,
+        heif_colorspace_undefined,
+        heif_chroma_undefined,
+        nullptr,
+        [&](heif_image* tile, const HeifRect& rect, unsigned int threadCount)
+        {
+            YuvPlanes planes;
+            if (!TryGetHdr10Planes(tile, fullRange, planes) || rect.x >= width || rect.y >= height)
+            {
+                return WINCODEC_ERR_UNSUPPORTEDPIXELFORMAT;
+            }
 
-    // Find the APP2 MP Extensions block
-    ComPtr<IWICMetadataBlockReader> blockReader;
-    IFRF(frame->QueryInterface(IID_PPV_ARGS(&blockReader)));
+            // Edge tiles are coded at full tile size.
+            planes.width = (std::min)({ planes.width, rect.width, width - rect.x });
+            planes.height = (std::min)({ planes.height, rect.height, height - rect.y });
 
-    UINT count = 0;
-    IFRF(blockReader->GetCount(&count));
+            ConvertHdr10YuvToScRgb(
+                planes,
+                lockData + static_cast<size_t>(rect.y) * lockStride + static_cast<size_t>(rect.x) * 8,
+                lockStride,
+                threadCount);
 
-    ULARGE_INTEGER gainmapOffset = {};
+            return S_OK;
+        }));
 
-    // WIC doesn't natively understand the APP2 MPF block so we have to iterate and look for it ourselves.
-    for (UINT i = 0; i < count; i++)
-    {
-        ComPtr<IWICMetadataReader> reader;
-        IFRF(blockReader->GetReaderByIndex(i, &reader));
+    return true;
+}
 
-        // NOTE: From this point in the loop, any failures should just continue to the next block.
-        GUID metaFmt = {};
-        IFRF(reader->GetMetadataFormat(&metaFmt));
-        if (metaFmt != GUID_MetadataFormatUnknown) continue;
+/// <summary>
+/// Decodes an 8 bit HEIF image with libheif straight into a premultiplied BGRA bitmap, a tile
+/// at a time like TryLoadHeifHdr10. If the image has an ICC profile it is kept in m_wicColorContext.
+/// </summary>
+/// <returns>False if the image is left to WIC, e.g. its nclx profile has primaries other than sRGB's.</returns>
+bool ImageLoader::TryLoadHeifSdr(const CHeifFileData& file, heif_image_handle* primary, ComPtr<IWICBitmap>& bitmap)
+{
+    if (heif_image_handle_get_luma_bits_per_pixel(primary) != 8) return false;
 
-        CPropVariant id, value;
-        IFRF(reader->GetValueByIndex(0, nullptr, &id, &value));
-        if (value.vt != 65) continue; // VT_BLOB
-        if (value.blob.cbSize != sizeof(m_appleApp2MPBlock)) continue;
+    auto fact = m_deviceResources->GetWicImagingFactory();
 
-        // Grab the offset before it's wiped out by the validity check.
-        assert(m_appleApp2MPBlockMagicOffset < value.blob.cbSize);
+    ComPtr<IWICColorContext> colorContext;
+    switch (heif_image_handle_get_color_profile_type(primary))
+    {
+    case heif_color_profile_type_prof:
+    case heif_color_profile_type_rICC:
+    {
+        std::vector<byte> profile(heif_image_handle_get_raw_color_profile_size(primary));
+        IFRF(HEIFHR(heif_image_handle_get_raw_color_profile(primary, profile.data())));
 
-        // The known APP2 header specifies Big Endian.
-        ULARGE_INTEGER tempOffset = {};
-        tempOffset.QuadPart =
-            value.blob.pBlobData[m_appleApp2MPBlockMagicOffset + 0] << 24 |
-            value.blob.pBlobData[m_appleApp2MPBlockMagicOffset + 1] << 16 |
-            value.blob.pBlobData[m_appleApp2MPBlockMagicOffset + 2] << 8  |
-            value.blob.pBlobData[m_appleApp2MPBlockMagicOffset + 3];
+        IFRF(fact->CreateColorContext(&colorContext));
+        IFRF(colorContext->InitializeFromMemory(profile.data(), static_cast<UINT>(profile.size())));
+        break;
+    }
 
-        // Fill in the known dynamic bytes with dummy values (0xFF).
-        for (int j = 0; j < ARRAYSIZE(m_appleApp2MPBlockDynamicBytes); j++)
+    case heif_color_profile_type_nclx:
+    {
+        // Drawn as sRGB, like an image without a profile. Other primaries and HDR transfer functions
+        // need a color context that only WIC derives.
+        CHeifNclx nclx;
+        IFRF(HEIFHR(heif_image_handle_get_nclx_color_profile(primary, &nclx.ptr)));
+
+        if ((nclx.ptr->color_primaries != heif_color_primaries_ITU_R_BT_709_5 &&
+             nclx.ptr->color_primaries != heif_color_primaries_unspecified) ||
+            nclx.ptr->transfer_characteristics == heif_transfer_characteristic_ITU_R_BT_2100_0_PQ ||
+            nclx.ptr->transfer_characteristics == heif_transfer_characteristic_ITU_R_BT_2100_0_HLG)
         {
-            assert(m_appleApp2MPBlockDynamicBytes[j] < value.blob.cbSize);
-            value.blob.pBlobData[m_appleApp2MPBlockDynamicBytes[j]] = 0xFF;
+            return false;
         }
 
-        // A not so robust check against magic values since this is much simpler than a true parser.
-        if (memcmp(value.blob.pBlobData, m_appleApp2MPBlock, sizeof(m_appleApp2MPBlock)) != 0) continue;
+        break;
+    }
 
-        // If we get here we've validated all of the data we can in the primary image and should move to the second image.
-        gainmapOffset = tempOffset;
+    case heif_color_profile_type_not_present:
         break;
+
+    default:
+        return false;
+    }
+
+    bool hasAlpha = heif_image_handle_has_alpha_channel(primary) != 0;
+    size_t sourceBytesPerPixel = hasAlpha ? 4 : 3;
+
+    UINT width = static_cast<UINT>(heif_image_handle_get_width(primary));
+    UINT height = static_cast<UINT>(heif_image_handle_get_height(primary));
+
+    IFRF(fact->CreateBitmap(width, height, GUID_WICPixelFormat32bppPBGRA, WICBitmapCacheOnLoad, &bitmap));
+
+    ComPtr<IWICBitmapLock> lock;
+    IFRF(bitmap->Lock({}, WICBitmapLockWrite, &lock));
+
+    UINT lockStride = 0, lockSize = 0;
+    WICInProcPointer lockData = nullptr;
+    IFRF(lock->GetStride(&lockStride));
+    IFRF(lock->GetDataPointer(&lockSize, &lockData));
+
+    IFRF(HeifTileDecoder::Decode(
+        file,
+        primary,
+        heif_colorspace_RGB,
+        hasAlpha ? heif_chroma_interleaved_RGBA : heif_chroma_interleaved_RGB,
+        nullptr,
+        [&](heif_image* tile, const HeifRect& rect, unsigned int threadCount)
+        {
+            int stride = 0;
+            const uint8_t* pixels = heif_image_get_plane_readonly(tile, heif_channel_interleaved, &stride);
+            if (!pixels || rect.x >= width || rect.y >= height) return WINCODEC_ERR_GENERIC_ERROR;
+
+            // Edge tiles are coded at full tile size.
+            UINT tileWidth = (std::min)({ static_cast<UINT>(heif_image_get_width(tile, heif_channel_interleaved)), rect.width, width - rect.x });
+            UINT tileHeight = (std::min)({ static_cast<UINT>(heif_image_get_height(tile, heif_channel_interleaved)), rect.height, height - rect.y });
+
+            ParallelFor(0, tileHeight, sc_SwizzleRowsPerBand, threadCount, [&](size_t first, size_t last)
+            {
+                for (size_t y = first; y < last; y++)
+                {
+                    const uint8_t* source = pixels + y * static_cast<size_t>(stride);
+                    uint8_t* dest = lockData + (rect.y + y) * lockStride + static_cast<size_t>(rect.x) * 4;
+
+                    for (UINT x = 0; x < tileWidth; x++, source += sourceBytesPerPixel, dest += 4)
+                    {
+                        // Premultiplied the same way as WIC's 32bppRGBA to 32bppPBGRA converter.
+                        unsigned int alpha = hasAlpha ? source[3] : 255;
+
+                        dest[0] = static_cast<uint8_t>((source[2] * alpha + 127) / 255);
+                        dest[1] = static_cast<uint8_t>((source[1] * alpha + 127) / 255);
+                        dest[2] = static_cast<uint8_t>((source[0] * alpha + 127) / 255);
+                        dest[3] = static_cast<uint8_t>(alpha);
+                    }
+                }
+            });
+
+            return S_OK;
+        }));
+
+    m_wicColorContext = colorContext;
+    m_imageInfo.countColorProfiles = colorContext ? 1 : 0;
+
+    return true;
+}
+
+/// <summary>
+/// Finds the Apple HDR gain map among the auxiliary images of a HEIF primary image.
+/// </summary>
+bool ImageLoader::TryGetAppleHdrGainMapHeic(heif_image_handle* primary, CHeifHandle& gainMap)
+{
+    int countAux = heif_image_handle_get_number_of_auxiliary_images(primary, 0);
+    std::vector<heif_item_id> auxIds(countAux);
+    heif_image_handle_get_list_of_auxiliary_image_IDs(primary, 0, auxIds.data(), static_cast<int>(auxIds.size()));
+
+    for (auto i : auxIds)
+    {
+        CHeifHandle auxHandle;
+        IFRF(HEIFHR(heif_image_handle_get_auxiliary_image_handle(primary, i, &auxHandle.ptr)));
+
+        CHeifAuxType type;
+        IFRF(HEIFHR(heif_image_handle_get_auxiliary_type(auxHandle.ptr, &type.ptr)));
+
+        if (type.IsAppleHdrGainMap())
+        {
+            std::swap(gainMap.ptr, auxHandle.ptr);
+            return true;
+        }
     }
 
-    if (gainmapOffset.QuadPart == 0) return false;
+    return false;
+}
+
+/// <summary>
+/// Decodes an Apple HDR gain map found by TryGetAppleHdrGainMapHeic and initializes the gainmap bitmap.
+/// </summary>
+/// <returns></returns>
+bool ImageLoader::TryLoadAppleHdrGainMapHeic(heif_image_handle* gainMap)
+{
+    IFRF(HEIFHR(heif_decode_image(gainMap, &m_appleHdrGainMap.ptr, heif_colorspace_monochrome, heif_chroma_monochrome, 0)));
+
+    int width = heif_image_get_primary_width(m_appleHdrGainMap.ptr);
+    int height = heif_image_get_primary_height(m_appleHdrGainMap.ptr);
+    int bitdepth = heif_image_get_bits_per_pixel_range(m_appleHdrGainMap.ptr, heif_channel_Y);
+
+    if (bitdepth != 8) return false; // Defer checking main image resolution until it is available later in decode process.
+
+    int stride = 0;
+    uint8_t* data = heif_image_get_plane(m_appleHdrGainMap.ptr, heif_channel_Y, &stride);
+
+    auto fact = m_deviceResources->GetWicImagingFactory();
+
+    // Memory and object lifetime is synchronized with CHeifImageWithWicBitmap.
+    ComPtr<IWICBitmap> bitmap;
+
+    IFRF(fact->CreateBitmapFromMemory(
+        width,
+        height,
+        GUID_WICPixelFormat8bppGray,
+        stride,
+        stride * height,
+        static_cast<BYTE *>(data),
+        &bitmap));
+
+    ComPtr<IWICFormatConverter> fmt;
+    IFRF(fact->CreateFormatConverter(&fmt));
+    IFRF(fmt->Initialize(bitmap.Get(), GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, nullptr, 0.0f, WICBitmapPaletteTypeCustom));
+
+    IFRF(fmt.As(&m_appleHdrGainMap.wicSource));
+
+    return true;
+}
+
+/// <summary>
+/// Checks if a JPEG image contains an Apple HDR gainmap stored in an MPO (Multi picture object). If true, initializes the gainmap bitmap.
+/// </summary>
+/// <param name="imageStream">Underlying stream is needed since we have to manually setup WIC to read the second Individual Image.</param>
+/// <returns></returns>
+bool ImageLoader::TryLoadAppleHdrGainMapJpegMpo(IStream* imageStream)
+{
+    auto fact = m_deviceResources->GetWicImagingFactory();
 
-    // Initialize the secondary image (HDR gainmap) and validate it.
-    // TODO: Apple MPO images may have a gap between the primary image EOI and second image SOI.
-    ULARGE_INTEGER ignore = {};
     STATSTG stats = {};
     IFRF(imageStream->Stat(&stats, STATFLAG_NONAME));
 
+    // The MPF index sits in an APP2 segment ahead of the image data, so one read of the head of the file finds it.
+    std::vector<byte> head(static_cast<size_t>((std::min)(stats.cbSize.QuadPart, static_cast<ULONGLONG>(sc_MpfHeadBytes))));
+    ULONG cbRead = 0;
+    IFRF(imageStream->Seek({}, STREAM_SEEK_SET, nullptr));
+    IFRF(imageStream->Read(head.data(), static_cast<ULONG>(head.size()), &cbRead));
+
+    MpfIndex index = {};
+    if (!ParseJpegMpf(head.data(), cbRead, stats.cbSize.QuadPart, index)) return false;
+
+    // Apple stores the gain map with the undefined MP type, which excludes stereo, multi-angle and
+    // panorama images as well as thumbnails.
+    const MpfImage* gainmapEntry = nullptr;
+    for (unsigned int i = 1; i < index.count; i++)
+    {
+        if (index.images[i].GetType() == sc_MpfTypeUndefined)
+        {
+            gainmapEntry = &index.images[i];
+            break;
+        }
+    }
+
+    if (gainmapEntry == nullptr) return false;
+
+    // Initialize the secondary image (HDR gainmap) and validate it. Its MP Entry gives its exact
+    // extent, which need not follow straight after the primary image's EOI.
+    ULARGE_INTEGER gainmapOffset = {};
+    gainmapOffset.QuadPart = gainmapEntry->offset;
+
     // Separate streams are needed because we have two live decoders.
     ULARGE_INTEGER region = {};
-    region.QuadPart = stats.cbSize.QuadPart - gainmapOffset.QuadPart;
+    region.QuadPart = gainmapEntry->size;
     ComPtr<IWICStream> gainmapStream;
     IFRF(fact->CreateStream(&gainmapStream));
     IFRF(gainmapStream->InitializeFromIStreamRegion(imageStream, gainmapOffset, region));
@@ -667,8 +1403,12 @@ bool ImageLoader::TryLoadAppleHdrGainMapJpegMpo(IStream* imageStream, IWICBitmap
     IFRF(fact->CreateFormatConverter(&fmt));
     IFRF(fmt->Initialize(gainmapFrame.Get(), GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, nullptr, 0.0f, WICBitmapPaletteTypeCustom));
 
+    // Like the main image, decode now so the gain map doesn't hold on to imageStream.
+    ComPtr<IWICBitmap> decoded;
+    IFRF(fact->CreateBitmapFromSource(fmt.Get(), WICBitmapCacheOnLoad, &decoded));
+
     // Just stuff the WIC pointer in here even though we don't have an associated heif_image.
-    IFRF(fmt.As(&m_appleHdrGainMap.wicSource));
+    IFRF(decoded.As(&m_appleHdrGainMap.wicSource));
 
     return true;
 }
@@ -691,11 +1431,22 @@ void ImageLoader::CreateDeviceDependentResourcesInternal()
     }
     else
     {
+        // Tiled images are read from the file only where they are drawn, and RGBE images are
+        // expanded to FP16 only where they are drawn.
         ComPtr<ID2D1ImageSourceFromWic> wicImageSource;
-        IFRIMG(context->CreateImageSourceFromWic(m_wicCachedSource.Get(), &wicImageSource));
+        IFRIMG(context->CreateImageSourceFromWic(
+            m_wicCachedSource.Get(),
+            (m_tiledStore || m_rgbeSource) ? D2D1_IMAGE_SOURCE_LOADING_OPTIONS_CACHE_ON_DEMAND : D2D1_IMAGE_SOURCE_LOADING_OPTIONS_NONE,
+            D2D1_ALPHA_MODE_UNKNOWN,
+            &wicImageSource));
         IFRIMG(wicImageSource.As(&m_imageSource));
     }
 
+    if (!TryCreateMipImageSources())
+    {
+        m_mipImageSources.clear();
+    }
+
     if (m_imageInfo.hasAppleHdrGainMap)
     {
         ComPtr<ID2D1ImageSourceFromWic> wicGainMapSource;
@@ -751,21 +1502,49 @@ ID2D1TransformedImageSource* ImageLoader::GetLoadedImage(float zoom, bool select
     EnforceStates(1, ImageLoaderState::LoadingSucceeded);
 
     ID2D1ImageSource* source = m_imageSource.Get();
+    float scaleX = zoom;
+    float scaleY = zoom;
 
     if (selectAppleHdrGainMap == true)
     {
         if (m_imageInfo.hasAppleHdrGainMap == false) return nullptr;
         zoom *= m_imageInfo.pixelSize.Width / m_imageInfo.gainMapPixelSize.Width; // Typically is 2x.
+        scaleX = scaleY = zoom;
         source = m_hdrGainMapSource.Get();
     }
+    else
+    {
+        // Draw from the smallest pyramid level that doesn't need to be scaled up. Levels are
+        // rounded up from odd sizes, so scale to exactly cover the full resolution image. The
+        // decoded image itself is a reduced level if fitSize selected one.
+        float decodedZoom = zoom * m_imageInfo.pixelSize.Width / m_decodedSize.width;
+        unsigned int level = MipPyramid::SelectLevel(decodedZoom, static_cast<unsigned int>(m_mipImageSources.size()));
+        while (level > 0 && m_mipImageSources[level - 1] == nullptr)
+        {
+            level--;
+        }
+
+        if (level > 0)
+        {
+            auto mipSize = GetMipLevelSize(level);
+            scaleX = zoom * m_imageInfo.pixelSize.Width / mipSize.width;
+            scaleY = zoom * m_imageInfo.pixelSize.Height / mipSize.height;
+            source = m_mipImageSources[level - 1].Get();
+        }
+        else
+        {
+            scaleX = zoom * m_imageInfo.pixelSize.Width / m_decodedSize.width;
+            scaleY = zoom * m_imageInfo.pixelSize.Height / m_decodedSize.height;
+        }
+    }
 
     // When using ID2D1ImageSource, the recommend method of scaling is to use
     // ID2D1TransformedImageSource. It is inexpensive to recreate this object.
     D2D1_TRANSFORMED_IMAGE_SOURCE_PROPERTIES props =
     {
         D2D1_ORIENTATION_DEFAULT,
-        zoom,
-        zoom,
+        scaleX,
+        scaleY,
         D2D1_INTERPOLATION_MODE_LINEAR, // This is ignored when using DrawImage.
         D2D1_TRANSFORMED_IMAGE_SOURCE_OPTIONS_NONE
     };
@@ -780,6 +1559,20 @@ ID2D1TransformedImageSource* ImageLoader::GetLoadedImage(float zoom, bool select
     return output.Detach();
 }
 
+/// <summary>
+/// Size of a level of m_tiledStore, or of m_mipPyramid for untiled images. Level must be at least 1.
+/// </summary>
+D2D1_SIZE_U ImageLoader::GetMipLevelSize(unsigned int level) const
+{
+    if (m_tiledStore)
+    {
+        return D2D1::SizeU(m_tiledStore->GetWidth(level), m_tiledStore->GetHeight(level));
+    }
+
+    auto& mip = m_mipPyramid.GetLevel(level);
+    return D2D1::SizeU(mip.width, mip.height);
+}
+
 /// <summary>
 /// Gets the color context of the image.
 /// </summary>
@@ -803,20 +1596,82 @@ ImageInfo ImageLoader::GetImageInfo()
 }
 
 /// <summary>
-/// For testing only. Obtains the cached WIC source.
+/// Gets the decoded pixels, for exporting the image without the render pipeline.
 /// </summary>
-IWICBitmapSource* ImageLoader::GetWicSourceTest()
+/// <remarks>
+/// Pixels are in the format ImageLoader keeps them: premultiplied FP16, 16 bit or 8 bit RGBA, or
+/// 10 bit BT.2100 PQ for HDR10 HEIF images. Very large images are read from the file on demand.
+/// If ImageLoaderOptions::fitSize selected a reduced DDS mip level, only that level is available.
+/// </remarks>
+IWICBitmapSource* ImageLoader::GetDecodedImage()
 {
+    EnforceStates(2, ImageLoaderState::LoadingSucceeded, ImageLoaderState::NeedDeviceResources);
+
     return m_wicCachedSource.Get();
 }
 
 /// <summary>
-/// Recreates device resources after device lost.
+/// Loads bitmap as if libheif had decoded it from a HEIF file, so that the handling of
+/// TryLoadHeifHdr10 and TryLoadHeifSdr output can be tested without an HEVC codec.
+/// </summary>
+ImageInfo ImageLoader::LoadHeifBitmapTest(_In_ IWICBitmapSource* bitmap)
+{
+    m_imageInfo.isHeif = true;
+    LoadHeifBitmap(bitmap);
+
+    return m_imageInfo;
+}
+
+/// <summary>
+/// Estimates the memory held by the decoded image, for DecodedImageCache's budget.
+/// </summary>
+uint64_t ImageLoader::GetDecodedSizeInBytes() const
+{
+    if (m_state != ImageLoaderState::LoadingSucceeded &&
+        m_state != ImageLoaderState::NeedDeviceResources)
+    {
+        return 0;
+    }
+
+    uint64_t size = 0;
+    UINT width = 0, height = 0;
+    WICPixelFormatGUID fmt = {};
+
+    if (m_tiledStore)
+    {
+        // At most the tile cache is held in memory.
+        size += m_tiledStore->GetBudget();
+    }
+    else if (m_rgbeSource)
+    {
+        size += m_rgbeSource->GetSizeInBytes();
+    }
+    // Every other path stores m_wicCachedSource as an IWICBitmap.
+    else if (m_wicCachedSource &&
+        SUCCEEDED(m_wicCachedSource->GetSize(&width, &height)) &&
+        SUCCEEDED(m_wicCachedSource->GetPixelFormat(&fmt)))
+    {
+        // 32bpp HDR10 or BGRA, otherwise 64bpp half/UNORM.
+        uint64_t bytesPerPixel = (fmt == GUID_WICPixelFormat32bppR10G10B10A2HDR10 || fmt == GUID_WICPixelFormat32bppPBGRA) ? 4 : 8;
+        size += uint64_t(width) * height * bytesPerPixel;
+    }
+
+    if (m_imageInfo.hasAppleHdrGainMap)
+    {
+        // 32bpp BGRA.
+        size += uint64_t(m_imageInfo.gainMapPixelSize.Width) * uint64_t(m_imageInfo.gainMapPixelSize.Height) * 4;
+    }
+
+    return size + m_mipPyramid.GetSizeInBytes();
+}
+
+/// <summary>
+/// Creates device resources after loading, and recreates them after device lost or after
+/// the image is taken back out of DecodedImageCache.
 /// </summary>
 /// <remarks>
 /// ImageLoader doesn't implement IDeviceNotify and relies on the caller to tell it
 /// when device resources need to be recreated.
-/// Don't call this during normal image load/initialization as this is done automatically.
 /// </remarks>
 void ImageLoader::CreateDeviceDependentResources()
 {
@@ -840,7 +1695,8 @@ void ImageLoader::CreateDeviceDependentResources()
 }
 
 /// <summary>
-/// Releases (invalid) device resources after device lost.
+/// Releases (invalid) device resources after device lost, or GPU memory when the image
+/// is no longer displayed but is kept in DecodedImageCache.
 /// </summary>
 /// <remarks>
 /// ImageLoader doesn't implement IDeviceNotify and relies on the caller to tell it
@@ -862,6 +1718,7 @@ void ImageLoader::ReleaseDeviceDependentResources()
         m_imageSource.Reset();
         m_colorContext.Reset();
         m_hdrGainMapSource.Reset();
+        m_mipImageSources.clear();
         break;
 
     case ImageLoaderState::NeedDeviceResources:
@@ -1056,8 +1913,6 @@ GUID ImageLoader::TranslateDxgiFormatToWic(DXGI_FORMAT fmt)
         break;
 
     case DXGI_FORMAT_R32G32B32A32_FLOAT:
-        // Used by Radiance RGBE; specifically DirectXTex expands out to FP32
-        // even though WIC offers a native GUID_WICPixelFormat32bppRGBE.
         return GUID_WICPixelFormat128bppRGBAFloat;
         break;
 
@@ -10,6 +10,15 @@
 // of device lost/restored events, i.e. it does not
 // independently register for IDeviceNotify.
 //
+// Loading only creates device-independent resources (fully
+// decoded WIC bitmaps), so it may run on a background thread
+// and the result can be kept in DecodedImageCache. The caller
+// creates device resources with CreateDeviceDependentResources.
+// Very large OpenEXR and DDS images are the exception: they are
+// left in the file and decoded a tile at a time as they are
+// drawn, see TiledImageStore. Radiance RGBE images are kept in
+// their packed file encoding, see RgbeBitmapSource.
+//
 // Throws WINCODEC_ERR_[foo] HRESULTs in exceptions as these
 // match well with the intended error states.
 //
@@ -19,6 +28,10 @@
 #include "Common\DeviceResources.h"
 #include "ImageInfo.h"
 #include "LibHeifHelpers.h"
+#include "CpuRender\LuminanceHistogram.h"
+#include "CpuRender\MipPyramid.h"
+#include "RgbeBitmapSource.h"
+#include "TiledImageStore.h"
 
 #include <cstdarg>
 
@@ -29,7 +42,7 @@ namespace DXRenderer
     /// </summary>
     /// <remarks>
     /// Valid transitions:
-    /// NotInitialized      --> LoadingSucceeded || LoadingFailed
+    /// NotInitialized      --> NeedDeviceResources || LoadingFailed
     /// LoadingFailed       --> [N/A]
     /// LoadingSucceeded    --> NeedDeviceResources
     /// NeedDeviceResources --> LoadingSucceeded
@@ -82,6 +95,19 @@ namespace DXRenderer
     {
         ImageLoaderOptionsType type;
         CustomSdrColorSpace customColorSpace;
+        // Window size in DIPs. If set, DDS files with mips only decode the level that
+        // FitImageToWindow would draw; zooming in further shows that level scaled up.
+        // ImageInfo::pixelSize is still the size of the full resolution image.
+        Windows::Foundation::Size fitSize;
+    };
+
+    // Identifies a decoded image in DecodedImageCache. Together with ImageLoaderOptions,
+    // a path and last modified time change whenever the decoded pixels would.
+    [Windows::Foundation::Metadata::WebHostHidden]
+    public value struct ImageCacheKey
+    {
+        Platform::String^ path; // Empty disables caching.
+        Windows::Foundation::DateTime lastModified;
     };
 
     class ImageLoader
@@ -92,14 +118,17 @@ namespace DXRenderer
 
         ImageLoaderState GetState() const { return m_state; };
 
-        ImageInfo LoadImageFromWic(_In_ IStream* imageStream);
+        ImageInfo LoadImageFromWic(_In_ IStream* imageStream, _In_ HANDLE imageFile = INVALID_HANDLE_VALUE);
         ImageInfo LoadImageFromDirectXTex(_In_ Platform::String^ filename, _In_ Platform::String^ extension);
 
         ID2D1TransformedImageSource* GetLoadedImage(float zoom, bool selectAppleHdrGainMap);
 
         ID2D1ColorContext* GetImageColorContext();
         ImageInfo GetImageInfo();
-        IWICBitmapSource* GetWicSourceTest();
+        IWICBitmapSource* GetDecodedImage();
+        ImageInfo LoadHeifBitmapTest(_In_ IWICBitmapSource* bitmap);
+        uint64_t GetDecodedSizeInBytes() const;
+        HistogramCLL GetFileCLL() const { return m_fileCLL; }
 
         void CreateDeviceDependentResources();
         void ReleaseDeviceDependentResources();
@@ -148,9 +177,15 @@ namespace DXRenderer
 
         inline HRESULT HEIFHR(heif_error herr) { return herr.code == heif_error_code::heif_error_Ok ? S_OK : WINCODEC_ERR_GENERIC_ERROR; }
 
-        void LoadImageFromWicInt(_In_ IStream* imageStream);
+        void LoadImageFromWicInt(_In_ IStream* imageStream, _In_ HANDLE imageFile);
         void LoadImageFromDirectXTexInt(_In_ Platform::String^ filename, _In_ Platform::String^ extension);
-        void LoadImageCommon(_In_ IWICBitmapSource* source);
+        void LoadImageCommon(_In_ IWICBitmapSource* source, _In_opt_ const WICPixelFormatGUID* nativeFormat = nullptr);
+        void LoadHeifBitmap(_In_ IWICBitmapSource* bitmap);
+        bool TryLoadTiledImage(_In_ Platform::String^ filename, _In_ Platform::String^ extension);
+        size_t SelectFittedMipLevel(_In_ Platform::String^ filename, _In_ Platform::String^ extension);
+        void SetFullResolutionSize(const DirectX::TexMetadata& metadata);
+        bool TryDecompressToBitmap(const DirectX::Image& image, Microsoft::WRL::ComPtr<IWICBitmap>& bitmap, WICPixelFormatGUID& nativeFormat);
+        void SetEXRChromaticities(const DirectX::EXRChromaticities& chromaticities);
         void CreateDeviceDependentResourcesInternal();
 
         void PopulateImageInfoACKind(ImageInfo& info, _In_ IWICBitmapSource* source);
@@ -160,8 +195,16 @@ namespace DXRenderer
         bool CheckCanDecode(_In_ IWICBitmapFrameDecode* frame);
         void CreateHeifHdr10CpuResources(_In_ IWICBitmapSource* source);
         void CreateHeifHdr10GpuResources();
-        bool TryLoadAppleHdrGainMapHeic(_In_ IStream* imageStream);
-        bool TryLoadAppleHdrGainMapJpegMpo(_In_ IStream* imageStream, _In_ IWICBitmapFrameDecode* frame);
+        bool TryOpenHeif(_In_ IStream* imageStream, _In_ HANDLE imageFile, CHeifFileData& file, CHeifContext& ctx, CHeifHandle& primary);
+        bool TryReadHeif(const CHeifFileData& file, CHeifContext& ctx, CHeifHandle& primary);
+        bool TryLoadHeifHdr10(const CHeifFileData& file, _In_ heif_image_handle* primary, Microsoft::WRL::ComPtr<IWICBitmap>& bitmap);
+        bool TryLoadHeifSdr(const CHeifFileData& file, _In_ heif_image_handle* primary, Microsoft::WRL::ComPtr<IWICBitmap>& bitmap);
+        bool TryGetAppleHdrGainMapHeic(_In_ heif_image_handle* primary, CHeifHandle& gainMap);
+        bool TryLoadAppleHdrGainMapHeic(_In_ heif_image_handle* gainMap);
+        bool TryLoadAppleHdrGainMapJpegMpo(_In_ IStream* imageStream);
+        bool TryBuildMipPyramid();
+        bool TryCreateMipImageSources();
+        D2D1_SIZE_U GetMipLevelSize(unsigned int level) const;
 
         std::shared_ptr<DeviceResources>                        m_deviceResources;
 
@@ -169,6 +212,12 @@ namespace DXRenderer
         Microsoft::WRL::ComPtr<IWICBitmapSource>                m_wicCachedSource;
         Microsoft::WRL::ComPtr<IWICColorContext>                m_wicColorContext;
         CHeifImageWithWicSource                                 m_appleHdrGainMap;
+        MipPyramid                                              m_mipPyramid;
+        std::shared_ptr<TiledImageStore>                        m_tiledStore; // Only set for images too large to decode up front.
+        Microsoft::WRL::ComPtr<RgbeBitmapSource>                m_rgbeSource; // Only set for Radiance RGBE images.
+        bool                                                    m_decodedByLibheif; // Pixels are already FP16 scRGB or 8 bit sRGB.
+        D2D1_SIZE_U                                             m_decodedSize; // Of m_wicCachedSource; less than pixelSize if a reduced mip level was decoded.
+        HistogramCLL                                            m_fileCLL; // Computed while decoding; -1 unless an OpenEXR file without overrides.
 
         ImageLoaderState                                        m_state;
         ImageInfo                                               m_imageInfo;
@@ -179,19 +228,10 @@ namespace DXRenderer
         Microsoft::WRL::ComPtr<ID2D1ImageSource>                m_imageSource;
         Microsoft::WRL::ComPtr<ID2D1ImageSource>                m_hdrGainMapSource;
         Microsoft::WRL::ComPtr<ID2D1ColorContext>               m_colorContext;
+        std::vector<Microsoft::WRL::ComPtr<ID2D1ImageSource>>   m_mipImageSources; // Index is level - 1. Null if not drawable.
 
         // 128 byte ICC profile header for Xbox console HDR screen captures.
         const unsigned char                                     m_xboxHdrIccHeaderBytes[128];
         const unsigned int                                      m_xboxHdrIccSize;
-
-        // 90 byte "known" APP2 MP Extension block for Apple HDR gainmap JPEG images.
-        // Reference: http://cipa.jp/std/documents/e/DC-X007_E.pdf
-        const unsigned char                                     m_appleApp2MPBlock[90];
-
-        // Indices for the 12 bytes of known dynamic data in the APP2 block.
-        const unsigned int                                      m_appleApp2MPBlockDynamicBytes[12];
-
-        // Offset of the 4 byte uint32 representing the EOI of the primary image.
-        const unsigned int                                      m_appleApp2MPBlockMagicOffset;
     };
 }
@@ -0,0 +1,76 @@
+#include "pch.h"
+#include "ImageStatistics.h"
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+using namespace DXRenderer;
+
+namespace
+{
+    /// <summary>
+    /// Y of an OpenEXR file's RGB space; equivalent to converting to scRGB like the Direct2D
+    /// color management effect does and then taking BT.709 luminance.
+    /// </summary>
+    XMFLOAT3 GetLuminanceWeights(const EXRChromaticities& c)
+    {
+        // The white point is stored as XYZ normalized to Y = 1.
+        float whiteSum = c.WhiteX + c.WhiteY + c.WhiteZ;
+
+        return LuminanceHistogram::GetLuminanceWeights(
+            c.RedX, c.RedY, c.GreenX, c.GreenY, c.BlueX, c.BlueY,
+            c.WhiteX / whiteSum, c.WhiteY / whiteSum);
+    }
+}
+
+HRESULT DXRenderer::ScanExrFileCLL(
+    const wchar_t* filename,
+    TexMetadata* metadata,
+    EXRChromaticities* chromaticities,
+    HistogramCLL& cll,
+    unsigned int threadCount,
+    const EXRScanlineCallback& onBand)
+{
+    cll = {};
+
+    // The chromaticities are only known once the header has been read, so the histogram is created
+    // by the first callback.
+    EXRChromaticities fileChromaticities = {};
+    std::unique_ptr<LuminanceHistogram> histogram;
+
+    HRESULT hr = ScanEXRFile(filename, metadata, &fileChromaticities, [&](const Image& band, size_t firstRow)
+    {
+        if (!histogram)
+        {
+            if (chromaticities)
+            {
+                *chromaticities = fileChromaticities;
+            }
+
+            histogram = fileChromaticities.Valid ?
+                std::make_unique<LuminanceHistogram>(GetLuminanceWeights(fileChromaticities)) :
+                std::make_unique<LuminanceHistogram>();
+        }
+
+        if (onBand)
+        {
+            HRESULT bandHr = onBand(band, firstRow);
+            if (FAILED(bandHr)) return bandHr;
+        }
+
+        histogram->AddPixels(
+            reinterpret_cast<const XMHALF4*>(band.pixels),
+            static_cast<unsigned int>(band.width),
+            static_cast<unsigned int>(band.height),
+            band.rowPitch,
+            threadCount);
+
+        return S_OK;
+    }, threadCount);
+
+    if (FAILED(hr)) return hr;
+
+    cll = histogram->ComputeCLL();
+
+    return S_OK;
+}
@@ -0,0 +1,40 @@
+//*********************************************************
+//
+// ImageStatistics
+//
+// Computes HDR metadata (MaxCLL and median CLL) of OpenEXR
+// files by streaming them through the luminance histogram a
+// band at a time, so memory use does not depend on image size.
+// Used both by ImageLoader, which keeps the bands it is given,
+// and by HeifUtil to audit large image libraries, so it does
+// not depend on the Windows Runtime.
+//
+// The histogram matches the one used by
+// HDRImageViewerRenderer::ComputeHdrMetadata, except that it
+// runs on the full resolution image.
+//
+//*********************************************************
+
+#pragma once
+#include "CpuRender\LuminanceHistogram.h"
+#include "DirectXTex\DirectXTexEXR.h"
+
+namespace DXRenderer
+{
+    /// <summary>
+    /// Streams an OpenEXR file through the luminance histogram, using the file's chromaticities if it
+    /// has them. Never holds more than the two band buffers used by DirectX::ScanEXRFile.
+    /// </summary>
+    /// <param name="onBand">Optional; sees each band before it is histogrammed, so a caller that keeps
+    /// the pixels only decodes the file once. metadata and chromaticities are set by then.</param>
+    /// <param name="cll">maxNits and medianNits are 0 if the image is pure black.</param>
+    /// <param name="threadCount">Threads used for decoding and histogramming; 0 means use all
+    /// hardware threads. Pass 1 when analyzing several files in parallel.</param>
+    HRESULT ScanExrFileCLL(
+        _In_z_ const wchar_t* filename,
+        _Out_opt_ DirectX::TexMetadata* metadata,
+        _Out_opt_ DirectX::EXRChromaticities* chromaticities,
+        _Out_ HistogramCLL& cll,
+        unsigned int threadCount = 0,
+        const DirectX::EXRScanlineCallback& onBand = nullptr);
+}
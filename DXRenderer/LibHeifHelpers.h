@@ -1,6 +1,10 @@
 #pragma once
 #include "pch.h"
 
+#include "Common\MemoryMappedFile.h"
+
+#include <vector>
+
 namespace DXRenderer
 {
     /// <summary>
@@ -49,4 +53,101 @@ namespace DXRenderer
         bool IsAppleHdrGainMap() { return strcmp(ptr, "urn:com:apple:photo:2020:aux:hdrgainmap") == 0; }
         const char* ptr = nullptr;
     };
+    /// <summary>
+    /// RAII wrapper for heif_color_profile_nclx
+    /// </summary>
+    class CHeifNclx {
+    public:
+        ~CHeifNclx() { if (ptr) heif_nclx_color_profile_free(ptr); }
+        heif_color_profile_nclx* ptr = nullptr;
+    };
+
+    /// <summary>
+    /// The bytes of a HEIF file, which libheif reads in place through
+    /// heif_context_read_from_memory_without_copy. The file is memory-mapped when there is a handle to
+    /// it; a stream that isn't backed by a local file is copied. Must outlive any heif_context reading
+    /// from it, and may be shared by several.
+    /// </summary>
+    class CHeifFileData {
+    public:
+        CHeifFileData() : m_data(nullptr), m_size(0) {}
+
+        /// <param name="file">Handle with read access to the file behind stream, or INVALID_HANDLE_VALUE.</param>
+        HRESULT Load(_In_ HANDLE file, _In_ IStream* stream)
+        {
+            if (file != INVALID_HANDLE_VALUE && m_file.Map(file))
+            {
+                m_data = m_file.GetData();
+                m_size = static_cast<size_t>(m_file.GetSize());
+                return S_OK;
+            }
+
+            STATSTG stats = {};
+            HRESULT hr = stream->Stat(&stats, STATFLAG_NONAME);
+            if (FAILED(hr)) return hr;
+            if (stats.cbSize.QuadPart > SIZE_MAX) return E_OUTOFMEMORY;
+
+            try
+            {
+                m_copy.resize(static_cast<size_t>(stats.cbSize.QuadPart));
+            }
+            catch (const std::bad_alloc&)
+            {
+                return E_OUTOFMEMORY;
+            }
+
+            hr = stream->Seek({}, STREAM_SEEK_SET, nullptr);
+            if (FAILED(hr)) return hr;
+
+            // IStream::Read is limited to 4GB at a time.
+            size_t offset = 0;
+            while (offset < m_copy.size())
+            {
+                ULONG chunk = static_cast<ULONG>((std::min)(m_copy.size() - offset, static_cast<size_t>(ULONG_MAX)));
+                ULONG cbRead = 0;
+                hr = stream->Read(m_copy.data() + offset, chunk, &cbRead);
+                if (FAILED(hr)) return hr;
+                if (cbRead == 0) return WINCODEC_ERR_STREAMREAD;
+
+                offset += cbRead;
+            }
+
+            m_data = m_copy.data();
+            m_size = m_copy.size();
+            return S_OK;
+        }
+
+        const uint8_t* GetData() const { return m_data; }
+        size_t GetSize() const { return m_size; }
+
+    private:
+        MemoryMappedFile                                        m_file;
+        std::vector<uint8_t>                                    m_copy;
+        const uint8_t*                                          m_data;
+        size_t                                                  m_size;
+    };
+
+    /// <summary>
+    /// Whether a primary image with more than 8 bits per channel is HDR10: BT.2100 PQ with BT.2020
+    /// primaries and matrix. Images without an nclx profile are assumed to be, as WIC does.
+    /// </summary>
+    /// <param name="fullRange">Receives the nclx range flag; false (video range) if there is no profile.</param>
+    inline bool IsHeifHdr10(heif_image_handle* handle, _Out_opt_ bool* fullRange = nullptr)
+    {
+        if (fullRange) *fullRange = false;
+
+        if (heif_image_handle_get_luma_bits_per_pixel(handle) <= 8) return false;
+
+        CHeifNclx nclx;
+        if (heif_image_handle_get_nclx_color_profile(handle, &nclx.ptr).code != heif_error_Ok) return true;
+
+        if (fullRange) *fullRange = nclx.ptr->full_range_flag != 0;
+
+        return nclx.ptr->transfer_characteristics == heif_transfer_characteristic_ITU_R_BT_2100_0_PQ &&
+            (nclx.ptr->color_primaries == heif_color_primaries_ITU_R_BT_2020_2_and_2100_0 ||
+             nclx.ptr->color_primaries == heif_color_primaries_unspecified) &&
+            (nclx.ptr->matrix_coefficients == heif_matrix_coefficients_ITU_R_BT_2020_2_non_constant_luminance ||
+             nclx.ptr->matrix_coefficients == heif_matrix_coefficients_unspecified);
+    }
+
 }
\ No newline at end of file
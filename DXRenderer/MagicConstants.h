@@ -7,8 +7,22 @@ static const float sc_DefaultImageMedCLL = 80.0f; // Needs more tuning based on
 static const float sc_MaxZoom = 1.0f; // Restrict max zoom to 1:1 scale.
 static const float sc_MinZoomSphereMap = 0.25f;
 
+// Same value as D2D1_SCENE_REFERRED_SDR_WHITE_LEVEL, for code which does not depend on Direct2D headers.
+static const float sc_SceneReferredSdrWhiteNits = 80.0f;
+
 // 400 bins with gamma of 10 lets us measure luminance to within 10% error for any
 // luminance above ~1.5 nits, up to 1 million nits.
 static const unsigned int sc_histNumBins = 400;
 static const float        sc_histGamma = 0.1f;
-static const unsigned int sc_histMaxNits = 1000000;
\ No newline at end of file
+static const unsigned int sc_histMaxNits = 1000000;
+
+// Decoded images kept in memory for fast switching between images; see DecodedImageCache.
+static const uint64_t sc_DefaultImageCacheBudgetBytes = 1024ull * 1024 * 1024;
+
+// ImageLoader's mip pyramid stops at the first level smaller than this in both dimensions.
+static const unsigned int sc_MipMinDimension = 256;
+
+// OpenEXR and DDS images whose FP16 decoded size is at least this are decoded on demand a tile
+// at a time from the file (see TiledImageStore), and only this much of the image is kept decoded.
+static const uint64_t sc_TiledImageMinBytes = 1024ull * 1024 * 1024;
+static const uint64_t sc_TileCacheBudgetBytes = 256ull * 1024 * 1024;
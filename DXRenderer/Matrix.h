@@ -1,98 +1,185 @@
+//*********************************************************
+//
+// Matrix
+//
+// Fixed size 3x3 matrix and 3 vector for color conversions.
+// No allocation, and every operation is constexpr so that
+// conversions between standard color spaces are computed at
+// compile time; the same functions derive display and image
+// conversions from chromaticities at run time.
+//
+// Matrices multiply column vectors, out = M * in, and are
+// stored row major, the same as the color matrices in the
+// literature. DirectXMath and Direct2D multiply row vectors,
+// so convert with the transpose.
+//
+//*********************************************************
+
 #pragma once
-#include <vector>
-#include <cassert>
-struct Matrix
+
+#include <cstddef>
+
+namespace DXRenderer
 {
-    Matrix(size_t x, size_t y) : X(x), Y(y)
+    template <typename T>
+    struct Vector3
     {
-        M.resize(x * y);
-    }
+        T x, y, z;
+    };
 
-    double& Index(size_t i_x, size_t i_y)
+    template <typename T>
+    struct Matrix3x3
     {
-        return M[i_y * X + i_x];
-    }
+        T M[9];
 
-    Matrix operator*(const Matrix& rhs)
-    {
-        assert(X == rhs.Y);
-        Matrix ret(rhs.X, Y);
+        constexpr T operator()(size_t row, size_t col) const
+        {
+            return M[row * 3 + col];
+        }
 
-        size_t x, y;
-        for (size_t i = 0; i < ret.M.size(); i++)
+        static constexpr Matrix3x3 Identity()
         {
-            x = i % ret.X;
-            y = i / ret.X;
+            return Diagonal({ 1, 1, 1 });
+        }
 
-            ret.M[i] = 0;
+        static constexpr Matrix3x3 Diagonal(const Vector3<T>& d)
+        {
+            return { { d.x, 0, 0, 0, d.y, 0, 0, 0, d.z } };
+        }
 
-            for (size_t r = 0; r < X; r++)
+        constexpr Matrix3x3 operator*(const Matrix3x3& rhs) const
+        {
+            Matrix3x3 ret = {};
+
+            for (size_t row = 0; row < 3; row++)
             {
-                ret.M[i] += M[X * y + r] * rhs.M[rhs.X * r + x];
+                for (size_t col = 0; col < 3; col++)
+                {
+                    ret.M[row * 3 + col] =
+                        M[row * 3 + 0] * rhs.M[0 + col] +
+                        M[row * 3 + 1] * rhs.M[3 + col] +
+                        M[row * 3 + 2] * rhs.M[6 + col];
+                }
             }
+
+            return ret;
         }
 
-        return ret;
-    }
+        constexpr Vector3<T> operator*(const Vector3<T>& v) const
+        {
+            return {
+                M[0] * v.x + M[1] * v.y + M[2] * v.z,
+                M[3] * v.x + M[4] * v.y + M[5] * v.z,
+                M[6] * v.x + M[7] * v.y + M[8] * v.z };
+        }
 
-    Matrix SubMatrix(size_t x_start, size_t y_start, size_t width, size_t height)
-    {
-        assert((x_start + width) <= X && (y_start + height) <= Y);
+        constexpr Matrix3x3 Transpose() const
+        {
+            return { { M[0], M[3], M[6], M[1], M[4], M[7], M[2], M[5], M[8] } };
+        }
 
-        Matrix ret(width, height);
-        size_t index = 0;
+        constexpr T Determinant() const
+        {
+            return
+                M[0] * (M[4] * M[8] - M[5] * M[7]) -
+                M[1] * (M[3] * M[8] - M[5] * M[6]) +
+                M[2] * (M[3] * M[7] - M[4] * M[6]);
+        }
 
-        for (size_t y = y_start; y < y_start + height; y++)
+        /// <summary>
+        /// Color matrices are always invertible; the result is undefined if the determinant is 0.
+        /// </summary>
+        constexpr Matrix3x3 Invert() const
         {
-            for (size_t x = x_start; x < x_start + width; x++)
-            {
-                ret.M[index++] = M[y * X + x % X];
-            }
+            T det = Determinant();
+
+            // Transposed cofactors.
+            return { {
+                (M[4] * M[8] - M[5] * M[7]) / det,
+                (M[2] * M[7] - M[1] * M[8]) / det,
+                (M[1] * M[5] - M[2] * M[4]) / det,
+                (M[5] * M[6] - M[3] * M[8]) / det,
+                (M[0] * M[8] - M[2] * M[6]) / det,
+                (M[2] * M[3] - M[0] * M[5]) / det,
+                (M[3] * M[7] - M[4] * M[6]) / det,
+                (M[1] * M[6] - M[0] * M[7]) / det,
+                (M[0] * M[4] - M[1] * M[3]) / det } };
         }
 
-        return ret;
-    }
+        /// <summary>
+        /// CIEXYZ of a CIE xy chromaticity, with Y = 1.
+        /// </summary>
+        static constexpr Vector3<T> XyToXyz(T x, T y)
+        {
+            return { x / y, 1, (1 - x - y) / y };
+        }
 
-    double Determinant()
-    {
-        assert(X == Y);
+        /// <summary>
+        /// Returns the 3x3 matrix which converts linear RGB with the given CIE xy primaries
+        /// and white point to CIEXYZ, normalized so that the white point has Y = 1.
+        /// </summary>
+        static constexpr Matrix3x3 RgbToXyz(T redX, T redY, T greenX, T greenY, T blueX, T blueY, T whiteX, T whiteY)
+        {
+            // Columns are the XYZ of each primary, scaled so that RGB (1, 1, 1) is the white point.
+            Vector3<T> r = XyToXyz(redX, redY);
+            Vector3<T> g = XyToXyz(greenX, greenY);
+            Vector3<T> b = XyToXyz(blueX, blueY);
 
-        // I'm lazy and only worrying about the 3x3 case right now.
-        assert(Y == 3);
+            Matrix3x3 primaries = { { r.x, g.x, b.x, r.y, g.y, b.y, r.z, g.z, b.z } };
 
-        double ret = 0;
+            return primaries * Diagonal(primaries.Invert() * XyToXyz(whiteX, whiteY));
+        }
 
-        for (size_t x = 0; x < X; x++)
+        /// <summary>
+        /// Bradford chromatic adaptation of CIEXYZ from one white point to another.
+        /// </summary>
+        static constexpr Matrix3x3 BradfordAdaptation(T sourceWhiteX, T sourceWhiteY, T destWhiteX, T destWhiteY)
         {
-            ret += (Index(0, x) *
-                (Index(1, (x + 1) % 3) * Index(2, (x + 2) % 3) -
-                    Index(1, (x + 2) % 3) * Index(2, (x + 1) % 3)));
+            Matrix3x3 bradford = { {
+                 0.8951,  0.2664, -0.1614,
+                -0.7502,  1.7135,  0.0367,
+                 0.0389, -0.0685,  1.0296 } };
+
+            // Scale each cone response by the ratio of the two whites.
+            Vector3<T> source = bradford * XyToXyz(sourceWhiteX, sourceWhiteY);
+            Vector3<T> dest = bradford * XyToXyz(destWhiteX, destWhiteY);
+
+            return bradford.Invert() * Diagonal({ dest.x / source.x, dest.y / source.y, dest.z / source.z }) * bradford;
         }
 
-        return ret;
-    }
+        /// <summary>
+        /// Same as RgbToXyz, but to CIEXYZ relative to D65, the white point of scRGB. Other white
+        /// points are adapted with BradfordAdaptation, so that the source white becomes D65 white.
+        /// </summary>
+        static constexpr Matrix3x3 RgbToXyzD65(T redX, T redY, T greenX, T greenY, T blueX, T blueY, T whiteX, T whiteY);
+    };
+
+    // CIE xy of the D65 white point.
+    constexpr double sc_D65WhiteX = 0.3127;
+    constexpr double sc_D65WhiteY = 0.3290;
 
-    Matrix Invert()
+    template <typename T>
+    constexpr Matrix3x3<T> Matrix3x3<T>::RgbToXyzD65(T redX, T redY, T greenX, T greenY, T blueX, T blueY, T whiteX, T whiteY)
     {
-        // Basically all color matrices are 3x3 - I'm only worrying about that here
-        assert(X == Y && X == 3);
+        // The adaptation is the identity for a D65 white.
+        return BradfordAdaptation(whiteX, whiteY, static_cast<T>(sc_D65WhiteX), static_cast<T>(sc_D65WhiteY)) *
+            RgbToXyz(redX, redY, greenX, greenY, blueX, blueY, whiteX, whiteY);
+    }
 
-        Matrix ret(3, 3);
-        double det = Determinant();
+    typedef Matrix3x3<double> ColorMatrix;
 
-        assert(det > 0);
+    // Linear RGB to CIEXYZ (Y = 1 for white) of the standard color spaces, computed at compile time.
 
-        for (int i = 0; i < 3; i++)
-        {
-            for (int j = 0; j < 3; j++)
-            {
-                ret.Index(i, j) = ((Index((j + 1) % 3, (i + 1) % 3) * Index((j + 2) % 3, (i + 2) % 3)) - (Index((j + 1) % 3, (i + 2) % 3) * Index((j + 2) % 3, (i + 1) % 3))) / det;
-            }
-        }
+    // BT.709 and sRGB primaries, which scRGB also uses.
+    constexpr ColorMatrix sc_ScRgbToXyz = ColorMatrix::RgbToXyz(0.640, 0.330, 0.300, 0.600, 0.150, 0.060, sc_D65WhiteX, sc_D65WhiteY);
+    constexpr ColorMatrix sc_XyzToScRgb = sc_ScRgbToXyz.Invert();
 
-        return ret;
-    }
+    // Display P3 (DCI-P3 primaries with a D65 white point).
+    constexpr ColorMatrix sc_DisplayP3ToXyz = ColorMatrix::RgbToXyz(0.680, 0.320, 0.265, 0.690, 0.150, 0.060, sc_D65WhiteX, sc_D65WhiteY);
+
+    // BT.2020 and BT.2100.
+    constexpr ColorMatrix sc_Bt2020ToXyz = ColorMatrix::RgbToXyz(0.708, 0.292, 0.170, 0.797, 0.131, 0.046, sc_D65WhiteX, sc_D65WhiteY);
 
-    const size_t X, Y;
-    std::vector<double> M;
-};
\ No newline at end of file
+    // ProPhoto (ROMM) RGB has a D50 white point, so it is adapted to D65.
+    constexpr ColorMatrix sc_ProPhotoToXyz = ColorMatrix::RgbToXyzD65(0.7347, 0.2653, 0.1596, 0.8404, 0.0366, 0.0001, 0.3457, 0.3585);
+}
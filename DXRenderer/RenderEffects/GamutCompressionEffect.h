@@ -0,0 +1,98 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+// {FBEB939E-6AC7-48F9-BB9E-AC5DEE2DAB9F}
+DEFINE_GUID(GUID_GamutCompressionPixelShader,
+    0xfbeb939e, 0x6ac7, 0x48f9, 0xbb, 0x9e, 0xac, 0x5d, 0xee, 0x2d, 0xab, 0x9f);
+
+// {BC729460-31D4-4200-8A2A-759C55DCD00C}
+DEFINE_GUID(CLSID_CustomGamutCompressionEffect,
+    0xbc729460, 0x31d4, 0x4200, 0x8a, 0x2a, 0x75, 0x9c, 0x55, 0xdc, 0xd0, 0x0c);
+
+#include "..\CpuRender\GamutCompressor.h"
+
+enum GAMUTCOMPRESSION_PROP
+{
+    // D2D1_MATRIX_4X4_F, linear scRGB to linear panel RGB. Same (row vector) convention as
+    // D2D1_COLORMATRIX_PROP_COLOR_MATRIX; only the upper 3x3 is used.
+    GAMUTCOMPRESSION_PROP_SCRGB_TO_PANEL = 0
+};
+
+// Single pass replacement for the two ColorMatrix effects which used to constrain output to the
+// display's gamut; see CpuRender\GamutCompressor.h for the algorithm.
+// Our effect contains one transform, which is simply a wrapper around a pixel shader. As such,
+// we can simply make the effect itself act as the transform.
+class GamutCompressionEffect : public ID2D1EffectImpl, public ID2D1DrawTransform
+{
+public:
+    // Declare effect registration methods.
+    static HRESULT Register(_In_ ID2D1Factory1* pFactory);
+
+    static HRESULT __stdcall CreateGamutCompressionImpl(_Outptr_ IUnknown** ppEffectImpl);
+
+    // Declare property getter/setters
+    HRESULT SetScRgbToPanel(D2D1_MATRIX_4X4_F matrix);
+    D2D1_MATRIX_4X4_F GetScRgbToPanel() const;
+
+    // Declare ID2D1EffectImpl implementation methods.
+    IFACEMETHODIMP Initialize(
+        _In_ ID2D1EffectContext* pContextInternal,
+        _In_ ID2D1TransformGraph* pTransformGraph
+        );
+
+    IFACEMETHODIMP PrepareForRender(D2D1_CHANGE_TYPE changeType);
+
+    IFACEMETHODIMP SetGraph(_In_ ID2D1TransformGraph* pGraph);
+
+    // Declare ID2D1DrawTransform implementation methods.
+    IFACEMETHODIMP SetDrawInfo(_In_ ID2D1DrawInfo* pRenderInfo);
+
+    // Declare ID2D1Transform implementation methods.
+    IFACEMETHODIMP MapOutputRectToInputRects(
+        _In_ const D2D1_RECT_L* pOutputRect,
+        _Out_writes_(inputRectCount) D2D1_RECT_L* pInputRects,
+        UINT32 inputRectCount
+        ) const;
+
+    IFACEMETHODIMP MapInputRectsToOutputRect(
+        _In_reads_(inputRectCount) CONST D2D1_RECT_L* pInputRects,
+        _In_reads_(inputRectCount) CONST D2D1_RECT_L* pInputOpaqueSubRects,
+        UINT32 inputRectCount,
+        _Out_ D2D1_RECT_L* pOutputRect,
+        _Out_ D2D1_RECT_L* pOutputOpaqueSubRect
+        );
+
+    IFACEMETHODIMP MapInvalidRect(
+        UINT32 inputIndex,
+        D2D1_RECT_L invalidInputRect,
+        _Out_ D2D1_RECT_L* pInvalidOutputRect
+        ) const;
+
+    // Declare ID2D1TransformNode implementation methods.
+    IFACEMETHODIMP_(UINT32) GetInputCount() const;
+
+    // Declare IUnknown implementation methods.
+    IFACEMETHODIMP_(ULONG) AddRef();
+    IFACEMETHODIMP_(ULONG) Release();
+    IFACEMETHODIMP QueryInterface(_In_ REFIID riid, _Outptr_ void** ppOutput);
+
+private:
+    GamutCompressionEffect();
+    HRESULT UpdateConstants();
+
+    // The constant buffer of the pixel shader. Derived from m_scRgbToPanel when the matrix changes.
+    DXRenderer::GamutCompressionConstants                   m_constants;
+
+    D2D1_MATRIX_4X4_F                                       m_scRgbToPanel;
+    Microsoft::WRL::ComPtr<ID2D1DrawInfo>                   m_drawInfo;
+    Microsoft::WRL::ComPtr<ID2D1EffectContext>              m_effectContext;
+    LONG                                                    m_refCount;
+    D2D1_RECT_L                                             m_inputRect;
+};
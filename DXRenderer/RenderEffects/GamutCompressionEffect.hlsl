@@ -0,0 +1,60 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Compresses scRGB colors into the display's gamut in one pass. Same kernel as
+// DXRenderer::GamutCompressor, see CpuRender\GamutCompressor.h.
+
+// Custom effects using pixel shaders should use HLSL helper functions defined in
+// d2d1effecthelpers.hlsli to make use of effect shader linking.
+#define D2D_INPUT_COUNT 1           // The pixel shader takes 1 input texture.
+#define D2D_INPUT0_SIMPLE
+
+// Note that the custom build step must provide the correct path to find d2d1effecthelpers.hlsli when calling fxc.exe.
+#include "d2d1effecthelpers.hlsli"
+
+// Same layout as DXRenderer::GamutCompressionConstants.
+cbuffer constants : register(b0)
+{
+    float4 scRgbToPanel[3] : packoffset(c0);    // Rows; out.r = dot(scRgbToPanel[0].rgb, in.rgb).
+    float4 panelToScRgb[3] : packoffset(c3);
+    float4 threshold : packoffset(c6);
+    float4 inverseScale : packoffset(c7);       // 0 disables compression of that channel.
+};
+
+D2D_PS_ENTRY(main)
+{
+    float4 input = D2DGetInput(0);
+
+    float3 rgb = float3(
+        dot(scRgbToPanel[0].rgb, input.rgb),
+        dot(scRgbToPanel[1].rgb, input.rgb),
+        dot(scRgbToPanel[2].rgb, input.rgb));
+
+    // Distance of each channel from the achromatic axis: 0 for neutrals, 1 on the gamut boundary.
+    float achromatic = max(max(rgb.r, rgb.g), rgb.b);
+    float3 distance = (achromatic - rgb) / (achromatic > 0.0f ? achromatic : 1.0f);
+
+    // Distances beyond the threshold are compressed; over / sqrt(1 + (over / s)^2) approaches s.
+    float3 over = max(distance - threshold.rgb, 0.0f);
+    float3 x = over * inverseScale.rgb;
+    float3 compressed = (distance - over) + over * rsqrt(1.0f + x * x);
+
+    // Colors with no positive channel are black on the panel.
+    rgb = achromatic > 0.0f ? achromatic - compressed * achromatic : rgb;
+    rgb = max(rgb, 0.0f);
+
+    float3 output = float3(
+        dot(panelToScRgb[0].rgb, rgb),
+        dot(panelToScRgb[1].rgb, rgb),
+        dot(panelToScRgb[2].rgb, rgb));
+
+    return float4(output, input.a);
+}
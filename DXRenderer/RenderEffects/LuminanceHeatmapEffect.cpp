@@ -14,11 +14,18 @@
 #include "LuminanceHeatmapEffect.h"
 #include "..\Common\BasicReaderWriter.h"
 
+#include <DirectXPackedVector.h>
+#include <array>
+
 #define XML(X) TEXT(#X)
 
+using namespace DirectX::PackedVector;
+using namespace DXRenderer;
+
 LuminanceHeatmapEffect::LuminanceHeatmapEffect() :
     m_refCount(1),
-    m_constants{}
+    m_constants{},
+    m_lutDirty(true)
 {
 }
 
@@ -37,6 +44,42 @@ HRESULT __stdcall LuminanceHeatmapEffect::CreateLuminanceHeatmapImpl(_Outptr_ IU
     }
 }
 
+HRESULT LuminanceHeatmapEffect::SetStops(_In_reads_(dataSize) const BYTE* data, UINT32 dataSize)
+{
+    if (dataSize % sizeof(ColormapStop) != 0 ||
+        !m_colormap.SetStops(reinterpret_cast<const ColormapStop*>(data), dataSize / sizeof(ColormapStop)))
+    {
+        return E_INVALIDARG;
+    }
+
+    m_lutDirty = true;
+
+    return S_OK;
+}
+
+HRESULT LuminanceHeatmapEffect::GetStops(_Out_writes_opt_(dataSize) BYTE* data, UINT32 dataSize, _Out_opt_ UINT32* actualSize) const
+{
+    auto& stops = m_colormap.GetStops();
+    UINT32 size = static_cast<UINT32>(stops.size() * sizeof(ColormapStop));
+
+    if (actualSize)
+    {
+        *actualSize = size;
+    }
+
+    if (data)
+    {
+        if (dataSize < size)
+        {
+            return HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+        }
+
+        memcpy(data, stops.data(), size);
+    }
+
+    return S_OK;
+}
+
 HRESULT LuminanceHeatmapEffect::Register(_In_ ID2D1Factory1* pFactory)
 {
     // The inspectable metadata of an effect is defined in XML. This can be passed in from an external source
@@ -54,16 +97,26 @@ HRESULT LuminanceHeatmapEffect::Register(_In_ ID2D1Factory1* pFactory)
                     <Input name = 'Source'/>
                 </Inputs>
                 <!-- Custom Properties go here -->
+                <Property name='Stops' type='blob'>
+                    <Property name='DisplayName' type='string' value='Colormap stops'/>
+                </Property>
             </Effect>
             );
 
+    // This defines the bindings from specific properties to the callback functions
+    // on the class that ID2D1Effect::SetValue() & GetValue() will call.
+    const D2D1_PROPERTY_BINDING bindings[] =
+    {
+        D2D1_BLOB_TYPE_BINDING(L"Stops", &SetStops, &GetStops),
+    };
+
     // This registers the effect with the factory, which will make the effect
     // instantiatable.
     return pFactory->RegisterEffectFromString(
         CLSID_CustomLuminanceHeatmapEffect,
         pszXml,
-        nullptr, // No custom properties
-        0,       // No custom properties
+        bindings,
+        ARRAYSIZE(bindings),
         CreateLuminanceHeatmapImpl
         );
 }
@@ -113,12 +166,75 @@ HRESULT LuminanceHeatmapEffect::UpdateConstants()
     m_effectContext->GetDpi(&m_dpi, &m_dpi);
     m_constants.dpi = m_dpi;
 
+    // How the shader indexes the LUT, see LuminanceColormap::GetLut.
+    m_constants.minNits = m_colormap.GetMinNits();
+    m_constants.maxNits = m_colormap.GetMaxNits();
+    m_constants.lutMinNits = m_colormap.GetLutMinNits();
+    m_constants.log2LutMin = m_colormap.GetLog2LutMin();
+    m_constants.indexScale = m_colormap.GetIndexScale();
+    m_constants.lutSize = static_cast<float>(sc_ColormapLutSize);
+
     return m_drawInfo->SetPixelShaderConstantBuffer(reinterpret_cast<BYTE*>(&m_constants), sizeof(m_constants));
 }
 
+// Uploads the colormap's LUT when the stops have changed. FP16 is filterable on every feature level
+// Direct2D supports, and is plenty for colors.
+HRESULT LuminanceHeatmapEffect::UpdateLut()
+{
+    if (!m_lutDirty && m_lutTexture) return S_OK;
+
+    std::array<XMHALF4, sc_ColormapLutSize> data;
+    for (unsigned int i = 0; i < sc_ColormapLutSize; i++)
+    {
+        XMStoreHalf4(&data[i], DirectX::XMLoadFloat4A(&m_colormap.GetLut()[i]));
+    }
+
+    UINT32 extent = sc_ColormapLutSize;
+    D2D1_EXTEND_MODE extendMode = D2D1_EXTEND_MODE_CLAMP;
+
+    D2D1_RESOURCE_TEXTURE_PROPERTIES props = {};
+    props.extents = &extent;
+    props.dimensions = 1;
+    props.bufferPrecision = D2D1_BUFFER_PRECISION_16BPC_FLOAT;
+    props.channelDepth = D2D1_CHANNEL_DEPTH_4;
+    props.filter = D2D1_FILTER_MIN_MAG_MIP_LINEAR;
+    props.extendModes = &extendMode;
+
+    // A null resource ID makes the texture private to this effect instance.
+    Microsoft::WRL::ComPtr<ID2D1ResourceTexture> texture;
+    HRESULT hr = m_effectContext->CreateResourceTexture(
+        nullptr,
+        &props,
+        reinterpret_cast<const BYTE*>(data.data()),
+        nullptr,
+        static_cast<UINT32>(sizeof(data)),
+        &texture);
+
+    if (SUCCEEDED(hr))
+    {
+        // Texture 0 is the effect input.
+        hr = m_drawInfo->SetResourceTexture(1, texture.Get());
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        m_lutTexture = texture;
+        m_lutDirty = false;
+    }
+
+    return hr;
+}
+
 IFACEMETHODIMP LuminanceHeatmapEffect::PrepareForRender(D2D1_CHANGE_TYPE changeType)
 {
-    return UpdateConstants();
+    HRESULT hr = UpdateLut();
+
+    if (SUCCEEDED(hr))
+    {
+        hr = UpdateConstants();
+    }
+
+    return hr;
 }
 
 // SetGraph is only called when the number of inputs changes. This never happens as we publish this effect
@@ -134,6 +250,9 @@ IFACEMETHODIMP LuminanceHeatmapEffect::SetDrawInfo(_In_ ID2D1DrawInfo* pDrawInfo
 {
     m_drawInfo = pDrawInfo;
 
+    // The LUT must be bound to the new draw info.
+    m_lutTexture = nullptr;
+
     return m_drawInfo->SetPixelShader(GUID_LuminanceHeatmapPixelShader);
 }
 
@@ -10,7 +10,10 @@
 //*********************************************************
 
 // Not a tonemapper, instead produces a colorized heatmap of the luminance of the image in SDR range.
-// See LuminanceHeatmapEffect.hlsl for the nits --> color mapping.
+// The nits --> color mapping is a LuminanceColormap, by default the heatmap described there; the
+// shader looks its colors up in the baked LUT, uploaded as a resource texture.
+
+#include "..\CpuRender\LuminanceColormap.h"
 
 DEFINE_GUID(GUID_LuminanceHeatmapPixelShader, 0xced40834, 0x5bc7, 0x4cc6, 0xbe, 0xe9, 0x4f, 0x94, 0xf, 0xab, 0x7b, 0xc1);
 DEFINE_GUID(CLSID_CustomLuminanceHeatmapEffect, 0x52bfa892, 0x4616, 0x4b9f, 0xb6, 0x69, 0x1f, 0x4e, 0xdb, 0xfe, 0x10, 0x72);
@@ -25,6 +28,10 @@ public:
 
     static HRESULT __stdcall CreateLuminanceHeatmapImpl(_Outptr_ IUnknown** ppEffectImpl);
 
+    // Declare property getter/setters. Stops is an array of DXRenderer::ColormapStop.
+    HRESULT SetStops(_In_reads_(dataSize) const BYTE* data, UINT32 dataSize);
+    HRESULT GetStops(_Out_writes_opt_(dataSize) BYTE* data, UINT32 dataSize, _Out_opt_ UINT32* actualSize) const;
+
     // Declare ID2D1EffectImpl implementation methods.
     IFACEMETHODIMP Initialize(
         _In_ ID2D1EffectContext* pContextInternal,
@@ -67,21 +74,30 @@ public:
     IFACEMETHODIMP_(ULONG) Release();
     IFACEMETHODIMP QueryInterface(_In_ REFIID riid, _Outptr_ void** ppOutput);
 
-    // Declare property getter/setter methods.
-
 private:
     LuminanceHeatmapEffect();
     HRESULT UpdateConstants();
+    HRESULT UpdateLut();
 
     // This struct defines the constant buffer of our pixel shader.
     struct
     {
         float dpi;
+        float minNits;
+        float maxNits;
+        float lutMinNits;
+        float log2LutMin;
+        float indexScale;
+        float lutSize;
+        float padding;
     } m_constants;
 
-    Microsoft::WRL::ComPtr<ID2D1DrawInfo>      m_drawInfo;
-    Microsoft::WRL::ComPtr<ID2D1EffectContext> m_effectContext;
-    LONG                                       m_refCount;
-    D2D1_RECT_L                                m_inputRect;
-    float                                      m_dpi;
+    Microsoft::WRL::ComPtr<ID2D1DrawInfo>       m_drawInfo;
+    Microsoft::WRL::ComPtr<ID2D1EffectContext>  m_effectContext;
+    Microsoft::WRL::ComPtr<ID2D1ResourceTexture> m_lutTexture;
+    LONG                                        m_refCount;
+    D2D1_RECT_L                                 m_inputRect;
+    float                                       m_dpi;
+    DXRenderer::LuminanceColormap               m_colormap;
+    bool                                        m_lutDirty;
 };
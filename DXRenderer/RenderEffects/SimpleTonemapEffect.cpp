@@ -17,7 +17,11 @@
 #define XML(X) TEXT(#X)
 
 SimpleTonemapEffect::SimpleTonemapEffect() :
-    m_refCount(1)
+    m_refCount(1),
+    m_constants{},
+    m_inputMaxLum(4000.0f / 80.0f),
+    m_outputMaxLum(270.0f / 80.0f),
+    m_operator(sc_TonemapReinhard)
 {
 }
 
@@ -43,14 +47,14 @@ HRESULT SimpleTonemapEffect::SetInputMaxLuminance(float nits)
         return E_INVALIDARG;
     }
 
-    m_constants.inputMaxLum = nits / 80.0f; // scRGB 1.0 == 80 nits.
+    m_inputMaxLum = nits / 80.0f; // scRGB 1.0 == 80 nits.
 
     return S_OK;
 }
 
 float SimpleTonemapEffect::GetInputMaxLuminance() const
 {
-    return m_constants.inputMaxLum * 80.0f;
+    return m_inputMaxLum * 80.0f;
 }
 
 HRESULT SimpleTonemapEffect::SetOutputMaxLuminance(float nits)
@@ -60,14 +64,14 @@ HRESULT SimpleTonemapEffect::SetOutputMaxLuminance(float nits)
         return E_INVALIDARG;
     }
 
-    m_constants.outputMaxLum = nits / 80.0f; // scRGB 1.0 == 80 nits.
+    m_outputMaxLum = nits / 80.0f; // scRGB 1.0 == 80 nits.
 
     return S_OK;
 }
 
 float SimpleTonemapEffect::GetOutputMaxLuminance() const
 {
-    return m_constants.outputMaxLum * 80.0f;
+    return m_outputMaxLum * 80.0f;
 }
 
 HRESULT SimpleTonemapEffect::SetDisplayMode(D2D1_HDRTONEMAP_DISPLAY_MODE mode)
@@ -82,6 +86,23 @@ D2D1_HDRTONEMAP_DISPLAY_MODE SimpleTonemapEffect::GetDisplayMode() const
     return m_ignored;
 }
 
+HRESULT SimpleTonemapEffect::SetOperator(UINT32 op)
+{
+    if (op >= static_cast<UINT32>(sc_TonemapOperatorCount))
+    {
+        return E_INVALIDARG;
+    }
+
+    m_operator = op;
+
+    return S_OK;
+}
+
+UINT32 SimpleTonemapEffect::GetOperator() const
+{
+    return m_operator;
+}
+
 HRESULT SimpleTonemapEffect::Register(_In_ ID2D1Factory1* pFactory)
 {
     // The inspectable metadata of an effect is defined in XML. This can be passed in from an external source
@@ -94,7 +115,7 @@ HRESULT SimpleTonemapEffect::Register(_In_ ID2D1Factory1* pFactory)
                 <Property name='DisplayName' type='string' value='Simple HDR Tonemapper' />
                 <Property name='Author' type='string' value='Microsoft Corporation' />
                 <Property name='Category' type='string' value='Stylize' />
-                <Property name='Description' type='string' value='Rudimentary HDR tonemapper using rational beziers' />
+                <Property name='Description' type='string' value='HDR tonemapper with a choice of curves' />
                 <Inputs>
                     <Input name='Source' />
                 </Inputs>
@@ -116,6 +137,17 @@ HRESULT SimpleTonemapEffect::Register(_In_ ID2D1Factory1* pFactory)
                         <Field name='HDR' displayname='HDR' index="1" />
                     </Fields>
                 </Property>
+                <Property name='Operator' type='enum'>
+                    <Property name='DisplayName' type='string' value='Tonemapping curve'/>
+                    <Property name="Default" type="enum" value="0" />
+                    <Fields>
+                        <Field name='Reinhard' displayname='Reinhard' index="0" />
+                        <Field name='ReinhardExtended' displayname='Extended Reinhard' index="1" />
+                        <Field name='Bt2390' displayname='BT.2390 EETF' index="2" />
+                        <Field name='AcesFitted' displayname='ACES (fitted)' index="3" />
+                        <Field name='Hable' displayname='Hable filmic' index="4" />
+                    </Fields>
+                </Property>
             </Effect>
             );
 
@@ -133,6 +165,9 @@ HRESULT SimpleTonemapEffect::Register(_In_ ID2D1Factory1* pFactory)
         // Note this property is IGNORED by this effect, the entry point is implemented as a convenience
         // to drop-in with the 1809 tonemapper.
         D2D1_VALUE_TYPE_BINDING(L"DisplayMode", &SetDisplayMode, &GetDisplayMode),
+
+        // When accessing by index, use SIMPLETONEMAP_PROP_OPERATOR = 3.
+        D2D1_VALUE_TYPE_BINDING(L"Operator", &SetOperator, &GetOperator),
     };
 
     // This registers the effect with the factory, which will make the effect
@@ -190,6 +225,13 @@ HRESULT SimpleTonemapEffect::UpdateConstants()
     // Update the DPI if it has changed. This allows the effect to scale across different DPIs automatically.
     m_effectContext->GetDpi(&m_dpi, &m_dpi); // DPI is never used right now.
 
+    // The per image values are computed once here, exactly as the CPU tonemappers do.
+    m_constants.curve = DXRenderer::GetTonemapConstants(
+        static_cast<DXRenderer::TonemapOperator>(m_operator),
+        m_inputMaxLum,
+        m_outputMaxLum);
+    m_constants.tonemapOperator = static_cast<int>(m_operator);
+
     return m_drawInfo->SetPixelShaderConstantBuffer(reinterpret_cast<BYTE*>(&m_constants), sizeof(m_constants));
 }
 
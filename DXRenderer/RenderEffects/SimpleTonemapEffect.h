@@ -15,6 +15,11 @@ DEFINE_GUID(GUID_SimpleTonemapEffectPixelShader,
 // {0273FF16-6CA6-4AC4-BD14-77704DAD5391}
 DEFINE_GUID(CLSID_CustomSimpleTonemapEffect, 0x273ff16, 0x6ca6, 0x4ac4, 0xbd, 0x14, 0x77, 0x70, 0x4d, 0xad, 0x53, 0x91);
 
+#include "..\CpuRender\Tonemappers.h"
+
+// Index of the Operator property, following the three properties shared with the Direct2D HDR tonemapper.
+const UINT32 SIMPLETONEMAP_PROP_OPERATOR = 3;
+
 // Our effect contains one transform, which is simply a wrapper around a pixel shader. As such,
 // we can simply make the effect itself act as the transform.
 class SimpleTonemapEffect : public ID2D1EffectImpl, public ID2D1DrawTransform
@@ -35,6 +40,10 @@ public:
     HRESULT SetDisplayMode(D2D1_HDRTONEMAP_DISPLAY_MODE mode);
     D2D1_HDRTONEMAP_DISPLAY_MODE GetDisplayMode() const;
 
+    // One of the sc_Tonemap* operator IDs in TonemapConstants.h.
+    HRESULT SetOperator(UINT32 op);
+    UINT32 GetOperator() const;
+
     // Declare ID2D1EffectImpl implementation methods.
     IFACEMETHODIMP Initialize(
         _In_ ID2D1EffectContext* pContextInternal,
@@ -107,10 +116,15 @@ private:
     // This struct defines the constant buffer of our pixel shader.
     struct
     {
-        float inputMaxLum;  // In scRGB values.
-        float outputMaxLum; // In scRGB values.
+        DXRenderer::TonemapConstants curve;
+        int tonemapOperator;
+        float padding[3];
     } m_constants;
 
+    float                                      m_inputMaxLum;  // In scRGB values.
+    float                                      m_outputMaxLum; // In scRGB values.
+    UINT32                                     m_operator;
+
     Microsoft::WRL::ComPtr<ID2D1DrawInfo>      m_drawInfo;
     Microsoft::WRL::ComPtr<ID2D1EffectContext> m_effectContext;
     LONG                                       m_refCount;
@@ -17,24 +17,89 @@
 // Note that the custom build step must provide the correct path to find d2d1effecthelpers.hlsli when calling fxc.exe.
 #include "d2d1effecthelpers.hlsli"
 
+// Curve constants shared with the CPU tonemappers in CpuRender\Tonemappers.h.
+#include "..\CpuRender\TonemapConstants.h"
+
+// Same layout as SimpleTonemapEffect::m_constants; the first two rows are DXRenderer::TonemapConstants.
 cbuffer constants : register(b0)
 {
-    float inputMax;  // In scRGB values.
-    float outputMax; // In scRGB values.
+    float inputMax : packoffset(c0.x);      // In scRGB values.
+    float outputMax : packoffset(c0.y);     // In scRGB values.
+    float white : packoffset(c0.z);         // inputMax / outputMax, at least 1.
+    float curveScale : packoffset(c0.w);
+    float pqSourceMax : packoffset(c1.x);
+    float pqMaxLum : packoffset(c1.y);
+    float pqKneeStart : packoffset(c1.z);
+    float pqKneeScale : packoffset(c1.w);
+    int tonemapOperator : packoffset(c2.x);
 };
 
-float reinhard(float input)
+float3 pqEotf(float3 e)
+{
+    float3 p = pow(saturate(e), 1.0f / sc_TonemapPqM2);
+    return pow(max(p - sc_TonemapPqC1, 0.0f) / (sc_TonemapPqC2 - sc_TonemapPqC3 * p), 1.0f / sc_TonemapPqM1);
+}
+
+float3 pqInverseEotf(float3 y)
 {
-    float output = input / inputMax;
+    float3 ym = pow(saturate(y), sc_TonemapPqM1);
+    return pow((sc_TonemapPqC1 + sc_TonemapPqC2 * ym) / (1.0f + sc_TonemapPqC3 * ym), sc_TonemapPqM2);
+}
+
+// Each curve takes non-negative scRGB values; see the matching CPU curve for a description.
+float3 reinhard(float3 x)
+{
+    float3 t = x / inputMax;
 
     // Vanilla Reinhard normalizes color values to [0, 1].
     // This modification scales to the luminance range of the display.
-    output = (output / 1 + output);
+    return t / (1.0f + t) * outputMax;
+}
 
-    return output * outputMax;
+float3 reinhardExtended(float3 x)
+{
+    float3 u = x / outputMax;
+    return min(u * (1.0f + u * curveScale) / (1.0f + u), 1.0f) * outputMax;
 }
 
-// Implements a rudimentary HDR tonemapper using a modified Reinhard operator.
+float3 bt2390(float3 x)
+{
+    float3 e = min(pqInverseEotf(x * sc_TonemapScRgbToPq) / pqSourceMax, 1.0f);
+
+    float3 t = (e - pqKneeStart) * pqKneeScale;
+    float3 t2 = t * t;
+    float3 t3 = t2 * t;
+
+    float3 p =
+        (2.0f * t3 - 3.0f * t2 + 1.0f) * pqKneeStart +
+        (t3 - 2.0f * t2 + t) * (1.0f - pqKneeStart) +
+        (-2.0f * t3 + 3.0f * t2) * pqMaxLum;
+
+    e = e > pqKneeStart ? p : e;
+
+    return pqEotf(e * pqSourceMax) / sc_TonemapScRgbToPq;
+}
+
+float3 acesFitted(float3 x)
+{
+    float3 u = x / outputMax;
+    float3 y = u * (sc_AcesFittedA * u + sc_AcesFittedB) / (u * (sc_AcesFittedC * u + sc_AcesFittedD) + sc_AcesFittedE);
+
+    return min(y * curveScale, 1.0f) * outputMax;
+}
+
+float3 hable(float3 x)
+{
+    float3 u = x / outputMax;
+    float3 y =
+        (u * (sc_HableA * u + sc_HableC * sc_HableB) + sc_HableD * sc_HableE) /
+        (u * (sc_HableA * u + sc_HableB) + sc_HableD * sc_HableF) - sc_HableE / sc_HableF;
+
+    return min(y * curveScale, 1.0f) * outputMax;
+}
+
+// Implements HDR tonemapping with the curve chosen by the Operator property. The operator is the
+// same for every pixel, so the branches are uniform.
 
 // Like the Direct2D HDR tonemapper, this effect outputs values in scRGB scene-referred
 // luminance space, i.e. the output numeric range will exceed [0, 1].
@@ -44,9 +109,34 @@ D2D_PS_ENTRY(main)
 {
     float4 color = D2DGetInput(0);
 
-    color.r = reinhard(color.r);
-    color.g = reinhard(color.g);
-    color.b = reinhard(color.b);
+    // Curves apply to the magnitude so negative (out of sRGB gamut) values keep their sign.
+    float3 x = abs(color.rgb);
+    float3 y;
+
+    [branch] switch (tonemapOperator)
+    {
+    case sc_TonemapReinhardExtended:
+        y = reinhardExtended(x);
+        break;
+
+    case sc_TonemapBt2390:
+        y = bt2390(x);
+        break;
+
+    case sc_TonemapAcesFitted:
+        y = acesFitted(x);
+        break;
+
+    case sc_TonemapHable:
+        y = hable(x);
+        break;
+
+    default:
+        y = reinhard(x);
+        break;
+    }
+
+    color.rgb = color.rgb < 0.0f ? -y : y;
 
     return color;
-}
\ No newline at end of file
+}
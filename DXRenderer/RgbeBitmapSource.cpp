@@ -0,0 +1,166 @@
+#include "pch.h"
+#include "RgbeBitmapSource.h"
+#include "CpuRender\PixelDecoders.h"
+
+using namespace DXRenderer;
+
+using namespace DirectX::PackedVector;
+
+RgbeBitmapSource::RgbeBitmapSource(unsigned int width, unsigned int height, std::vector<uint8_t>&& pixels) :
+    m_width(width),
+    m_height(height),
+    m_pixels(std::move(pixels)),
+    m_refCount(1)
+{
+}
+
+HRESULT RgbeBitmapSource::Create(
+    unsigned int width,
+    unsigned int height,
+    std::vector<uint8_t>&& pixels,
+    RgbeBitmapSource** source)
+{
+    *source = nullptr;
+
+    if (width == 0 || height == 0 || pixels.size() != static_cast<size_t>(width) * height * 4)
+    {
+        return E_INVALIDARG;
+    }
+
+    *source = new (std::nothrow) RgbeBitmapSource(width, height, std::move(pixels));
+
+    return *source ? S_OK : E_OUTOFMEMORY;
+}
+
+IFACEMETHODIMP RgbeBitmapSource::GetSize(UINT* width, UINT* height)
+{
+    if (width == nullptr || height == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    *width = m_width;
+    *height = m_height;
+
+    return S_OK;
+}
+
+IFACEMETHODIMP RgbeBitmapSource::GetPixelFormat(WICPixelFormatGUID* pixelFormat)
+{
+    if (pixelFormat == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    *pixelFormat = GUID_WICPixelFormat64bppPRGBAHalf;
+
+    return S_OK;
+}
+
+IFACEMETHODIMP RgbeBitmapSource::GetResolution(double* dpiX, double* dpiY)
+{
+    if (dpiX == nullptr || dpiY == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    *dpiX = 96.0;
+    *dpiY = 96.0;
+
+    return S_OK;
+}
+
+IFACEMETHODIMP RgbeBitmapSource::CopyPalette(IWICPalette* palette)
+{
+    UNREFERENCED_PARAMETER(palette);
+
+    return WINCODEC_ERR_PALETTEUNAVAILABLE;
+}
+
+IFACEMETHODIMP RgbeBitmapSource::CopyPixels(const WICRect* rect, UINT stride, UINT bufferSize, BYTE* buffer)
+{
+    if (buffer == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    // A null rect means the entire bitmap.
+    WICRect full = { 0, 0, static_cast<INT>(m_width), static_cast<INT>(m_height) };
+    if (rect == nullptr)
+    {
+        rect = &full;
+    }
+
+    if (rect->X < 0 || rect->Y < 0 || rect->Width < 0 || rect->Height < 0 ||
+        static_cast<unsigned int>(rect->X) + rect->Width > m_width ||
+        static_cast<unsigned int>(rect->Y) + rect->Height > m_height)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (rect->Width == 0 || rect->Height == 0)
+    {
+        return S_OK;
+    }
+
+    uint64_t rowBytes = static_cast<uint64_t>(rect->Width) * sizeof(XMHALF4);
+    if (stride < rowBytes || bufferSize < static_cast<uint64_t>(stride) * (rect->Height - 1) + rowBytes)
+    {
+        return WINCODEC_ERR_INSUFFICIENTBUFFER;
+    }
+
+    for (INT y = 0; y < rect->Height; y++)
+    {
+        const uint8_t* source = m_pixels.data() + (static_cast<size_t>(rect->Y) + y) * GetStride() + static_cast<size_t>(rect->X) * 4;
+
+        DecodeRowRgbeToHalf(source, rect->Width, reinterpret_cast<XMHALF4*>(buffer + static_cast<size_t>(y) * stride));
+    }
+
+    return S_OK;
+}
+
+IFACEMETHODIMP_(ULONG) RgbeBitmapSource::AddRef()
+{
+    return InterlockedIncrement(&m_refCount);
+}
+
+IFACEMETHODIMP_(ULONG) RgbeBitmapSource::Release()
+{
+    ULONG count = InterlockedDecrement(&m_refCount);
+
+    if (count == 0)
+    {
+        delete this;
+    }
+
+    return count;
+}
+
+IFACEMETHODIMP RgbeBitmapSource::QueryInterface(
+    _In_ REFIID riid,
+    _Outptr_ void** ppOutput
+    )
+{
+    *ppOutput = nullptr;
+    HRESULT hr = S_OK;
+
+    if (riid == __uuidof(IWICBitmapSource))
+    {
+        *ppOutput = static_cast<IWICBitmapSource*>(this);
+    }
+    else if (riid == __uuidof(IUnknown))
+    {
+        *ppOutput = this;
+    }
+    else
+    {
+        hr = E_NOINTERFACE;
+    }
+
+    if (*ppOutput != nullptr)
+    {
+        AddRef();
+    }
+
+    return hr;
+}
@@ -0,0 +1,51 @@
+//*********************************************************
+//
+// RgbeBitmapSource
+//
+// Holds a Radiance HDR image in its file encoding: 8-bit RGB
+// mantissas sharing an 8-bit exponent, 4 bytes per pixel, as
+// read by LoadFromRGBEFile. This is a quarter of FP16 RGBA,
+// without any loss relative to the file. Rows are expanded to
+// FP16 only when Direct2D asks for them.
+//
+//*********************************************************
+
+#pragma once
+
+namespace DXRenderer
+{
+    class RgbeBitmapSource : public IWICBitmapSource
+    {
+    public:
+        /// <param name="pixels">Tightly packed RGBE pixels; taken over by the source.</param>
+        static HRESULT Create(
+            unsigned int width,
+            unsigned int height,
+            std::vector<uint8_t>&& pixels,
+            _COM_Outptr_ RgbeBitmapSource** source);
+
+        const uint8_t* GetPixels() const { return m_pixels.data(); }
+        size_t GetStride() const { return static_cast<size_t>(m_width) * 4; }
+        uint64_t GetSizeInBytes() const { return m_pixels.size(); }
+
+        // Declare IWICBitmapSource implementation methods.
+        IFACEMETHODIMP GetSize(_Out_ UINT* width, _Out_ UINT* height);
+        IFACEMETHODIMP GetPixelFormat(_Out_ WICPixelFormatGUID* pixelFormat);
+        IFACEMETHODIMP GetResolution(_Out_ double* dpiX, _Out_ double* dpiY);
+        IFACEMETHODIMP CopyPalette(_In_ IWICPalette* palette);
+        IFACEMETHODIMP CopyPixels(_In_opt_ const WICRect* rect, UINT stride, UINT bufferSize, _Out_writes_bytes_(bufferSize) BYTE* buffer);
+
+        // Declare IUnknown implementation methods.
+        IFACEMETHODIMP_(ULONG) AddRef();
+        IFACEMETHODIMP_(ULONG) Release();
+        IFACEMETHODIMP QueryInterface(_In_ REFIID riid, _Outptr_ void** ppOutput);
+
+    private:
+        RgbeBitmapSource(unsigned int width, unsigned int height, std::vector<uint8_t>&& pixels);
+
+        unsigned int                                            m_width;
+        unsigned int                                            m_height;
+        std::vector<uint8_t>                                    m_pixels;
+        LONG                                                    m_refCount; // Direct2D may call from any thread.
+    };
+}
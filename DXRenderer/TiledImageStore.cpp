@@ -0,0 +1,587 @@
+#include "pch.h"
+#include "TiledImageStore.h"
+#include "Common\MemoryMappedFile.h"
+#include "CpuRender\MipPyramid.h"
+
+using namespace DXRenderer;
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+using namespace std;
+
+class TiledImageStore::Decoder
+{
+public:
+    virtual ~Decoder() {}
+
+    virtual unsigned int GetLevelCount() const = 0;
+    virtual unsigned int GetWidth(unsigned int level) const = 0;
+    virtual unsigned int GetHeight(unsigned int level) const = 0;
+
+    /// <summary>
+    /// Decodes a rectangle of a level to FP16 RGBA with straight alpha.
+    /// </summary>
+    /// <param name="destPitch">In pixels.</param>
+    virtual HRESULT DecodeRegion(
+        unsigned int level,
+        unsigned int x,
+        unsigned int y,
+        unsigned int width,
+        unsigned int height,
+        XMHALF4* dest,
+        size_t destPitch) = 0;
+};
+
+namespace
+{
+    // Each native decode covers one row of tiles, as many columns wide as fit in this
+    // fraction of the cache budget. OpenEXR always decodes full scanlines, so wider is better.
+    const uint64_t sc_windowBudgetDivisor = 4;
+
+    // Target size of each batch of scanlines read by EXRDecoder.
+    const size_t sc_exrBandBytes = 16 * 1024 * 1024;
+
+    const uint32_t sc_ddsMagicSize = 4;
+    const uint32_t sc_ddsHeaderSize = 124;
+    const uint32_t sc_ddsHeaderDxt10Size = 20;
+    const uint32_t sc_ddsPixelFormatFlagsOffset = 80;
+    const uint32_t sc_ddsFourCCOffset = 84;
+    const uint32_t sc_ddsFourCCFlag = 0x4; // DDPF_FOURCC
+
+    uint64_t MakeTileKey(unsigned int level, unsigned int tileX, unsigned int tileY)
+    {
+        return (static_cast<uint64_t>(level) << 48) | (static_cast<uint64_t>(tileY) << 24) | tileX;
+    }
+
+    void PremultiplyAlpha(XMHALF4* pixels, size_t count)
+    {
+        const HALF one = 0x3C00;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (pixels[i].w == one)
+            {
+                continue;
+            }
+
+            XMVECTOR v = XMLoadHalf4(&pixels[i]);
+            XMStoreHalf4(&pixels[i], XMVectorSelect(v, XMVectorMultiply(v, XMVectorSplatW(v)), g_XMSelect1110));
+        }
+    }
+
+    void CopyRows(const uint8_t* source, size_t sourcePitch, uint8_t* dest, size_t destPitch, size_t rowBytes, size_t rows)
+    {
+        for (size_t y = 0; y < rows; y++)
+        {
+            memcpy(dest + y * destPitch, source + y * sourcePitch, rowBytes);
+        }
+    }
+
+    /// <summary>
+    /// OpenEXR stores a single level, read with scanline range reads.
+    /// </summary>
+    class EXRDecoder : public TiledImageStore::Decoder
+    {
+    public:
+        HRESULT Open(_In_z_ const wchar_t* filename, _Out_opt_ EXRChromaticities* chromaticities)
+        {
+            TexMetadata metadata = {};
+            HRESULT hr = m_reader.Open(filename, &metadata, chromaticities);
+            if (FAILED(hr))
+                return hr;
+
+            if (metadata.width > UINT_MAX || metadata.height > UINT_MAX)
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+            m_width = static_cast<unsigned int>(metadata.width);
+            m_height = static_cast<unsigned int>(metadata.height);
+
+            return S_OK;
+        }
+
+        virtual unsigned int GetLevelCount() const override { return 1; }
+        virtual unsigned int GetWidth(unsigned int) const override { return m_width; }
+        virtual unsigned int GetHeight(unsigned int) const override { return m_height; }
+
+        virtual HRESULT DecodeRegion(
+            unsigned int,
+            unsigned int x,
+            unsigned int y,
+            unsigned int width,
+            unsigned int height,
+            XMHALF4* dest,
+            size_t destPitch) override
+        {
+            // Start on a line block boundary so no block is decompressed for two bands.
+            size_t linesPerBlock = m_reader.GetLinesPerBlock();
+            size_t rowBytes = static_cast<size_t>(m_width) * sizeof(XMHALF4);
+            size_t bandRows = (std::max)(sc_exrBandBytes / rowBytes / linesPerBlock, size_t(1)) * linesPerBlock;
+
+            size_t end = static_cast<size_t>(y) + height;
+            for (size_t first = y / linesPerBlock * linesPerBlock; first < end; first += bandRows)
+            {
+                size_t rows = (std::min)(bandRows, static_cast<size_t>(m_height) - first);
+                m_band.resize(static_cast<size_t>(m_width) * rows);
+
+                Image band = {};
+                band.width = m_width;
+                band.height = rows;
+                band.format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+                band.rowPitch = rowBytes;
+                band.slicePitch = rowBytes * rows;
+                band.pixels = reinterpret_cast<uint8_t*>(m_band.data());
+
+                HRESULT hr = m_reader.ReadRows(first, band);
+                if (FAILED(hr))
+                    return hr;
+
+                size_t copyFirst = (std::max)(first, static_cast<size_t>(y));
+                size_t copyLast = (std::min)(first + rows, end);
+
+                CopyRows(
+                    reinterpret_cast<const uint8_t*>(&m_band[(copyFirst - first) * m_width + x]),
+                    rowBytes,
+                    reinterpret_cast<uint8_t*>(&dest[(copyFirst - y) * destPitch]),
+                    destPitch * sizeof(XMHALF4),
+                    static_cast<size_t>(width) * sizeof(XMHALF4),
+                    copyLast - copyFirst);
+            }
+
+            return S_OK;
+        }
+
+    private:
+        EXRFileReader                                           m_reader;
+        std::vector<XMHALF4>                                    m_band;
+        unsigned int                                            m_width = 0;
+        unsigned int                                            m_height = 0;
+    };
+
+    /// <summary>
+    /// Reads the mips of a DDS file directly out of a memory mapping, so only the pages
+    /// backing the requested region are ever touched.
+    /// </summary>
+    class DDSDecoder : public TiledImageStore::Decoder
+    {
+    public:
+        HRESULT Open(_In_z_ const wchar_t* filename)
+        {
+            if (!m_file.Open(filename))
+                return HRESULT_FROM_WIN32(GetLastError());
+
+            auto data = m_file.GetData();
+            auto size = m_file.GetSize();
+
+            // Legacy formats that need expanding can't be read in place.
+            HRESULT hr = GetMetadataFromDDSMemory(data, static_cast<size_t>(size), DDS_FLAGS_NO_LEGACY_EXPANSION, m_metadata);
+            if (FAILED(hr))
+                return hr;
+
+            auto fmt = m_metadata.format;
+            if (m_metadata.dimension != TEX_DIMENSION_TEXTURE2D ||
+                m_metadata.width > UINT_MAX || m_metadata.height > UINT_MAX ||
+                IsPlanar(fmt) || IsPacked(fmt) || IsVideo(fmt) || IsPalettized(fmt) ||
+                (!IsCompressed(fmt) && (BitsPerPixel(fmt) % 8) != 0))
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+            uint64_t offset = sc_ddsMagicSize + sc_ddsHeaderSize;
+
+            uint32_t pixelFormatFlags = 0, fourCC = 0;
+            memcpy(&pixelFormatFlags, data + sc_ddsPixelFormatFlagsOffset, sizeof(pixelFormatFlags));
+            memcpy(&fourCC, data + sc_ddsFourCCOffset, sizeof(fourCC));
+            if ((pixelFormatFlags & sc_ddsFourCCFlag) && fourCC == MAKEFOURCC('D', 'X', '1', '0'))
+            {
+                offset += sc_ddsHeaderDxt10Size;
+            }
+
+            // The first array slice's mips are stored first, largest to smallest.
+            for (size_t level = 0; level < m_metadata.mipLevels; level++)
+            {
+                MipInfo mip = {};
+                mip.width = static_cast<unsigned int>((std::max)(m_metadata.width >> level, size_t(1)));
+                mip.height = static_cast<unsigned int>((std::max)(m_metadata.height >> level, size_t(1)));
+                mip.offset = offset;
+
+                size_t slicePitch = 0;
+                hr = ComputePitch(fmt, mip.width, mip.height, mip.rowPitch, slicePitch, CP_FLAGS_NONE);
+                if (FAILED(hr))
+                    return hr;
+
+                offset += slicePitch;
+                if (offset > size)
+                    return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+
+                m_mips.push_back(mip);
+            }
+
+            return S_OK;
+        }
+
+        DXGI_FORMAT GetFormat() const { return m_metadata.format; }
+
+        virtual unsigned int GetLevelCount() const override { return static_cast<unsigned int>(m_mips.size()); }
+        virtual unsigned int GetWidth(unsigned int level) const override { return m_mips[level].width; }
+        virtual unsigned int GetHeight(unsigned int level) const override { return m_mips[level].height; }
+
+        virtual HRESULT DecodeRegion(
+            unsigned int level,
+            unsigned int x,
+            unsigned int y,
+            unsigned int width,
+            unsigned int height,
+            XMHALF4* dest,
+            size_t destPitch) override
+        {
+            auto& mip = m_mips[level];
+            auto levelData = m_file.GetData() + mip.offset;
+
+            // Values are copied as stored, without sRGB to linear conversion.
+            Image view = {};
+            view.format = MakeLinear(m_metadata.format);
+            view.rowPitch = mip.rowPitch;
+
+            // Offset of the requested rectangle within view.
+            unsigned int viewX = 0, viewY = 0;
+
+            if (IsCompressed(view.format))
+            {
+                // Expand the rectangle to whole blocks.
+                unsigned int blockX = x & ~3u;
+                unsigned int blockY = y & ~3u;
+                size_t blockBytes = BitsPerPixel(view.format) * 2; // 4x4 pixels.
+
+                view.width = (std::min)((x + width + 3) & ~3u, mip.width) - blockX;
+                view.height = (std::min)((y + height + 3) & ~3u, mip.height) - blockY;
+                view.slicePitch = view.rowPitch * ((view.height + 3) / 4);
+                view.pixels = const_cast<uint8_t*>(levelData + (blockY / 4) * view.rowPitch + (blockX / 4) * blockBytes);
+
+                viewX = x - blockX;
+                viewY = y - blockY;
+            }
+            else
+            {
+                view.width = width;
+                view.height = height;
+                view.slicePitch = view.rowPitch * height;
+                view.pixels = const_cast<uint8_t*>(levelData + y * view.rowPitch + x * (BitsPerPixel(view.format) / 8));
+            }
+
+            const Image* decoded = &view;
+            ScratchImage scratch;
+
+            if (IsCompressed(view.format))
+            {
+                HRESULT hr = Decompress(view, DXGI_FORMAT_R16G16B16A16_FLOAT, scratch);
+                if (FAILED(hr))
+                    return hr;
+
+                decoded = scratch.GetImage(0, 0, 0);
+            }
+            else if (view.format != DXGI_FORMAT_R16G16B16A16_FLOAT)
+            {
+                HRESULT hr = Convert(view, DXGI_FORMAT_R16G16B16A16_FLOAT, TEX_FILTER_DEFAULT, TEX_THRESHOLD_DEFAULT, scratch);
+                if (FAILED(hr))
+                    return hr;
+
+                decoded = scratch.GetImage(0, 0, 0);
+            }
+
+            CopyRows(
+                decoded->pixels + viewY * decoded->rowPitch + viewX * sizeof(XMHALF4),
+                decoded->rowPitch,
+                reinterpret_cast<uint8_t*>(dest),
+                destPitch * sizeof(XMHALF4),
+                static_cast<size_t>(width) * sizeof(XMHALF4),
+                height);
+
+            return S_OK;
+        }
+
+    private:
+        struct MipInfo
+        {
+            unsigned int                                        width;
+            unsigned int                                        height;
+            size_t                                              rowPitch;
+            uint64_t                                            offset;
+        };
+
+        MemoryMappedFile                                        m_file;
+        TexMetadata                                             m_metadata = {};
+        std::vector<MipInfo>                                    m_mips;
+    };
+}
+
+HRESULT TiledImageStore::OpenEXR(
+    const wchar_t* filename,
+    uint64_t budgetBytes,
+    shared_ptr<TiledImageStore>& store,
+    EXRChromaticities* chromaticities)
+{
+    auto decoder = make_unique<EXRDecoder>();
+
+    HRESULT hr = decoder->Open(filename, chromaticities);
+    if (FAILED(hr))
+        return hr;
+
+    store.reset(new TiledImageStore(move(decoder), budgetBytes));
+    return S_OK;
+}
+
+HRESULT TiledImageStore::OpenDDS(
+    const wchar_t* filename,
+    uint64_t budgetBytes,
+    shared_ptr<TiledImageStore>& store,
+    DXGI_FORMAT* fileFormat)
+{
+    auto decoder = make_unique<DDSDecoder>();
+
+    HRESULT hr = decoder->Open(filename);
+    if (FAILED(hr))
+        return hr;
+
+    if (fileFormat)
+    {
+        *fileFormat = decoder->GetFormat();
+    }
+
+    store.reset(new TiledImageStore(move(decoder), budgetBytes));
+    return S_OK;
+}
+
+TiledImageStore::TiledImageStore(unique_ptr<Decoder> decoder, uint64_t budgetBytes) :
+    m_decoder(move(decoder)),
+    m_budgetBytes(budgetBytes),
+    m_sizeBytes(0)
+{
+    // Native levels come first; DDS mips round odd sizes down. Synthesized levels round up
+    // so that each tile covers exactly 2x2 tiles of the level below.
+    LevelSize size = { m_decoder->GetWidth(0), m_decoder->GetHeight(0) };
+    m_levels.push_back(size);
+
+    while (size.width > TileSize || size.height > TileSize)
+    {
+        auto level = static_cast<unsigned int>(m_levels.size());
+        if (level < m_decoder->GetLevelCount())
+        {
+            size = { m_decoder->GetWidth(level), m_decoder->GetHeight(level) };
+        }
+        else
+        {
+            size = { (size.width + 1) / 2, (size.height + 1) / 2 };
+        }
+
+        m_levels.push_back(size);
+    }
+}
+
+TiledImageStore::~TiledImageStore()
+{
+}
+
+HRESULT TiledImageStore::GetTile(unsigned int level, unsigned int tileX, unsigned int tileY, shared_ptr<const ImageTile>& tile)
+{
+    if (level >= GetLevelCount() || tileX >= GetTilesAcross(level) || tileY >= GetTilesDown(level))
+        return E_INVALIDARG;
+
+    lock_guard<recursive_mutex> lock(m_lock);
+
+    auto it = m_index.find(MakeTileKey(level, tileX, tileY));
+    if (it != m_index.end())
+    {
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        tile = it->second->tile;
+        return S_OK;
+    }
+
+    if (level < m_decoder->GetLevelCount())
+    {
+        return DecodeTilesLocked(level, tileX, tileY, tile);
+    }
+    else
+    {
+        return SynthesizeTileLocked(level, tileX, tileY, tile);
+    }
+}
+
+HRESULT TiledImageStore::CopyPixels(
+    unsigned int level,
+    unsigned int x,
+    unsigned int y,
+    unsigned int width,
+    unsigned int height,
+    size_t strideBytes,
+    uint8_t* buffer)
+{
+    if (level >= GetLevelCount() ||
+        x > m_levels[level].width || width > m_levels[level].width - x ||
+        y > m_levels[level].height || height > m_levels[level].height - y ||
+        strideBytes < static_cast<size_t>(width) * sizeof(XMHALF4))
+        return E_INVALIDARG;
+
+    if (width == 0 || height == 0)
+        return S_OK;
+
+    for (unsigned int tileY = y / TileSize; tileY <= (y + height - 1) / TileSize; tileY++)
+    {
+        for (unsigned int tileX = x / TileSize; tileX <= (x + width - 1) / TileSize; tileX++)
+        {
+            shared_ptr<const ImageTile> tile;
+            HRESULT hr = GetTile(level, tileX, tileY, tile);
+            if (FAILED(hr))
+                return hr;
+
+            // Intersect the tile with the requested rectangle.
+            unsigned int left = (std::max)(x, tileX * TileSize);
+            unsigned int top = (std::max)(y, tileY * TileSize);
+            unsigned int right = (std::min)(x + width, tileX * TileSize + tile->width);
+            unsigned int bottom = (std::min)(y + height, tileY * TileSize + tile->height);
+
+            CopyRows(
+                reinterpret_cast<const uint8_t*>(&tile->pixels[(top - tileY * TileSize) * tile->width + (left - tileX * TileSize)]),
+                tile->width * sizeof(XMHALF4),
+                buffer + (top - y) * strideBytes + (left - x) * sizeof(XMHALF4),
+                strideBytes,
+                (right - left) * sizeof(XMHALF4),
+                bottom - top);
+        }
+    }
+
+    return S_OK;
+}
+
+/// <summary>
+/// Decodes a window of tiles around the requested one from the file and caches all of them,
+/// since neighboring tiles are usually needed next and decoding a wider region is cheaper
+/// than decoding each tile separately.
+/// </summary>
+HRESULT TiledImageStore::DecodeTilesLocked(unsigned int level, unsigned int tileX, unsigned int tileY, shared_ptr<const ImageTile>& tile)
+{
+    const uint64_t tileBytes = TileSize * TileSize * sizeof(XMHALF4);
+
+    unsigned int tilesAcross = GetTilesAcross(level);
+    auto windowTiles = static_cast<unsigned int>((std::min)(
+        (std::max)(m_budgetBytes / sc_windowBudgetDivisor / tileBytes, uint64_t(1)),
+        static_cast<uint64_t>(tilesAcross)));
+
+    // Windows are aligned so that requests for nearby tiles reuse the same one.
+    unsigned int firstTile = tileX / windowTiles * windowTiles;
+    unsigned int lastTile = (std::min)(firstTile + windowTiles, tilesAcross);
+
+    unsigned int windowX = firstTile * TileSize;
+    unsigned int windowY = tileY * TileSize;
+    unsigned int windowWidth = (std::min)(lastTile * TileSize, m_levels[level].width) - windowX;
+    unsigned int windowHeight = (std::min)(TileSize, m_levels[level].height - windowY);
+
+    m_window.resize(static_cast<size_t>(windowWidth) * windowHeight);
+
+    HRESULT hr = m_decoder->DecodeRegion(level, windowX, windowY, windowWidth, windowHeight, m_window.data(), windowWidth);
+    if (FAILED(hr))
+        return hr;
+
+    PremultiplyAlpha(m_window.data(), m_window.size());
+
+    shared_ptr<ImageTile> requested;
+
+    for (unsigned int i = firstTile; i < lastTile; i++)
+    {
+        auto decoded = make_shared<ImageTile>();
+        decoded->width = (std::min)(TileSize, windowX + windowWidth - i * TileSize);
+        decoded->height = windowHeight;
+        decoded->pixels.resize(static_cast<size_t>(decoded->width) * decoded->height);
+
+        CopyRows(
+            reinterpret_cast<const uint8_t*>(&m_window[(i - firstTile) * TileSize]),
+            static_cast<size_t>(windowWidth) * sizeof(XMHALF4),
+            reinterpret_cast<uint8_t*>(decoded->pixels.data()),
+            decoded->width * sizeof(XMHALF4),
+            decoded->width * sizeof(XMHALF4),
+            decoded->height);
+
+        if (i == tileX)
+        {
+            requested = decoded;
+        }
+        else
+        {
+            InsertLocked(MakeTileKey(level, i, tileY), decoded);
+        }
+    }
+
+    // Inserted last so it is the most recently used.
+    InsertLocked(MakeTileKey(level, tileX, tileY), requested);
+    tile = requested;
+
+    return S_OK;
+}
+
+/// <summary>
+/// Box filters the (up to) 2x2 tiles below the requested one.
+/// </summary>
+HRESULT TiledImageStore::SynthesizeTileLocked(unsigned int level, unsigned int tileX, unsigned int tileY, shared_ptr<const ImageTile>& tile)
+{
+    unsigned int child = level - 1;
+    unsigned int childX = tileX * 2 * TileSize;
+    unsigned int childY = tileY * 2 * TileSize;
+    unsigned int childWidth = (std::min)(2 * TileSize, m_levels[child].width - childX);
+    unsigned int childHeight = (std::min)(2 * TileSize, m_levels[child].height - childY);
+
+    std::vector<XMHALF4> children(static_cast<size_t>(childWidth) * childHeight);
+
+    HRESULT hr = CopyPixels(
+        child,
+        childX,
+        childY,
+        childWidth,
+        childHeight,
+        childWidth * sizeof(XMHALF4),
+        reinterpret_cast<uint8_t*>(children.data()));
+    if (FAILED(hr))
+        return hr;
+
+    MipLevel reduced;
+    MipPyramid::Downsample(
+        children.data(),
+        MipSourceFormat::R16G16B16A16Float,
+        childWidth,
+        childHeight,
+        childWidth * sizeof(XMHALF4),
+        reduced);
+
+    auto synthesized = make_shared<ImageTile>();
+    synthesized->width = reduced.width;
+    synthesized->height = reduced.height;
+    synthesized->pixels = move(reduced.pixels);
+
+    InsertLocked(MakeTileKey(level, tileX, tileY), synthesized);
+    tile = synthesized;
+
+    return S_OK;
+}
+
+void TiledImageStore::InsertLocked(uint64_t key, const shared_ptr<const ImageTile>& tile)
+{
+    auto existing = m_index.find(key);
+    if (existing != m_index.end())
+    {
+        m_sizeBytes -= existing->second->sizeBytes;
+        m_entries.erase(existing->second);
+        m_index.erase(existing);
+    }
+
+    uint64_t sizeBytes = tile->pixels.size() * sizeof(XMHALF4);
+
+    m_entries.push_front(Entry{ key, tile, sizeBytes });
+    m_index[key] = m_entries.begin();
+    m_sizeBytes += sizeBytes;
+
+    // Tiles still referenced by callers stay alive until they are released.
+    while (m_sizeBytes > m_budgetBytes && m_entries.size() > 1)
+    {
+        auto& lru = m_entries.back();
+
+        m_sizeBytes -= lru.sizeBytes;
+        m_index.erase(lru.key);
+        m_entries.pop_back();
+    }
+}
@@ -0,0 +1,134 @@
+//*********************************************************
+//
+// TiledImageStore
+//
+// Out-of-core access to images too large to decode into memory
+// at once, such as gigapixel OpenEXR and DDS files. Each level
+// of a power-of-two pyramid is divided into square tiles, which
+// are decoded from the file on demand and kept in an LRU cache
+// bounded by a byte budget.
+//
+// Levels stored in the file (DDS mips) are decoded directly.
+// Other levels are box filtered from the four tiles below them,
+// so the first request for a small level reads the matching
+// region of the file once.
+//
+// Tiles are FP16 RGBA with premultiplied alpha and hold the
+// file's values without any gamma conversion, the same as what
+// ImageLoader decodes other images to. All methods are thread
+// safe.
+//
+//*********************************************************
+
+#pragma once
+#include "DirectXTex.h"
+#include "DirectXTex\DirectXTexEXR.h"
+
+#include <DirectXPackedVector.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace DXRenderer
+{
+    struct ImageTile
+    {
+        unsigned int                                            width;
+        unsigned int                                            height;
+        std::vector<DirectX::PackedVector::XMHALF4>             pixels; // Tightly packed.
+    };
+
+    class TiledImageStore
+    {
+    public:
+        static const unsigned int TileSize = 256;
+
+        /// <summary>
+        /// Reads regions of the levels stored in a file; implemented per file format.
+        /// </summary>
+        class Decoder;
+
+        static HRESULT OpenEXR(
+            _In_z_ const wchar_t* filename,
+            uint64_t budgetBytes,
+            std::shared_ptr<TiledImageStore>& store,
+            _Out_opt_ DirectX::EXRChromaticities* chromaticities);
+
+        /// <summary>
+        /// Only the first array slice of 2D textures is read.
+        /// </summary>
+        /// <param name="fileFormat">Format of the pixels in the file.</param>
+        static HRESULT OpenDDS(
+            _In_z_ const wchar_t* filename,
+            uint64_t budgetBytes,
+            std::shared_ptr<TiledImageStore>& store,
+            _Out_opt_ DXGI_FORMAT* fileFormat);
+
+        ~TiledImageStore();
+
+        /// <summary>
+        /// Level 0 is the full resolution image; the last level fits in a single tile.
+        /// </summary>
+        unsigned int GetLevelCount() const { return static_cast<unsigned int>(m_levels.size()); }
+        unsigned int GetWidth(unsigned int level) const { return m_levels[level].width; }
+        unsigned int GetHeight(unsigned int level) const { return m_levels[level].height; }
+        uint64_t GetBudget() const { return m_budgetBytes; }
+
+        /// <summary>
+        /// Returns a tile, decoding it if it isn't cached. Tiles on the right and bottom edges
+        /// are smaller than TileSize.
+        /// </summary>
+        HRESULT GetTile(
+            unsigned int level,
+            unsigned int tileX,
+            unsigned int tileY,
+            std::shared_ptr<const ImageTile>& tile);
+
+        /// <summary>
+        /// Copies an arbitrary rectangle of a level as FP16 RGBA.
+        /// </summary>
+        HRESULT CopyPixels(
+            unsigned int level,
+            unsigned int x,
+            unsigned int y,
+            unsigned int width,
+            unsigned int height,
+            size_t strideBytes,
+            _Out_writes_bytes_(strideBytes * height) uint8_t* buffer);
+
+    private:
+        struct LevelSize
+        {
+            unsigned int                                        width;
+            unsigned int                                        height;
+        };
+
+        struct Entry
+        {
+            uint64_t                                            key;
+            std::shared_ptr<const ImageTile>                    tile;
+            uint64_t                                            sizeBytes;
+        };
+
+        TiledImageStore(std::unique_ptr<Decoder> decoder, uint64_t budgetBytes);
+
+        unsigned int GetTilesAcross(unsigned int level) const { return (m_levels[level].width + TileSize - 1) / TileSize; }
+        unsigned int GetTilesDown(unsigned int level) const { return (m_levels[level].height + TileSize - 1) / TileSize; }
+
+        // Callers must hold m_lock.
+        HRESULT DecodeTilesLocked(unsigned int level, unsigned int tileX, unsigned int tileY, std::shared_ptr<const ImageTile>& tile);
+        HRESULT SynthesizeTileLocked(unsigned int level, unsigned int tileX, unsigned int tileY, std::shared_ptr<const ImageTile>& tile);
+        void InsertLocked(uint64_t key, const std::shared_ptr<const ImageTile>& tile);
+
+        std::unique_ptr<Decoder>                                m_decoder;
+        std::vector<LevelSize>                                  m_levels;
+
+        // Recursive because synthesizing a tile requests the tiles below it.
+        std::recursive_mutex                                    m_lock;
+        std::list<Entry>                                        m_entries; // Most recently used first.
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> m_index;
+        std::vector<DirectX::PackedVector::XMHALF4>             m_window; // Scratch for DecodeTilesLocked.
+        uint64_t                                                m_budgetBytes;
+        uint64_t                                                m_sizeBytes;
+    };
+}
@@ -0,0 +1,177 @@
+#include "pch.h"
+#include "TiledWicBitmapSource.h"
+
+using namespace DXRenderer;
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+TiledWicBitmapSource::TiledWicBitmapSource(const std::shared_ptr<TiledImageStore>& store, unsigned int level, bool isFloat) :
+    m_store(store),
+    m_level(level),
+    m_isFloat(isFloat),
+    m_refCount(1)
+{
+}
+
+HRESULT TiledWicBitmapSource::Create(
+    const std::shared_ptr<TiledImageStore>& store,
+    unsigned int level,
+    bool isFloat,
+    IWICBitmapSource** source)
+{
+    *source = nullptr;
+
+    if (store == nullptr || level >= store->GetLevelCount())
+    {
+        return E_INVALIDARG;
+    }
+
+    *source = new (std::nothrow) TiledWicBitmapSource(store, level, isFloat);
+
+    return *source ? S_OK : E_OUTOFMEMORY;
+}
+
+IFACEMETHODIMP TiledWicBitmapSource::GetSize(UINT* width, UINT* height)
+{
+    if (width == nullptr || height == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    *width = m_store->GetWidth(m_level);
+    *height = m_store->GetHeight(m_level);
+
+    return S_OK;
+}
+
+IFACEMETHODIMP TiledWicBitmapSource::GetPixelFormat(WICPixelFormatGUID* pixelFormat)
+{
+    if (pixelFormat == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    *pixelFormat = m_isFloat ? GUID_WICPixelFormat64bppPRGBAHalf : GUID_WICPixelFormat64bppPRGBA;
+
+    return S_OK;
+}
+
+IFACEMETHODIMP TiledWicBitmapSource::GetResolution(double* dpiX, double* dpiY)
+{
+    if (dpiX == nullptr || dpiY == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    *dpiX = 96.0;
+    *dpiY = 96.0;
+
+    return S_OK;
+}
+
+IFACEMETHODIMP TiledWicBitmapSource::CopyPalette(IWICPalette* palette)
+{
+    UNREFERENCED_PARAMETER(palette);
+
+    return WINCODEC_ERR_PALETTEUNAVAILABLE;
+}
+
+IFACEMETHODIMP TiledWicBitmapSource::CopyPixels(const WICRect* rect, UINT stride, UINT bufferSize, BYTE* buffer)
+{
+    if (buffer == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    // A null rect means the entire bitmap.
+    WICRect full = { 0, 0, static_cast<INT>(m_store->GetWidth(m_level)), static_cast<INT>(m_store->GetHeight(m_level)) };
+    if (rect == nullptr)
+    {
+        rect = &full;
+    }
+
+    if (rect->X < 0 || rect->Y < 0 || rect->Width < 0 || rect->Height < 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (rect->Width == 0 || rect->Height == 0)
+    {
+        return S_OK;
+    }
+
+    uint64_t rowBytes = static_cast<uint64_t>(rect->Width) * sizeof(XMHALF4);
+    if (stride < rowBytes || bufferSize < static_cast<uint64_t>(stride) * (rect->Height - 1) + rowBytes)
+    {
+        return WINCODEC_ERR_INSUFFICIENTBUFFER;
+    }
+
+    HRESULT hr = m_store->CopyPixels(m_level, rect->X, rect->Y, rect->Width, rect->Height, stride, buffer);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    if (!m_isFloat)
+    {
+        // Same size per pixel, so convert in place.
+        for (INT y = 0; y < rect->Height; y++)
+        {
+            auto row = buffer + static_cast<size_t>(y) * stride;
+            for (INT x = 0; x < rect->Width; x++)
+            {
+                XMVECTOR v = XMLoadHalf4(reinterpret_cast<XMHALF4*>(row) + x);
+                XMStoreUShortN4(reinterpret_cast<XMUSHORTN4*>(row) + x, v);
+            }
+        }
+    }
+
+    return S_OK;
+}
+
+IFACEMETHODIMP_(ULONG) TiledWicBitmapSource::AddRef()
+{
+    return InterlockedIncrement(&m_refCount);
+}
+
+IFACEMETHODIMP_(ULONG) TiledWicBitmapSource::Release()
+{
+    ULONG count = InterlockedDecrement(&m_refCount);
+
+    if (count == 0)
+    {
+        delete this;
+    }
+
+    return count;
+}
+
+IFACEMETHODIMP TiledWicBitmapSource::QueryInterface(
+    _In_ REFIID riid,
+    _Outptr_ void** ppOutput
+    )
+{
+    *ppOutput = nullptr;
+    HRESULT hr = S_OK;
+
+    if (riid == __uuidof(IWICBitmapSource))
+    {
+        *ppOutput = static_cast<IWICBitmapSource*>(this);
+    }
+    else if (riid == __uuidof(IUnknown))
+    {
+        *ppOutput = this;
+    }
+    else
+    {
+        hr = E_NOINTERFACE;
+    }
+
+    if (*ppOutput != nullptr)
+    {
+        AddRef();
+    }
+
+    return hr;
+}
@@ -0,0 +1,49 @@
+//*********************************************************
+//
+// TiledWicBitmapSource
+//
+// Exposes one level of a TiledImageStore as an IWICBitmapSource,
+// so Direct2D can draw it with CreateImageSourceFromWic and
+// D2D1_IMAGE_SOURCE_LOADING_OPTIONS_CACHE_ON_DEMAND: only the
+// regions actually drawn are requested, and those are decoded
+// from the file a tile at a time.
+//
+//*********************************************************
+
+#pragma once
+#include "TiledImageStore.h"
+
+namespace DXRenderer
+{
+    class TiledWicBitmapSource : public IWICBitmapSource
+    {
+    public:
+        /// <param name="isFloat">If false, pixels are provided as 64bppPRGBA instead of
+        /// 64bppPRGBAHalf, matching what ImageLoader uses for integer images.</param>
+        static HRESULT Create(
+            const std::shared_ptr<TiledImageStore>& store,
+            unsigned int level,
+            bool isFloat,
+            _COM_Outptr_ IWICBitmapSource** source);
+
+        // Declare IWICBitmapSource implementation methods.
+        IFACEMETHODIMP GetSize(_Out_ UINT* width, _Out_ UINT* height);
+        IFACEMETHODIMP GetPixelFormat(_Out_ WICPixelFormatGUID* pixelFormat);
+        IFACEMETHODIMP GetResolution(_Out_ double* dpiX, _Out_ double* dpiY);
+        IFACEMETHODIMP CopyPalette(_In_ IWICPalette* palette);
+        IFACEMETHODIMP CopyPixels(_In_opt_ const WICRect* rect, UINT stride, UINT bufferSize, _Out_writes_bytes_(bufferSize) BYTE* buffer);
+
+        // Declare IUnknown implementation methods.
+        IFACEMETHODIMP_(ULONG) AddRef();
+        IFACEMETHODIMP_(ULONG) Release();
+        IFACEMETHODIMP QueryInterface(_In_ REFIID riid, _Outptr_ void** ppOutput);
+
+    private:
+        TiledWicBitmapSource(const std::shared_ptr<TiledImageStore>& store, unsigned int level, bool isFloat);
+
+        std::shared_ptr<TiledImageStore>                        m_store;
+        unsigned int                                            m_level;
+        bool                                                    m_isFloat;
+        LONG                                                    m_refCount; // Direct2D may call from any thread.
+    };
+}
@@ -229,7 +229,8 @@ protected override void OnFileActivated(Windows.ApplicationModel.Activation.File
             {
                 hideUI = false,
                 useFullscreen = false,
-                initialFileToken = StorageApplicationPermissions.FutureAccessList.Add(file)
+                initialFileToken = StorageApplicationPermissions.FutureAccessList.Add(file),
+                neighboringFiles = e.NeighboringFilesQuery
             };
 
             LaunchAppCommon(args, false);
@@ -21,12 +21,19 @@ public enum ErrorDialogType
 
     public sealed partial class ErrorContentDialog : ContentDialog
     {
-        public ErrorContentDialog(ErrorDialogType type, String customTitle = UIStrings.ERROR_DEFAULTTITLE)
+        /// <param name="message">Optional detail shown below the text for type, e.g. an exception message.</param>
+        public ErrorContentDialog(ErrorDialogType type, String customTitle = UIStrings.ERROR_DEFAULTTITLE, String message = null)
         {
             this.InitializeComponent();
 
             this.Title = customTitle;
 
+            if (!String.IsNullOrEmpty(message))
+            {
+                MessageText.Text = message;
+                MessageText.Visibility = Visibility.Visible;
+            }
+
             if (type.HasFlag(ErrorDialogType.InvalidFile))
             {
                 InvalidFileText.Visibility = Visibility.Visible;
@@ -1,12 +1,15 @@
 ﻿using DXRenderer;
 using System;
+using System.Collections.Generic;
 using System.Diagnostics;
+using System.Linq;
 using System.Threading.Tasks;
 using Windows.Foundation.Collections;
 using Windows.Graphics.Display;
 using Windows.Storage;
 using Windows.Storage.AccessCache;
 using Windows.Storage.Pickers;
+using Windows.Storage.Search;
 using Windows.System;
 using Windows.UI.Core;
 using Windows.UI.Input;
@@ -32,6 +35,7 @@ public struct DXViewerLaunchArgs
         public bool hasForcedEffect;
         public DXRenderer.RenderEffectKind forcedEffect;
         public string initialFileToken; // StorageItemAccessList token
+        public StorageFileQueryResult neighboringFiles; // Only set for file activation. Can be null.
         public ErrorDialogType errorType; // If this is not DefaultValue, triggers the error dialog.
         public string errorFilename; // Only use this if ErrorDialogType is InvalidFile.
         public string rawCommandLine;
@@ -56,6 +60,11 @@ public sealed partial class DXViewerPage : Page
         bool profileColorimetryOverride;
         ImageLoaderOptions loaderOptions;
         string commandLine;
+
+        // Images in the same folder as the opened file, for previous/next navigation.
+        IReadOnlyList<StorageFile> folderFiles;
+        int folderIndex;
+        bool isSteppingFolder;
         DXRenderer.RenderEffectKind? forcedEffect;
 
         ToolTip tooltip;
@@ -170,7 +179,7 @@ protected async override void OnNavigatedTo(NavigationEventArgs e)
                 if (args.initialFileToken != null)
                 {
                     var file = await StorageApplicationPermissions.FutureAccessList.GetFileAsync(args.initialFileToken);
-                    await LoadImageAsync(file);
+                    await OpenImageAsync(file, args.neighboringFiles);
                 }
 
                 // Startup effect needs to be set after the image is loaded in UpdateDefaultRenderOptions.
@@ -421,6 +430,22 @@ private void ToggleExperimentalToolsInvoked(KeyboardAccelerator sender, Keyboard
             SetExperimentalTools(!enableExperimentalTools);
         }
 
+        private async void NextImageInvoked(KeyboardAccelerator sender, KeyboardAcceleratorInvokedEventArgs args)
+        {
+            if (WorkaroundShouldIgnoreAccelerator()) return;
+
+            args.Handled = true;
+            await StepFolderAsync(1);
+        }
+
+        private async void PreviousImageInvoked(KeyboardAccelerator sender, KeyboardAcceleratorInvokedEventArgs args)
+        {
+            if (WorkaroundShouldIgnoreAccelerator()) return;
+
+            args.Handled = true;
+            await StepFolderAsync(-1);
+        }
+
         private void ScrapeColorProfile()
         {
 
@@ -450,6 +475,169 @@ private bool CheckHeifAvifOsVersion()
             }
         }
 
+        /// <summary>
+        /// Loads an image chosen by the user, and makes its folder the one navigated by the previous/next image keys.
+        /// </summary>
+        /// <param name="neighboringFiles">From file activation. If null, the folder is queried directly, which
+        /// only works if the app has access to it.</param>
+        private async Task OpenImageAsync(StorageFile imageFile, StorageFileQueryResult neighboringFiles)
+        {
+            await LoadImageAsync(imageFile);
+
+            folderFiles = null;
+            folderIndex = -1;
+
+            try
+            {
+                IReadOnlyList<StorageFile> files = null;
+
+                if (neighboringFiles != null)
+                {
+                    files = await neighboringFiles.GetFilesAsync();
+                }
+                else
+                {
+                    var folder = await imageFile.GetParentAsync(); // null without access to the folder.
+                    if (folder != null)
+                    {
+                        files = await folder.CreateFileQueryWithOptions(new QueryOptions(CommonFileQuery.DefaultQuery, GetOpenFileTypes())).GetFilesAsync();
+                    }
+                }
+
+                if (files != null)
+                {
+                    var types = GetOpenFileTypes();
+                    var images = files.Where(f => types.Contains(f.FileType.ToLowerInvariant())).ToList();
+                    folderFiles = images;
+                    folderIndex = images.FindIndex(f => string.Equals(f.Path, imageFile.Path, StringComparison.OrdinalIgnoreCase));
+                }
+            }
+            catch
+            {
+                // Folder navigation is optional.
+                folderFiles = null;
+            }
+
+            PrefetchNeighboringImages();
+        }
+
+        private async Task StepFolderAsync(int step)
+        {
+            if (folderFiles == null || folderIndex < 0 || folderFiles.Count < 2 || isSteppingFolder) return;
+
+            isSteppingFolder = true;
+
+            try
+            {
+                folderIndex = (folderIndex + step + folderFiles.Count) % folderFiles.Count;
+                await LoadImageAsync(folderFiles[folderIndex]);
+            }
+            catch (Exception ex)
+            {
+                var dialog = new ErrorContentDialog(ErrorDialogType.InvalidFile, UIStrings.ERROR_DEFAULTTITLE, ex.Message);
+                await dialog.ShowAsync();
+            }
+            finally
+            {
+                isSteppingFolder = false;
+            }
+
+            PrefetchNeighboringImages();
+        }
+
+        /// <summary>
+        /// Decodes the next and previous images in the folder in the background, so stepping to them is instant.
+        /// </summary>
+        private async void PrefetchNeighboringImages()
+        {
+            if (folderFiles == null || folderIndex < 0 || folderFiles.Count < 2) return;
+
+            var count = folderFiles.Count;
+            var neighbors = new StorageFile[] { folderFiles[(folderIndex + 1) % count], folderFiles[(folderIndex + count - 1) % count] };
+
+            foreach (var file in neighbors)
+            {
+                try
+                {
+                    var cacheKey = await GetImageCacheKeyAsync(file);
+                    if (renderer.IsImageCached(cacheKey, loaderOptions)) continue;
+
+                    var type = file.FileType.ToLowerInvariant();
+                    if (IsDirectXTexFileType(type))
+                    {
+                        // Same requirement as LoadImageAsync.
+                        var tempFile = await file.CopyAsync(
+                            ApplicationData.Current.TemporaryFolder,
+                            GetTempFileName(file, cacheKey),
+                            NameCollisionOption.ReplaceExisting);
+
+                        renderer.PrefetchImageFromDirectXTex(tempFile.Path, type, loaderOptions, cacheKey);
+                    }
+                    else
+                    {
+                        renderer.PrefetchImageFromWic(file, await file.OpenAsync(FileAccessMode.Read), loaderOptions, cacheKey);
+                    }
+                }
+                catch
+                {
+                    // Prefetching is best effort; the image is loaded normally when it is opened.
+                }
+            }
+        }
+
+        private static List<string> GetOpenFileTypes()
+        {
+            var types = new List<string>(UIStrings.FILEFORMATS_OPEN);
+
+            if (Windows.Foundation.Metadata.ApiInformation.IsApiContractPresent(
+                "Windows.Foundation.UniversalApiContract", 8)) // 8 == Windows 1903/19H1
+            {
+                types.AddRange(UIStrings.FILEFORMATS_OPEN_19H1);
+            }
+
+            return types;
+        }
+
+        private static bool IsDirectXTexFileType(string type)
+        {
+            return type == ".hdr" ||
+                   type == ".exr" ||
+                   type == ".dds";
+        }
+
+        /// <summary>
+        /// Name for the temporary copy of a file that DirectXTex loads. Derived from the cache key, so a
+        /// copy that a cached or prefetching image may still have open is only replaced by the same file.
+        /// </summary>
+        private static string GetTempFileName(StorageFile file, ImageCacheKey cacheKey)
+        {
+            if (string.IsNullOrEmpty(cacheKey.path))
+            {
+                return Guid.NewGuid().ToString("N") + file.FileType;
+            }
+
+            // FNV-1a; string.GetHashCode isn't guaranteed to be stable.
+            ulong hash = 14695981039346656037;
+            foreach (char c in cacheKey.path + "|" + cacheKey.lastModified.UtcTicks)
+            {
+                hash = (hash ^ c) * 1099511628211;
+            }
+
+            return hash.ToString("x16") + file.FileType;
+        }
+
+        private static async Task<ImageCacheKey> GetImageCacheKeyAsync(StorageFile file)
+        {
+            var props = await file.GetBasicPropertiesAsync();
+
+            // StorageFile.Path is empty for some files, e.g. from other apps; these are not cached.
+            return new ImageCacheKey
+            {
+                path = file.Path,
+                lastModified = props.DateModified
+            };
+        }
+
         public async Task LoadImageAsync(StorageFile imageFile)
         {
             // File format handler registration is static vs. OS version (in the appxmanifset), so a user may attempt to activate
@@ -465,31 +653,31 @@ public async Task LoadImageAsync(StorageFile imageFile)
             PixelColorCheckbox.IsEnabled = false;
             DispMaxCLLOverrideSlider.IsEnabled = false;
 
-            bool useDirectXTex = false;
-
             var type = imageFile.FileType.ToLowerInvariant();
-            if (type == ".hdr" ||
-                type == ".exr" ||
-                type == ".dds")
-            {
-                useDirectXTex = true;
-            }
+            bool useDirectXTex = IsDirectXTexFileType(type);
 
-            ImageInfo info;
+            var cacheKey = await GetImageCacheKeyAsync(imageFile);
 
-            if (useDirectXTex)
-            {
-                // For formats that are loaded by DirectXTex, we must use a file path from the temporary folder.
-                imageFile = await imageFile.CopyAsync(
-                        ApplicationData.Current.TemporaryFolder,
-                        imageFile.Name,
-                        NameCollisionOption.ReplaceExisting);
+            // If the image is still being prefetched, wait for it rather than decode it again.
+            await renderer.WaitForImagePrefetchAsync(cacheKey, loaderOptions);
+            ImageInfo info = renderer.LoadImageFromCache(cacheKey, loaderOptions);
 
-                info = renderer.LoadImageFromDirectXTex(imageFile.Path, type, loaderOptions);
-            }
-            else
+            if (info.isValid == false)
             {
-                info = renderer.LoadImageFromWic(await imageFile.OpenAsync(FileAccessMode.Read), loaderOptions);
+                if (useDirectXTex)
+                {
+                    // For formats that are loaded by DirectXTex, we must use a file path from the temporary folder.
+                    var tempFile = await imageFile.CopyAsync(
+                            ApplicationData.Current.TemporaryFolder,
+                            GetTempFileName(imageFile, cacheKey),
+                            NameCollisionOption.ReplaceExisting);
+
+                    info = renderer.LoadImageFromDirectXTex(tempFile.Path, type, loaderOptions, cacheKey);
+                }
+                else
+                {
+                    info = renderer.LoadImageFromWic(imageFile, await imageFile.OpenAsync(FileAccessMode.Read), loaderOptions, cacheKey);
+                }
             }
 
             if (info.isValid == false)
@@ -587,6 +775,11 @@ private async Task ExportImageAsync(StorageFile file)
             {
                 renderer.ExportImageToJxr(ras);
             }
+            else if (file.FileType == ".dds")
+            {
+                // Default quality.
+                renderer.ExportImageToDds(ras, -1.0f);
+            }
             else
             {
                 renderer.ExportImageToSdr(ras, wicFormat);
@@ -692,7 +885,16 @@ private async void ExportImageButton_Click(object sender, RoutedEventArgs e)
             var pickedFile = await picker.PickSaveFileAsync();
             if (pickedFile != null)
             {
-                await ExportImageAsync(pickedFile);
+                try
+                {
+                    await ExportImageAsync(pickedFile);
+                }
+                catch (Exception)
+                {
+                    // E.g. DDS export of a format it can't compress, such as HDR10.
+                    var dialog = new ErrorContentDialog(ErrorDialogType.DefaultValue, UIStrings.ERROR_EXPORTTITLE);
+                    await dialog.ShowAsync();
+                }
             }
         }
 
@@ -723,7 +925,7 @@ private async void OpenImageButton_Click(object sender, RoutedEventArgs e)
                 var file = await picker.PickSingleFileAsync();
                 if (file != null)
                 {
-                    await LoadImageAsync(file);
+                    await OpenImageAsync(file, null);
                 }
             }
             catch (Exception ex)
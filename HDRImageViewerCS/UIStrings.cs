@@ -27,6 +27,7 @@ static class UIStrings
 
         public const string ERROR_DEFAULTTITLE         = "Unable to load image";
         public const string ERROR_INVALIDCMDARGS       = "Command line usage";
+        public const string ERROR_EXPORTTITLE          = "Unable to export image";
 
         public const string DIALOG_SAVECOMMIT          = "Export image to SDR";
 
@@ -51,7 +52,8 @@ static class UIStrings
         {
             { "JPEG image (SDR)", new List<string> { ".jpg" } },
             { "PNG image (SDR)" , new List<string> { ".png" } },
-            { "JPEG-XR image (HDR)" , new List<string> { ".jxr" } }
+            { "JPEG-XR image (HDR)" , new List<string> { ".jxr" } },
+            { "DDS texture (BC6H/BC7)" , new List<string> { ".dds" } }
         };
 
 
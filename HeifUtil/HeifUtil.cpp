@@ -1,139 +1,232 @@
 // HeifUtil.cpp : This file contains the 'main' function. Program execution begins and ends there.
 //
+// Batch metadata scanner. Walks files and directory trees and writes one JSON object per
+// supported image (HEIF, OpenEXR, Radiance RGBE, DDS) containing the same information
+// HDRImageViewer reports in ImageInfo and ImageCLL.
+//
+// Usage: HeifUtil /input=<file or directory> [/input=...] [/output=<file.jsonl>] [/threads=N] [/nocll]
+//
+// /output   Defaults to stdout.
+// /threads  Number of files processed concurrently. Defaults to one per hardware thread.
+// /nocll    Only read headers; skips decoding pixels to compute MaxCLL and median luminance.
+//
 
 #include "pch.h"
-#include "LibHeifHelpers.h"
+#include "ImageProbe.h"
 
-int main(int argc, WCHAR* argv[])
-{
-    HRESULT hr = S_OK;
-    heif_error herr = {};
-    hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+using namespace HeifUtil;
 
-    PWSTR inputFilenameRaw = nullptr;
-    PWSTR outputFilename = nullptr;
-    std::wstring inputFilename;
-
-    for (int i = 1; i < argc; ++i)
+namespace
+{
+    /// <summary>
+    /// Fixed capacity multi-producer multi-consumer queue. Bounds the number of discovered but
+    /// unprocessed paths, so walking huge directory trees does not run ahead of the workers.
+    /// </summary>
+    template <typename T>
+    class BoundedQueue
     {
-        const WCHAR szInputArg[] = L"/input=";
-        const UINT cchInputArg = ARRAYSIZE(szInputArg) - 1;
-        if (!wcsncmp(szInputArg, argv[i], cchInputArg) && wcslen(argv[i]) > cchInputArg)
+    public:
+        BoundedQueue(size_t capacity) : m_capacity(capacity), m_closed(false) {}
+
+        void Push(T item)
         {
-            inputFilenameRaw = &argv[i][cchInputArg];
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_notFull.wait(lock, [this] { return m_items.size() < m_capacity; });
 
-            inputFilename = std::wstring(inputFilenameRaw);
+            m_items.push_back(std::move(item));
+            m_notEmpty.notify_one();
         }
 
-        const WCHAR szOutputArg[] = L"/output=";
-        const UINT cchOutputArg = ARRAYSIZE(szOutputArg) - 1;
-        if (!wcsncmp(szOutputArg, argv[i], cchOutputArg) && wcslen(argv[i]) > cchOutputArg)
+        /// <summary>
+        /// Returns false once the queue is closed and empty.
+        /// </summary>
+        bool Pop(T& item)
         {
-            outputFilename = &argv[i][cchOutputArg];
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_notEmpty.wait(lock, [this] { return !m_items.empty() || m_closed; });
+
+            if (m_items.empty())
+            {
+                return false;
+            }
+
+            item = std::move(m_items.front());
+            m_items.pop_front();
+            m_notFull.notify_one();
+            return true;
         }
-    }
-
-    CComPtr<IWICImagingFactory> fact;
-    hr = CoCreateInstance(
-        CLSID_WICImagingFactory2,
-        nullptr,
-        CLSCTX_INPROC_SERVER,
-        IID_PPV_ARGS(&fact));
-
-    DXRenderer::CHeifContext ctx;
-    herr = heif_context_read_from_file(ctx.ptr, "input.heic", nullptr);
 
-    DXRenderer::CHeifHandle mainHandle;
-    herr = heif_context_get_primary_image_handle(ctx.ptr, &mainHandle.ptr);
-
-    // Decode the main image into WIC. This code is currently not used.
+        void Close()
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_closed = true;
+            m_notEmpty.notify_all();
+        }
 
-    DXRenderer::CHeifImage mainImg;
-    herr = heif_decode_image(mainHandle.ptr, &mainImg.ptr, heif_colorspace_RGB, heif_chroma_interleaved_RGB, 0);
+    private:
+        std::mutex                                              m_lock;
+        std::condition_variable                                 m_notEmpty;
+        std::condition_variable                                 m_notFull;
+        std::deque<T>                                           m_items;
+        const size_t                                            m_capacity;
+        bool                                                    m_closed;
+    };
 
-    int mainWidth = heif_image_get_primary_width(mainImg.ptr);
-    int mainHeight = heif_image_get_primary_height(mainImg.ptr);
-    // Assuming 8bpc.
+    // Paths queued per worker thread.
+    const size_t sc_queueDepthPerThread = 16;
 
-    int mainStride = 0;
-    uint8_t* mainData = heif_image_get_plane(mainImg.ptr, heif_channel_interleaved, &mainStride);
+    // Progress is reported on stderr after this many files.
+    const uint64_t sc_progressInterval = 1000;
 
-    CComPtr<IWICBitmap> mainBmpRaw;
-    hr = fact->CreateBitmapFromMemory(mainWidth, mainHeight, GUID_WICPixelFormat8bppGray, mainStride, mainStride * mainHeight, mainData, &mainBmpRaw);
+    bool GetArgValue(const WCHAR* arg, const WCHAR* name, std::wstring& value)
+    {
+        size_t cchName = wcslen(name);
+        if (wcsncmp(name, arg, cchName) || wcslen(arg) <= cchName)
+        {
+            return false;
+        }
 
-    CComPtr<IWICBitmapScaler> scaler;
-    hr = fact->CreateBitmapScaler(&scaler);
-    hr = scaler->Initialize(mainBmpRaw, mainWidth / 2, mainHeight / 2, WICBitmapInterpolationModeLinear); // Filtering is good enough for exact 2x2 downscale.
+        value = &arg[cchName];
+        return true;
+    }
 
-    CComPtr<IWICFormatConverter> format;
-    hr = fact->CreateFormatConverter(&format);
-    hr = format->Initialize(scaler.p, GUID_WICPixelFormat8bppGray, WICBitmapDitherTypeNone, nullptr, 0.0f, WICBitmapPaletteTypeCustom);
+    void EnqueueInput(const std::filesystem::path& input, BoundedQueue<std::filesystem::path>& queue)
+    {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(input, ec))
+        {
+            // Explicitly named files are always reported, even if unsupported.
+            queue.Push(input);
+            return;
+        }
 
-    CComPtr<IWICBitmap> mainBitmap;
-    hr = fact->CreateBitmapFromSource(format.p, WICBitmapCacheOnDemand, &mainBitmap);
+        auto options = std::filesystem::directory_options::skip_permission_denied;
+        for (std::filesystem::recursive_directory_iterator it(input, options, ec), end; !ec && it != end; it.increment(ec))
+        {
+            if (it->is_regular_file(ec) && GetImageContainer(it->path()) != ImageContainer::Unknown)
+            {
+                queue.Push(it->path());
+            }
+        }
 
-    // Get all of the auxiliary images.
+        if (ec)
+        {
+            std::wcerr << L"Error walking " << input.wstring() << L": " << ec.message().c_str() << std::endl;
+        }
+    }
+}
 
-    int countAux = heif_image_handle_get_number_of_auxiliary_images(mainHandle.ptr, 0);
-    std::vector<heif_item_id> auxIds(countAux);
-    heif_image_handle_get_list_of_auxiliary_image_IDs(mainHandle.ptr, 0, auxIds.data(), auxIds.size());
+int wmain(int argc, WCHAR* argv[])
+{
+    std::vector<std::filesystem::path> inputs;
+    std::wstring outputFilename;
+    unsigned int threadCount = 0;
+    bool computeCLL = true;
 
-    for (auto i : auxIds)
+    for (int i = 1; i < argc; ++i)
     {
-        DXRenderer::CHeifHandle auxHandle;
-        herr = heif_image_handle_get_auxiliary_image_handle(mainHandle.ptr, i, &auxHandle.ptr);
+        std::wstring value;
 
-        DXRenderer::CHeifAuxType type;
-        herr = heif_image_handle_get_auxiliary_type(auxHandle.ptr, &type.ptr);
-
-        if (type.IsAppleHdrGainMap())
+        if (GetArgValue(argv[i], L"/input=", value))
+        {
+            inputs.push_back(value);
+        }
+        else if (GetArgValue(argv[i], L"/output=", value))
+        {
+            outputFilename = value;
+        }
+        else if (GetArgValue(argv[i], L"/threads=", value))
+        {
+            threadCount = static_cast<unsigned int>(wcstoul(value.c_str(), nullptr, 10));
+        }
+        else if (!wcscmp(argv[i], L"/nocll"))
         {
-            DXRenderer::CHeifImage img;
-            herr = heif_decode_image(auxHandle.ptr, &img.ptr, heif_colorspace_monochrome, heif_chroma_monochrome, 0);
+            computeCLL = false;
+        }
+        else
+        {
+            std::wcerr << L"Unknown argument: " << argv[i] << std::endl;
+            return -1;
+        }
+    }
 
-            int width = heif_image_get_primary_width(img.ptr);
-            int height = heif_image_get_primary_height(img.ptr);
-            int bitdepth = heif_image_get_bits_per_pixel_range(img.ptr, heif_channel_Y);
+    if (inputs.empty())
+    {
+        std::wcerr << L"Usage: HeifUtil /input=<file or directory> [/input=...] [/output=<file.jsonl>] [/threads=N] [/nocll]" << std::endl;
+        return -1;
+    }
 
-            int stride = 0;
-            uint8_t* data = heif_image_get_plane(img.ptr, heif_channel_Y, &stride);
+    std::ofstream outputFile;
+    if (!outputFilename.empty())
+    {
+        outputFile.open(outputFilename, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!outputFile)
+        {
+            std::wcerr << L"Can't open " << outputFilename << std::endl;
+            return -1;
+        }
+    }
 
-            CComPtr<IWICStream> stream;
-            hr = fact->CreateStream(&stream);
-            hr = stream->InitializeFromFilename(L"output.png", GENERIC_WRITE);
+    std::ostream& output = outputFilename.empty() ? std::cout : outputFile;
 
-            CComPtr<IWICBitmap> bitmap;
-            hr = fact->CreateBitmapFromMemory(width, height, GUID_WICPixelFormat8bppGray, stride, stride * height, data, &bitmap);
+    if (threadCount == 0)
+    {
+        threadCount = max(std::thread::hardware_concurrency(), 1u);
+    }
 
-            CComPtr<IWICBitmapEncoder> encoder;
-            hr = fact->CreateEncoder(GUID_ContainerFormatPng, nullptr, &encoder);
-            hr = encoder->Initialize(stream.p, WICBitmapEncoderNoCache);
+    // Each worker holds at most one decoded image (OpenEXR is streamed), so peak memory is
+    // bounded by threadCount rather than by the number of files.
+    BoundedQueue<std::filesystem::path> queue(threadCount * sc_queueDepthPerThread);
+    std::mutex outputLock;
+    std::atomic<uint64_t> countProcessed{ 0 };
+    std::atomic<uint64_t> countFailed{ 0 };
 
-            CComPtr<IWICBitmapFrameEncode> frame;
-            hr = encoder->CreateNewFrame(&frame, nullptr);
-            hr = frame->Initialize(nullptr);
-            hr = frame->WriteSource(bitmap.p, nullptr);
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < threadCount; i++)
+    {
+        workers.emplace_back([&]()
+        {
+            std::filesystem::path path;
+            ImageProbeResult result;
+
+            while (queue.Pop(path))
+            {
+                ProbeImage(path, computeCLL, result);
+                auto line = ToJsonLine(result);
+
+                {
+                    std::lock_guard<std::mutex> lock(outputLock);
+                    output << line << '\n';
+                }
+
+                if (FAILED(result.hr))
+                {
+                    countFailed++;
+                }
+
+                if (++countProcessed % sc_progressInterval == 0)
+                {
+                    std::wcerr << L"Processed " << countProcessed.load() << L" files" << std::endl;
+                }
+            }
+        });
+    }
 
-            hr = frame->Commit();
-            hr = encoder->Commit();
-            hr = stream->Commit(STGC_DEFAULT);
+    for (auto& input : inputs)
+    {
+        EnqueueInput(input, queue);
+    }
 
-            // Get main image pixels.. This code is currently unused.
+    queue.Close();
 
-            CComPtr<IWICBitmapLock> scaleLock;
-            hr = mainBitmap->Lock(nullptr, GENERIC_READ, &scaleLock);
-            UINT mainWidth = 0, mainHeight = 0, mainStride = 0;
-            hr = scaleLock->GetSize(&mainWidth, &mainHeight);
-            if ((mainWidth != width) || (mainHeight != height)) return -1; // Assert.
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
 
-            hr = scaleLock->GetStride(&mainStride);
-            
-            std::vector<uint8_t> mainPixels(mainStride * mainHeight);
+    output.flush();
 
-            // Immediately return once we have a gain map.
-            return 0;
-        }
-    }
+    std::wcerr << L"Processed " << countProcessed.load() << L" files, " << countFailed.load() << L" failed" << std::endl;
 
-    return 0;
-}
\ No newline at end of file
+    return countFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,584 @@
+#include "pch.h"
+#include "ImageProbe.h"
+#include "LibHeifHelpers.h"
+#include "..\DXRenderer\ImageStatistics.h"
+#include "..\DXRenderer\Common\MemoryMappedFile.h"
+#include "..\DXRenderer\CpuRender\LuminanceHistogram.h"
+#include "..\DXRenderer\CpuRender\PixelDecoders.h"
+#include "..\DXRenderer\CpuRender\TransferFunctions.h"
+#include "..\DXRenderer\DirectXTex\DirectXTexRGBE.h"
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+using namespace DXRenderer;
+using namespace HeifUtil;
+
+/// <summary>
+/// "If failed return"
+/// </summary>
+#define IFR(expr) { HRESULT _hr = (expr); if (FAILED(_hr)) { return _hr; } }
+
+namespace
+{
+    inline HRESULT HEIFHR(heif_error herr) { return herr.code == heif_error_code::heif_error_Ok ? S_OK : WINCODEC_ERR_GENERIC_ERROR; }
+
+    // BT.2100 PQ is decoded to linear with 1.0 = 10000 nits, and LuminanceHistogram expects
+    // 1.0 = sc_SceneReferredSdrWhiteNits.
+    const float sc_pqToHistogramScale = 10000.0f / sc_SceneReferredSdrWhiteNits;
+
+    // Y row of the BT.2020 RGB to XYZ matrix.
+    const XMFLOAT3 sc_bt2020Luminance = { 0.2627f * sc_pqToHistogramScale, 0.6780f * sc_pqToHistogramScale, 0.0593f * sc_pqToHistogramScale };
+
+    void UpdateImageKind(ImageProbeResult& result)
+    {
+        // Same rules as ImageLoader::PopulateImageInfoACKind.
+        result.imageKind = ImageKind::Sdr;
+
+        if (result.bitsPerChannel > 8 || result.countColorProfiles >= 1)
+        {
+            result.imageKind = ImageKind::Wcg;
+        }
+
+        if (result.isFloat || result.forceBT2100ColorSpace || result.hasAppleHdrGainMap)
+        {
+            result.imageKind = ImageKind::Hdr;
+        }
+    }
+
+    void SetCLL(const HistogramCLL& cll, ImageProbeResult& result)
+    {
+        // Pure black images are treated as unknown, like HDRImageViewerRenderer::ComputeHdrMetadata.
+        if (cll.maxNits > 0.0f)
+        {
+            result.maxNits = cll.maxNits;
+            result.medianNits = cll.medianNits;
+        }
+
+        result.isSceneReferred = true;
+    }
+
+    /// <summary>
+    /// Adds a decoded DirectXTex image in one of the float formats HDRImageViewer supports.
+    /// </summary>
+    HRESULT AddImageToHistogram(const Image& image, LuminanceHistogram& histogram)
+    {
+        switch (image.format)
+        {
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            histogram.AddPixels(
+                reinterpret_cast<const XMHALF4*>(image.pixels),
+                static_cast<unsigned int>(image.width),
+                static_cast<unsigned int>(image.height),
+                image.rowPitch,
+                1);
+            return S_OK;
+
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            // ScratchImage rows are 16 byte aligned.
+            for (size_t y = 0; y < image.height; y++)
+            {
+                histogram.AddPixels(reinterpret_cast<const XMFLOAT4A*>(image.pixels + y * image.rowPitch), image.width);
+            }
+            return S_OK;
+
+        default:
+            return WINCODEC_ERR_UNSUPPORTEDPIXELFORMAT;
+        }
+    }
+
+    /// <summary>
+    /// Format produced by DirectX::Decompress with DXGI_FORMAT_UNKNOWN, i.e. what ImageLoader gets for a DDS file.
+    /// </summary>
+    DXGI_FORMAT GetDecodedDdsFormat(DXGI_FORMAT format)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC7_UNORM:
+            return DXGI_FORMAT_R8G8B8A8_UNORM;
+
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+            return DXGI_FORMAT_R32G32B32A32_FLOAT;
+
+        default:
+            // Other compressed formats decompress to formats ImageLoader can't display.
+            return IsCompressed(format) ? DXGI_FORMAT_UNKNOWN : format;
+        }
+    }
+
+    HRESULT ProbeHeif(const std::filesystem::path& path, bool computeCLL, ImageProbeResult& result)
+    {
+        result.isHeif = true;
+
+        // libheif only accepts narrow file names, so map the file and parse it in place.
+        MemoryMappedFile file;
+        if (!file.Open(path.c_str()))
+        {
+            // Mapping an empty file fails without an error code.
+            DWORD error = GetLastError();
+            return error ? HRESULT_FROM_WIN32(error) : E_FAIL;
+        }
+
+        CHeifContext ctx;
+        IFR(HEIFHR(heif_context_read_from_memory_without_copy(ctx.ptr, file.GetData(), static_cast<size_t>(file.GetSize()), nullptr)));
+
+        CHeifHandle mainHandle;
+        IFR(HEIFHR(heif_context_get_primary_image_handle(ctx.ptr, &mainHandle.ptr)));
+
+        result.width = static_cast<unsigned int>(heif_image_handle_get_width(mainHandle.ptr));
+        result.height = static_cast<unsigned int>(heif_image_handle_get_height(mainHandle.ptr));
+
+        // ImageLoader decodes HDR10 images with libheif to FP16 scRGB. Other images go through WIC,
+        // which only exposes more than 8 bpc as GUID_WICPixelFormat32bppR10G10B10A2HDR10, which
+        // ImageLoader always treats as BT.2100.
+        int lumaBits = heif_image_handle_get_luma_bits_per_pixel(mainHandle.ptr);
+        bool isHdr10 = IsHeifHdr10(mainHandle.ptr);
+
+        result.bitsPerPixel = isHdr10 ? 64 : 32;
+        result.bitsPerChannel = isHdr10 ? 16 : (lumaBits > 8 ? 10 : 8);
+        result.isFloat = isHdr10;
+        result.forceBT2100ColorSpace = !isHdr10 && lumaBits > 8;
+
+        auto profileType = heif_image_handle_get_color_profile_type(mainHandle.ptr);
+        if (profileType == heif_color_profile_type_prof || profileType == heif_color_profile_type_rICC)
+        {
+            result.countColorProfiles = 1;
+        }
+
+        int countAux = heif_image_handle_get_number_of_auxiliary_images(mainHandle.ptr, 0);
+        std::vector<heif_item_id> auxIds(countAux);
+        heif_image_handle_get_list_of_auxiliary_image_IDs(mainHandle.ptr, 0, auxIds.data(), static_cast<int>(auxIds.size()));
+
+        for (auto i : auxIds)
+        {
+            CHeifHandle auxHandle;
+            IFR(HEIFHR(heif_image_handle_get_auxiliary_image_handle(mainHandle.ptr, i, &auxHandle.ptr)));
+
+            CHeifAuxType type;
+            IFR(HEIFHR(heif_image_handle_get_auxiliary_type(auxHandle.ptr, &type.ptr)));
+
+            if (type.IsAppleHdrGainMap())
+            {
+                result.hasAppleHdrGainMap = true;
+                result.gainMapWidth = static_cast<unsigned int>(heif_image_handle_get_width(auxHandle.ptr));
+                result.gainMapHeight = static_cast<unsigned int>(heif_image_handle_get_height(auxHandle.ptr));
+                break;
+            }
+        }
+
+        UpdateImageKind(result);
+
+        // Gain map images are display referred, so their histogram isn't meaningful as nits.
+        if (!computeCLL || !(isHdr10 || result.forceBT2100ColorSpace) || result.hasAppleHdrGainMap)
+        {
+            return S_OK;
+        }
+
+        CHeifImage image;
+        IFR(HEIFHR(heif_decode_image(mainHandle.ptr, &image.ptr, heif_colorspace_RGB, heif_chroma_interleaved_RRGGBB_LE, nullptr)));
+
+        int bits = heif_image_get_bits_per_pixel_range(image.ptr, heif_channel_interleaved);
+        if (bits <= 0 || bits > 16)
+        {
+            return WINCODEC_ERR_UNSUPPORTEDPIXELFORMAT;
+        }
+
+        int stride = 0;
+        const uint8_t* data = heif_image_get_plane_readonly(image.ptr, heif_channel_interleaved, &stride);
+        if (!data)
+        {
+            return WINCODEC_ERR_GENERIC_ERROR;
+        }
+
+        // The EOTF is applied through a table indexed by code value.
+        unsigned int maxCode = (1u << bits) - 1;
+        std::vector<float> pqLut;
+        BuildLinearizeTable(TransferFunction::Pq, static_cast<unsigned int>(bits), pqLut);
+
+        LuminanceHistogram histogram(sc_bt2020Luminance);
+        std::vector<XMFLOAT4A> row(result.width);
+
+        auto toLinear = [&](uint16_t code) { return pqLut[code > maxCode ? maxCode : code]; };
+
+        for (unsigned int y = 0; y < result.height; y++)
+        {
+            auto src = reinterpret_cast<const uint16_t*>(data + static_cast<size_t>(y) * stride);
+            for (unsigned int x = 0; x < result.width; x++, src += 3)
+            {
+                row[x] = XMFLOAT4A(toLinear(src[0]), toLinear(src[1]), toLinear(src[2]), 1.0f);
+            }
+
+            histogram.AddPixels(row.data(), row.size());
+        }
+
+        SetCLL(histogram.ComputeCLL(), result);
+
+        return S_OK;
+    }
+
+    HRESULT ProbeExr(const std::filesystem::path& path, bool computeCLL, ImageProbeResult& result)
+    {
+        TexMetadata metadata = {};
+        EXRChromaticities& chromaticities = result.chromaticities;
+
+        if (!computeCLL)
+        {
+            IFR(GetMetadataFromEXRFile(path.c_str(), metadata, &chromaticities));
+        }
+        else
+        {
+            // Streams the image so memory use does not depend on image size.
+            HistogramCLL cll = {};
+            IFR(ScanExrFileCLL(path.c_str(), &metadata, &chromaticities, cll, 1));
+
+            SetCLL(cll, result);
+        }
+
+        // OpenEXR is always decoded to FP16.
+        result.width = static_cast<unsigned int>(metadata.width);
+        result.height = static_cast<unsigned int>(metadata.height);
+        result.bitsPerPixel = 64;
+        result.bitsPerChannel = 16;
+        result.isFloat = true;
+        result.hasEXRChromaticitiesInfo = chromaticities.Valid;
+        result.countColorProfiles = chromaticities.Valid ? 1 : 0;
+
+        UpdateImageKind(result);
+
+        return S_OK;
+    }
+
+    HRESULT ProbeRadianceHdr(const std::filesystem::path& path, bool computeCLL, ImageProbeResult& result)
+    {
+        // The same parser as ImageLoader::LoadImageFromDirectXTexInt, which keeps the pixels packed.
+        TexMetadata metadata = {};
+        std::vector<uint8_t> rgbe;
+
+        if (computeCLL)
+        {
+            IFR(LoadFromRGBEFile(path.c_str(), &metadata, nullptr, rgbe));
+        }
+        else
+        {
+            IFR(GetMetadataFromRGBEFile(path.c_str(), metadata));
+        }
+
+        // Same fix-up as ImageLoader::LoadImageFromDirectXTexInt: metadata describes RGBE
+        // expanded to FP32, but 16 bpc best preserves the intent of the format.
+        result.width = static_cast<unsigned int>(metadata.width);
+        result.height = static_cast<unsigned int>(metadata.height);
+        result.bitsPerPixel = 32;
+        result.bitsPerChannel = 16;
+        result.isFloat = true;
+
+        UpdateImageKind(result);
+
+        if (computeCLL)
+        {
+            // Expanded a row at a time, the same way RgbeBitmapSource does as Direct2D reads it.
+            std::vector<XMFLOAT4A> row(result.width);
+            LuminanceHistogram histogram;
+
+            for (size_t y = 0; y < result.height; y++)
+            {
+                DecodeRowRgbe(rgbe.data() + y * result.width * 4, result.width, row.data());
+                histogram.AddPixels(row.data(), row.size());
+            }
+
+            SetCLL(histogram.ComputeCLL(), result);
+        }
+
+        return S_OK;
+    }
+
+    HRESULT ProbeDds(const std::filesystem::path& path, bool computeCLL, ImageProbeResult& result)
+    {
+        TexMetadata metadata = {};
+        IFR(GetMetadataFromDDSFile(path.c_str(), DDS_FLAGS_NONE, metadata));
+
+        DXGI_FORMAT decodedFormat = GetDecodedDdsFormat(metadata.format);
+
+        // Only the formats in ImageLoader::TranslateDxgiFormatToWic can be displayed.
+        switch (decodedFormat)
+        {
+        case DXGI_FORMAT_R8G8B8A8_SINT:
+        case DXGI_FORMAT_R8G8B8A8_SNORM:
+        case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_R8G8B8A8_UINT:
+            result.bitsPerPixel = 32;
+            result.bitsPerChannel = 8;
+            break;
+
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            result.bitsPerPixel = 64;
+            result.bitsPerChannel = 16;
+            result.isFloat = true;
+            break;
+
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            result.bitsPerPixel = 128;
+            result.bitsPerChannel = 32;
+            result.isFloat = true;
+            break;
+
+        default:
+            return WINCODEC_ERR_UNSUPPORTEDPIXELFORMAT;
+        }
+
+        result.width = static_cast<unsigned int>(metadata.width);
+        result.height = static_cast<unsigned int>(metadata.height);
+
+        UpdateImageKind(result);
+
+        if (!computeCLL || !result.isFloat)
+        {
+            return S_OK;
+        }
+
+        ScratchImage scratch;
+        IFR(LoadFromDDSFile(path.c_str(), DDS_FLAGS_NONE, nullptr, scratch));
+
+        // Like ImageLoader, only the first image is used.
+        const Image* image = scratch.GetImage(0, 0, 0);
+
+        ScratchImage decompressed;
+        if (IsCompressed(image->format))
+        {
+            IFR(Decompress(*image, DXGI_FORMAT_UNKNOWN, decompressed));
+
+            // Release the compressed data before histogramming.
+            scratch.Release();
+            image = decompressed.GetImage(0, 0, 0);
+        }
+
+        LuminanceHistogram histogram;
+        IFR(AddImageToHistogram(*image, histogram));
+        SetCLL(histogram.ComputeCLL(), result);
+
+        return S_OK;
+    }
+
+    void AppendJsonString(std::string& json, const std::string& utf8)
+    {
+        json += '"';
+
+        for (char c : utf8)
+        {
+            switch (c)
+            {
+            case '"':  json += "\\\""; break;
+            case '\\': json += "\\\\"; break;
+            case '\b': json += "\\b"; break;
+            case '\f': json += "\\f"; break;
+            case '\n': json += "\\n"; break;
+            case '\r': json += "\\r"; break;
+            case '\t': json += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char escape[8];
+                    sprintf_s(escape, "\\u%04x", static_cast<unsigned int>(c));
+                    json += escape;
+                }
+                else
+                {
+                    json += c;
+                }
+                break;
+            }
+        }
+
+        json += '"';
+    }
+
+    void AppendJsonField(std::string& json, const char* name)
+    {
+        if (json.back() != '{')
+        {
+            json += ',';
+        }
+
+        json += '"';
+        json += name;
+        json += "\":";
+    }
+
+    void AppendJsonField(std::string& json, const char* name, unsigned int value)
+    {
+        AppendJsonField(json, name);
+        json += std::to_string(value);
+    }
+
+    void AppendJsonField(std::string& json, const char* name, bool value)
+    {
+        AppendJsonField(json, name);
+        json += value ? "true" : "false";
+    }
+
+    void AppendJsonField(std::string& json, const char* name, float value)
+    {
+        AppendJsonField(json, name);
+
+        char buffer[32];
+        sprintf_s(buffer, "%.9g", value);
+        json += buffer;
+    }
+
+    void AppendJsonField(std::string& json, const char* name, const char* value)
+    {
+        AppendJsonField(json, name);
+        AppendJsonString(json, value);
+    }
+
+    const char* ToString(ImageContainer container)
+    {
+        switch (container)
+        {
+        case ImageContainer::Heif:          return "heif";
+        case ImageContainer::OpenExr:       return "exr";
+        case ImageContainer::RadianceHdr:   return "hdr";
+        case ImageContainer::Dds:           return "dds";
+        default:                            return "unknown";
+        }
+    }
+
+    const char* ToString(ImageKind kind)
+    {
+        switch (kind)
+        {
+        case ImageKind::Wcg:    return "WideColorGamut";
+        case ImageKind::Hdr:    return "HighDynamicRange";
+        default:                return "StandardDynamicRange";
+        }
+    }
+}
+
+ImageContainer HeifUtil::GetImageContainer(const std::filesystem::path& path)
+{
+    auto ext = path.extension().wstring();
+    std::transform(ext.begin(), ext.end(), ext.begin(), towlower);
+
+    if (ext == L".heic" || ext == L".heif" || ext == L".avif") return ImageContainer::Heif;
+    if (ext == L".exr") return ImageContainer::OpenExr;
+    if (ext == L".hdr") return ImageContainer::RadianceHdr;
+    if (ext == L".dds") return ImageContainer::Dds;
+
+    return ImageContainer::Unknown;
+}
+
+void HeifUtil::ProbeImage(const std::filesystem::path& path, bool computeCLL, ImageProbeResult& result)
+{
+    result = {};
+    result.path = path;
+    result.container = GetImageContainer(path);
+
+    try
+    {
+        switch (result.container)
+        {
+        case ImageContainer::Heif:
+            result.hr = ProbeHeif(path, computeCLL, result);
+            break;
+
+        case ImageContainer::OpenExr:
+            result.hr = ProbeExr(path, computeCLL, result);
+            break;
+
+        case ImageContainer::RadianceHdr:
+            result.hr = ProbeRadianceHdr(path, computeCLL, result);
+            break;
+
+        case ImageContainer::Dds:
+            result.hr = ProbeDds(path, computeCLL, result);
+            break;
+
+        default:
+            result.hr = WINCODEC_ERR_COMPONENTNOTFOUND;
+            break;
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        result.hr = E_OUTOFMEMORY;
+    }
+    catch (...)
+    {
+        result.hr = E_UNEXPECTED;
+    }
+}
+
+std::string HeifUtil::ToJsonLine(const ImageProbeResult& result)
+{
+    std::string json = "{";
+
+    AppendJsonField(json, "path");
+    AppendJsonString(json, result.path.u8string());
+
+    AppendJsonField(json, "container", ToString(result.container));
+    AppendJsonField(json, "isValid", SUCCEEDED(result.hr));
+
+    if (FAILED(result.hr))
+    {
+        char hr[16];
+        sprintf_s(hr, "0x%08X", static_cast<unsigned int>(result.hr));
+        AppendJsonField(json, "hr", hr);
+        json += '}';
+        return json;
+    }
+
+    AppendJsonField(json, "width", result.width);
+    AppendJsonField(json, "height", result.height);
+    AppendJsonField(json, "bitsPerPixel", result.bitsPerPixel);
+    AppendJsonField(json, "bitsPerChannel", result.bitsPerChannel);
+    AppendJsonField(json, "isFloat", result.isFloat);
+    AppendJsonField(json, "imageKind", ToString(result.imageKind));
+    AppendJsonField(json, "countColorProfiles", result.countColorProfiles);
+    AppendJsonField(json, "isHeif", result.isHeif);
+    AppendJsonField(json, "forceBT2100ColorSpace", result.forceBT2100ColorSpace);
+    AppendJsonField(json, "hasAppleHdrGainMap", result.hasAppleHdrGainMap);
+
+    if (result.hasAppleHdrGainMap)
+    {
+        AppendJsonField(json, "gainMapWidth", result.gainMapWidth);
+        AppendJsonField(json, "gainMapHeight", result.gainMapHeight);
+    }
+
+    AppendJsonField(json, "hasEXRChromaticitiesInfo", result.hasEXRChromaticitiesInfo);
+
+    if (result.hasEXRChromaticitiesInfo)
+    {
+        auto& c = result.chromaticities;
+
+        // Primaries are xy; the white point is XYZ (Y is 1), as in EXRChromaticities.
+        AppendJsonField(json, "chromaticities");
+        json += '{';
+        AppendJsonField(json, "redX", c.RedX);
+        AppendJsonField(json, "redY", c.RedY);
+        AppendJsonField(json, "greenX", c.GreenX);
+        AppendJsonField(json, "greenY", c.GreenY);
+        AppendJsonField(json, "blueX", c.BlueX);
+        AppendJsonField(json, "blueY", c.BlueY);
+        AppendJsonField(json, "whiteX", c.WhiteX);
+        AppendJsonField(json, "whiteY", c.WhiteY);
+        AppendJsonField(json, "whiteZ", c.WhiteZ);
+        json += '}';
+    }
+
+    AppendJsonField(json, "maxNits", result.maxNits);
+    AppendJsonField(json, "medianNits", result.medianNits);
+    AppendJsonField(json, "isSceneReferred", result.isSceneReferred);
+
+    json += '}';
+    return json;
+}
@@ -0,0 +1,82 @@
+//*********************************************************
+//
+// ImageProbe
+//
+// Reads the properties HDRImageViewer reports in ImageInfo and
+// ImageCLL from a single image file, without any Direct2D or
+// WIC rendering. Supports the containers the app decodes with
+// libheif and DirectXTex: HEIF, OpenEXR, Radiance RGBE and DDS.
+//
+// Memory use per probe is bounded by one decoded image for
+// HEIF, Radiance and DDS files; OpenEXR files are streamed.
+//
+//*********************************************************
+
+#pragma once
+#include "pch.h"
+#include "..\DXRenderer\DirectXTex\DirectXTexEXR.h"
+
+namespace HeifUtil
+{
+    enum class ImageContainer
+    {
+        Unknown,
+        Heif,
+        OpenExr,
+        RadianceHdr,
+        Dds
+    };
+
+    enum class ImageKind
+    {
+        Sdr,
+        Wcg,
+        Hdr
+    };
+
+    /// <summary>
+    /// Equivalent of DXRenderer::ImageInfo plus ImageCLL, for code which does not depend on the Windows Runtime.
+    /// </summary>
+    struct ImageProbeResult
+    {
+        std::filesystem::path   path;
+        ImageContainer          container = ImageContainer::Unknown;
+        HRESULT                 hr = E_FAIL;
+
+        unsigned int            width = 0;
+        unsigned int            height = 0;
+        unsigned int            bitsPerPixel = 0;
+        unsigned int            bitsPerChannel = 0;
+        bool                    isFloat = false;
+        ImageKind               imageKind = ImageKind::Sdr;
+        unsigned int            countColorProfiles = 0;
+        bool                    isHeif = false;
+        bool                    forceBT2100ColorSpace = false;
+        bool                    hasAppleHdrGainMap = false;
+        unsigned int            gainMapWidth = 0;
+        unsigned int            gainMapHeight = 0;
+        bool                    hasEXRChromaticitiesInfo = false;
+        DirectX::EXRChromaticities chromaticities = {};
+
+        // -1 if unknown or not computed. Only HDR images which are scene referred get CLL values.
+        float                   maxNits = -1.0f;
+        float                   medianNits = -1.0f;
+        bool                    isSceneReferred = false;
+    };
+
+    /// <summary>
+    /// Returns the container handled by ProbeImage for a file extension, or Unknown.
+    /// </summary>
+    ImageContainer GetImageContainer(const std::filesystem::path& path);
+
+    /// <summary>
+    /// Fills result for one file. Errors are reported in result.hr rather than thrown.
+    /// </summary>
+    /// <param name="computeCLL">If false only headers are read, which is much faster.</param>
+    void ProbeImage(const std::filesystem::path& path, bool computeCLL, _Out_ ImageProbeResult& result);
+
+    /// <summary>
+    /// Formats result as a single line JSON object, without the trailing newline.
+    /// </summary>
+    std::string ToJsonLine(const ImageProbeResult& result);
+}
@@ -36,8 +36,40 @@ namespace DXRenderer
     /// </summary>
     class CHeifAuxType {
     public:
-        ~CHeifAuxType() { if (ptr) free(&ptr); }
+        ~CHeifAuxType() { if (ptr) free((void*)ptr); }
         bool IsAppleHdrGainMap() { return strcmp(ptr, "urn:com:apple:photo:2020:aux:hdrgainmap") == 0; }
         const char* ptr = nullptr;
     };
+    /// <summary>
+    /// RAII wrapper for heif_color_profile_nclx
+    /// </summary>
+    class CHeifNclx {
+    public:
+        ~CHeifNclx() { if (ptr) heif_nclx_color_profile_free(ptr); }
+        heif_color_profile_nclx* ptr = nullptr;
+    };
+
+    /// <summary>
+    /// Whether a primary image with more than 8 bits per channel is HDR10: BT.2100 PQ with BT.2020
+    /// primaries and matrix. Images without an nclx profile are assumed to be, as WIC does.
+    /// </summary>
+    /// <param name="fullRange">Receives the nclx range flag; false (video range) if there is no profile.</param>
+    inline bool IsHeifHdr10(heif_image_handle* handle, _Out_opt_ bool* fullRange = nullptr)
+    {
+        if (fullRange) *fullRange = false;
+
+        if (heif_image_handle_get_luma_bits_per_pixel(handle) <= 8) return false;
+
+        CHeifNclx nclx;
+        if (heif_image_handle_get_nclx_color_profile(handle, &nclx.ptr).code != heif_error_Ok) return true;
+
+        if (fullRange) *fullRange = nclx.ptr->full_range_flag != 0;
+
+        return nclx.ptr->transfer_characteristics == heif_transfer_characteristic_ITU_R_BT_2100_0_PQ &&
+            (nclx.ptr->color_primaries == heif_color_primaries_ITU_R_BT_2020_2_and_2100_0 ||
+             nclx.ptr->color_primaries == heif_color_primaries_unspecified) &&
+            (nclx.ptr->matrix_coefficients == heif_matrix_coefficients_ITU_R_BT_2020_2_non_constant_luminance ||
+             nclx.ptr->matrix_coefficients == heif_matrix_coefficients_unspecified);
+    }
+
 }
\ No newline at end of file
@@ -8,7 +8,17 @@
 #define PCH_H
 
 // add headers that you want to pre-compile here
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cwctype>
+#include <deque>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 #include <locale>
@@ -17,6 +27,10 @@
 #include <wincodec.h>
 #include <atlbase.h>
 
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include <DirectXTex.h>
+
 #include <libheif/heif.h>
 
 #endif //PCH_H
@@ -0,0 +1,112 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "..\DXRenderer\CpuRender\ColorLut3D.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace DirectX;
+using namespace DXRenderer;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTests
+{
+    XMVECTOR XM_CALLCONV AffineColor(FXMVECTOR color)
+    {
+        // Crosstalk between all three channels, and an offset.
+        XMMATRIX m = XMMATRIX(
+            0.8f, 0.1f, 0.2f, 0.0f,
+            0.3f, 0.7f, -0.1f, 0.0f,
+            -0.1f, 0.2f, 0.9f, 0.0f,
+            0.05f, 0.0f, -0.02f, 1.0f);
+
+        return XMVector3Transform(color, m);
+    }
+
+    std::shared_ptr<const ColorLut3D> IdentityLut(unsigned int size)
+    {
+        return std::make_shared<const ColorLut3D>(ColorLutDomain::Unit, size, [](FXMVECTOR color) { return color; });
+    }
+
+    TEST_CLASS(ColorLut3DTests)
+    {
+    public:
+        TEST_METHOD(TetrahedralIsExactForAffineFunctions)
+        {
+            ColorLut3D lut(ColorLutDomain::Unit, 5, AffineColor);
+
+            // Covers all 6 tetrahedra, cell boundaries and the top face.
+            const float values[] = { 0.0f, 0.1f, 0.25f, 0.4f, 0.77f, 0.9f, 1.0f };
+
+            for (float r : values)
+            {
+                for (float g : values)
+                {
+                    for (float b : values)
+                    {
+                        XMVECTOR color = XMVectorSet(r, g, b, 0.5f);
+
+                        XMFLOAT4 expected, actual;
+                        XMStoreFloat4(&expected, AffineColor(color));
+                        XMStoreFloat4(&actual, lut.Map(color));
+
+                        Assert::AreEqual(expected.x, actual.x, 1e-5f);
+                        Assert::AreEqual(expected.y, actual.y, 1e-5f);
+                        Assert::AreEqual(expected.z, actual.z, 1e-5f);
+                        Assert::AreEqual(0.5f, actual.w);
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD(PqDomain)
+        {
+            ColorLut3D lut(ColorLutDomain::Pq, sc_ColorLutDefaultSize, [](FXMVECTOR color) { return color; });
+
+            Assert::IsTrue(lut.IsInDomain(XMVectorSet(0.0f, 1.0f, 125.0f, 1.0f)));
+            Assert::IsFalse(lut.IsInDomain(XMVectorSet(-0.01f, 1.0f, 1.0f, 1.0f)));
+            Assert::IsFalse(lut.IsInDomain(XMVectorSet(1.0f, 126.0f, 1.0f, 1.0f)));
+            Assert::IsFalse(lut.IsInDomain(XMVectorSet(1.0f, 1.0f, std::numeric_limits<float>::quiet_NaN(), 1.0f)));
+
+            // Neutrals only interpolate along the diagonal. Linear values interpolated between 33
+            // points in PQ stay within 4% from 1 to 10000 nits.
+            for (float value = 1.0f / 80.0f; value <= 125.0f; value *= 1.5f)
+            {
+                XMVECTOR mapped = lut.Map(XMVectorReplicate(value));
+
+                Assert::AreEqual(value, XMVectorGetX(mapped), value * 0.04f);
+                Assert::AreEqual(XMVectorGetX(mapped), XMVectorGetY(mapped));
+                Assert::AreEqual(XMVectorGetX(mapped), XMVectorGetZ(mapped));
+            }
+        }
+
+        TEST_METHOD(CacheReusesAndEvicts)
+        {
+            ColorLut3DCache cache(2);
+            unsigned int bakes = 0;
+
+            auto get = [&](float keyValue)
+            {
+                return cache.GetOrBake({ keyValue }, [&]()
+                {
+                    bakes++;
+                    return IdentityLut(2);
+                });
+            };
+
+            auto a = get(1.0f);
+            Assert::IsTrue(a == get(1.0f));
+            Assert::AreEqual(1u, bakes);
+
+            get(2.0f);
+            get(3.0f); // Evicts 1.
+            Assert::AreEqual(3u, bakes);
+
+            Assert::IsTrue(a != get(1.0f));
+            Assert::AreEqual(4u, bakes);
+            Assert::AreEqual(size_t(1), cache.GetHitCount());
+            Assert::AreEqual(size_t(4), cache.GetMissCount());
+        }
+    };
+}
@@ -0,0 +1,141 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "..\DXRenderer\CpuRender\CpuRenderPipeline.h"
+
+#include <cmath>
+
+using namespace DirectX;
+using namespace DXRenderer;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTests
+{
+    // One scRGB unit is 80 nits.
+    const float sc_oneNit = 1.0f / 80.0f;
+
+    CpuRenderOptions HdrDisplayOptions(CpuRenderEffectKind effect, unsigned int lutSize)
+    {
+        CpuRenderOptions options = {};
+        options.effect = effect;
+        options.exposureAdjustment = 1.0f;
+        options.hasDisplayInfo = true;
+        options.display = { CpuAdvancedColorKind::HighDynamicRange, 600.0f, 80.0f,
+            { 0.680f, 0.320f, 0.265f, 0.690f, 0.150f, 0.060f, 0.3127f, 0.3290f } };
+        options.constrainGamut = true;
+        options.tonemapOperator = TonemapOperator::Reinhard;
+        options.lutSize = lutSize;
+
+        return options;
+    }
+
+    // Ramps through shadows, HDR highlights up to 1000 nits and colors outside the panel gamut,
+    // including negative scRGB values which are outside the LUT's domain.
+    CpuImage TestImage(CpuSourceTransfer transfer)
+    {
+        CpuImage image(64, 64);
+        float scale = transfer == CpuSourceTransfer::Linear ? 12.5f : 1.0f;
+
+        for (unsigned int y = 0; y < image.GetHeight(); y++)
+        {
+            for (unsigned int x = 0; x < image.GetWidth(); x++)
+            {
+                float brightness = scale * std::pow(y / 63.0f, 2.0f);
+                float saturation = (x % 16) / 15.0f;
+                float hue = (x / 16) / 4.0f;
+
+                image.GetRow(y)[x] = XMFLOAT4A(
+                    brightness * (1.0f - saturation * hue),
+                    brightness * (1.0f - saturation * (1.0f - hue)),
+                    brightness * (1.0f - saturation * 0.5f) - (transfer == CpuSourceTransfer::Linear ? saturation * 0.1f : 0.0f),
+                    0.5f + x / 128.0f);
+            }
+        }
+
+        return image;
+    }
+
+    // Largest difference between two renders, relative to the exact value plus 1 nit.
+    float RenderLutError(const CpuSourceInfo& source, CpuRenderOptions options, unsigned int lutSize)
+    {
+        CpuImage exact = TestImage(source.transfer);
+        CpuImage baked = exact;
+
+        options.lutSize = 0;
+        CpuRenderPipeline exactPipeline(source, options);
+        Assert::IsFalse(exactPipeline.IsLutBaked());
+        exactPipeline.Render(exact);
+
+        options.lutSize = lutSize;
+        CpuRenderPipeline lutPipeline(source, options);
+        Assert::IsTrue(lutPipeline.IsLutBaked());
+        lutPipeline.Render(baked);
+
+        float maxError = 0.0f;
+        for (size_t i = 0; i < exact.GetPixelCount(); i++)
+        {
+            XMFLOAT4A a = exact.GetPixels()[i];
+            XMFLOAT4A b = baked.GetPixels()[i];
+
+            maxError = (std::max)(maxError, std::abs(a.x - b.x) / (std::abs(a.x) + sc_oneNit));
+            maxError = (std::max)(maxError, std::abs(a.y - b.y) / (std::abs(a.y) + sc_oneNit));
+            maxError = (std::max)(maxError, std::abs(a.z - b.z) / (std::abs(a.z) + sc_oneNit));
+            Assert::AreEqual(a.w, b.w);
+        }
+
+        return maxError;
+    }
+
+    TEST_CLASS(CpuRenderPipelineTests)
+    {
+    public:
+        TEST_METHOD(HdrTonemapLutMatchesExactPath)
+        {
+            CpuSourceInfo source = {};
+            source.imageKind = CpuAdvancedColorKind::HighDynamicRange;
+            source.maxCLL = 1000.0f;
+            source.transfer = CpuSourceTransfer::Linear;
+
+            auto options = HdrDisplayOptions(CpuRenderEffectKind::HdrTonemap, 0);
+
+            float error33 = RenderLutError(source, options, sc_ColorLutDefaultSize);
+            float error65 = RenderLutError(source, options, 65);
+
+            Assert::IsTrue(error33 <= 0.03f, L"33 point LUT");
+            Assert::IsTrue(error65 <= error33 * 0.5f, L"65 point LUT");
+        }
+
+        TEST_METHOD(SrgbSourceLutMatchesExactPath)
+        {
+            // sRGB values are baked over the unit domain, including the sRGB to linear conversion.
+            CpuSourceInfo source = {};
+            source.imageKind = CpuAdvancedColorKind::StandardDynamicRange;
+            source.maxCLL = -1.0f;
+            source.transfer = CpuSourceTransfer::Srgb;
+
+            auto options = HdrDisplayOptions(CpuRenderEffectKind::None, 0);
+
+            Assert::IsTrue(RenderLutError(source, options, sc_ColorLutDefaultSize) <= 0.03f);
+        }
+
+        TEST_METHOD(PipelinesShareCachedLut)
+        {
+            CpuSourceInfo source = {};
+            source.imageKind = CpuAdvancedColorKind::HighDynamicRange;
+            source.maxCLL = 1000.0f;
+            source.transfer = CpuSourceTransfer::Linear;
+
+            ColorLut3DCache cache(4);
+            auto options = HdrDisplayOptions(CpuRenderEffectKind::HdrTonemap, sc_ColorLutDefaultSize);
+
+            CpuRenderPipeline first(source, options, &cache);
+            CpuRenderPipeline second(source, options, &cache);
+            Assert::AreEqual(size_t(1), cache.GetHitCount());
+
+            // A different exposure is a different function.
+            options.exposureAdjustment = 2.0f;
+            CpuRenderPipeline brighter(source, options, &cache);
+            Assert::AreEqual(size_t(2), cache.GetMissCount());
+        }
+    };
+}
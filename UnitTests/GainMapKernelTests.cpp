@@ -0,0 +1,118 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "..\DXRenderer\CpuRender\GainMapKernel.h"
+
+#include <cmath>
+
+using namespace DXRenderer;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTests
+{
+    // Linear gain of an encoded gain map value, as the Direct2D GainMapMerge computes it.
+    float ExpectedGain(float value, float gainMapScale)
+    {
+        return powf(value, 1.0f / 2.2f) * 2.0f * gainMapScale;
+    }
+
+    TEST_CLASS(GainMapKernelTests)
+    {
+    public:
+        TEST_METHOD(FlatGainMap)
+        {
+            CpuImage gainMap(3, 2);
+            for (size_t i = 0; i < gainMap.GetPixelCount(); i++)
+            {
+                gainMap.GetPixels()[i] = { 0.5f, 0.0f, 0.0f, 1.0f };
+            }
+
+            GainMapKernel kernel(gainMap, 7, 5, 1.5f);
+            float expected = ExpectedGain(0.5f, 1.5f);
+
+            for (unsigned int y = 0; y < 5; y++)
+            {
+                auto row = kernel.GetRow(y);
+                for (unsigned int x = 0; x < 7; x++)
+                {
+                    Assert::AreEqual(expected, kernel.Sample(row, x), 1e-6f);
+                }
+            }
+        }
+
+        TEST_METHOD(BilinearUpsampling)
+        {
+            // 2x2 gain map for a 4x4 image: pixel centers are aligned and edges are clamped.
+            CpuImage gainMap(2, 2);
+            gainMap.GetRow(0)[0] = { 0.25f, 0.0f, 0.0f, 1.0f };
+            gainMap.GetRow(0)[1] = { 1.0f, 0.0f, 0.0f, 1.0f };
+            gainMap.GetRow(1)[0] = { 0.25f, 0.0f, 0.0f, 1.0f };
+            gainMap.GetRow(1)[1] = { 1.0f, 0.0f, 0.0f, 1.0f };
+
+            GainMapKernel kernel(gainMap, 4, 4, 1.0f);
+            float left = ExpectedGain(0.25f, 1.0f);
+            float right = ExpectedGain(1.0f, 1.0f);
+
+            // Gains are interpolated after linearization.
+            const float weights[] = { 0.0f, 0.25f, 0.75f, 1.0f };
+
+            for (unsigned int y = 0; y < 4; y++)
+            {
+                auto row = kernel.GetRow(y);
+                for (unsigned int x = 0; x < 4; x++)
+                {
+                    Assert::AreEqual(left + (right - left) * weights[x], kernel.Sample(row, x), 1e-6f);
+                }
+            }
+        }
+
+        TEST_METHOD(ApplyScalesColorButNotAlpha)
+        {
+            // Same gain map as BilinearUpsampling, applied to a mid gray image.
+            CpuImage gainMap(2, 2);
+            gainMap.GetRow(0)[0] = { 0.25f, 0.0f, 0.0f, 1.0f };
+            gainMap.GetRow(0)[1] = { 1.0f, 0.0f, 0.0f, 1.0f };
+            gainMap.GetRow(1)[0] = { 0.25f, 0.0f, 0.0f, 1.0f };
+            gainMap.GetRow(1)[1] = { 1.0f, 0.0f, 0.0f, 1.0f };
+
+            GainMapKernel kernel(gainMap, 4, 40, 1.0f);
+
+            CpuImage image(4, 40);
+            for (size_t i = 0; i < image.GetPixelCount(); i++)
+            {
+                image.GetPixels()[i] = { 0.5f, 0.25f, -0.125f, 0.75f };
+            }
+
+            kernel.Apply(image);
+
+            for (unsigned int y = 0; y < 40; y++)
+            {
+                auto row = kernel.GetRow(y);
+                for (unsigned int x = 0; x < 4; x++)
+                {
+                    float gain = kernel.Sample(row, x);
+                    auto& pixel = image.GetRow(y)[x];
+
+                    Assert::AreEqual(0.5f * gain, pixel.x, 1e-6f);
+                    Assert::AreEqual(0.25f * gain, pixel.y, 1e-6f);
+                    Assert::AreEqual(-0.125f * gain, pixel.z, 1e-6f);
+                    Assert::AreEqual(0.75f, pixel.w);
+                }
+            }
+
+            // Images of another size are left alone.
+            CpuImage other(3, 40);
+            other.GetPixels()[0] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            kernel.Apply(other);
+            Assert::AreEqual(1.0f, other.GetPixels()[0].x);
+        }
+
+        TEST_METHOD(EmptyGainMapLeavesImageUnchanged)
+        {
+            GainMapKernel kernel(CpuImage(), 4, 3, 2.0f);
+
+            auto row = kernel.GetRow(2);
+            Assert::AreEqual(1.0f, kernel.Sample(row, 3));
+        }
+    };
+}
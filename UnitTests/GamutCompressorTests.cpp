@@ -0,0 +1,134 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "..\DXRenderer\CpuRender\GamutCompressor.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+using namespace DXRenderer;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTests
+{
+    // scRGB to Display P3 (D65) panel RGB, DirectXMath row vector convention.
+    XMMATRIX XM_CALLCONV ScRgbToDisplayP3()
+    {
+        return XMMATRIX(
+            0.8224621f, 0.0331941f, 0.0170827f, 0.0f,
+            0.1775380f, 0.9668058f, 0.0723974f, 0.0f,
+            0.0f,       0.0f,       0.9105199f, 0.0f,
+            0.0f,       0.0f,       0.0f,       1.0f);
+    }
+
+    TEST_CLASS(GamutCompressorTests)
+    {
+    public:
+        TEST_METHOD(ColorsInsideThresholdAreUnchanged)
+        {
+            GamutCompressor compressor(ScRgbToDisplayP3());
+            XMMATRIX panelToScRgb = XMMatrixInverse(nullptr, ScRgbToDisplayP3());
+
+            // Panel RGB: neutrals, HDR highlights and saturated colors below the threshold.
+            const XMFLOAT4 panelColors[] =
+            {
+                { 0.0f, 0.0f, 0.0f, 1.0f },
+                { 0.18f, 0.18f, 0.18f, 1.0f },
+                { 12.5f, 12.5f, 12.5f, 1.0f },
+                { 1.0f, 0.5f, 0.5f, 1.0f },
+                { 0.3f, 0.9f, 0.25f, 1.0f },
+                { 4.0f, 3.0f, 6.0f, 1.0f },
+            };
+
+            for (auto& panel : panelColors)
+            {
+                XMVECTOR color = XMVector3Transform(XMLoadFloat4(&panel), panelToScRgb);
+
+                XMFLOAT4 expected, actual;
+                XMStoreFloat4(&expected, color);
+                XMStoreFloat4(&actual, compressor(color));
+
+                Assert::AreEqual(expected.x, actual.x, 1e-4f * (1.0f + std::abs(expected.x)));
+                Assert::AreEqual(expected.y, actual.y, 1e-4f * (1.0f + std::abs(expected.y)));
+                Assert::AreEqual(expected.z, actual.z, 1e-4f * (1.0f + std::abs(expected.z)));
+            }
+        }
+
+        TEST_METHOD(Bt2020ColorsAreInsidePanelGamut)
+        {
+            GamutCompressor compressor(ScRgbToDisplayP3());
+
+            // BT.2020 primaries and secondaries in scRGB, at SDR white and at 10x brightness.
+            const XMFLOAT4 colors[] =
+            {
+                { 1.660491f, -0.124550f, -0.018151f, 1.0f },
+                { -0.587641f, 1.132900f, -0.100579f, 1.0f },
+                { -0.072850f, -0.008349f, 1.118730f, 1.0f },
+                { 1.072850f, 1.008349f, -0.118730f, 1.0f },
+                { 1.587641f, -0.132900f, 1.100579f, 1.0f },
+                { -0.660491f, 1.124550f, 1.018151f, 1.0f },
+            };
+
+            for (float scale : { 1.0f, 10.0f })
+            {
+                for (auto& c : colors)
+                {
+                    XMVECTOR color = XMVectorScale(XMLoadFloat4(&c), scale);
+
+                    XMFLOAT4 before, after;
+                    XMStoreFloat4(&before, XMVector3Transform(color, ScRgbToDisplayP3()));
+                    XMStoreFloat4(&after, XMVector3Transform(compressor(color), ScRgbToDisplayP3()));
+
+                    // No negative panel values, and the largest channel (brightness) is kept.
+                    float tolerance = 1e-4f * scale;
+                    Assert::IsTrue(after.x >= -tolerance && after.y >= -tolerance && after.z >= -tolerance);
+
+                    float maxBefore = (std::max)((std::max)(before.x, before.y), before.z);
+                    float maxAfter = (std::max)((std::max)(after.x, after.y), after.z);
+                    Assert::AreEqual(maxBefore, maxAfter, tolerance);
+                }
+            }
+        }
+
+        TEST_METHOD(CompressionIsMonotonic)
+        {
+            GamutCompressor compressor(ScRgbToDisplayP3());
+
+            // Walk from P3 green toward BT.2020 green and beyond; the panel red channel (distance
+            // from neutral) must not reverse.
+            XMVECTOR green = XMVectorSet(-0.587641f, 1.132900f, -0.100579f, 1.0f);
+            XMVECTOR neutral = XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f);
+
+            float previous = 1.0f;
+            for (int i = 0; i <= 40; i++)
+            {
+                XMVECTOR color = XMVectorLerp(neutral, green, i / 32.0f);
+
+                XMFLOAT4 panel;
+                XMStoreFloat4(&panel, XMVector3Transform(compressor(color), ScRgbToDisplayP3()));
+
+                float red = panel.x / panel.y;
+                Assert::IsTrue(red <= previous + 1e-5f);
+                Assert::IsTrue(red >= -1e-5f);
+                previous = red;
+            }
+        }
+
+        TEST_METHOD(AlphaAndBlack)
+        {
+            GamutCompressor compressor(ScRgbToDisplayP3());
+
+            XMFLOAT4 result;
+            XMStoreFloat4(&result, compressor(XMVectorSet(1.5f, -0.2f, 0.1f, 0.25f)));
+            Assert::AreEqual(0.25f, result.w);
+
+            // A color with no positive panel channel is black.
+            XMStoreFloat4(&result, compressor(XMVectorSet(-0.5f, -0.1f, -0.2f, 0.75f)));
+            Assert::AreEqual(0.0f, result.x, 1e-6f);
+            Assert::AreEqual(0.0f, result.y, 1e-6f);
+            Assert::AreEqual(0.0f, result.z, 1e-6f);
+            Assert::AreEqual(0.75f, result.w);
+        }
+    };
+}
@@ -0,0 +1,275 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "..\DXRenderer\CpuRender\HeifGridParser.h"
+
+#include <cstring>
+
+using namespace DXRenderer;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTests
+{
+    const uint32_t sc_gridItemId = 1;
+    const uint32_t sc_firstTileId = 2;
+    const uint32_t sc_tileCount = 4;
+
+    struct GridFileOptions
+    {
+        bool                                                    descriptorInIdat;   // Construction method 1.
+        bool                                                    largeFields;        // 32 bit output size.
+        bool                                                    rotated;            // irot on the grid item.
+    };
+
+    void Append16(std::vector<uint8_t>& data, uint32_t value)
+    {
+        data.push_back(static_cast<uint8_t>(value >> 8));
+        data.push_back(static_cast<uint8_t>(value));
+    }
+
+    void Append32(std::vector<uint8_t>& data, uint32_t value)
+    {
+        Append16(data, value >> 16);
+        Append16(data, value & 0xFFFF);
+    }
+
+    void AppendType(std::vector<uint8_t>& data, const char* type)
+    {
+        data.insert(data.end(), type, type + 4);
+    }
+
+    /// <summary>
+    /// Starts a box, or a full box if version is not negative. Returns where it starts, for EndBox.
+    /// </summary>
+    size_t BeginBox(std::vector<uint8_t>& data, const char* type, int version = -1, uint32_t flags = 0)
+    {
+        size_t start = data.size();
+        Append32(data, 0);
+        AppendType(data, type);
+
+        if (version >= 0)
+        {
+            Append32(data, (static_cast<uint32_t>(version) << 24) | flags);
+        }
+
+        return start;
+    }
+
+    void EndBox(std::vector<uint8_t>& data, size_t start)
+    {
+        uint32_t size = static_cast<uint32_t>(data.size() - start);
+        data[start + 0] = static_cast<uint8_t>(size >> 24);
+        data[start + 1] = static_cast<uint8_t>(size >> 16);
+        data[start + 2] = static_cast<uint8_t>(size >> 8);
+        data[start + 3] = static_cast<uint8_t>(size);
+    }
+
+    /// <summary>
+    /// 1000x900 grid of 2x2 hidden 512x512 tiles, laid out like an iPhone HEIC: ftyp, mdat, then meta.
+    /// </summary>
+    std::vector<uint8_t> MakeGridFile(const GridFileOptions& options)
+    {
+        std::vector<uint8_t> descriptor = { 0, static_cast<uint8_t>(options.largeFields ? 1 : 0), 1, 1 };
+        if (options.largeFields)
+        {
+            Append32(descriptor, 1000);
+            Append32(descriptor, 900);
+        }
+        else
+        {
+            Append16(descriptor, 1000);
+            Append16(descriptor, 900);
+        }
+
+        std::vector<uint8_t> file;
+
+        size_t box = BeginBox(file, "ftyp");
+        AppendType(file, "heic");
+        Append32(file, 0);
+        AppendType(file, "mif1");
+        AppendType(file, "heic");
+        EndBox(file, box);
+
+        // Coded tiles are a few dummy bytes each; the descriptor follows unless it is in idat.
+        box = BeginBox(file, "mdat");
+        uint32_t tileData = static_cast<uint32_t>(file.size());
+        file.insert(file.end(), sc_tileCount * 4, 0xAB);
+        uint32_t descriptorData = static_cast<uint32_t>(file.size());
+        if (!options.descriptorInIdat) file.insert(file.end(), descriptor.begin(), descriptor.end());
+        EndBox(file, box);
+
+        size_t meta = BeginBox(file, "meta", 0);
+
+        box = BeginBox(file, "hdlr", 0);
+        Append32(file, 0);
+        AppendType(file, "pict");
+        file.insert(file.end(), 13, 0);
+        EndBox(file, box);
+
+        box = BeginBox(file, "pitm", 0);
+        Append16(file, sc_gridItemId);
+        EndBox(file, box);
+
+        size_t iinf = BeginBox(file, "iinf", 0);
+        Append16(file, 1 + sc_tileCount);
+        for (uint32_t id = sc_gridItemId; id < sc_firstTileId + sc_tileCount; id++)
+        {
+            bool isGrid = id == sc_gridItemId;
+            box = BeginBox(file, "infe", 2, isGrid ? 0 : 1);
+            Append16(file, id);
+            Append16(file, 0);
+            AppendType(file, isGrid ? "grid" : "hvc1");
+            file.push_back(0);
+            EndBox(file, box);
+        }
+        EndBox(file, iinf);
+
+        // Version 1 for the construction method; 4 byte offsets and lengths, no base offset.
+        box = BeginBox(file, "iloc", 1);
+        file.push_back(0x44);
+        file.push_back(0x00);
+        Append16(file, 1 + sc_tileCount);
+        Append16(file, sc_gridItemId);
+        Append16(file, options.descriptorInIdat ? 1 : 0);
+        Append16(file, 0);
+        Append16(file, 1);
+        Append32(file, options.descriptorInIdat ? 0 : descriptorData);
+        Append32(file, static_cast<uint32_t>(descriptor.size()));
+        for (uint32_t i = 0; i < sc_tileCount; i++)
+        {
+            Append16(file, sc_firstTileId + i);
+            Append16(file, 0);
+            Append16(file, 0);
+            Append16(file, 1);
+            Append32(file, tileData + i * 4);
+            Append32(file, 4);
+        }
+        EndBox(file, box);
+
+        if (options.descriptorInIdat)
+        {
+            box = BeginBox(file, "idat");
+            file.insert(file.end(), descriptor.begin(), descriptor.end());
+            EndBox(file, box);
+        }
+
+        // Tiles are referenced out of order to check that the order of dimg is kept.
+        size_t iref = BeginBox(file, "iref", 0);
+        box = BeginBox(file, "dimg");
+        Append16(file, sc_gridItemId);
+        Append16(file, sc_tileCount);
+        Append16(file, sc_firstTileId + 1);
+        Append16(file, sc_firstTileId);
+        Append16(file, sc_firstTileId + 3);
+        Append16(file, sc_firstTileId + 2);
+        EndBox(file, box);
+        EndBox(file, iref);
+
+        // Properties: 1 tile ispe, 2 grid ispe, 3 irot.
+        size_t iprp = BeginBox(file, "iprp");
+        size_t ipco = BeginBox(file, "ipco");
+        box = BeginBox(file, "ispe", 0);
+        Append32(file, 512);
+        Append32(file, 512);
+        EndBox(file, box);
+        box = BeginBox(file, "ispe", 0);
+        Append32(file, 1000);
+        Append32(file, 900);
+        EndBox(file, box);
+        box = BeginBox(file, "irot");
+        file.push_back(1);
+        EndBox(file, box);
+        EndBox(file, ipco);
+
+        box = BeginBox(file, "ipma", 0);
+        Append32(file, 1 + sc_tileCount);
+        Append16(file, sc_gridItemId);
+        file.push_back(options.rotated ? 2 : 1);
+        file.push_back(0x80 | 2);
+        if (options.rotated) file.push_back(0x80 | 3);
+        for (uint32_t i = 0; i < sc_tileCount; i++)
+        {
+            Append16(file, sc_firstTileId + i);
+            file.push_back(1);
+            file.push_back(0x80 | 1);
+        }
+        EndBox(file, box);
+        EndBox(file, iprp);
+
+        EndBox(file, meta);
+
+        return file;
+    }
+
+    TEST_CLASS(HeifGridParserTests)
+    {
+    public:
+        TEST_METHOD(AppleStyleGrid)
+        {
+            auto file = MakeGridFile({ false, false, false });
+
+            HeifGrid grid;
+            Assert::IsTrue(ParseHeifGrid(file.data(), file.size(), sc_gridItemId, grid));
+
+            Assert::AreEqual(2u, grid.rows);
+            Assert::AreEqual(2u, grid.columns);
+            Assert::AreEqual(1000u, grid.outputWidth);
+            Assert::AreEqual(900u, grid.outputHeight);
+            Assert::AreEqual(512u, grid.tileWidth);
+            Assert::AreEqual(512u, grid.tileHeight);
+
+            Assert::AreEqual(size_t(4), grid.tileIds.size());
+            Assert::AreEqual(sc_firstTileId + 1, grid.tileIds[0]);
+            Assert::AreEqual(sc_firstTileId, grid.tileIds[1]);
+            Assert::AreEqual(sc_firstTileId + 3, grid.tileIds[2]);
+            Assert::AreEqual(sc_firstTileId + 2, grid.tileIds[3]);
+
+            // Each offset is the hidden bit of a tile's infe box.
+            Assert::AreEqual(size_t(4), grid.hiddenFlagOffsets.size());
+            for (size_t i = 0; i < grid.hiddenFlagOffsets.size(); i++)
+            {
+                uint64_t offset = grid.hiddenFlagOffsets[i];
+                Assert::IsTrue(offset >= 8 && offset < file.size());
+                Assert::AreEqual(uint8_t(1), file[static_cast<size_t>(offset)]);
+                Assert::AreEqual(0, memcmp(&file[static_cast<size_t>(offset) - 7], "infe", 4));
+
+                if (i > 0) Assert::IsTrue(offset > grid.hiddenFlagOffsets[i - 1]);
+            }
+        }
+
+        TEST_METHOD(DescriptorInIdat)
+        {
+            auto file = MakeGridFile({ true, true, false });
+
+            HeifGrid grid;
+            Assert::IsTrue(ParseHeifGrid(file.data(), file.size(), sc_gridItemId, grid));
+
+            Assert::AreEqual(1000u, grid.outputWidth);
+            Assert::AreEqual(900u, grid.outputHeight);
+            Assert::AreEqual(size_t(4), grid.tileIds.size());
+        }
+
+        TEST_METHOD(RejectsTransformedGrid)
+        {
+            auto file = MakeGridFile({ false, false, true });
+
+            HeifGrid grid;
+            Assert::IsFalse(ParseHeifGrid(file.data(), file.size(), sc_gridItemId, grid));
+        }
+
+        TEST_METHOD(RejectsOtherItemsAndTruncatedFiles)
+        {
+            auto file = MakeGridFile({ false, false, false });
+
+            HeifGrid grid;
+            Assert::IsFalse(ParseHeifGrid(file.data(), file.size(), sc_firstTileId, grid));
+            Assert::IsFalse(ParseHeifGrid(file.data(), file.size(), 99, grid));
+
+            // Every cut through the meta box leaves it invalid.
+            for (size_t size = file.size() - 1; size > file.size() - 200; size--)
+            {
+                Assert::IsFalse(ParseHeifGrid(file.data(), size, sc_gridItemId, grid));
+            }
+        }
+    };
+}
@@ -0,0 +1,115 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "..\DXRenderer\CpuRender\JpegMpfParser.h"
+
+using namespace DXRenderer;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTests
+{
+    // APP2 MPF segment as written by iPhones: big endian, a baseline primary image and one
+    // undefined image (the gain map). Sizes and the gain map offset are filled in by MakeJpegHead.
+    const uint8_t sc_appleMpfSegment[] = {
+        0xFF, 0xE2, 0x00, 0x58, 0x4D, 0x50, 0x46, 0x00, 0x4D, 0x4D, 0x00, 0x2A,
+        0x00, 0x00, 0x00, 0x08, 0x00, 0x03, 0xB0, 0x00, 0x00, 0x07, 0x00, 0x00,
+        0x00, 0x04, 0x30, 0x31, 0x30, 0x30, 0xB0, 0x01, 0x00, 0x04, 0x00, 0x00,
+        0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0xB0, 0x02, 0x00, 0x07, 0x00, 0x00,
+        0x00, 0x20, 0x00, 0x00, 0x00, 0x32, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+
+    const size_t sc_primarySizeOffset = 62;
+    const size_t sc_secondarySizeOffset = 78;
+    const size_t sc_secondaryOffsetOffset = 82;
+    const size_t sc_versionOffset = 26;
+
+    void WriteBigEndian32(std::vector<uint8_t>& data, size_t offset, uint32_t value)
+    {
+        data[offset + 0] = static_cast<uint8_t>(value >> 24);
+        data[offset + 1] = static_cast<uint8_t>(value >> 16);
+        data[offset + 2] = static_cast<uint8_t>(value >> 8);
+        data[offset + 3] = static_cast<uint8_t>(value);
+    }
+
+    /// <summary>
+    /// SOI, an APP1 segment, the MPF segment and SOS. Returns where the MPF segment starts.
+    /// </summary>
+    size_t MakeJpegHead(std::vector<uint8_t>& head, uint32_t primarySize, uint32_t secondarySize, uint32_t secondaryOffset)
+    {
+        head = { 0xFF, 0xD8, 0xFF, 0xE1, 0x00, 0x06, 'E', 'x', 'i', 'f' };
+
+        size_t mpf = head.size();
+        head.insert(head.end(), std::begin(sc_appleMpfSegment), std::end(sc_appleMpfSegment));
+        WriteBigEndian32(head, mpf + sc_primarySizeOffset, primarySize);
+        WriteBigEndian32(head, mpf + sc_secondarySizeOffset, secondarySize);
+        WriteBigEndian32(head, mpf + sc_secondaryOffsetOffset, secondaryOffset);
+
+        head.insert(head.end(), { 0xFF, 0xDA, 0x00, 0x02 });
+        return mpf;
+    }
+
+    TEST_CLASS(JpegMpfParserTests)
+    {
+    public:
+        TEST_METHOD(AppleGainMapIndex)
+        {
+            std::vector<uint8_t> head;
+            size_t mpf = MakeJpegHead(head, 100000, 20000, 100000);
+
+            // Offsets in the MP Entry table are relative to the TIFF header after "MPF\0".
+            uint64_t tiff = mpf + 8;
+
+            MpfIndex index = {};
+            Assert::IsTrue(ParseJpegMpf(head.data(), head.size(), 200000, index));
+            Assert::AreEqual(2u, index.count);
+
+            Assert::AreEqual(sc_MpfTypeBaselinePrimary, index.images[0].GetType());
+            Assert::AreEqual(0ull, static_cast<unsigned long long>(index.images[0].offset));
+            Assert::AreEqual(100000u, index.images[0].size);
+
+            Assert::AreEqual(sc_MpfTypeUndefined, index.images[1].GetType());
+            Assert::IsTrue(index.images[1].IsJpeg());
+            Assert::AreEqual(static_cast<unsigned long long>(tiff + 100000), static_cast<unsigned long long>(index.images[1].offset));
+            Assert::AreEqual(20000u, index.images[1].size);
+        }
+
+        TEST_METHOD(RejectsInvalidIndex)
+        {
+            std::vector<uint8_t> head;
+            MpfIndex index = {};
+
+            // Second image runs past the end of the file.
+            MakeJpegHead(head, 100000, 20000, 100000);
+            Assert::IsFalse(ParseJpegMpf(head.data(), head.size(), 110000, index));
+            Assert::AreEqual(0u, index.count);
+
+            // Second image overlaps the primary image.
+            MakeJpegHead(head, 100000, 20000, 50000);
+            Assert::IsFalse(ParseJpegMpf(head.data(), head.size(), 200000, index));
+
+            // Unknown MPF version.
+            size_t mpf = MakeJpegHead(head, 100000, 20000, 100000);
+            head[mpf + sc_versionOffset] = '9';
+            Assert::IsFalse(ParseJpegMpf(head.data(), head.size(), 200000, index));
+
+            // MPF segment cut off by the end of the head.
+            MakeJpegHead(head, 100000, 20000, 100000);
+            Assert::IsFalse(ParseJpegMpf(head.data(), mpf + 40, 200000, index));
+
+            // Not a JPEG.
+            head[1] = 0x00;
+            Assert::IsFalse(ParseJpegMpf(head.data(), head.size(), 200000, index));
+        }
+
+        TEST_METHOD(NoMpfSegment)
+        {
+            const uint8_t head[] = { 0xFF, 0xD8, 0xFF, 0xE1, 0x00, 0x06, 'E', 'x', 'i', 'f', 0xFF, 0xDA, 0x00, 0x02 };
+
+            MpfIndex index = {};
+            Assert::IsFalse(ParseJpegMpf(head, sizeof(head), 1000, index));
+        }
+    };
+}
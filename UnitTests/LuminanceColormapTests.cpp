@@ -0,0 +1,93 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "..\DXRenderer\CpuRender\LuminanceColormap.h"
+
+using namespace DirectX;
+using namespace DXRenderer;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTests
+{
+    // Interpolating the LUT instead of the stops is this close, per channel.
+    const float sc_colormapTolerance = 0.01f;
+
+    XMVECTOR GrayOfNits(float nits)
+    {
+        float value = nits / 80.0f;
+        return XMVectorSet(value, value, value, 1.0f);
+    }
+
+    void AssertColor(const XMFLOAT4& expected, FXMVECTOR actual)
+    {
+        XMFLOAT4 color;
+        XMStoreFloat4(&color, actual);
+
+        Assert::AreEqual(expected.x, color.x, sc_colormapTolerance);
+        Assert::AreEqual(expected.y, color.y, sc_colormapTolerance);
+        Assert::AreEqual(expected.z, color.z, sc_colormapTolerance);
+        Assert::AreEqual(expected.w, color.w, sc_colormapTolerance);
+    }
+
+    TEST_CLASS(LuminanceColormapTests)
+    {
+    public:
+        TEST_METHOD(HeatmapStops)
+        {
+            LuminanceColormap colormap;
+
+            for (auto& stop : colormap.GetStops())
+            {
+                AssertColor(stop.color, colormap.Map(GrayOfNits(stop.nits)));
+            }
+
+            // Halfway between green at 31.6 and yellow at 100 nits, linear in nits.
+            AssertColor({ 0.5f, 1.0f, 0.0f, 1.0f }, colormap.Map(GrayOfNits(65.8f)));
+
+            // Outside the stops.
+            AssertColor({ 0.0f, 0.0f, 0.0f, 0.0f }, colormap.Map(GrayOfNits(10001.0f)));
+            AssertColor({ 0.0f, 0.0f, 0.0f, 0.0f }, colormap.Map(GrayOfNits(-1.0f)));
+        }
+
+        TEST_METHOD(ExposureBands)
+        {
+            const ColormapStop bands[] =
+            {
+                { 10.0f,  { 0.0f, 0.0f, 1.0f, 1.0f } },
+                { 50.0f,  { 0.0f, 0.0f, 1.0f, 1.0f } },
+                { 50.0f,  { 0.0f, 1.0f, 0.0f, 1.0f } },
+                { 200.0f, { 0.0f, 1.0f, 0.0f, 1.0f } },
+            };
+
+            LuminanceColormap colormap;
+            Assert::IsTrue(colormap.SetStops(bands, ARRAYSIZE(bands)));
+
+            AssertColor({ 0.0f, 0.0f, 1.0f, 1.0f }, colormap.Map(GrayOfNits(48.0f)));
+            AssertColor({ 0.0f, 1.0f, 0.0f, 1.0f }, colormap.Map(GrayOfNits(52.0f)));
+            AssertColor({ 0.0f, 0.0f, 0.0f, 0.0f }, colormap.Map(GrayOfNits(5.0f)));
+        }
+
+        TEST_METHOD(RejectsInvalidStops)
+        {
+            const ColormapStop descending[] =
+            {
+                { 100.0f, { 1.0f, 1.0f, 1.0f, 1.0f } },
+                { 10.0f,  { 0.0f, 0.0f, 0.0f, 1.0f } },
+            };
+
+            const ColormapStop empty[] =
+            {
+                { 10.0f, { 1.0f, 1.0f, 1.0f, 1.0f } },
+                { 10.0f, { 0.0f, 0.0f, 0.0f, 1.0f } },
+            };
+
+            LuminanceColormap colormap;
+            Assert::IsFalse(colormap.SetStops(descending, ARRAYSIZE(descending)));
+            Assert::IsFalse(colormap.SetStops(empty, ARRAYSIZE(empty)));
+            Assert::IsFalse(colormap.SetStops(descending, 1));
+
+            // Unchanged.
+            Assert::AreEqual(size_t(9), colormap.GetStops().size());
+        }
+    };
+}
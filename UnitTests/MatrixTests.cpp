@@ -0,0 +1,87 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "..\DXRenderer\Matrix.h"
+
+using namespace DXRenderer;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTests
+{
+    // Standard color spaces are derived at compile time.
+    static_assert(sc_ScRgbToXyz(1, 0) > 0.2126 && sc_ScRgbToXyz(1, 0) < 0.2127, "BT.709 luminance of red");
+    static_assert((sc_XyzToScRgb * sc_ScRgbToXyz)(2, 2) > 0.999999, "Invert");
+
+    void AssertMatrixEqual(const ColorMatrix& expected, const ColorMatrix& actual, double tolerance)
+    {
+        for (size_t i = 0; i < 9; i++)
+        {
+            Assert::AreEqual(expected.M[i], actual.M[i], tolerance);
+        }
+    }
+
+    TEST_CLASS(MatrixTests)
+    {
+    public:
+        TEST_METHOD(InvertAndMultiply)
+        {
+            ColorMatrix m = { { 2.0, 0.5, -1.0, 0.25, 3.0, 0.0, 1.0, -0.5, 1.5 } };
+
+            AssertMatrixEqual(ColorMatrix::Identity(), m * m.Invert(), 1e-12);
+            AssertMatrixEqual(ColorMatrix::Identity(), m.Invert() * m, 1e-12);
+            AssertMatrixEqual(m, m.Transpose().Transpose(), 0.0);
+
+            Vector3<double> v = m * Vector3<double>{ 1.0, 2.0, 3.0 };
+            Assert::AreEqual(0.0, v.x, 1e-12);
+            Assert::AreEqual(6.25, v.y, 1e-12);
+            Assert::AreEqual(4.5, v.z, 1e-12);
+        }
+
+        TEST_METHOD(StandardColorSpaces)
+        {
+            // Published BT.709/sRGB to XYZ matrix, as previously hard coded for scRGB.
+            ColorMatrix bt709 = { {
+                0.4124564, 0.3575761, 0.1804375,
+                0.2126729, 0.7151522, 0.0721750,
+                0.0193339, 0.1191920, 0.9503041 } };
+            AssertMatrixEqual(bt709, sc_ScRgbToXyz, 5e-4);
+
+            // White maps to D65 in every color space, including ProPhoto's adapted D50.
+            auto d65 = ColorMatrix::XyToXyz(sc_D65WhiteX, sc_D65WhiteY);
+
+            for (auto& toXyz : { sc_ScRgbToXyz, sc_DisplayP3ToXyz, sc_Bt2020ToXyz, sc_ProPhotoToXyz })
+            {
+                Vector3<double> white = toXyz * Vector3<double>{ 1.0, 1.0, 1.0 };
+                Assert::AreEqual(d65.x, white.x, 1e-9);
+                Assert::AreEqual(d65.y, white.y, 1e-9);
+                Assert::AreEqual(d65.z, white.z, 1e-9);
+            }
+
+            // BT.2020 primaries in scRGB, see e.g. BT.2087.
+            auto bt2020ToScRgb = sc_XyzToScRgb * sc_Bt2020ToXyz;
+            Assert::AreEqual(1.660491, bt2020ToScRgb(0, 0), 1e-5);
+            Assert::AreEqual(-0.124550, bt2020ToScRgb(1, 0), 1e-5);
+            Assert::AreEqual(-0.018151, bt2020ToScRgb(2, 0), 1e-5);
+            Assert::AreEqual(1.118730, bt2020ToScRgb(2, 2), 1e-5);
+        }
+
+        TEST_METHOD(BradfordAdaptation)
+        {
+            // Published Bradford D50 to D65 matrix; D50 is x = 0.3457, y = 0.3585.
+            ColorMatrix expected = { {
+                 0.9555766, -0.0230393, 0.0631636,
+                -0.0282895,  1.0099416, 0.0210077,
+                 0.0122982, -0.0204830, 1.3299098 } };
+
+            AssertMatrixEqual(expected, ColorMatrix::BradfordAdaptation(0.3457, 0.3585, sc_D65WhiteX, sc_D65WhiteY), 2e-3);
+            AssertMatrixEqual(ColorMatrix::Identity(), ColorMatrix::BradfordAdaptation(0.3127, 0.3290, 0.3127, 0.3290), 1e-12);
+
+            // Display chromaticities at run time; D65 white needs no adaptation.
+            float x = 0.3127f, y = 0.3290f;
+            AssertMatrixEqual(
+                ColorMatrix::RgbToXyz(0.68f, 0.32f, 0.265f, 0.69f, 0.15f, 0.06f, x, y),
+                ColorMatrix::RgbToXyzD65(0.68f, 0.32f, 0.265f, 0.69f, 0.15f, 0.06f, x, y),
+                1e-4);
+        }
+    };
+}
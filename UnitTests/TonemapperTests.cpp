@@ -0,0 +1,91 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "..\DXRenderer\CpuRender\Tonemappers.h"
+
+using namespace DirectX;
+using namespace DXRenderer;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTests
+{
+    // 4000 nits mastering to a 600 nit display, in scRGB.
+    const float sc_tonemapInputMax = 50.0f;
+    const float sc_tonemapOutputMax = 7.5f;
+
+    const TonemapOperator sc_tonemapOperators[] =
+    {
+        TonemapOperator::Reinhard,
+        TonemapOperator::ReinhardExtended,
+        TonemapOperator::Bt2390,
+        TonemapOperator::AcesFitted,
+        TonemapOperator::Hable,
+    };
+
+    float TonemapGray(TonemapOperator op, float inputMax, float outputMax, float value)
+    {
+        float result = 0.0f;
+        DispatchTonemapper(op, inputMax, outputMax, [&](const auto& tonemapper)
+        {
+            result = XMVectorGetX(tonemapper(XMVectorSet(value, value, value, 1.0f)));
+        });
+
+        return result;
+    }
+
+    TEST_CLASS(TonemapperTests)
+    {
+    public:
+        TEST_METHOD(InputMaxReachesOutputMax)
+        {
+            for (auto op : sc_tonemapOperators)
+            {
+                // Reinhard only approaches output max.
+                if (op == TonemapOperator::Reinhard) continue;
+
+                Assert::AreEqual(sc_tonemapOutputMax, TonemapGray(op, sc_tonemapInputMax, sc_tonemapOutputMax, sc_tonemapInputMax), 0.01f);
+            }
+        }
+
+        TEST_METHOD(Monotonic)
+        {
+            for (auto op : sc_tonemapOperators)
+            {
+                float previous = 0.0f;
+
+                for (float value = 0.05f; value <= sc_tonemapInputMax; value *= 1.25f)
+                {
+                    float mapped = TonemapGray(op, sc_tonemapInputMax, sc_tonemapOutputMax, value);
+
+                    Assert::IsTrue(mapped >= previous);
+                    Assert::IsTrue(mapped <= sc_tonemapOutputMax * 1.0001f);
+                    previous = mapped;
+                }
+            }
+        }
+
+        TEST_METHOD(IdentityWhenContentFits)
+        {
+            for (auto op : { TonemapOperator::ReinhardExtended, TonemapOperator::Bt2390 })
+            {
+                for (float value : { 0.1f, 1.0f, 5.0f })
+                {
+                    Assert::AreEqual(value, TonemapGray(op, 5.0f, 7.5f, value), value * 0.001f);
+                }
+            }
+        }
+
+        TEST_METHOD(SignAndAlpha)
+        {
+            Tonemapper<HableCurve<>> tonemapper(sc_tonemapInputMax, sc_tonemapOutputMax);
+
+            XMFLOAT4 color;
+            XMStoreFloat4(&color, tonemapper(XMVectorSet(-2.0f, 2.0f, 0.0f, 0.25f)));
+
+            Assert::AreEqual(-color.y, color.x);
+            Assert::IsTrue(color.y > 0.0f);
+            Assert::AreEqual(0.0f, color.z, 1e-6f);
+            Assert::AreEqual(0.25f, color.w);
+        }
+    };
+}
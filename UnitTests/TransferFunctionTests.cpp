@@ -0,0 +1,214 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "..\DXRenderer\CpuRender\TransferFunctions.h"
+
+#include <limits>
+
+using namespace DirectX;
+using namespace DXRenderer;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTests
+{
+    // Straight from BT.2100, in double precision, independent of the code under test.
+    double ReferencePqEotf(double e)
+    {
+        const double m1 = 0.1593017578125, m2 = 78.84375, c1 = 0.8359375, c2 = 18.8515625, c3 = 18.6875;
+        double p = pow(e, 1.0 / m2);
+        return pow((std::max)(p - c1, 0.0) / (c2 - c3 * p), 1.0 / m1);
+    }
+
+    double ReferencePqInverseEotf(double y)
+    {
+        const double m1 = 0.1593017578125, m2 = 78.84375, c1 = 0.8359375, c2 = 18.8515625, c3 = 18.6875;
+        double ym = pow(y, m1);
+        return pow((c1 + c2 * ym) / (1.0 + c3 * ym), m2);
+    }
+
+    double ReferenceHlgOetf(double e)
+    {
+        const double a = 0.17883277, b = 0.28466892, c = 0.55991073;
+        return (e <= 1.0 / 12.0) ? sqrt(3.0 * e) : a * log(12.0 * e - b) + c;
+    }
+
+    double ReferenceHlgInverseOetf(double v)
+    {
+        const double a = 0.17883277, b = 0.28466892, c = 0.55991073;
+        return (v <= 0.5) ? v * v / 3.0 : (exp((v - c) / a) + b) / 12.0;
+    }
+
+    /// <summary>
+    /// Largest error seen, relative where the reference is at least relativeFloor and absolute below it.
+    /// </summary>
+    struct MaxError
+    {
+        double relativeFloor = 0.0;
+        double relative = 0.0;
+        double absolute = 0.0;
+
+        void Add(double reference, double actual)
+        {
+            double error = fabs(actual - reference);
+            if (relativeFloor > 0.0 && reference >= relativeFloor)
+            {
+                relative = (std::max)(relative, error / reference);
+            }
+            else
+            {
+                absolute = (std::max)(absolute, error);
+            }
+        }
+    };
+
+    const unsigned int sc_testBitDepths[] = { 10, 12, 16 };
+
+    TEST_CLASS(TransferFunctionTests)
+    {
+    public:
+        // The bounds below are the ones documented in TransferFunctions.h.
+
+        TEST_METHOD(PqEotfAllCodeValues)
+        {
+            for (unsigned int bits : sc_testBitDepths)
+            {
+                unsigned int maxCode = (1u << bits) - 1;
+
+                std::vector<float> table;
+                BuildLinearizeTable(TransferFunction::Pq, bits, table);
+                Assert::AreEqual(static_cast<size_t>(maxCode) + 1, table.size());
+
+                MaxError tableError, scalarError, vectorError;
+                tableError.relativeFloor = scalarError.relativeFloor = vectorError.relativeFloor = 1e-7;
+
+                for (unsigned int code = 0; code <= maxCode; code += 4)
+                {
+                    float v[4];
+                    for (unsigned int i = 0; i < 4; i++)
+                    {
+                        v[i] = static_cast<float>((std::min)(code + i, maxCode)) / maxCode;
+                    }
+
+                    XMFLOAT4 results;
+                    XMStoreFloat4(&results, PqEotf(XMVectorSet(v[0], v[1], v[2], v[3])));
+                    const float* lanes = &results.x;
+
+                    for (unsigned int i = 0; i < 4; i++)
+                    {
+                        unsigned int c = (std::min)(code + i, maxCode);
+                        double exact = ReferencePqEotf(static_cast<double>(c) / maxCode);
+                        double fromFloat = ReferencePqEotf(v[i]);
+
+                        tableError.Add(exact, table[c]);
+                        scalarError.Add(fromFloat, PqEotf(v[i]));
+                        vectorError.Add(fromFloat, lanes[i]);
+                    }
+                }
+
+                Assert::IsTrue(tableError.relative <= 1e-7 && tableError.absolute <= 1e-12, L"PQ EOTF table");
+                Assert::IsTrue(scalarError.relative <= 1e-4 && scalarError.absolute <= 1e-12, L"PQ EOTF scalar");
+                Assert::IsTrue(vectorError.relative <= 5e-4 && vectorError.absolute <= 1e-12, L"PQ EOTF XMVECTOR");
+            }
+
+            Assert::AreEqual(1.0f, PqEotf(1.0f), 1e-6f);
+            Assert::AreEqual(0.0f, PqEotf(0.0f));
+        }
+
+        TEST_METHOD(PqInverseEotfAllCodeValues)
+        {
+            PqInverseEotfTable encoder;
+
+            for (unsigned int bits : sc_testBitDepths)
+            {
+                unsigned int maxCode = (1u << bits) - 1;
+
+                std::vector<float> table;
+                BuildLinearizeTable(TransferFunction::Pq, bits, table);
+
+                MaxError tableError, scalarError, vectorError;
+
+                for (unsigned int code = 0; code <= maxCode; code++)
+                {
+                    // Encode the linear value of every code, which must round back to the code.
+                    float y = table[code];
+                    double reference = ReferencePqInverseEotf(y);
+
+                    tableError.Add(reference, encoder(y));
+                    scalarError.Add(reference, PqInverseEotf(y));
+                    vectorError.Add(reference, XMVectorGetX(PqInverseEotf(XMVectorReplicate(y))));
+
+                    Assert::AreEqual(code, static_cast<unsigned int>(encoder(y) * maxCode + 0.5f));
+                }
+
+                Assert::IsTrue(tableError.absolute <= 1e-5, L"PQ inverse EOTF table");
+                Assert::IsTrue(scalarError.absolute <= 3e-5, L"PQ inverse EOTF scalar");
+                Assert::IsTrue(vectorError.absolute <= 5e-5, L"PQ inverse EOTF XMVECTOR");
+            }
+
+            // Between table entries and below the smallest one.
+            MaxError denseError;
+            for (double y = 1e-14; y <= 1.0; y *= 1.0001)
+            {
+                float yf = static_cast<float>(y);
+                denseError.Add(ReferencePqInverseEotf(yf), encoder(yf));
+            }
+
+            Assert::IsTrue(denseError.absolute <= 1e-5, L"PQ inverse EOTF table between codes");
+            Assert::AreEqual(1.0f, encoder(2.0f), 1e-6f);
+            Assert::AreEqual(encoder(0.0f), encoder(std::numeric_limits<float>::quiet_NaN()));
+        }
+
+        TEST_METHOD(HlgAllCodeValues)
+        {
+            for (unsigned int bits : sc_testBitDepths)
+            {
+                unsigned int maxCode = (1u << bits) - 1;
+
+                std::vector<float> table;
+                BuildLinearizeTable(TransferFunction::Hlg, bits, table);
+
+                MaxError tableError, scalarError, vectorError, oetfScalarError, oetfVectorError;
+                tableError.relativeFloor = scalarError.relativeFloor = vectorError.relativeFloor = 1e-30;
+
+                for (unsigned int code = 0; code <= maxCode; code++)
+                {
+                    float v = static_cast<float>(code) / maxCode;
+                    double reference = ReferenceHlgInverseOetf(v);
+
+                    tableError.Add(ReferenceHlgInverseOetf(static_cast<double>(code) / maxCode), table[code]);
+                    scalarError.Add(reference, HlgInverseOetf(v));
+                    vectorError.Add(reference, XMVectorGetX(HlgInverseOetf(XMVectorReplicate(v))));
+
+                    // And back again.
+                    float e = table[code];
+                    double oetfReference = ReferenceHlgOetf(e);
+
+                    oetfScalarError.Add(oetfReference, HlgOetf(e));
+                    oetfVectorError.Add(oetfReference, XMVectorGetX(HlgOetf(XMVectorReplicate(e))));
+                }
+
+                Assert::IsTrue(tableError.relative <= 1e-7, L"HLG inverse OETF table");
+                Assert::IsTrue(scalarError.relative <= 1e-6, L"HLG inverse OETF scalar");
+                Assert::IsTrue(vectorError.relative <= 2e-5, L"HLG inverse OETF XMVECTOR");
+                Assert::IsTrue(oetfScalarError.absolute <= 1e-6, L"HLG OETF scalar");
+                Assert::IsTrue(oetfVectorError.absolute <= 2e-5, L"HLG OETF XMVECTOR");
+            }
+        }
+
+        TEST_METHOD(HlgOotfScalesByLuminance)
+        {
+            Assert::AreEqual(1.2f, HlgSystemGamma(1000.0f), 1e-6f);
+
+            // Neutral colors are raised to the system gamma; alpha passes through.
+            XMFLOAT4 result;
+            XMStoreFloat4(&result, DXRenderer::HlgOotf(XMVectorSet(0.5f, 0.5f, 0.5f, 0.25f), 1.2f));
+
+            Assert::AreEqual(powf(0.5f, 1.2f), result.x, 1e-4f);
+            Assert::AreEqual(powf(0.5f, 1.2f), result.z, 1e-4f);
+            Assert::AreEqual(0.25f, result.w);
+
+            XMStoreFloat4(&result, DXRenderer::HlgOotf(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), 1.2f));
+            Assert::AreEqual(0.0f, result.x);
+        }
+    };
+}
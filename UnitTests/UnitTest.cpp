@@ -1,8 +1,10 @@
 #include "pch.h"
 #include "CppUnitTest.h"
 
-#include "..\HDRImageViewer\ImageLoader.h"
-using namespace HDRImageViewer;
+#include "..\DXRenderer\ImageLoader.h"
+#include <DirectXTex.h>
+#include <DirectXPackedVector.h>
+using namespace DXRenderer;
 
 using namespace concurrency;
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -21,26 +23,26 @@ namespace UnitTests
     {
         std::wstring                        filename;
         bool                                useWic; // Either WIC or DirectXTex to decode.
-        HDRImageViewer::ImageInfo   info;
-        HDRImageViewer::ImageCLL    cllInfo;
+        DXRenderer::ImageInfo       info;
+        DXRenderer::ImageCLL        cllInfo;
     };
 
     TEST_CLASS(ImageLoaderTests)
     {
     public:
-        std::shared_ptr<DX::DeviceResources> m_devRes;
+        std::shared_ptr<DeviceResources> m_devRes;
 
         TEST_METHOD_INITIALIZE(methodName)
         {
 			// TODO: Move device resource initialization to test method initialize.
-            // m_devRes = std::make_shared<DX::DeviceResources>();
+            // m_devRes = std::make_shared<DeviceResources>();
         }
 
         TEST_METHOD(LoadValidWicImages)
         {
             HRESULT hr = S_OK;
 
-            m_devRes = std::make_shared<DX::DeviceResources>();
+            m_devRes = std::make_shared<DeviceResources>();
 
             TestInputDefinition definitions[] = {
                 // Filename                     |useWIC | bpp |bpc|isfloat|pixelsize    |numICC| ACKind                               |isXbox|valid| maxCLL|medCLL
@@ -67,20 +69,21 @@ namespace UnitTests
                     ComPtr<IStream> iStream;
                     CreateStreamOverRandomAccessStream(stream, IID_PPV_ARGS(&iStream));
 
-                    auto loader = std::make_unique<ImageLoader>(m_devRes);
+                    ImageLoaderOptions options = {};
+                    auto loader = std::make_unique<ImageLoader>(m_devRes, options);
                     Assert::IsTrue(loader->GetState() == ImageLoaderState::NotInitialized);
 
                     ImageInfo info = loader->LoadImageFromWic(iStream.Get());
                     Assert::IsTrue(loader->GetState() == ImageLoaderState::LoadingSucceeded);
 
-                    auto imageSource = loader->GetLoadedImage(1.0f);
-                    auto imageSource2 = loader->GetLoadedImage(0.5f);
+                    auto imageSource = loader->GetLoadedImage(1.0f, false);
+                    auto imageSource2 = loader->GetLoadedImage(0.5f, false);
 
                     Assert::AreEqual(info.bitsPerPixel, definitions[i].info.bitsPerPixel);
                     Assert::AreEqual(info.bitsPerChannel, definitions[i].info.bitsPerChannel);
                     Assert::AreEqual(info.isFloat, definitions[i].info.isFloat);
-                    Assert::AreEqual(info.size.Width, definitions[i].info.size.Width);
-                    Assert::AreEqual(info.size.Height, definitions[i].info.size.Height);
+                    Assert::AreEqual(info.pixelSize.Width, definitions[i].info.pixelSize.Width);
+                    Assert::AreEqual(info.pixelSize.Height, definitions[i].info.pixelSize.Height);
                     Assert::AreEqual(info.countColorProfiles, definitions[i].info.countColorProfiles);
                     Assert::IsTrue(info.imageKind == definitions[i].info.imageKind);
                     Assert::AreEqual(info.forceBT2100ColorSpace, definitions[i].info.forceBT2100ColorSpace);
@@ -97,5 +100,97 @@ namespace UnitTests
                 });
             }
         }
+
+        TEST_METHOD(LoadHeifBitmapsWithForceBT2100)
+        {
+            m_devRes = std::make_shared<DeviceResources>();
+            auto wicFactory = m_devRes->GetWicImagingFactory();
+
+            // libheif decodes HDR10 HEIFs to FP16 scRGB and SDR HEIFs to 8 bit sRGB, so the
+            // ForceBT2100 override must not treat these as 10 bit BT.2100 WIC frames.
+            const WICPixelFormatGUID formats[] = { GUID_WICPixelFormat64bppPRGBAHalf, GUID_WICPixelFormat32bppPBGRA };
+
+            for (auto& format : formats)
+            {
+                ComPtr<IWICBitmap> bitmap;
+                TESTHR(wicFactory->CreateBitmap(16, 8, format, WICBitmapCacheOnDemand, &bitmap));
+
+                ImageLoaderOptions options = {};
+                options.type = ImageLoaderOptionsType::ForceBT2100;
+                auto loader = std::make_unique<ImageLoader>(m_devRes, options);
+
+                ImageInfo info = loader->LoadHeifBitmapTest(bitmap.Get());
+                Assert::IsTrue(loader->GetState() == ImageLoaderState::NeedDeviceResources);
+
+                Assert::IsTrue(info.isHeif);
+                Assert::IsTrue(info.isValid);
+                Assert::IsFalse(info.forceBT2100ColorSpace);
+                Assert::AreEqual(16.0f, info.pixelSize.Width);
+                Assert::AreEqual(8.0f, info.pixelSize.Height);
+
+                loader->CreateDeviceDependentResources();
+                Assert::IsTrue(loader->GetState() == ImageLoaderState::LoadingSucceeded);
+                Assert::IsNotNull(loader->GetLoadedImage(1.0f, false));
+            }
+        }
+
+        TEST_METHOD(LoadFittedDdsMipLevel)
+        {
+            m_devRes = std::make_shared<DeviceResources>();
+
+            // 256x128 with a full mip chain; every pixel of level n is n + 1, so the decoded level can be told apart.
+            DirectX::ScratchImage mips;
+            TESTHR(mips.Initialize2D(DXGI_FORMAT_R16G16B16A16_FLOAT, 256, 128, 1, 0));
+            for (size_t level = 0; level < mips.GetMetadata().mipLevels; level++)
+            {
+                auto image = mips.GetImage(level, 0, 0);
+                auto value = DirectX::PackedVector::XMConvertFloatToHalf(static_cast<float>(level + 1));
+                for (size_t y = 0; y < image->height; y++)
+                {
+                    auto row = reinterpret_cast<DirectX::PackedVector::HALF*>(image->pixels + y * image->rowPitch);
+                    std::fill(row, row + image->width * 4, value);
+                }
+            }
+
+            DirectX::ScratchImage bc6h;
+            TESTHR(DirectX::Compress(mips.GetImages(), mips.GetImageCount(), mips.GetMetadata(),
+                DXGI_FORMAT_BC6H_UF16, DirectX::TEX_COMPRESS_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, bc6h));
+
+            auto path = Windows::Storage::ApplicationData::Current->TemporaryFolder->Path + L"\\FittedMips.dds";
+            TESTHR(DirectX::SaveToDDSFile(bc6h.GetImages(), bc6h.GetImageCount(), bc6h.GetMetadata(), DirectX::DDS_FLAGS_NONE, path->Data()));
+
+            // A quarter of the full size in each dimension fits level 2 (64x32).
+            ImageLoaderOptions options = {};
+            options.fitSize = Size(64, 64);
+            auto loader = std::make_unique<ImageLoader>(m_devRes, options);
+
+            ImageInfo info = loader->LoadImageFromDirectXTex(path, L".dds");
+            Assert::IsTrue(loader->GetState() == ImageLoaderState::NeedDeviceResources);
+
+            // Layout and zoom limits still see the full resolution image.
+            Assert::AreEqual(256.0f, info.pixelSize.Width);
+            Assert::AreEqual(128.0f, info.pixelSize.Height);
+
+            ComPtr<IWICBitmap> bitmap;
+            TESTHR(loader->GetDecodedImage()->QueryInterface(IID_PPV_ARGS(&bitmap)));
+
+            UINT width = 0, height = 0;
+            TESTHR(bitmap->GetSize(&width, &height));
+            Assert::AreEqual(64u, width);
+            Assert::AreEqual(32u, height);
+
+            ComPtr<IWICBitmapLock> lock;
+            TESTHR(bitmap->Lock(nullptr, WICBitmapLockRead, &lock));
+
+            UINT size = 0;
+            WICInProcPointer data = nullptr;
+            TESTHR(lock->GetDataPointer(&size, &data));
+            Assert::AreEqual(3.0f, DirectX::PackedVector::XMConvertHalfToFloat(reinterpret_cast<DirectX::PackedVector::HALF*>(data)[0]), 0.01f);
+            lock.Reset();
+
+            loader->CreateDeviceDependentResources();
+            Assert::IsTrue(loader->GetState() == ImageLoaderState::LoadingSucceeded);
+            Assert::IsNotNull(loader->GetLoadedImage(0.25f, false));
+        }
     };
-}
\ No newline at end of file
+}